@@ -5,7 +5,12 @@
       ['OS=="mac"', {
         'sources' : [ "src/macadam_util.cc", "src/macadam.cc",
           "src/capture_promise.cc", "src/playback_promise.cc",
-          "src/timecode.cc", "src/converted_frame.cc" ],
+          "src/timecode.cc", "src/converted_frame.cc",
+          "src/worker_pool.cc", "src/pixel_convert.cc",
+          "src/input_allocator.cc", "src/ancillary_decode.cc",
+          "src/audio_convert.cc", "src/audio_ring.cc",
+          "src/recorder.cc", "src/shared_ring.cc",
+          "src/video_qc.cc", "src/output_pool.cc" ],
         'xcode_settings': {
           'GCC_ENABLE_CPP_RTTI': 'YES',
           'MACOSX_DEPLOYMENT_TARGET': '10.7',
@@ -27,13 +32,18 @@
       ['OS=="linux"', {
         'sources' : [ "src/macadam_util.cc", "src/macadam.cc",
           "src/capture_promise.cc", "src/playback_promise.cc",
-          "src/timecode.cc", "src/converted_frame.cc" ],
+          "src/timecode.cc", "src/converted_frame.cc",
+          "src/worker_pool.cc", "src/pixel_convert.cc",
+          "src/input_allocator.cc", "src/ancillary_decode.cc",
+          "src/audio_convert.cc", "src/audio_ring.cc",
+          "src/recorder.cc", "src/shared_ring.cc",
+          "src/video_qc.cc", "src/output_pool.cc" ],
         'link_settings' : {
           "libraries": [
             "/usr/lib/libDeckLinkAPI.so"
           ],
           "ldflags" : [
-            "-lm -ldl -lpthread"
+            "-lm -ldl -lpthread -lrt"
 	      ]
         },
         "include_dirs" : [
@@ -44,6 +54,11 @@
         "sources" : [ "src/macadam_util.cc", "src/macadam.cc",
           "src/capture_promise.cc", "src/playback_promise.cc",
           "src/timecode.cc", "src/converted_frame.cc",
+          "src/worker_pool.cc", "src/pixel_convert.cc",
+          "src/input_allocator.cc", "src/ancillary_decode.cc",
+          "src/audio_convert.cc", "src/audio_ring.cc",
+          "src/recorder.cc", "src/shared_ring.cc",
+          "src/video_qc.cc", "src/output_pool.cc",
           "decklink/Win/include/DeckLinkAPI_i.c" ],
         "configurations": {
           "Release": {
@@ -860,6 +860,19 @@ var macadam = {
   getDeviceInfo : macadamNative.getDeviceInfo,
   getDeviceConfig : macadamNative.getDeviceConfig,
   setDeviceConfig : macadamNative.setDeviceConfig,
+  // Pixel format utilities
+  swizzleBGRA : macadamNative.swizzleBGRA,
+  convertPixels : macadamNative.convertPixels,
+  // Black, freeze and gamut analysis of a frame
+  analyseFrame : macadamNative.analyseFrame,
+  // Audio format utilities
+  audioToFloat : macadamNative.audioToFloat,
+  // Ancillary data utilities
+  decodeAncillary : macadamNative.decodeAncillary,
+  // Timecode utilities
+  formatTimecode : macadamNative.formatTimecode,
+  // Read frames published to shared memory by a capture
+  openSharedRing : macadamNative.openSharedRing,
   // Raw access to device classes
   DirectCapture : macadamNative.Capture,
   Capture : Capture,
@@ -0,0 +1,67 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Compares native conversion of 16 channels of interleaved audio to planar
+// float32 with the equivalent JavaScript, for one 25fps frame of 48kHz audio
+
+const macadam = require('../index.js');
+
+const channels = 16;
+const frames = 1920;
+const iterations = 2000;
+
+function jsToFloat(data, sampleType, channels) {
+  let bytes = sampleType / 8;
+  let count = data.length / (channels * bytes);
+  let planar = [];
+  for ( let c = 0 ; c < channels ; c++ ) {
+    let plane = new Float32Array(count);
+    if (sampleType === 16) {
+      for ( let i = 0 ; i < count ; i++ ) {
+        plane[i] = data.readInt16LE((i * channels + c) * 2) / 32768;
+      }
+    } else {
+      for ( let i = 0 ; i < count ; i++ ) {
+        plane[i] = data.readInt32LE((i * channels + c) * 4) / 2147483648;
+      }
+    }
+    planar.push(plane);
+  }
+  return planar;
+}
+
+for ( let sampleType of [ 16, 32 ] ) {
+  let data = Buffer.alloc(channels * frames * sampleType / 8);
+  for ( let x = 0 ; x < data.length ; x++ ) data[x] = (x * 7919) & 0xff;
+
+  for ( let [ name, fn ] of [
+    [ 'javascript', () => jsToFloat(data, sampleType, channels) ],
+    [ 'scalar', () => macadam.audioToFloat(data,
+      { sampleType: sampleType, channels: channels, kernel: 'scalar' }) ],
+    [ 'avx2', () => macadam.audioToFloat(data,
+      { sampleType: sampleType, channels: channels, kernel: 'avx2' }) ] ] ) {
+    try {
+      fn(); // Warm up
+    } catch (err) {
+      console.log(`${sampleType}-bit ${name}: not available`);
+      continue;
+    }
+    for ( let x = 0 ; x < 100 ; x++ ) fn();
+    let start = process.hrtime();
+    for ( let x = 0 ; x < iterations ; x++ ) fn();
+    let [ s, ns ] = process.hrtime(start);
+    console.log(`${sampleType}-bit ${name}: ${((s * 1e6 + ns / 1e3) / iterations).toFixed(1)}us per frame`);
+  }
+}
@@ -0,0 +1,37 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measures copying frames into the output pool with each available kernel,
+// for 10-bit YUV frames at HD and UHD
+
+const macadam = require('bindings')('macadam');
+
+const iterations = 200;
+
+for ( let [ name, bytes ] of [ [ 'HD', 5120 * 1080 ], [ 'UHD', 10240 * 2160 ] ] ) {
+  for ( let kernel of [ 'memcpy', 'avx2' ] ) {
+    let result;
+    try {
+      macadam.frameCopyTest(bytes, 10, kernel); // Warm up
+      result = macadam.frameCopyTest(bytes, iterations, kernel);
+    } catch (err) {
+      console.log(`${name} ${kernel}: ${err.message}`);
+      continue;
+    }
+    let micros = result.nanos / iterations / 1000;
+    console.log(`${name} ${kernel}: ${micros.toFixed(1)}us per frame,`,
+      `${(bytes / micros / 1000).toFixed(2)}GB/s, ${result.ok ? 'OK' : 'MISMATCH'}.`);
+  }
+}
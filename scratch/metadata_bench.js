@@ -0,0 +1,134 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Compares per-frame metadata objects with binary metadata records.
+// With a device index argument, captures 600 frames in each mode:
+//   node scratch/metadata_bench.js 0
+// Without, models the per-frame work of each mode with no device attached.
+
+const macadam = require('../index.js');
+const { PerformanceObserver } = require('perf_hooks');
+
+const RECORD_SIZE = 72;
+const frames = 600;
+
+let gcCount = 0;
+let gcMillis = 0;
+const obs = new PerformanceObserver(list => {
+  for ( let entry of list.getEntries() ) {
+    gcCount++;
+    gcMillis += entry.duration;
+  }
+});
+obs.observe({ entryTypes: [ 'gc' ] });
+
+function readRecord(view, offset) {
+  return view.getUint32(offset + 0, true) + // sequence
+    view.getUint32(offset + 4, true) + // frameFlags
+    Number(view.getBigInt64(offset + 8, true)) + // frameTime
+    view.getUint32(offset + 40, true) + // timecodeBCD
+    view.getUint32(offset + 52, true); // sampleFrameCount
+}
+
+function readObject(frame) {
+  return frame.video.frameTime + frame.video.frameDuration +
+    (frame.video.timecode ? frame.video.timecode.length : 0) +
+    (frame.audio ? frame.audio.sampleFrameCount : 0);
+}
+
+// Builds the same object graph as the native frame resolver
+function modelObject(x, video, audio) {
+  return { type: 'frame',
+    video: { type: 'videoFrame', width: 1920, height: 1080, rowBytes: 5120,
+      frameTime: x * 1000, frameDuration: 1000, data: video,
+      timecode: `10:00:${('0' + (x / 25 | 0) % 60).slice(-2)}:${('0' + x % 25).slice(-2)}`,
+      userbits: 0, hardwareRefFrameTime: x * 1000 + 17379742688,
+      hardwareRefFrameDuration: 1000 },
+    audio: { type: 'audioPacket', sampleFrameCount: 1920, data: audio } };
+}
+
+function modelRecord(x, view, records, video, audio) {
+  let record = x % records;
+  let offset = record * RECORD_SIZE;
+  view.setUint32(offset + 0, x, true);
+  view.setUint32(offset + 4, 0, true);
+  view.setBigInt64(offset + 8, BigInt(x * 1000), true);
+  view.setBigInt64(offset + 16, 1000n, true);
+  view.setUint32(offset + 40, 0x10000000 | x % 25, true);
+  view.setUint32(offset + 52, 1920, true);
+  return { type: 'frame', record: record, video: video, audio: audio };
+}
+
+async function report(name, count, start, heapStart, check) {
+  let [ s, ns ] = process.hrtime(start);
+  let heap = process.memoryUsage().heapUsed - heapStart;
+  await new Promise(resolve => setTimeout(resolve, 100)); // GC entries arrive asynchronously
+  console.log(`${name}: ${((s * 1e6 + ns / 1e3) / count).toFixed(3)}us per frame,`,
+    `${gcCount} GCs taking ${gcMillis.toFixed(2)}ms, heap growth ${(heap / 1024).toFixed(1)}KiB`,
+    `(check ${check})`);
+  gcCount = 0;
+  gcMillis = 0;
+}
+
+async function model() {
+  const video = Buffer.alloc(16);
+  const audio = Buffer.alloc(16);
+  const modelFrames = frames * 1000;
+  const records = 32;
+  const view = new DataView(new ArrayBuffer(records * RECORD_SIZE));
+  const held = new Array(4); // Frames escape, as they do when queued for JS
+  let check = 0;
+
+  for ( let [ name, fn ] of [
+    [ 'objects', x => readObject(held[x & 3] = modelObject(x, video, audio)) ],
+    [ 'records', x => readRecord(view,
+      (held[x & 3] = modelRecord(x, view, records, video, audio)).record * RECORD_SIZE) ] ] ) {
+    for ( let x = 0 ; x < 10000 ; x++ ) check += fn(x); // Warm up
+    gcCount = 0;
+    gcMillis = 0;
+    let heapStart = process.memoryUsage().heapUsed;
+    let start = process.hrtime();
+    for ( let x = 0 ; x < modelFrames ; x++ ) check += fn(x);
+    await report(`${name} (modelled)`, modelFrames, start, heapStart, check);
+  }
+}
+
+async function device(deviceIndex) {
+  for ( let binary of [ false, true ] ) {
+    let capture = await macadam.capture({
+      deviceIndex: deviceIndex,
+      displayMode: macadam.bmdModeHD1080i50,
+      pixelFormat: macadam.bmdFormat10BitYUV,
+      channels: 2,
+      binaryMetadata: binary
+    });
+    let view = binary ? new DataView(capture.metadata) : null;
+    let check = 0;
+    await capture.frame(); // Start streams
+    gcCount = 0;
+    gcMillis = 0;
+    let heapStart = process.memoryUsage().heapUsed;
+    let start = process.hrtime();
+    for ( let x = 0 ; x < frames ; x++ ) {
+      let frame = await capture.frame();
+      check += binary ? readRecord(view, frame.record * RECORD_SIZE) : readObject(frame);
+    }
+    await report(binary ? 'records' : 'objects', frames, start, heapStart, check);
+    capture.stop();
+  }
+}
+
+let run = (process.argv.length > 2) ? device(+process.argv[2]) : model();
+run.then(() => obs.disconnect(), err => { console.error(err); obs.disconnect(); });
@@ -0,0 +1,30 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+// Measures the ring of pending played() promises against the std::map it
+// replaced, for promises made 5, 50 and 500 frames ahead of playback
+
+const macadam = require('bindings')('macadam');
+
+const frames = 100000;
+
+for ( let depth of [ 5, 50, 500 ] ) {
+  macadam.pendingPlayTest(depth, 1000); // Warm up
+  let result = macadam.pendingPlayTest(depth, frames);
+  console.log(`Depth ${depth}: ring ${(result.ringNanos / frames).toFixed(1)}ns/frame,`,
+    `map ${(result.mapNanos / frames).toFixed(1)}ns/frame, ring size ${result.ringSize},`,
+    `expired ${result.expired}, ${result.ok ? 'OK' : 'MISMATCH'}.`);
+}
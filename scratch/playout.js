@@ -0,0 +1,63 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Plays a test pattern, rolling down a few lines per frame, from the native
+// playout queue, refilling it in batches
+
+const macadam = require('../');
+const fs = require('fs');
+const util = require('util');
+const readFile = util.promisify(fs.readFile);
+
+function shift(b, rowBytes) {
+  return Buffer.concat([b.slice(-rowBytes), b.slice(0, -rowBytes)], b.length);
+}
+
+async function run() {
+  let frame = await readFile(__dirname + '/EBU_3325_1080_7.v210');
+  let playback = await macadam.playback({
+    displayMode: macadam.bmdModeHD1080i50,
+    pixelFormat: macadam.bmdFormat10BitYUV
+  });
+  process.on('SIGINT', () => {
+    console.log('Received SIGINT.');
+    playback.stop();
+    process.exit();
+  });
+  let count = 0;
+  playback.playout({
+    depth: 4,
+    lowWater: 4,
+    queueSize: 12,
+    refill: wanted => {
+      let frames = [];
+      for ( let x = 0 ; x < wanted && count < 500 ; x++, count++ ) {
+        frame = shift(frame, 5120 * 10);
+        frames.push({ video: frame });
+      }
+      if (frames.length > 0) playback.enqueue(frames, { end: count >= 500 });
+    }
+  });
+  let timer = setInterval(() => {
+    let stats = playback.stats();
+    console.log(stats);
+    if (count >= 500 && stats.playoutScheduled === 0) {
+      clearInterval(timer);
+      playback.stop();
+    }
+  }, 1000);
+}
+
+run().catch(console.error);
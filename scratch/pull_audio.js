@@ -0,0 +1,77 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Plays a test pattern at 29.97Hz from the playout queue with a tone pulled
+// from the native audio FIFO. Audio is written in the 1602, 1601, 1602, 1601,
+// 1602 sample sequence for NTSC, but any chunk size would do.
+
+const macadam = require('../');
+const fs = require('fs');
+const util = require('util');
+const readFile = util.promisify(fs.readFile);
+
+const cadence = [ 1602, 1601, 1602, 1601, 1602 ];
+
+function tone(frames, offset) {
+  let b = Buffer.alloc(frames * 4);
+  for ( let x = 0 ; x < frames ; x++ ) {
+    let s = Math.round(Math.sin(2 * Math.PI * 1000 * (offset + x) / 48000) * 8192);
+    b.writeInt16LE(s, x * 4);
+    b.writeInt16LE(s, x * 4 + 2);
+  }
+  return b;
+}
+
+async function run() {
+  let frame = await readFile(__dirname + '/EBU_3325_1080_7.v210');
+  let playback = await macadam.playback({
+    displayMode: macadam.bmdModeHD1080i5994,
+    pixelFormat: macadam.bmdFormat10BitYUV,
+    channels: 2,
+    sampleRate: macadam.bmdAudioSampleRate48kHz,
+    sampleType: macadam.bmdAudioSampleType16bitInteger
+  });
+  process.on('SIGINT', () => {
+    console.log('Received SIGINT.');
+    playback.stop();
+    process.exit();
+  });
+  playback.pullAudio({ targetLevel: 4800 });
+  let count = 0;
+  let samples = 0;
+  playback.playout({
+    refill: wanted => {
+      let frames = [];
+      for ( let x = 0 ; x < wanted && count < 500 ; x++, count++ ) {
+        let chunk = cadence[count % cadence.length];
+        let taken = playback.writeAudio(tone(chunk, samples));
+        if (taken < chunk) console.log(`Audio FIFO full, took ${taken} of ${chunk} sample frames.`);
+        samples += taken;
+        frames.push({ video: frame });
+      }
+      if (frames.length > 0) playback.enqueue(frames);
+    }
+  });
+  let timer = setInterval(() => {
+    let stats = playback.stats();
+    console.log(stats);
+    if (count >= 500 && stats.playoutScheduled === 0) {
+      clearInterval(timer);
+      playback.stop();
+    }
+  }, 1000);
+}
+
+run().catch(console.error);
@@ -0,0 +1,50 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measures analyseFrame on synthetic HD and UHD frames, every line and
+// every other line, against a frame budget at 50Hz
+
+const macadam = require('../index.js');
+
+const iterations = 50;
+const budget = 20; // Milliseconds per frame at 50Hz
+
+function testFrame(pixelFormat, width, height) {
+  let rowBytes = (pixelFormat === macadam.bmdFormat10BitYUV) ?
+    Math.floor((width + 47) / 48) * 128 : width * 2;
+  let frame = Buffer.alloc(rowBytes * height);
+  for ( let x = 0 ; x < frame.length ; x++ ) frame[x] = (x * 7 + (x >> 12)) & 0xff;
+  return frame;
+}
+
+for ( let [ width, height ] of [ [ 1920, 1080 ], [ 3840, 2160 ] ] ) {
+  for ( let pixelFormat of [ macadam.bmdFormat10BitYUV, macadam.bmdFormat8BitYUV ] ) {
+    let frame = testFrame(pixelFormat, width, height);
+    for ( let lineStep of [ 1, 2 ] ) {
+      let options = { pixelFormat, width, height, lineStep };
+      let result = macadam.analyseFrame(frame, options); // Warm up
+      options.previous = result.signature;
+      let start = process.hrtime();
+      for ( let x = 0 ; x < iterations ; x++ ) {
+        macadam.analyseFrame(frame, options);
+      }
+      let [ s, ns ] = process.hrtime(start);
+      let perFrame = (s * 1e3 + ns / 1e6) / iterations;
+      console.log(`${width}x${height} ${macadam.intToBMCode(pixelFormat)} lineStep ${lineStep}:`,
+        `${perFrame.toFixed(3)}ms per frame, native ${result.micros}us,`,
+        `${(perFrame / budget * 100).toFixed(1)}% of a 50Hz frame`);
+    }
+  }
+}
@@ -0,0 +1,39 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Compares the BGRA to RGBA swizzle kernels on a 1080p frame
+
+const macadam = require('../index.js');
+
+const frame = Buffer.alloc(1920 * 1080 * 4);
+const iterations = 200;
+
+for ( let kernel of [ 'scalar', 'ssse3', 'avx2', 'neon', undefined ] ) {
+  let name;
+  try {
+    name = macadam.swizzleBGRA(frame, kernel); // Warm up
+  } catch (err) {
+    console.log(`${kernel}: not available`);
+    continue;
+  }
+  let start = process.hrtime();
+  for ( let x = 0 ; x < iterations ; x++ ) {
+    macadam.swizzleBGRA(frame, kernel);
+  }
+  let [ s, ns ] = process.hrtime(start);
+  let perFrame = (s * 1e3 + ns / 1e6) / iterations;
+  console.log(`${kernel ? name : 'selected (' + name + ')'}: ${perFrame.toFixed(3)}ms per frame,`,
+    `${(frame.length / perFrame / 1e6).toFixed(2)}GB/s`);
+}
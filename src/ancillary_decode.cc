@@ -0,0 +1,393 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "ancillary_decode.h"
+#include "macadam_util.h"
+
+static inline uint16_t readUInt16BE(const uint8_t* p) {
+  return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t readUInt32BE(const uint8_t* p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+macadamAncillaryType ancillaryType(uint32_t did, uint32_t sdid) {
+  if ((did == 0x61) && (sdid == 0x01)) return macadamAncillaryCEA708;
+  if ((did == 0x41) && (sdid == 0x05)) return macadamAncillaryAFD;
+  if ((did == 0x41) && (sdid == 0x07)) return macadamAncillarySCTE104;
+  return macadamAncillaryUnknown;
+}
+
+bool decodeCDP(const uint8_t* data, uint32_t size, cdpCaptions* captions) {
+  uint8_t checksum = 0;
+  uint32_t length, pos;
+
+  // Header of 7 bytes and footer of 4
+  if ((size < 11) || (data[0] != 0x96) || (data[1] != 0x69)) return false;
+  length = data[2];
+  if ((length < 11) || (length > size)) return false;
+  for ( uint32_t x = 0 ; x < length ; x++ ) checksum += data[x];
+  if (checksum != 0) return false;
+  if ((data[length - 4] != 0x74) || (readUInt16BE(data + length - 3) != readUInt16BE(data + 5))) {
+    return false;
+  }
+
+  captions->frameRateCode = data[3] >> 4;
+  captions->flags = data[4];
+  captions->sequence = readUInt16BE(data + 5);
+  captions->hasTimecode = false;
+  captions->ccCount = 0;
+  pos = 7;
+
+  if ((captions->flags & 0x80) != 0) { // time_code_present
+    if ((pos + 5 > length - 4) || (data[pos] != 0x71)) return false;
+    memcpy(captions->timecode, data + pos + 1, 4);
+    captions->hasTimecode = true;
+    pos += 5;
+  }
+
+  if ((captions->flags & 0x40) != 0) { // ccdata_present
+    if ((pos + 2 > length - 4) || (data[pos] != 0x72)) return false;
+    uint32_t ccCount = data[pos + 1] & 0x1f;
+    pos += 2;
+    if (pos + ccCount * 3 > length - 4) return false;
+    for ( uint32_t x = 0 ; x < ccCount ; x++, pos += 3 ) {
+      if ((data[pos] & 0x04) == 0) continue; // cc_valid
+      uint8_t* cc = captions->ccData[captions->ccCount++];
+      cc[0] = data[pos] & 0x03;
+      cc[1] = data[pos + 1];
+      cc[2] = data[pos + 2];
+    }
+  }
+
+  return true;
+}
+
+bool decodeAFD(const uint8_t* data, uint32_t size, afdBarData* afd) {
+  if (size < 8) return false;
+  afd->afd = (data[0] >> 3) & 0x0f;
+  afd->wide = (data[0] & 0x04) != 0;
+  afd->barFlags = data[3] & 0xf0;
+  afd->barValue1 = readUInt16BE(data + 4);
+  afd->barValue2 = readUInt16BE(data + 6);
+  return true;
+}
+
+static const uint8_t timestampLengths[4] = { 0, 6, 4, 2 };
+
+bool decodeSCTE104(const uint8_t* data, uint32_t size, scte104Message* message) {
+  const uint8_t* msg;
+  uint32_t pos, end;
+
+  if (size < 2) return false;
+  message->descriptor = data[0];
+  msg = data + 1;
+  end = size - 1;
+  memset(message->timestamp, 0, sizeof(message->timestamp));
+  message->timeType = 0;
+  message->scte35ProtocolVersion = 0;
+
+  if (end < 4) return false;
+  message->multiple = readUInt16BE(msg) == SCTE104_MULTIPLE_OP;
+  message->messageSize = readUInt16BE(msg + 2);
+  // Messages spanning more than one packet are not reassembled
+  if ((message->messageSize < 4) || (message->messageSize > end)) return false;
+  end = message->messageSize;
+
+  if (!message->multiple) {
+    // opID, messageSize, result, result_extension, protocol_version,
+    // AS_index, message_number, DPI_PID_index, then the operation data
+    if (end < 13) return false;
+    message->protocolVersion = msg[8];
+    message->asIndex = msg[9];
+    message->messageNumber = msg[10];
+    message->dpiPidIndex = readUInt16BE(msg + 11);
+    message->numOps = 1;
+    message->ops[0].opID = readUInt16BE(msg);
+    message->ops[0].dataLength = (uint16_t) (end - 13);
+    message->ops[0].data = msg + 13;
+    return true;
+  }
+
+  // reserved, messageSize, protocol_version, AS_index, message_number,
+  // DPI_PID_index, SCTE35_protocol_version, timestamp, num_ops, operations
+  if (end < 11) return false;
+  message->protocolVersion = msg[4];
+  message->asIndex = msg[5];
+  message->messageNumber = msg[6];
+  message->dpiPidIndex = readUInt16BE(msg + 7);
+  message->scte35ProtocolVersion = msg[9];
+  message->timeType = msg[10];
+  if (message->timeType > 3) return false;
+  pos = 11;
+  if (pos + timestampLengths[message->timeType] + 1 > end) return false;
+  memcpy(message->timestamp, msg + pos, timestampLengths[message->timeType]);
+  pos += timestampLengths[message->timeType];
+
+  message->numOps = msg[pos++];
+  if (message->numOps > SCTE104_MAX_OPS) return false;
+  for ( uint32_t x = 0 ; x < message->numOps ; x++ ) {
+    if (pos + 4 > end) return false;
+    scte104Operation* op = &message->ops[x];
+    op->opID = readUInt16BE(msg + pos);
+    op->dataLength = readUInt16BE(msg + pos + 2);
+    op->data = msg + pos + 4;
+    pos += 4 + op->dataLength;
+    if (pos > end) return false;
+  }
+  return true;
+}
+
+bool decodeSpliceRequest(const scte104Operation* op, scte104SpliceRequest* request) {
+  const uint8_t* d = op->data;
+  if ((op->opID != SCTE104_SPLICE_REQUEST) || (op->dataLength < 14)) return false;
+  request->spliceInsertType = d[0];
+  request->spliceEventId = readUInt32BE(d + 1);
+  request->uniqueProgramId = readUInt16BE(d + 5);
+  request->preRollTime = readUInt16BE(d + 7);
+  request->breakDuration = readUInt16BE(d + 9);
+  request->availNum = d[11];
+  request->availsExpected = d[12];
+  request->autoReturn = d[13] != 0;
+  return true;
+}
+
+static napi_status setUint32(napi_env env, napi_value obj, const char* name, uint32_t value) {
+  napi_status status;
+  napi_value param;
+  status = napi_create_uint32(env, value, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, obj, name, param);
+}
+
+static napi_status setBool(napi_env env, napi_value obj, const char* name, bool value) {
+  napi_status status;
+  napi_value param;
+  status = napi_get_boolean(env, value, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, obj, name, param);
+}
+
+static napi_status setType(napi_env env, napi_value obj, const char* type) {
+  napi_status status;
+  napi_value param;
+  status = napi_create_string_utf8(env, type, NAPI_AUTO_LENGTH, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, obj, "type", param);
+}
+
+static napi_status captionsValue(napi_env env, const cdpCaptions* captions, napi_value* event) {
+  napi_status status;
+  napi_value param;
+
+  status = napi_create_object(env, event);
+  PASS_STATUS;
+  status = setType(env, *event, "cea708");
+  PASS_STATUS;
+  status = setUint32(env, *event, "frameRateCode", captions->frameRateCode);
+  PASS_STATUS;
+  status = setUint32(env, *event, "sequence", captions->sequence);
+  PASS_STATUS;
+  status = setBool(env, *event, "captionServiceActive", (captions->flags & 0x02) != 0);
+  PASS_STATUS;
+  // cc_type, cc_data_1 and cc_data_2 for each valid entry, in a single buffer
+  status = napi_create_buffer_copy(env, captions->ccCount * 3, captions->ccData, nullptr, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, *event, "ccData", param);
+}
+
+static napi_status afdValue(napi_env env, const afdBarData* afd, napi_value* event) {
+  napi_status status;
+
+  status = napi_create_object(env, event);
+  PASS_STATUS;
+  status = setType(env, *event, "afd");
+  PASS_STATUS;
+  status = setUint32(env, *event, "afd", afd->afd);
+  PASS_STATUS;
+  status = setBool(env, *event, "wide", afd->wide);
+  PASS_STATUS;
+  status = setUint32(env, *event, "barFlags", afd->barFlags);
+  PASS_STATUS;
+  if (afd->barFlags != 0) {
+    status = setUint32(env, *event, "barValue1", afd->barValue1);
+    PASS_STATUS;
+    status = setUint32(env, *event, "barValue2", afd->barValue2);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+static napi_status operationValue(napi_env env, const scte104Operation* op, napi_value* value) {
+  napi_status status;
+  napi_value param;
+  scte104SpliceRequest splice;
+
+  status = napi_create_object(env, value);
+  PASS_STATUS;
+  status = setUint32(env, *value, "opID", op->opID);
+  PASS_STATUS;
+
+  if (decodeSpliceRequest(op, &splice)) {
+    status = setUint32(env, *value, "spliceInsertType", splice.spliceInsertType);
+    PASS_STATUS;
+    status = setUint32(env, *value, "spliceEventId", splice.spliceEventId);
+    PASS_STATUS;
+    status = setUint32(env, *value, "uniqueProgramId", splice.uniqueProgramId);
+    PASS_STATUS;
+    status = setUint32(env, *value, "preRollTime", splice.preRollTime);
+    PASS_STATUS;
+    status = setUint32(env, *value, "breakDuration", splice.breakDuration);
+    PASS_STATUS;
+    status = setUint32(env, *value, "availNum", splice.availNum);
+    PASS_STATUS;
+    status = setUint32(env, *value, "availsExpected", splice.availsExpected);
+    PASS_STATUS;
+    return setBool(env, *value, "autoReturn", splice.autoReturn);
+  }
+
+  if ((op->opID == SCTE104_TIME_SIGNAL_REQUEST) && (op->dataLength >= 2)) {
+    return setUint32(env, *value, "preRollTime", (op->data[0] << 8) | op->data[1]);
+  }
+
+  status = napi_create_buffer_copy(env, op->dataLength, op->data, nullptr, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, *value, "data", param);
+}
+
+static napi_status scte104Value(napi_env env, const scte104Message* message, napi_value* event) {
+  napi_status status;
+  napi_value operations, value;
+  const uint8_t* ts = message->timestamp;
+
+  status = napi_create_object(env, event);
+  PASS_STATUS;
+  status = setType(env, *event, "scte104");
+  PASS_STATUS;
+  status = setUint32(env, *event, "asIndex", message->asIndex);
+  PASS_STATUS;
+  status = setUint32(env, *event, "messageNumber", message->messageNumber);
+  PASS_STATUS;
+  status = setUint32(env, *event, "dpiPidIndex", message->dpiPidIndex);
+  PASS_STATUS;
+  status = setUint32(env, *event, "timeType", message->timeType);
+  PASS_STATUS;
+  switch (message->timeType) {
+    case 1: // UTC seconds and microseconds
+      status = setUint32(env, *event, "utcSeconds",
+        ((uint32_t) ts[0] << 24) | (ts[1] << 16) | (ts[2] << 8) | ts[3]);
+      PASS_STATUS;
+      status = setUint32(env, *event, "utcMicroseconds", (ts[4] << 8) | ts[5]);
+      PASS_STATUS;
+      break;
+    case 2: { // VITC hours, minutes, seconds and frames, as binary values
+      char timecode[12];
+      snprintf(timecode, sizeof(timecode), "%02u:%02u:%02u:%02u",
+        ts[0] % 100, ts[1] % 100, ts[2] % 100, ts[3] % 100);
+      status = napi_create_string_utf8(env, timecode, NAPI_AUTO_LENGTH, &value);
+      PASS_STATUS;
+      status = napi_set_named_property(env, *event, "vitc", value);
+      PASS_STATUS;
+      break;
+    }
+    case 3: // GPI number and edge
+      status = setUint32(env, *event, "gpiNumber", ts[0]);
+      PASS_STATUS;
+      status = setUint32(env, *event, "gpiEdge", ts[1]);
+      PASS_STATUS;
+      break;
+    default:
+      break;
+  }
+
+  status = napi_create_array(env, &operations);
+  PASS_STATUS;
+  for ( uint32_t x = 0 ; x < message->numOps ; x++ ) {
+    status = operationValue(env, &message->ops[x], &value);
+    PASS_STATUS;
+    status = napi_set_element(env, operations, x, value);
+    PASS_STATUS;
+  }
+  return napi_set_named_property(env, *event, "operations", operations);
+}
+
+napi_status ancillaryEventValue(napi_env env, uint32_t did, uint32_t sdid,
+    const uint8_t* data, uint32_t size, napi_value* event) {
+  switch (ancillaryType(did, sdid)) {
+    case macadamAncillaryCEA708: {
+      cdpCaptions captions;
+      if (decodeCDP(data, size, &captions)) return captionsValue(env, &captions, event);
+      break;
+    }
+    case macadamAncillaryAFD: {
+      afdBarData afd;
+      if (decodeAFD(data, size, &afd)) return afdValue(env, &afd, event);
+      break;
+    }
+    case macadamAncillarySCTE104: {
+      scte104Message message;
+      if (decodeSCTE104(data, size, &message)) return scte104Value(env, &message, event);
+      break;
+    }
+    default:
+      break;
+  }
+  return napi_get_undefined(env, event);
+}
+
+// Decodes a packet object, as found in a frame's ancillary array
+napi_value decodeAncillary(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[1];
+  napi_value result, param;
+  napi_valuetype type;
+  size_t argc = 1;
+  uint32_t did, sdid;
+  bool isBuffer;
+  void* data;
+  size_t dataSize;
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("An ancillary packet must be provided.");
+  status = napi_typeof(env, argv[0], &type);
+  CHECK_STATUS;
+  if (type != napi_object) NAPI_THROW_ERROR("An ancillary packet must be an object.");
+
+  status = napi_get_named_property(env, argv[0], "did", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, &did);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Packet DID must be a number.");
+  CHECK_STATUS;
+  status = napi_get_named_property(env, argv[0], "sdid", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, &sdid);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Packet SDID must be a number.");
+  CHECK_STATUS;
+  status = napi_get_named_property(env, argv[0], "data", &param);
+  CHECK_STATUS;
+  status = napi_is_buffer(env, param, &isBuffer);
+  CHECK_STATUS;
+  if (!isBuffer) NAPI_THROW_ERROR("Packet data must be a node buffer.");
+  status = napi_get_buffer_info(env, param, &data, &dataSize);
+  CHECK_STATUS;
+
+  status = ancillaryEventValue(env, did, sdid, (const uint8_t*) data, (uint32_t) dataSize, &result);
+  CHECK_STATUS;
+  return result;
+}
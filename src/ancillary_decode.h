@@ -0,0 +1,114 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef ANCILLARY_DECODE_H
+#define ANCILLARY_DECODE_H
+
+#include <stdint.h>
+#include "node_api.h"
+
+// Decoders for the ancillary packets that are parsed on most frames. Input is
+// the user data words of a packet in 8-bit form, as returned for
+// bmdAncillaryPacketFormatUInt8, without DID, SDID or data count.
+
+typedef uint32_t macadamAncillaryType;
+enum _macadamAncillaryType {
+  macadamAncillaryUnknown = 0,
+  macadamAncillaryCEA708 = 1, // SMPTE 334 caption distribution packet, DID 0x61 SDID 0x01
+  macadamAncillaryAFD = 2, // SMPTE 2016-3 AFD and bar data, DID 0x41 SDID 0x05
+  macadamAncillarySCTE104 = 3 // SMPTE 2010 SCTE-104 messages, DID 0x41 SDID 0x07
+};
+
+macadamAncillaryType ancillaryType(uint32_t did, uint32_t sdid);
+
+#define CDP_MAX_CC_COUNT 31
+
+// Caption data from a CEA-708 caption distribution packet
+struct cdpCaptions {
+  uint8_t frameRateCode; // 1 = 23.976 ... 8 = 60
+  uint8_t flags; // cdp_flags, e.g. 0x02 caption service active
+  uint16_t sequence;
+  bool hasTimecode;
+  uint8_t timecode[4]; // Packed BCD time_code_section fields, as carried
+  uint8_t ccCount; // Number of valid entries in ccData
+  uint8_t ccData[CDP_MAX_CC_COUNT][3]; // cc_type, cc_data_1, cc_data_2
+};
+
+// Validates the CDP header, footer and checksum. Only entries with cc_valid set
+// are kept, so a packet of padding decodes with a ccCount of zero.
+bool decodeCDP(const uint8_t* data, uint32_t size, cdpCaptions* captions);
+
+// Active format description and bar data
+struct afdBarData {
+  uint8_t afd; // 4-bit active format description code
+  bool wide; // Aspect ratio flag, set for 16:9 and clear for 4:3
+  uint8_t barFlags; // 0x80 top, 0x40 bottom, 0x20 left, 0x10 right
+  uint16_t barValue1; // Top or left bar
+  uint16_t barValue2; // Bottom or right bar
+};
+
+bool decodeAFD(const uint8_t* data, uint32_t size, afdBarData* afd);
+
+#define SCTE104_MAX_OPS 16
+#define SCTE104_MULTIPLE_OP 0xffff
+#define SCTE104_SPLICE_REQUEST 0x0101
+#define SCTE104_TIME_SIGNAL_REQUEST 0x0104
+
+struct scte104Operation {
+  uint16_t opID;
+  uint16_t dataLength;
+  const uint8_t* data; // Points into the decoded packet
+};
+
+// A single or multiple operation SCTE-104 message carried in one packet.
+// Single operation messages have one operation with the message's opID.
+struct scte104Message {
+  uint8_t descriptor; // SMPTE 2010 payload descriptor byte
+  bool multiple;
+  uint16_t messageSize;
+  uint8_t protocolVersion;
+  uint8_t asIndex;
+  uint8_t messageNumber;
+  uint16_t dpiPidIndex;
+  uint8_t scte35ProtocolVersion; // Multiple operation messages only
+  uint8_t timeType; // 0 none, 1 UTC, 2 VITC, 3 GPI
+  uint8_t timestamp[6];
+  uint8_t numOps;
+  scte104Operation ops[SCTE104_MAX_OPS];
+};
+
+bool decodeSCTE104(const uint8_t* data, uint32_t size, scte104Message* message);
+
+// splice_request_data of a splice request operation
+struct scte104SpliceRequest {
+  uint8_t spliceInsertType; // 1 start normal, 2 start immediate, 3 end normal, 4 end immediate, 5 cancel
+  uint32_t spliceEventId;
+  uint16_t uniqueProgramId;
+  uint16_t preRollTime; // Milliseconds
+  uint16_t breakDuration; // Tenths of a second
+  uint8_t availNum;
+  uint8_t availsExpected;
+  bool autoReturn;
+};
+
+bool decodeSpliceRequest(const scte104Operation* op, scte104SpliceRequest* request);
+
+// Decoded event for a packet, or undefined if the packet has no decoder or is malformed
+napi_status ancillaryEventValue(napi_env env, uint32_t did, uint32_t sdid,
+  const uint8_t* data, uint32_t size, napi_value* event);
+
+napi_value decodeAncillary(napi_env env, napi_callback_info info);
+
+#endif // ANCILLARY_DECODE_H
@@ -0,0 +1,233 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <string.h>
+#include "audio_convert.h"
+#include "macadam_util.h"
+#include "simd_util.h"
+
+#define INT16_SCALE (1.0f / 32768.0f)
+#define INT32_SCALE (1.0f / 2147483648.0f)
+
+static void deinterleaveScalar(const uint8_t* src, uint32_t sampleBytes, uint32_t channels,
+    uint32_t frames, const uint32_t* channelMap, uint32_t outChannels, float* const* dst) {
+  for ( uint32_t c = 0 ; c < outChannels ; c++ ) {
+    float* d = dst[c];
+    if (sampleBytes == 2) {
+      const int16_t* s = (const int16_t*) src + channelMap[c];
+      for ( uint32_t i = 0 ; i < frames ; i++ ) d[i] = s[i * channels] * INT16_SCALE;
+    } else {
+      const int32_t* s = (const int32_t*) src + channelMap[c];
+      for ( uint32_t i = 0 ; i < frames ; i++ ) d[i] = s[i * channels] * INT32_SCALE;
+    }
+  }
+}
+
+#ifdef MACADAM_X86
+
+// Gathers eight frames of one channel at a time
+MACADAM_TARGET("avx2")
+static void deinterleaveAVX2(const uint8_t* src, uint32_t sampleBytes, uint32_t channels,
+    uint32_t frames, const uint32_t* channelMap, uint32_t outChannels, float* const* dst) {
+  const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+    _mm256_set1_epi32((int) channels));
+  for ( uint32_t c = 0 ; c < outChannels ; c++ ) {
+    float* d = dst[c];
+    uint32_t i = 0;
+    if (sampleBytes == 2) {
+      const __m256 scale = _mm256_set1_ps(INT16_SCALE);
+      const int16_t* s = (const int16_t*) src + channelMap[c];
+      // Each 16-bit sample is read as 32 bits, so stop short of the last frame
+      for ( ; i + 8 < frames ; i += 8 ) {
+        __m256i v = _mm256_i32gather_epi32((const int*) (s + i * channels), index, 2);
+        v = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+        _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+      }
+      for ( ; i < frames ; i++ ) d[i] = s[i * channels] * INT16_SCALE;
+    } else {
+      const __m256 scale = _mm256_set1_ps(INT32_SCALE);
+      const int32_t* s = (const int32_t*) src + channelMap[c];
+      for ( ; i + 8 <= frames ; i += 8 ) {
+        __m256i v = _mm256_i32gather_epi32((const int*) (s + i * channels), index, 4);
+        _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+      }
+      for ( ; i < frames ; i++ ) d[i] = s[i * channels] * INT32_SCALE;
+    }
+  }
+}
+
+#endif // MACADAM_X86
+
+static deinterleaveKernel selectedDeinterleave = deinterleaveScalar;
+static const char* selectedDeinterleaveName = "scalar";
+
+void selectAudioKernels() {
+  #ifdef MACADAM_X86
+  if (cpuHasAVX2()) {
+    selectedDeinterleave = deinterleaveAVX2;
+    selectedDeinterleaveName = "avx2";
+  }
+  #endif
+}
+
+void deinterleaveToFloat(const uint8_t* src, uint32_t sampleBytes, uint32_t channels,
+    uint32_t frames, const uint32_t* channelMap, uint32_t outChannels, float* const* dst) {
+  selectedDeinterleave(src, sampleBytes, channels, frames, channelMap, outChannels, dst);
+}
+
+const char* audioKernelName() {
+  return selectedDeinterleaveName;
+}
+
+deinterleaveKernel getAudioKernel(const char* name) {
+  if (strcmp(name, "scalar") == 0) return deinterleaveScalar;
+  #ifdef MACADAM_X86
+  if ((strcmp(name, "avx2") == 0) && cpuHasAVX2()) return deinterleaveAVX2;
+  #endif
+  return nullptr;
+}
+
+napi_status parseChannelMap(napi_env env, napi_value value, uint32_t channels,
+    std::vector<uint32_t>* channelMap) {
+  napi_status status;
+  napi_value item;
+  bool isArray;
+  uint32_t length, source;
+
+  status = napi_is_array(env, value, &isArray);
+  PASS_STATUS;
+  if (!isArray) return napi_invalid_arg;
+  status = napi_get_array_length(env, value, &length);
+  PASS_STATUS;
+  if ((length == 0) || (length > 64)) return napi_invalid_arg;
+  channelMap->clear();
+  for ( uint32_t x = 0 ; x < length ; x++ ) {
+    status = napi_get_element(env, value, x, &item);
+    PASS_STATUS;
+    status = napi_get_value_uint32(env, item, &source);
+    if (status == napi_number_expected) return napi_invalid_arg;
+    PASS_STATUS;
+    if (source >= channels) return napi_invalid_arg;
+    channelMap->push_back(source);
+  }
+  return napi_ok;
+}
+
+napi_status planarAudioValue(napi_env env, const uint8_t* src, uint32_t sampleBytes,
+    uint32_t channels, uint32_t frames, const std::vector<uint32_t>& channelMap,
+    deinterleaveKernel kernel, napi_value* result) {
+  napi_status status;
+  napi_value arrayBuffer, channel;
+  void* data;
+  uint32_t outChannels = (uint32_t) channelMap.size();
+  float* dst[64];
+
+  if (outChannels > 64) return napi_invalid_arg;
+  if (kernel == nullptr) kernel = selectedDeinterleave;
+  status = napi_create_arraybuffer(env, (size_t) outChannels * frames * sizeof(float),
+    &data, &arrayBuffer);
+  PASS_STATUS;
+  for ( uint32_t c = 0 ; c < outChannels ; c++ ) dst[c] = (float*) data + (size_t) c * frames;
+  kernel(src, sampleBytes, channels, frames, channelMap.data(), outChannels, dst);
+
+  status = napi_create_array_with_length(env, outChannels, result);
+  PASS_STATUS;
+  for ( uint32_t c = 0 ; c < outChannels ; c++ ) {
+    status = napi_create_typedarray(env, napi_float32_array, frames, arrayBuffer,
+      (size_t) c * frames * sizeof(float), &channel);
+    PASS_STATUS;
+    status = napi_set_element(env, *result, c, channel);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+// audioToFloat(buffer, { sampleType, channels, channelMap, kernel }) converts
+// interleaved samples, as captured, to an array of Float32Array channels
+napi_value audioToFloat(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[2];
+  napi_value result, param;
+  napi_valuetype type;
+  size_t argc = 2;
+  bool isBuffer;
+  void* data;
+  size_t dataSize;
+  uint32_t sampleType = 16;
+  uint32_t channels;
+  std::vector<uint32_t> channelMap;
+  deinterleaveKernel kernel = selectedDeinterleave;
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 2) NAPI_THROW_ERROR("A buffer and audio options must be provided.");
+
+  status = napi_is_buffer(env, argv[0], &isBuffer);
+  CHECK_STATUS;
+  if (!isBuffer) NAPI_THROW_ERROR("Audio data must be provided as a node buffer.");
+  status = napi_get_buffer_info(env, argv[0], &data, &dataSize);
+  CHECK_STATUS;
+  status = napi_typeof(env, argv[1], &type);
+  CHECK_STATUS;
+  if (type != napi_object) NAPI_THROW_ERROR("Audio options must be an object.");
+
+  status = napi_get_named_property(env, argv[1], "channels", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, &channels);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Channels must be a number.");
+  CHECK_STATUS;
+  if ((channels == 0) || (channels > 64)) NAPI_THROW_ERROR("Channels must be between 1 and 64.");
+
+  status = napi_get_named_property(env, argv[1], "sampleType", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_undefined) {
+    status = napi_get_value_uint32(env, param, &sampleType);
+    if (status == napi_number_expected) NAPI_THROW_ERROR("Sample type must be a number.");
+    CHECK_STATUS;
+    if ((sampleType != 16) && (sampleType != 32)) NAPI_THROW_ERROR("Sample type must be 16 or 32.");
+  }
+
+  status = napi_get_named_property(env, argv[1], "channelMap", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_undefined) {
+    status = parseChannelMap(env, param, channels, &channelMap);
+    if (status == napi_invalid_arg) NAPI_THROW_ERROR("Channel map must be an array of source channels.");
+    CHECK_STATUS;
+  } else {
+    for ( uint32_t c = 0 ; c < channels ; c++ ) channelMap.push_back(c);
+  }
+
+  status = napi_get_named_property(env, argv[1], "kernel", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type == napi_string) {
+    char kernelName[16];
+    size_t kernelNameLen;
+    status = napi_get_value_string_utf8(env, param, kernelName, sizeof(kernelName), &kernelNameLen);
+    CHECK_STATUS;
+    kernel = getAudioKernel(kernelName);
+    if (kernel == nullptr) NAPI_THROW_ERROR("Requested audio kernel is not available.");
+  }
+
+  status = planarAudioValue(env, (const uint8_t*) data, sampleType / 8, channels,
+    (uint32_t) (dataSize / (channels * (sampleType / 8))), channelMap, kernel, &result);
+  CHECK_STATUS;
+  return result;
+}
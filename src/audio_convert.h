@@ -0,0 +1,52 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef AUDIO_CONVERT_H
+#define AUDIO_CONVERT_H
+
+#include <stdint.h>
+#include <vector>
+#include "node_api.h"
+
+// Converts interleaved 16- or 32-bit signed integer samples to planar float32
+// in the range [-1.0, 1.0). Output channel c is read from source channel
+// channelMap[c] and written to dst[c], which must hold frames samples.
+typedef void (*deinterleaveKernel)(const uint8_t* src, uint32_t sampleBytes, uint32_t channels,
+  uint32_t frames, const uint32_t* channelMap, uint32_t outChannels, float* const* dst);
+
+// Select the fastest kernel supported by the CPU. Called once at module load.
+void selectAudioKernels();
+
+void deinterleaveToFloat(const uint8_t* src, uint32_t sampleBytes, uint32_t channels,
+  uint32_t frames, const uint32_t* channelMap, uint32_t outChannels, float* const* dst);
+const char* audioKernelName();
+
+// Named kernel - "scalar" or "avx2" - or nullptr when not available
+deinterleaveKernel getAudioKernel(const char* name);
+
+// Parses an array of source channel indices, each less than channels
+napi_status parseChannelMap(napi_env env, napi_value value, uint32_t channels,
+  std::vector<uint32_t>* channelMap);
+
+// Creates an array of Float32Array views, one per output channel, over a
+// single new ArrayBuffer holding the converted samples. A null kernel uses the
+// one chosen by selectAudioKernels.
+napi_status planarAudioValue(napi_env env, const uint8_t* src, uint32_t sampleBytes,
+  uint32_t channels, uint32_t frames, const std::vector<uint32_t>& channelMap,
+  deinterleaveKernel kernel, napi_value* result);
+
+napi_value audioToFloat(napi_env env, napi_callback_info info);
+
+#endif // AUDIO_CONVERT_H
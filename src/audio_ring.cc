@@ -0,0 +1,131 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "audio_ring.h"
+
+macadamAudioRing::macadamAudioRing(uint32_t capacity, uint32_t frameBytes)
+    : capacityFrames(capacity), frameBytes(frameBytes) {
+  buffer = (uint8_t*) malloc((size_t) capacity * frameBytes);
+}
+
+macadamAudioRing::~macadamAudioRing() {
+  free(buffer);
+}
+
+void macadamAudioRing::write(const uint8_t* data, uint32_t frames, int64_t sampleTime) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  // Only the most recent capacity frames of a very large write can be kept
+  if (frames > capacityFrames) {
+    uint32_t skip = frames - capacityFrames;
+    data += (size_t) skip * frameBytes;
+    sampleTime += skip;
+    writePosition += skip;
+    frames = capacityFrames;
+  }
+
+  copyIn(data, frames, sampleTime);
+
+  if (writePosition - readPosition > capacityFrames) {
+    // Includes any frames of an oversized write skipped above
+    uint64_t lost = writePosition - readPosition - capacityFrames;
+    overruns++;
+    overrunFrames += lost;
+    readPosition = writePosition - capacityFrames;
+  }
+  uint32_t level = (uint32_t) (writePosition - readPosition);
+  if (level > highWater) highWater = level;
+
+  // Keep only the mark at or before the read position and those after it
+  while ((timeMarks.size() > 1) && (timeMarks[1].position <= readPosition)) {
+    timeMarks.pop_front();
+  }
+}
+
+uint32_t macadamAudioRing::writeAvailable(const uint8_t* data, uint32_t frames,
+    int64_t sampleTime) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  uint32_t space = capacityFrames - (uint32_t) (writePosition - readPosition);
+  if (frames > space) {
+    overruns++;
+    overrunFrames += frames - space;
+    frames = space;
+  }
+  if (frames > 0) copyIn(data, frames, sampleTime);
+  uint32_t level = (uint32_t) (writePosition - readPosition);
+  if (level > highWater) highWater = level;
+  return frames;
+}
+
+// Appends frames at the write position, marking the sample time of any new run
+void macadamAudioRing::copyIn(const uint8_t* data, uint32_t frames, int64_t sampleTime) {
+  if (sampleTime != nextSampleTime) {
+    if (nextSampleTime != INT64_MIN) discontinuities++;
+    timeMarks.push_back({ writePosition, sampleTime });
+  }
+  nextSampleTime = sampleTime + frames;
+
+  uint32_t offset = (uint32_t) (writePosition % capacityFrames);
+  uint32_t first = (frames < capacityFrames - offset) ? frames : capacityFrames - offset;
+  memcpy(buffer + (size_t) offset * frameBytes, data, (size_t) first * frameBytes);
+  if (first < frames) {
+    memcpy(buffer, data + (size_t) first * frameBytes, (size_t) (frames - first) * frameBytes);
+  }
+  writePosition += frames;
+}
+
+void macadamAudioRing::copyOut(uint8_t* dst, uint64_t position, uint32_t frames) {
+  uint32_t offset = (uint32_t) (position % capacityFrames);
+  uint32_t first = (frames < capacityFrames - offset) ? frames : capacityFrames - offset;
+  memcpy(dst, buffer + (size_t) offset * frameBytes, (size_t) first * frameBytes);
+  if (first < frames) {
+    memcpy(dst + (size_t) first * frameBytes, buffer, (size_t) (frames - first) * frameBytes);
+  }
+}
+
+bool macadamAudioRing::read(uint8_t* dst, uint32_t frames, int64_t* sampleTime) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (writePosition - readPosition < frames) return false;
+
+  while ((timeMarks.size() > 1) && (timeMarks[1].position <= readPosition)) {
+    timeMarks.pop_front();
+  }
+  const timeMark& mark = timeMarks.front();
+  *sampleTime = mark.sampleTime + (int64_t) (readPosition - mark.position);
+
+  copyOut(dst, readPosition, frames);
+  readPosition += frames;
+  return true;
+}
+
+uint32_t macadamAudioRing::available() {
+  std::lock_guard<std::mutex> guard(lock);
+  return (uint32_t) (writePosition - readPosition);
+}
+
+void macadamAudioRing::getStats(audioRingStats* stats) {
+  std::lock_guard<std::mutex> guard(lock);
+  stats->capacity = capacityFrames;
+  stats->level = (uint32_t) (writePosition - readPosition);
+  stats->highWater = highWater;
+  stats->written = writePosition;
+  stats->read = readPosition;
+  stats->overruns = overruns;
+  stats->overrunFrames = overrunFrames;
+  stats->discontinuities = discontinuities;
+}
@@ -0,0 +1,82 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+
+struct audioRingStats {
+  uint32_t capacity; // Sample frames
+  uint32_t level; // Sample frames waiting to be read
+  uint32_t highWater;
+  uint64_t written; // Sample frames written since creation
+  uint64_t read;
+  uint64_t overruns; // Writes that overwrote unread samples, or that did not fit
+  uint64_t overrunFrames; // Unread sample frames overwritten, or those refused
+  uint64_t discontinuities; // Writes with a sample time other than the one expected
+};
+
+// Fixed capacity ring of interleaved audio sample frames, written from the
+// DeckLink callback thread and read from the main thread. When a write would
+// overflow, the oldest unread samples are overwritten and counted. Used as a
+// FIFO with writeAvailable(), a write that does not fit is cut short instead.
+// Stream times are kept for each contiguous run of samples, so that any
+// read can report the sample time of its first sample frame.
+class macadamAudioRing {
+public:
+  macadamAudioRing(uint32_t capacity, uint32_t frameBytes);
+  ~macadamAudioRing();
+  // False if the buffer could not be allocated, when the ring must not be used
+  bool allocated() { return buffer != nullptr; }
+
+  void write(const uint8_t* data, uint32_t frames, int64_t sampleTime);
+  // Writes as many of frames as fit without overwriting unread samples,
+  // returning the number written. Any not written are counted as an overrun.
+  uint32_t writeAvailable(const uint8_t* data, uint32_t frames, int64_t sampleTime);
+  // Copies exactly frames sample frames to dst, returning false with nothing
+  // read if fewer are available
+  bool read(uint8_t* dst, uint32_t frames, int64_t* sampleTime);
+  uint32_t available();
+  uint32_t capacity() { return capacityFrames; }
+  uint32_t bytesPerFrame() { return frameBytes; }
+  void getStats(audioRingStats* stats);
+
+private:
+  struct timeMark {
+    uint64_t position; // Absolute sample frame position
+    int64_t sampleTime;
+  };
+
+  std::mutex lock;
+  uint8_t* buffer;
+  uint32_t capacityFrames;
+  uint32_t frameBytes;
+  uint64_t writePosition = 0; // Absolute positions, modulo capacity in the buffer
+  uint64_t readPosition = 0;
+  std::deque<timeMark> timeMarks; // Starts of contiguous runs, oldest first
+  int64_t nextSampleTime = INT64_MIN;
+  uint32_t highWater = 0;
+  uint64_t overruns = 0;
+  uint64_t overrunFrames = 0;
+  uint64_t discontinuities = 0;
+
+  void copyIn(const uint8_t* data, uint32_t frames, int64_t sampleTime);
+  void copyOut(uint8_t* dst, uint64_t position, uint32_t frames);
+};
+
+#endif // AUDIO_RING_H
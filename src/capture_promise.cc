@@ -41,6 +41,7 @@
  */
 
 #include <inttypes.h>
+#include <string.h>
 #include "capture_promise.h"
 #include "converted_frame.h"
 
@@ -55,6 +56,32 @@ HRESULT captureThreadsafe::VideoInputFrameArrived(
     return E_FAIL;
   }
 
+  if ((audioRing != nullptr) && (audioPacket != nullptr)) {
+    void* bytes;
+    BMDTimeValue packetTime;
+    if ((audioPacket->GetBytes(&bytes) == S_OK) &&
+        (audioPacket->GetPacketTime(&packetTime, sampleRate) == S_OK)) {
+      audioRing->write((const uint8_t*) bytes, audioPacket->GetSampleFrameCount(), packetTime);
+    }
+  }
+
+  if (sharedRing != nullptr) {
+    publishFrame(videoFrame, audioPacket);
+  }
+
+  if (recorder != nullptr) {
+    recordFrame(videoFrame, audioPacket);
+  }
+
+  if (!deliverFrames && (audioRing == nullptr) && (qc == nullptr)) {
+    status = napi_release_threadsafe_function(tsFn, napi_tsfn_release);
+    if (status != napi_ok) {
+      printf("DEBUG: Failed to release NAPI threadsafe function on capture, status=%d.\n", status);
+      return E_FAIL;
+    }
+    return S_OK;
+  }
+
   videoFrame->AddRef();
   if (audioPacket != nullptr) {
     audioPacket->AddRef();
@@ -65,15 +92,31 @@ HRESULT captureThreadsafe::VideoInputFrameArrived(
   data->videoFrame = videoFrame;
   data->audioPacket = audioPacket;
   data->convertedFrame = nullptr;
-
-  hangover = napi_call_threadsafe_function(tsFn, data, napi_tsfn_nonblocking);
-  if (hangover != napi_ok) {
-    if (hangover == napi_queue_full)
-      printf("WARNING: Frame overrun: Dropped frame as frame queue is full! status=%d.\n", hangover);
-    else
-      printf("DEBUG: Failed to call NAPI threadsafe function on capture, status=%d.\n", hangover);
+  data->sequence = 0;
+  memset(data->proxies, 0, sizeof(data->proxies));
+  data->proxyMicros = 0;
+  data->qc = nullptr;
+
+  if (conversionPool != nullptr) {
+    // The threadsafe function stays acquired until the converted frame is dispatched
+    data->sequence = nextConversionSequence;
+    if (conversionPool->submit([this, data](uint32_t workerIndex) {
+        convertFrame(data, workerIndex);
+      })) {
+      nextConversionSequence++;
+      return S_OK;
+    }
+    conversionQueueFull++;
+    releaseFrameData(data);
+    status = napi_release_threadsafe_function(tsFn, napi_tsfn_release);
+    if (status != napi_ok) {
+      printf("DEBUG: Failed to release NAPI threadsafe function on capture, status=%d.\n", status);
+    }
+    return E_FAIL;
   }
 
+  hangover = dispatchFrame(data);
+
   status = napi_release_threadsafe_function(tsFn, napi_tsfn_release);
   if (status != napi_ok) {
     printf("DEBUG: Failed to release NAPI threadsafe function on capture, status=%d.\n", status);
@@ -83,6 +126,295 @@ HRESULT captureThreadsafe::VideoInputFrameArrived(
   return (hangover == napi_ok) ? S_OK : E_FAIL;
 };
 
+static void releaseRecordedFrame(void* data) {
+  releaseFrameData((frameData*) data);
+}
+
+// Hand the frame's buffers to the recorder, which holds them until written
+void captureThreadsafe::recordFrame(IDeckLinkVideoInputFrame* videoFrame,
+    IDeckLinkAudioInputPacket* audioPacket) {
+  recorderFrame frame;
+  void* bytes;
+  BMDTimeValue packetTime, frameTime, frameDuration;
+  IDeckLinkTimecode* timecode;
+
+  frameData* data = (frameData*) malloc(sizeof(frameData));
+  data->rgbaAuxiliaryBuf = nullptr;
+  data->videoFrame = videoFrame;
+  data->audioPacket = nullptr;
+  data->convertedFrame = nullptr;
+  data->sequence = 0;
+  memset(data->proxies, 0, sizeof(data->proxies));
+  data->proxyMicros = 0;
+  data->qc = nullptr;
+  videoFrame->AddRef();
+  if (videoFrame->GetBytes(&bytes) == S_OK) {
+    frame.video = (const uint8_t*) bytes;
+    frame.videoBytes = videoFrame->GetRowBytes() * videoFrame->GetHeight();
+  }
+  if (videoFrame->GetStreamTime(&frameTime, &frameDuration, timeScale) == S_OK) {
+    frame.frameTime = frameTime;
+  }
+  if (videoFrame->GetTimecode(bmdTimecodeRP188Any, &timecode) == S_OK) {
+    frame.timecodeBCD = timecode->GetBCD();
+    frame.timecodeFlags = (uint16_t) timecode->GetFlags();
+    frame.indexFlags |= recorderIndexHasTimecode;
+    timecode->Release();
+  }
+  if (videoFrame->GetFlags() & bmdFrameHasNoInputSource) {
+    frame.indexFlags |= recorderIndexNoInputSource;
+  }
+  if ((audioPacket != nullptr) && (audioPacket->GetBytes(&bytes) == S_OK) &&
+      (audioPacket->GetPacketTime(&packetTime, sampleRate) == S_OK)) {
+    audioPacket->AddRef();
+    data->audioPacket = audioPacket;
+    frame.audio = (const uint8_t*) bytes;
+    frame.audioBytes = audioPacket->GetSampleFrameCount() * sampleByteFactor;
+    frame.audioTime = packetTime;
+  }
+  frame.release = releaseRecordedFrame;
+  frame.releaseData = data;
+  recorder->submit(frame);
+}
+
+// Copy the frame into the shared memory ring for readers in other processes
+void captureThreadsafe::publishFrame(IDeckLinkVideoInputFrame* videoFrame,
+    IDeckLinkAudioInputPacket* audioPacket) {
+  sharedRingFrame frame;
+  void* bytes;
+  BMDTimeValue frameTime, frameDuration, packetTime;
+  IDeckLinkTimecode* timecode;
+  BMDTimecodeUserBits userBits;
+
+  if (videoFrame->GetBytes(&bytes) == S_OK) {
+    frame.video = (const uint8_t*) bytes;
+    frame.videoBytes = videoFrame->GetRowBytes() * videoFrame->GetHeight();
+  }
+  frame.rowBytes = videoFrame->GetRowBytes();
+  frame.width = videoFrame->GetWidth();
+  frame.height = videoFrame->GetHeight();
+  frame.pixelFormat = videoFrame->GetPixelFormat();
+  frame.frameFlags = videoFrame->GetFlags();
+  if (videoFrame->GetStreamTime(&frameTime, &frameDuration, timeScale) == S_OK) {
+    frame.frameTime = frameTime;
+    frame.frameDuration = frameDuration;
+  }
+  if (videoFrame->GetTimecode(bmdTimecodeRP188Any, &timecode) == S_OK) {
+    frame.hasTimecode = true;
+    frame.timecodeBCD = timecode->GetBCD();
+    frame.timecodeFlags = timecode->GetFlags();
+    if (timecode->GetTimecodeUserBits(&userBits) == S_OK) frame.userbits = userBits;
+    timecode->Release();
+  }
+  if ((audioPacket != nullptr) && (audioPacket->GetBytes(&bytes) == S_OK) &&
+      (audioPacket->GetPacketTime(&packetTime, sampleRate) == S_OK)) {
+    frame.audio = (const uint8_t*) bytes;
+    frame.sampleFrameCount = audioPacket->GetSampleFrameCount();
+    frame.audioTime = packetTime;
+  }
+  sharedRing->publish(frame);
+}
+
+// Pass a frame to the main thread, releasing it if the callback queue will not take it
+napi_status captureThreadsafe::dispatchFrame(frameData* frame) {
+  napi_status hangover;
+  hangover = napi_call_threadsafe_function(tsFn, frame,
+    callbackQueueBlocking ? napi_tsfn_blocking : napi_tsfn_nonblocking);
+  if (hangover != napi_ok) {
+    if (hangover == napi_queue_full) {
+      callbackQueueFull++;
+    } else {
+      callbackFailures++;
+      printf("DEBUG: Failed to call NAPI threadsafe function on capture, status=%d.\n", hangover);
+    }
+    releaseFrameData(frame);
+  }
+  return hangover;
+}
+
+// Runs on a conversion worker
+void captureThreadsafe::convertFrame(frameData* frame, uint32_t workerIndex) {
+  HR_TIME_POINT start = NOW;
+  bool converted = true;
+  if (convertTo != macadamLayoutNone) {
+    converted = convertNative(frame, workerIndex);
+  } else if (outputRGBA) {
+    converted = convertToRGBA(frame, workerIndex);
+  }
+  long long conversionMicros = (long long) microTime(start);
+  bool proxied = true;
+  if (!proxies.empty()) {
+    start = NOW;
+    proxied = makeProxies(frame, workerIndex);
+    frame->proxyMicros = (uint32_t) microTime(start);
+  }
+  if (qc != nullptr) {
+    analyseQC(frame, workerIndex);
+  }
+  dispatchConverted(frame, conversionMicros, converted, proxied);
+}
+
+// Converts to BGRA with this worker's DeckLink conversion instance where
+// required, then swizzles to RGBA in place
+bool captureThreadsafe::convertToRGBA(frameData* frame, uint32_t workerIndex) {
+  IDeckLinkVideoFrame* video = frame->videoFrame;
+  BMDPixelFormat outputFormat = pixelFormat;
+  bool converted = true;
+  void* bytes;
+
+  if ((outputFormat == bmdFormat8BitARGB || outputFormat == bmdFormat8BitYUV) &&
+      (workerIndex >= deckLinkConversions.size())) {
+    converted = false; // No conversion instance could be created for this worker
+  } else if (outputFormat == bmdFormat8BitARGB || outputFormat == bmdFormat8BitYUV) {
+    ConvertedVideoFrame *convertedFrame = new ConvertedVideoFrame(
+      video->GetWidth(),
+      video->GetHeight(),
+      bmdFormat8BitBGRA,
+      4 * video->GetWidth(),
+      framePool
+    );
+
+    HRESULT result = E_OUTOFMEMORY;
+    if ((convertedFrame->GetBytes(&bytes) == S_OK) && (bytes != nullptr)) {
+      result = deckLinkConversions[workerIndex]->ConvertFrame(video, convertedFrame);
+    }
+
+    if (result == E_FAIL) {
+      printf("Failed to convert frame from YUV to BGRA (E_FAIL)\n");
+    } else if (result == E_NOTIMPL) {
+      printf("Failed to convert frame from YUV to BGRA (E_NOTIMPL)\n");
+    } else if (result == E_OUTOFMEMORY) {
+      printf("Failed to convert frame from YUV to BGRA (E_OUTOFMEMORY)\n");
+    }
+
+    if (result == S_OK) {
+      frame->convertedFrame = convertedFrame;
+      video = convertedFrame;
+      outputFormat = bmdFormat8BitBGRA;
+    } else {
+      // Deliver the frame in its captured format rather than lose it
+      convertedFrame->Release();
+      converted = false;
+    }
+  }
+
+  if ((outputFormat == bmdFormat8BitBGRA) && (video->GetBytes(&bytes) == S_OK)) {
+    swizzleBGRAtoRGBA((uint8_t*) bytes, video->GetRowBytes() * video->GetHeight());
+  }
+
+  return converted;
+}
+
+// Converts 2vuy or v210 with the native kernels into a frame from the pool.
+// On failure the frame is delivered in its captured format.
+bool captureThreadsafe::convertNative(frameData* frame, uint32_t workerIndex) {
+  IDeckLinkVideoFrame* video = frame->videoFrame;
+  uint32_t width = video->GetWidth();
+  uint32_t height = video->GetHeight();
+  void* source;
+  void* bytes;
+
+  if (video->GetBytes(&source) != S_OK) return false;
+  // Most layouts have no DeckLink pixel format, so none is given
+  ConvertedVideoFrame *convertedFrame = new ConvertedVideoFrame(width, height,
+    (BMDPixelFormat) 0, pixelLayoutRowBytes(convertTo, width), framePool);
+  if ((convertedFrame->GetBytes(&bytes) != S_OK) || (bytes == nullptr) ||
+      !convertPixelLayout(video->GetPixelFormat(), (const uint8_t*) source, video->GetRowBytes(),
+        width, height, convertTo, (uint8_t*) bytes, conversionScratch[workerIndex])) {
+    convertedFrame->Release();
+    return false;
+  }
+  frame->convertedFrame = convertedFrame;
+  return true;
+}
+
+// Downscales the captured frame into a buffer from each proxy's pool. A
+// proxy that cannot be made, e.g. after the input format has changed, is
+// left out of the frame.
+bool captureThreadsafe::makeProxies(frameData* frame, uint32_t workerIndex) {
+  IDeckLinkVideoFrame* video = frame->videoFrame;
+  bool made = true;
+  void* source;
+  void* bytes;
+
+  if (video->GetBytes(&source) != S_OK) return false;
+  for ( uint32_t x = 0 ; x < proxies.size() ; x++ ) {
+    const captureProxy& proxy = proxies[x];
+    BMDPixelFormat proxyFormat = (proxy.layout == macadamLayoutUYVY) ?
+      (BMDPixelFormat) bmdFormat8BitYUV : (BMDPixelFormat) 0;
+    ConvertedVideoFrame *proxyFrame = new ConvertedVideoFrame(proxy.width, proxy.height,
+      proxyFormat, proxy.rowBytes, proxy.pool);
+    if ((proxyFrame->GetBytes(&bytes) != S_OK) || (bytes == nullptr) ||
+        !scalePixelLayout(video->GetPixelFormat(), (const uint8_t*) source, video->GetRowBytes(),
+          video->GetWidth(), video->GetHeight(), proxy.width, proxy.height, proxy.layout,
+          (uint8_t*) bytes, conversionScratch[workerIndex])) {
+      proxyFrame->Release();
+      made = false;
+      continue;
+    }
+    frame->proxies[x] = proxyFrame;
+  }
+  return made;
+}
+
+// Analyses the captured frame, before any conversion, for comparison with
+// its neighbours once the frames are back in order
+void captureThreadsafe::analyseQC(frameData* frame, uint32_t workerIndex) {
+  IDeckLinkVideoInputFrame* video = frame->videoFrame;
+  BMDTimeValue frameTime, frameDuration;
+  void* bytes;
+
+  if (video->GetBytes(&bytes) != S_OK) return;
+  qcFrameResult* result = new qcFrameResult;
+  if (!analyseVideoFrame(video->GetPixelFormat(), (const uint8_t*) bytes, video->GetRowBytes(),
+      video->GetWidth(), video->GetHeight(), qc->getOptions(), result,
+      conversionScratch[workerIndex])) {
+    result->release();
+    return;
+  }
+  if (video->GetStreamTime(&frameTime, &frameDuration, timeScale) == S_OK) {
+    result->stats.frameTime = frameTime;
+  }
+  frame->qc = result;
+}
+
+// Workers finish out of order, so hold frames back until all earlier frames have gone
+void captureThreadsafe::dispatchConverted(frameData* frame, long long conversionMicros,
+    bool converted, bool proxied) {
+  napi_status status;
+  {
+    std::lock_guard<std::mutex> guard(statsLock);
+    if (outputRGBA || (convertTo != macadamLayoutNone)) {
+      conversionCount++;
+      if (!converted) conversionFailures++;
+      conversionMicrosLast = conversionMicros;
+      conversionMicrosTotal += conversionMicros;
+      if (conversionMicros > conversionMicrosMax) conversionMicrosMax = conversionMicros;
+    }
+    if (!proxies.empty()) {
+      proxyFrames++;
+      if (!proxied) proxyFailures++;
+      proxyMicrosLast = frame->proxyMicros;
+      proxyMicrosTotal += frame->proxyMicros;
+      if (proxyMicrosLast > proxyMicrosMax) proxyMicrosMax = proxyMicrosLast;
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(dispatchLock);
+  convertedFrames[frame->sequence] = frame;
+  for ( auto it = convertedFrames.begin() ;
+      (it != convertedFrames.end()) && (it->first == nextDispatchSequence) ;
+      it = convertedFrames.erase(it) ) {
+    if (it->second->qc != nullptr) qc->compare(it->second->qc);
+    dispatchFrame(it->second);
+    nextDispatchSequence++;
+    status = napi_release_threadsafe_function(tsFn, napi_tsfn_release);
+    if (status != napi_ok) {
+      printf("DEBUG: Failed to release NAPI threadsafe function on capture, status=%d.\n", status);
+    }
+  }
+}
+
 HRESULT captureThreadsafe::VideoInputFormatChanged(
   BMDVideoInputFormatChangedEvents notificationEvents,
   IDeckLinkDisplayMode *newDisplayMode,
@@ -158,11 +490,27 @@ void finalizeVideoBuffer(napi_env env, void* finalize_data, void* finalize_hint)
     frame->rgbaAuxiliaryBuf = NULL;
   }
 
+  // Any proxies not handed to their own buffers
+  for ( uint32_t x = 0 ; x < MACADAM_MAX_PROXIES ; x++ ) {
+    if (frame->proxies[x] != nullptr) frame->proxies[x]->Release();
+  }
+  if (frame->qc != nullptr) frame->qc->release();
+
   // printf("Releasing video frame - ext mem now %li\n", externalMemory);
   
   free(frame);
 }
 
+void finalizeProxyBuffer(napi_env env, void* finalize_data, void* finalize_hint) {
+  napi_status status;
+  int64_t externalMemory;
+  IDeckLinkVideoFrame* proxy = (IDeckLinkVideoFrame*) finalize_hint;
+  status = napi_adjust_external_memory(env, -proxy->GetRowBytes()*proxy->GetHeight(),
+    &externalMemory);
+  FLOATING_STATUS;
+  proxy->Release();
+}
+
 void finalizeAudioPacket(napi_env env, void* finalize_data, void* finalize_hint) {
   napi_status status;
   int64_t externalMemory = 0;
@@ -173,6 +521,121 @@ void finalizeAudioPacket(napi_env env, void* finalize_data, void* finalize_hint)
   free(audio);
 }
 
+// Release a frame that never made it into a JS buffer
+void releaseFrameData(frameData* frame) {
+  if (frame->convertedFrame != nullptr) { frame->convertedFrame->Release(); }
+  if (frame->videoFrame != nullptr) { frame->videoFrame->Release(); }
+  if (frame->audioPacket != nullptr) { frame->audioPacket->Release(); }
+  if (frame->rgbaAuxiliaryBuf != nullptr) { free(frame->rgbaAuxiliaryBuf); }
+  for ( uint32_t x = 0 ; x < MACADAM_MAX_PROXIES ; x++ ) {
+    if (frame->proxies[x] != nullptr) { frame->proxies[x]->Release(); }
+  }
+  if (frame->qc != nullptr) { frame->qc->release(); }
+  free(frame);
+}
+
+// Release the video of a frame delivered without its data, as with proxyOnly,
+// once its metadata has been read. The audio is owned by its own buffer.
+static void releaseUndeliveredVideo(frameData* frame) {
+  if (frame->convertedFrame != nullptr) { frame->convertedFrame->Release(); }
+  if (frame->videoFrame != nullptr) { frame->videoFrame->Release(); }
+  for ( uint32_t x = 0 ; x < MACADAM_MAX_PROXIES ; x++ ) {
+    if (frame->proxies[x] != nullptr) { frame->proxies[x]->Release(); }
+  }
+  if (frame->qc != nullptr) { frame->qc->release(); }
+  free(frame);
+}
+
+// Hands the frame's proxies to JS, each as { width, height, layout, rowBytes,
+// data } or null where the proxy could not be made
+static napi_status proxyValues(napi_env env, captureThreadsafe* crts, frameData* frame,
+    napi_value* value) {
+  napi_status status;
+  napi_value proxy, param;
+  int64_t externalMemory;
+  void* bytes;
+
+  status = napi_create_array(env, value);
+  PASS_STATUS;
+  for ( uint32_t x = 0 ; x < crts->proxies.size() ; x++ ) {
+    IDeckLinkVideoFrame* proxyFrame = frame->proxies[x];
+    if ((proxyFrame == nullptr) || (proxyFrame->GetBytes(&bytes) != S_OK)) {
+      status = napi_get_null(env, &proxy);
+      PASS_STATUS;
+      status = napi_set_element(env, *value, x, proxy);
+      PASS_STATUS;
+      continue;
+    }
+    status = napi_create_object(env, &proxy);
+    PASS_STATUS;
+    status = napi_create_uint32(env, crts->proxies[x].width, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, proxy, "width", param);
+    PASS_STATUS;
+    status = napi_create_uint32(env, crts->proxies[x].height, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, proxy, "height", param);
+    PASS_STATUS;
+    status = napi_create_string_utf8(env, pixelLayoutName(crts->proxies[x].layout),
+      NAPI_AUTO_LENGTH, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, proxy, "layout", param);
+    PASS_STATUS;
+    status = napi_create_uint32(env, crts->proxies[x].rowBytes, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, proxy, "rowBytes", param);
+    PASS_STATUS;
+    status = napi_create_external_buffer(env, proxyFrame->GetRowBytes() * proxyFrame->GetHeight(),
+      bytes, finalizeProxyBuffer, proxyFrame, &param);
+    PASS_STATUS;
+    frame->proxies[x] = nullptr; // Now released when the buffer is collected
+    status = napi_set_named_property(env, proxy, "data", param);
+    PASS_STATUS;
+    status = napi_adjust_external_memory(env, proxyFrame->GetRowBytes() * proxyFrame->GetHeight(),
+      &externalMemory);
+    PASS_STATUS;
+    status = napi_set_element(env, *value, x, proxy);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+// Hold on to a frame until a frame() promise asks for it, applying the overflow policy
+void queueFrame(captureThreadsafe* crts, frameData* frame) {
+  if (crts->frameQueue.size() >= crts->frameQueueDepth) {
+    if ((crts->frameQueuePolicy == macadamDropNewest) || crts->frameQueue.empty()) {
+      releaseFrameData(frame);
+      crts->droppedNewest++;
+      return;
+    }
+    releaseFrameData(crts->frameQueue.front());
+    crts->frameQueue.pop_front();
+    crts->droppedOldest++;
+  }
+  crts->frameQueue.push_back(frame);
+  if (crts->frameQueue.size() > crts->frameQueueHighWater) {
+    crts->frameQueueHighWater = (uint32_t) crts->frameQueue.size();
+  }
+}
+
+static void rejectAudio(napi_env env, audioCarrier* c, const char* msg, int32_t status) {
+  REJECT_ERROR(msg, status);
+}
+
+static void rejectSubscription(napi_env env, frameCarrier* c, const char* msg, int32_t status) {
+  REJECT_ERROR(msg, status);
+}
+
+// Rejects waiting promises, releases queued frames and deletes the subscriber
+static void closeSubscriber(napi_env env, captureSubscriber* sub, const char* msg) {
+  while (!sub->promises.empty()) {
+    rejectSubscription(env, sub->promises.front(), msg, MACADAM_ALREADY_STOPPED);
+    sub->promises.pop();
+  }
+  for ( auto frame : sub->queue ) releaseFrameData(frame);
+  delete sub;
+}
+
 napi_value stopStreams(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value value, param, capture;
@@ -189,6 +652,12 @@ napi_value stopStreams(napi_env env, napi_callback_info info) {
   if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
   CHECK_STATUS;
 
+  if (crts->callbackQueueBlocking) {
+    // Wake any DeckLink callback blocked on a full queue so that stopping cannot deadlock
+    status = napi_release_threadsafe_function(crts->tsFn, napi_tsfn_abort);
+    CHECK_STATUS;
+  }
+
   hresult = crts->deckLinkInput->StopStreams();
   if (hresult != S_OK) NAPI_THROW_ERROR("Unable to stop streams. May be already stopped?");
   hresult = crts->deckLinkInput->DisableVideoInput();
@@ -196,8 +665,44 @@ napi_value stopStreams(napi_env env, napi_callback_info info) {
 	hresult = crts->deckLinkInput->SetCallback(NULL);
   if (hresult != S_OK) NAPI_THROW_ERROR("Unable to unset callback for decklink input.");
 
-  status = napi_release_threadsafe_function(crts->tsFn, napi_tsfn_release);
-  CHECK_STATUS;
+  // Finishes any queued conversions, dispatching or releasing their frames
+  if (crts->conversionPool != nullptr) {
+    delete crts->conversionPool;
+    crts->conversionPool = nullptr;
+  }
+
+  // Writes out queued frames and completes the files
+  if (crts->recorder != nullptr) {
+    crts->recorder->close();
+  }
+
+  // Readers see the end of the stream, while their mappings stay valid
+  if (crts->sharedRing != nullptr) {
+    crts->sharedRing->close();
+  }
+
+  if (!crts->callbackQueueBlocking) {
+    status = napi_release_threadsafe_function(crts->tsFn, napi_tsfn_release);
+    CHECK_STATUS;
+  }
+
+  while (!crts->frameQueue.empty()) {
+    releaseFrameData(crts->frameQueue.front());
+    crts->frameQueue.pop_front();
+  }
+
+  for ( auto sub : crts->subscribers ) {
+    closeSubscriber(env, sub, "Capture stopped before a frame arrived.");
+  }
+  crts->subscribers.clear();
+
+  // Audio requests that the samples already captured cannot satisfy never will be
+  resolveAudio(env, crts);
+  while (!crts->audioPromises.empty()) {
+    rejectAudio(env, crts->audioPromises.front(),
+      "Capture stopped before enough audio samples arrived.", MACADAM_ALREADY_STOPPED);
+    crts->audioPromises.pop_front();
+  }
 
   status = napi_get_undefined(env, &value);
   CHECK_STATUS;
@@ -235,6 +740,268 @@ napi_value pauseStreams(napi_env env, napi_callback_info info) {
   return value;
 }
 
+napi_value captureStats(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value value, param, capture;
+  captureThreadsafe* crts;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &capture, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, capture, "deckLinkInput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &crts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
+  CHECK_STATUS;
+
+  status = napi_create_object(env, &value);
+  CHECK_STATUS;
+  status = napi_create_string_utf8(env, "captureStats", NAPI_AUTO_LENGTH, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "type", param);
+  CHECK_STATUS;
+
+  status = napi_create_uint32(env, (uint32_t) crts->frameQueue.size(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "queueLength", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, crts->frameQueueDepth, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "queueDepth", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, crts->frameQueueHighWater, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "queueHighWater", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, crts->droppedOldest, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "droppedOldest", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, crts->droppedNewest, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "droppedNewest", param);
+  CHECK_STATUS;
+
+  status = napi_create_uint32(env, crts->callbackQueueSize, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "callbackQueueSize", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, crts->callbackQueueFull.load(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "callbackQueueFull", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, crts->callbackFailures.load(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "callbackFailures", param);
+  CHECK_STATUS;
+
+  if (crts->recorder != nullptr) {
+    status = recorderStatsValue(env, crts->recorder, value);
+    CHECK_STATUS;
+  }
+
+  if (crts->sharedRing != nullptr) {
+    status = napi_create_uint32(env, crts->sharedRing->slots(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "sharedRingSlots", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->sharedRing->framesPublished(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "sharedRingPublished", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->sharedRing->framesTruncated(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "sharedRingTruncated", param);
+    CHECK_STATUS;
+  }
+
+  status = napi_create_uint32(env, (uint32_t) crts->subscribers.size(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "subscribers", param);
+  CHECK_STATUS;
+
+  if (crts->audioRing != nullptr) {
+    audioRingStats ringStats;
+    crts->audioRing->getStats(&ringStats);
+    status = napi_create_uint32(env, ringStats.capacity, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioRingCapacity", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, ringStats.level, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioRingLevel", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, ringStats.highWater, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioRingHighWater", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, ringStats.written, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioFramesWritten", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, ringStats.read, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioFramesRead", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, ringStats.overruns, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioOverruns", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, ringStats.overrunFrames, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioOverrunFrames", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, ringStats.discontinuities, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioDiscontinuities", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, (uint32_t) crts->audioPromises.size(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioRequestsWaiting", param);
+    CHECK_STATUS;
+  }
+
+  if (crts->conversionPool != nullptr) {
+    std::lock_guard<std::mutex> guard(crts->statsLock);
+    status = napi_create_uint32(env, crts->conversionThreads, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "conversionThreads", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->conversionCount, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "conversions", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->conversionFailures, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "conversionFailures", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->conversionQueueFull.load(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "conversionQueueFull", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->conversionMicrosLast, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "conversionMicrosLast", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->conversionMicrosMax, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "conversionMicrosMax", param);
+    CHECK_STATUS;
+    status = napi_create_double(env, (crts->conversionCount > 0) ?
+      (double) crts->conversionMicrosTotal / crts->conversionCount : 0.0, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "conversionMicrosMean", param);
+    CHECK_STATUS;
+  }
+
+  if (!crts->proxies.empty()) {
+    std::lock_guard<std::mutex> guard(crts->statsLock);
+    status = napi_create_uint32(env, (uint32_t) crts->proxies.size(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "proxies", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->proxyFrames, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "proxyFrames", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->proxyFailures, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "proxyFailures", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->proxyMicrosLast, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "proxyMicrosLast", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, crts->proxyMicrosMax, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "proxyMicrosMax", param);
+    CHECK_STATUS;
+    status = napi_create_double(env, (crts->proxyFrames > 0) ?
+      (double) crts->proxyMicrosTotal / crts->proxyFrames : 0.0, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "proxyMicrosMean", param);
+    CHECK_STATUS;
+  }
+
+  if (crts->qc != nullptr) {
+    status = qcStatsValue(env, crts->qc, value);
+    CHECK_STATUS;
+  }
+
+  if (crts->inputAllocator != nullptr) {
+    inputAllocatorStats allocatorStats;
+    crts->inputAllocator->getStats(&allocatorStats);
+    status = napi_create_uint32(env, allocatorStats.bufferCount, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputBuffers", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, allocatorStats.bufferSize, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputBufferSize", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, allocatorStats.inUse, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputBuffersInUse", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, allocatorStats.highWater, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputBuffersHighWater", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, allocatorStats.hits, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputBufferHits", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, allocatorStats.misses, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputBufferMisses", param);
+    CHECK_STATUS;
+    status = napi_get_boolean(env, allocatorStats.hugePages, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputHugePages", param);
+    CHECK_STATUS;
+    status = napi_create_int32(env, allocatorStats.numaNode, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputNumaNode", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, allocatorStats.numaFailures, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "inputNumaFailures", param);
+    CHECK_STATUS;
+  }
+
+  if (crts->framePool != nullptr) {
+    convertedFramePoolStats poolStats;
+    crts->framePool->getStats(&poolStats);
+    status = napi_create_uint32(env, poolStats.poolSize, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "bufferPoolSize", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, poolStats.allocated, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "buffersAllocated", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, poolStats.inUse, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "buffersInUse", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, poolStats.highWater, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "buffersHighWater", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, poolStats.allocations, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "bufferAllocations", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, poolStats.reuses, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "bufferReuses", param);
+    CHECK_STATUS;
+  }
+
+  return value;
+}
+
 void captureExecute(napi_env env, void* data) {
   captureCarrier* c = (captureCarrier*) data;
 
@@ -294,6 +1061,18 @@ void captureExecute(napi_env env, void* data) {
       return;
   }
 
+  if (c->inputBuffers > 0) {
+    // Must be set before the video input is enabled
+    c->inputAllocator = new macadamInputAllocator(c->inputBuffers,
+      c->inputHugePages, c->inputNumaNode);
+    hresult = deckLinkInput->SetVideoInputFrameMemoryAllocator(c->inputAllocator);
+    if (hresult != S_OK) {
+      c->status = MACADAM_CALL_FAILURE;
+      c->errorMsg = "Failed to set the memory allocator for video input frames.";
+      return;
+    }
+  }
+
   hresult = deckLinkInput->EnableVideoInput(c->requestedDisplayMode,
     c->requestedPixelFormat, c->requestedVideoInputFlags);
   switch (hresult) {
@@ -333,8 +1112,81 @@ void captureExecute(napi_env env, void* data) {
         break;
     }
   }
+
+  if (c->recordOptions != nullptr) {
+    std::string error;
+    c->recordOptions->channels = c->channels;
+    c->recordOptions->sampleRate = c->requestedSampleRate;
+    c->recordOptions->sampleType = c->requestedSampleType;
+    BMDTimeValue frameRateDuration;
+    BMDTimeScale frameRateScale;
+    if (c->selectedDisplayMode->GetFrameRate(&frameRateDuration, &frameRateScale) == S_OK) {
+      c->recordOptions->timeScale = (uint32_t) frameRateScale;
+      c->recordOptions->frameDuration = (uint32_t) frameRateDuration;
+    }
+    c->recorder = new macadamRecorder(*c->recordOptions);
+    if (!c->recorder->open(&error)) {
+      c->status = MACADAM_CALL_FAILURE;
+      c->errorMsg = error;
+      return;
+    }
+  }
+
+  if (!c->sharedRingName.empty()) {
+    std::string error;
+    BMDTimeValue frameRateDuration;
+    BMDTimeScale frameRateScale;
+    sharedRingFormat format;
+    c->selectedDisplayMode->GetFrameRate(&frameRateDuration, &frameRateScale);
+    format.width = (uint32_t) c->selectedDisplayMode->GetWidth();
+    format.height = (uint32_t) c->selectedDisplayMode->GetHeight();
+    format.pixelFormat = c->requestedPixelFormat;
+    format.videoCapacity = sharedRingRowBytes(format.pixelFormat, format.width) * format.height;
+    format.timeScale = (uint32_t) frameRateScale;
+    format.frameDuration = (uint32_t) frameRateDuration;
+    if (c->channels > 0) {
+      format.sampleRate = c->requestedSampleRate;
+      format.channels = c->channels;
+      format.sampleType = c->requestedSampleType;
+      // Twice the samples of a frame, for packets that are not evenly spread
+      uint64_t samples = ((uint64_t) format.sampleRate * frameRateDuration +
+        frameRateScale - 1) / frameRateScale;
+      format.audioCapacity = (uint32_t) (2 * samples * c->channels * (c->requestedSampleType / 8));
+    }
+    c->sharedRing = macadamSharedRing::create(c->sharedRingName, c->sharedRingSlots, format, &error);
+    if (c->sharedRing == nullptr) {
+      c->status = MACADAM_CALL_FAILURE;
+      c->errorMsg = error;
+      return;
+    }
+  }
+
+  // Proxy sizes keep the aspect ratio, with an even width for 4:2:2 chroma
+  uint32_t width = (uint32_t) c->selectedDisplayMode->GetWidth();
+  uint32_t height = (uint32_t) c->selectedDisplayMode->GetHeight();
+  for ( auto& proxy : c->proxies ) {
+    if (proxy.scale > 0) {
+      proxy.outWidth = (width / proxy.scale) & ~1u;
+      proxy.outHeight = height / proxy.scale;
+    } else {
+      if (proxy.width > width) {
+        c->status = MACADAM_OUT_OF_BOUNDS;
+        c->errorMsg = "Proxy width must be no larger than the width of the display mode.";
+        return;
+      }
+      proxy.outWidth = proxy.width;
+      proxy.outHeight = (uint32_t) (((uint64_t) proxy.width * height + width / 2) / width);
+    }
+    if ((proxy.outWidth == 0) || (proxy.outHeight == 0)) {
+      c->status = MACADAM_OUT_OF_BOUNDS;
+      c->errorMsg = "Proxy is too small for the display mode.";
+      return;
+    }
+  }
 }
 
+static bool startCapture(captureThreadsafe* crts, carrier* c);
+
 void captureComplete(napi_env env, napi_status asyncStatus, void* data) {
   captureCarrier* c = (captureCarrier*) data;
   napi_value param, paramPart, result, asyncName;
@@ -490,26 +1342,129 @@ void captureComplete(napi_env env, napi_status asyncStatus, void* data) {
   c->status = napi_set_named_property(env, result, "frame", param);
   REJECT_STATUS;
 
-  captureThreadsafe* crts = new captureThreadsafe;
-  crts->deckLinkInput = c->deckLinkInput;
-  c->deckLinkInput = nullptr;
-  crts->displayMode = c->selectedDisplayMode;
-  c->selectedDisplayMode = nullptr;
-  crts->timeScale = frameRateScale;
-  crts->pixelFormat = c->requestedPixelFormat;
-  crts->outputRGBA = c->outputRGBA;
+  c->status = napi_create_function(env, "frames", NAPI_AUTO_LENGTH, framesPromise,
+    nullptr, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "frames", param);
+  REJECT_STATUS;
 
-  crts->deckLinkConversion = nullptr;
-  #ifdef WIN32
-  hresult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-  CoCreateInstance(CLSID_CDeckLinkVideoConversion, NULL, CLSCTX_ALL, IID_IDeckLinkVideoConversion, (void**)&crts->deckLinkConversion);
-  #else
-  crts->deckLinkConversion = CreateVideoConversionInstance();
-  #endif
+  c->status = napi_create_function(env, "framesAvailable", NAPI_AUTO_LENGTH, framesAvailable,
+    nullptr, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "framesAvailable", param);
+  REJECT_STATUS;
 
-  if (!crts->deckLinkConversion) {
-    printf("ERROR: Failed to initialize DeckLink video conversion interface\n");
-  }
+  c->status = napi_create_function(env, "subscribe", NAPI_AUTO_LENGTH, subscribe,
+    nullptr, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "subscribe", param);
+  REJECT_STATUS;
+
+  if (c->audioRing > 0) {
+    c->status = napi_create_function(env, "audio", NAPI_AUTO_LENGTH, audioPromise,
+      nullptr, &param);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, result, "audio", param);
+    REJECT_STATUS;
+
+    c->status = napi_create_function(env, "audioAvailable", NAPI_AUTO_LENGTH, audioAvailable,
+      nullptr, &param);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, result, "audioAvailable", param);
+    REJECT_STATUS;
+  }
+
+  if (c->qc != nullptr) {
+    c->status = napi_create_function(env, "qcEvents", NAPI_AUTO_LENGTH, qcEvents,
+      nullptr, &param);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, result, "qcEvents", param);
+    REJECT_STATUS;
+  }
+
+  c->status = napi_create_function(env, "stats", NAPI_AUTO_LENGTH, captureStats,
+    nullptr, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "stats", param);
+  REJECT_STATUS;
+
+  captureThreadsafe* crts = new captureThreadsafe;
+  crts->deckLinkInput = c->deckLinkInput;
+  c->deckLinkInput = nullptr;
+  crts->displayMode = c->selectedDisplayMode;
+  c->selectedDisplayMode = nullptr;
+  crts->timeScale = frameRateScale;
+  crts->pixelFormat = c->requestedPixelFormat;
+  crts->outputRGBA = c->outputRGBA;
+  crts->frameQueueDepth = c->frameQueueDepth;
+  crts->frameQueuePolicy = c->frameQueuePolicy;
+  crts->callbackQueueSize = c->callbackQueueSize;
+  crts->callbackQueueBlocking = c->callbackQueueBlocking;
+
+  crts->inputAllocator = c->inputAllocator;
+  c->inputAllocator = nullptr;
+  crts->conversionThreads = c->conversionThreads;
+  crts->convertTo = c->convertTo;
+  // The DeckLink conversion does not handle v210, so convert that natively
+  if (crts->outputRGBA && (crts->pixelFormat == bmdFormat10BitYUV) &&
+      (crts->convertTo == macadamLayoutNone)) {
+    crts->convertTo = macadamLayoutRGBA;
+  }
+
+  if (crts->outputRGBA || (crts->convertTo != macadamLayoutNone) || !c->proxies.empty() ||
+      (c->qc != nullptr)) {
+    uint32_t width = crts->displayMode->GetWidth();
+    uint32_t height = crts->displayMode->GetHeight();
+    if (crts->outputRGBA && (crts->convertTo == macadamLayoutNone)) {
+      #ifdef WIN32
+      hresult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+      #endif
+      for ( uint32_t x = 0 ; x < crts->conversionThreads ; x++ ) {
+        IDeckLinkVideoConversion* deckLinkConversion = nullptr;
+        #ifdef WIN32
+        CoCreateInstance(CLSID_CDeckLinkVideoConversion, NULL, CLSCTX_ALL, IID_IDeckLinkVideoConversion, (void**)&deckLinkConversion);
+        #else
+        deckLinkConversion = CreateVideoConversionInstance();
+        #endif
+        if (!deckLinkConversion) {
+          printf("ERROR: Failed to initialize DeckLink video conversion interface\n");
+          break;
+        }
+        crts->deckLinkConversions.push_back(deckLinkConversion);
+      }
+    }
+    // Enough buffers for frames being converted, waiting for a worker and
+    // queued for JS, so that a steady stream reuses the same few buffers
+    uint32_t poolSize = crts->conversionThreads * 3 + crts->frameQueueDepth + 2;
+    // BGRA is swizzled in place, as is any other format passed through, so
+    // only native and DeckLink conversions need frames from a pool
+    if (crts->convertTo != macadamLayoutNone) {
+      crts->framePool = new ConvertedFramePool(poolSize,
+        pixelLayoutRowBytes(crts->convertTo, width) * height, poolSize);
+    } else if (crts->outputRGBA &&
+        (crts->pixelFormat == bmdFormat8BitARGB || crts->pixelFormat == bmdFormat8BitYUV)) {
+      crts->framePool = new ConvertedFramePool(poolSize, 4 * width * height, poolSize);
+    }
+    for ( auto& request : c->proxies ) {
+      captureProxy proxy;
+      proxy.width = request.outWidth;
+      proxy.height = request.outHeight;
+      proxy.layout = request.layout;
+      proxy.rowBytes = pixelLayoutRowBytes(request.layout, request.outWidth);
+      proxy.pool = new ConvertedFramePool(poolSize, proxy.rowBytes * proxy.height, poolSize);
+      crts->proxies.push_back(proxy);
+    }
+    crts->proxyOnly = c->proxyOnly;
+    if (c->qc != nullptr) {
+      crts->qc = new macadamVideoQC(*c->qc);
+    }
+    for ( uint32_t x = 0 ; x < crts->conversionThreads ; x++ ) {
+      crts->conversionScratch.push_back(new pixelScratch);
+    }
+    // Bounded so that a stalled main thread causes drops rather than unbounded growth
+    crts->conversionPool = new macadamWorkerPool(crts->conversionThreads,
+      crts->conversionThreads * 2);
+  }
 
   crts->roughFps = (uint16_t) (frameRateScale / frameRateDuration); // Used for timecode formatting
   crts->channels = c->channels;
@@ -517,6 +1472,19 @@ void captureComplete(napi_env env, napi_status asyncStatus, void* data) {
     crts->sampleRate = c->requestedSampleRate;
     crts->sampleType = c->requestedSampleType;
     crts->sampleByteFactor = c->channels * (crts->sampleType / 8);
+    crts->planarAudio = c->planarAudio;
+    crts->channelMap = c->channelMap;
+    if (crts->channelMap.empty()) {
+      for ( uint32_t x = 0 ; x < c->channels ; x++ ) crts->channelMap.push_back(x);
+    }
+    if (c->audioRing > 0) {
+      crts->audioRing = new macadamAudioRing(c->audioRing, crts->sampleByteFactor);
+      if (!crts->audioRing->allocated()) {
+        c->status = MACADAM_OUT_OF_MEMORY;
+        c->errorMsg = "Unable to allocate the capture audio ring.";
+        REJECT_STATUS;
+      }
+    }
   }
 
   hresult = crts->deckLinkInput->SetCallback(crts);
@@ -526,12 +1494,47 @@ void captureComplete(napi_env env, napi_status asyncStatus, void* data) {
     REJECT_STATUS;
   }
 
+  // Created before the threadsafe function, which deletes the references when it finalizes
+  crts->refs = new captureRefs;
+  if (c->binaryMetadata) {
+    void* records;
+    c->status = napi_create_arraybuffer(env, c->metadataRecords * sizeof(macadamFrameRecord),
+      &records, &param);
+    REJECT_STATUS;
+    memset(records, 0, c->metadataRecords * sizeof(macadamFrameRecord));
+    c->status = napi_create_reference(env, param, 1, &crts->refs->metadata);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, result, "metadata", param);
+    REJECT_STATUS;
+    crts->metadataRecords = (macadamFrameRecord*) records;
+    crts->metadataRecordCount = c->metadataRecords;
+  }
+
+  crts->recorder = c->recorder;
+  c->recorder = nullptr;
+  crts->sharedRing = c->sharedRing;
+  c->sharedRing = nullptr;
+  crts->deliverFrames = c->deliverFrames;
+
+  crts->ancillaryMode = c->ancillaryMode;
+  crts->ancillaryFilter = c->ancillaryFilter;
+  crts->decodeAncillary = c->decodeAncillary;
+  crts->timecodeString = c->timecodeString;
+  if (crts->ancillaryMode == macadamAncillaryLazy) { // One method shared by all frames
+    c->status = napi_create_function(env, "ancillary", NAPI_AUTO_LENGTH, ancillaryPackets,
+      nullptr, &param);
+    REJECT_STATUS;
+    c->status = napi_create_reference(env, param, 1, &crts->refs->ancillaryMethod);
+    REJECT_STATUS;
+  }
+
   c->status = napi_create_string_utf8(env, "capture", NAPI_AUTO_LENGTH, &asyncName);
   REJECT_STATUS;
   c->status = napi_create_function(env, "nop", NAPI_AUTO_LENGTH, nop, nullptr, &param);
   REJECT_STATUS;
   c->status = napi_create_threadsafe_function(env, param, nullptr, asyncName,
-    20, 1, nullptr, captureTsFnFinalize, crts, frameResolver, &crts->tsFn);
+    crts->callbackQueueSize, 1, crts->refs, captureTsFnFinalize, crts, frameResolver,
+    &crts->tsFn);
   REJECT_STATUS;
 
   // Set up onVideoInputFormatChanged callback
@@ -552,6 +1555,10 @@ void captureComplete(napi_env env, napi_status asyncStatus, void* data) {
   c->status = napi_set_named_property(env, result, "deckLinkInput", param);
   REJECT_STATUS;
 
+  // Recording and publishing run from creation, without waiting for frames to be requested
+  if (((crts->recorder != nullptr) || (crts->sharedRing != nullptr)) &&
+      !startCapture(crts, c)) REJECT_STATUS;
+
   napi_status status;
   status = napi_resolve_deferred(env, c->_deferred, result);
   FLOATING_STATUS;
@@ -710,6 +1717,414 @@ napi_value capture(napi_env env, napi_callback_info info) {
     REJECT_RETURN;
   }
 
+  c->status = napi_get_named_property(env, options, "frameQueueDepth", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Frame queue depth must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->frameQueueDepth);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "frameQueuePolicy", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_string) REJECT_ERROR_RETURN(
+      "Frame queue policy must be a string, either 'dropOldest' or 'dropNewest'.",
+      MACADAM_INVALID_ARGS);
+    c->status = parseOverflowPolicy(env, param, &c->frameQueuePolicy);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Frame queue policy must be either 'dropOldest' or 'dropNewest'.",
+      MACADAM_INVALID_ARGS);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "callbackQueueSize", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Callback queue size must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->callbackQueueSize);
+    REJECT_RETURN;
+    if (c->callbackQueueSize == 0) REJECT_ERROR_RETURN(
+      "Callback queue size must be greater than zero.", MACADAM_OUT_OF_BOUNDS);
+  }
+
+  c->status = napi_get_named_property(env, options, "callbackQueueMode", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_string) REJECT_ERROR_RETURN(
+      "Callback queue mode must be a string, either 'drop' or 'block'.", MACADAM_INVALID_ARGS);
+    c->status = parseCallbackQueueMode(env, param, &c->callbackQueueBlocking);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Callback queue mode must be either 'drop' or 'block'.", MACADAM_INVALID_ARGS);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "conversionThreads", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Conversion threads must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->conversionThreads);
+    REJECT_RETURN;
+    if ((c->conversionThreads == 0) || (c->conversionThreads > 16)) REJECT_ERROR_RETURN(
+      "Conversion threads must be between 1 and 16.", MACADAM_OUT_OF_BOUNDS);
+  }
+
+  c->status = napi_get_named_property(env, options, "inputBuffers", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Input buffers must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->inputBuffers);
+    REJECT_RETURN;
+    if (c->inputBuffers > 256) REJECT_ERROR_RETURN(
+      "Input buffers must be no more than 256.", MACADAM_OUT_OF_BOUNDS);
+  }
+
+  c->status = napi_get_named_property(env, options, "inputHugePages", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) REJECT_ERROR_RETURN(
+      "Input huge pages must be a boolean.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_bool(env, param, &c->inputHugePages);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "inputNumaNode", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Input NUMA node must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_int32(env, param, &c->inputNumaNode);
+    REJECT_RETURN;
+    if ((c->inputNumaNode < -1) || (c->inputNumaNode > 255)) REJECT_ERROR_RETURN(
+      "Input NUMA node must be between 0 and 255, or -1 for any node.", MACADAM_OUT_OF_BOUNDS);
+  }
+
+  c->status = napi_get_named_property(env, options, "convertTo", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_string) REJECT_ERROR_RETURN(
+      "Conversion target must be a string, one of 'rgba', 'rgb48', 'yuv422p10' or 'uyvy'.",
+      MACADAM_INVALID_ARGS);
+    c->status = parsePixelLayout(env, param, &c->convertTo);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Conversion target must be one of 'rgba', 'rgb48', 'yuv422p10' or 'uyvy'.",
+      MACADAM_INVALID_ARGS);
+    REJECT_RETURN;
+    if (!canConvertPixels(c->requestedPixelFormat)) REJECT_ERROR_RETURN(
+      "Only 8-bit and 10-bit YUV pixel formats can be converted with convertTo.",
+      MACADAM_NO_CONVERSION);
+  }
+
+  c->status = napi_get_named_property(env, options, "binaryMetadata", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) REJECT_ERROR_RETURN(
+      "Binary metadata must be a boolean.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_bool(env, param, &c->binaryMetadata);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "metadataRecords", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Metadata records must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->metadataRecords);
+    REJECT_RETURN;
+    if ((c->metadataRecords == 0) || (c->metadataRecords > 4096)) REJECT_ERROR_RETURN(
+      "Metadata records must be between 1 and 4096.", MACADAM_OUT_OF_BOUNDS);
+  }
+  // Otherwise a batch of queued frames would overwrite its own first records
+  if (c->binaryMetadata && (c->metadataRecords < c->frameQueueDepth)) REJECT_ERROR_RETURN(
+    "Metadata records must be at least the frame queue depth.", MACADAM_OUT_OF_BOUNDS);
+
+  c->status = napi_get_named_property(env, options, "ancillary", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_string) REJECT_ERROR_RETURN(
+      "Ancillary mode must be a string, one of 'eager', 'lazy' or 'none'.", MACADAM_INVALID_ARGS);
+    c->status = parseAncillaryMode(env, param, &c->ancillaryMode);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Ancillary mode must be one of 'eager', 'lazy' or 'none'.", MACADAM_INVALID_ARGS);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "ancillaryFilter", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    ancillaryFilters* filter = new ancillaryFilters;
+    c->ancillaryFilter.reset(filter);
+    c->status = parseAncillaryFilter(env, param, filter);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Ancillary filter must be an object or array of objects with a numeric did and optional sdid.",
+      MACADAM_INVALID_ARGS);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "decodeAncillary", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) REJECT_ERROR_RETURN(
+      "Decode ancillary must be a boolean.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_bool(env, param, &c->decodeAncillary);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "timecodeString", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) REJECT_ERROR_RETURN(
+      "Timecode string must be a boolean.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_bool(env, param, &c->timecodeString);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "planarAudio", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) REJECT_ERROR_RETURN(
+      "Planar audio must be a boolean.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_bool(env, param, &c->planarAudio);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "channelMap", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (!c->planarAudio) REJECT_ERROR_RETURN(
+      "A channel map can only be used with planar audio.", MACADAM_INVALID_ARGS);
+    c->status = parseChannelMap(env, param, c->channels, &c->channelMap);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Channel map must be an array of up to 64 source channel indexes, each less than channels.",
+      MACADAM_OUT_OF_BOUNDS);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "audioRing", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Audio ring capacity must be a number of sample frames.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->audioRing);
+    REJECT_RETURN;
+    if (c->audioRing > 0x1000000) REJECT_ERROR_RETURN(
+      "Audio ring capacity must be at most 16777216 sample frames.", MACADAM_OUT_OF_BOUNDS);
+    if ((c->audioRing > 0) && (c->channels == 0)) REJECT_ERROR_RETURN(
+      "An audio ring requires audio channels to be captured.", MACADAM_INVALID_ARGS);
+  }
+
+  c->status = napi_get_named_property(env, options, "record", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    c->recordOptions = new recorderOptions;
+    c->status = parseRecorderOptions(env, param, c->recordOptions);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Record options must be an object with video, audio and index paths, boolean directIO, queueDepth from 1 to 1024, writeSize a multiple of 4096 bytes and at most one of segmentFrames and segmentSeconds.",
+      MACADAM_INVALID_ARGS);
+    REJECT_RETURN;
+    if (c->recordOptions->videoPath.empty() &&
+        (c->recordOptions->audioPath.empty() || (c->channels == 0))) REJECT_ERROR_RETURN(
+      "Record options must give a video path or, with audio channels, an audio path.",
+      MACADAM_INVALID_ARGS);
+  }
+
+  c->status = napi_get_named_property(env, options, "sharedRing", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    napi_value value;
+    if (type != napi_object) REJECT_ERROR_RETURN(
+      "Shared ring options must be an object with a name and a number of slots.",
+      MACADAM_INVALID_ARGS);
+    c->status = napi_get_named_property(env, param, "name", &value);
+    REJECT_RETURN;
+    c->status = napi_typeof(env, value, &type);
+    REJECT_RETURN;
+    if (type != napi_string) REJECT_ERROR_RETURN(
+      "Shared ring name must be a string.", MACADAM_INVALID_ARGS);
+    size_t nameLength;
+    char name[SHARED_RING_NAME_MAX + 2];
+    c->status = napi_get_value_string_utf8(env, value, name, sizeof(name), &nameLength);
+    REJECT_RETURN;
+    c->sharedRingName = name;
+    if (!validSharedRingName(c->sharedRingName) || (nameLength > SHARED_RING_NAME_MAX)) REJECT_ERROR_RETURN(
+      "Shared ring name must be 1 to 30 letters, digits, '_' or '-'.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_named_property(env, param, "slots", &value);
+    REJECT_RETURN;
+    c->status = napi_typeof(env, value, &type);
+    REJECT_RETURN;
+    if (type != napi_undefined) {
+      if (type != napi_number) REJECT_ERROR_RETURN(
+        "Shared ring slots must be a number.", MACADAM_INVALID_ARGS);
+      c->status = napi_get_value_uint32(env, value, &c->sharedRingSlots);
+      REJECT_RETURN;
+      if ((c->sharedRingSlots < 2) || (c->sharedRingSlots > 256)) REJECT_ERROR_RETURN(
+        "Shared ring slots must be from 2 to 256.", MACADAM_OUT_OF_BOUNDS);
+    }
+  }
+
+  c->status = napi_get_named_property(env, options, "proxies", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    napi_value item, value;
+    bool isArray;
+    uint32_t proxyCount;
+    c->status = napi_is_array(env, param, &isArray);
+    REJECT_RETURN;
+    if (!isArray) REJECT_ERROR_RETURN(
+      "Proxies must be an array of objects.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_array_length(env, param, &proxyCount);
+    REJECT_RETURN;
+    if (proxyCount > MACADAM_MAX_PROXIES) REJECT_ERROR_RETURN(
+      "No more than 4 proxies may be made of each frame.", MACADAM_OUT_OF_BOUNDS);
+    if ((proxyCount > 0) && !canConvertPixels(c->requestedPixelFormat)) REJECT_ERROR_RETURN(
+      "Proxies can only be made from 8-bit and 10-bit YUV pixel formats.",
+      MACADAM_NO_CONVERSION);
+    for ( uint32_t x = 0 ; x < proxyCount ; x++ ) {
+      proxyRequest proxy;
+      c->status = napi_get_element(env, param, x, &item);
+      REJECT_RETURN;
+      c->status = napi_typeof(env, item, &type);
+      REJECT_RETURN;
+      if (type != napi_object) REJECT_ERROR_RETURN(
+        "Each proxy must be an object with a scale or a width.", MACADAM_INVALID_ARGS);
+      c->status = napi_get_named_property(env, item, "scale", &value);
+      REJECT_RETURN;
+      c->status = napi_typeof(env, value, &type);
+      REJECT_RETURN;
+      if (type != napi_undefined) {
+        if (type != napi_number) REJECT_ERROR_RETURN(
+          "Proxy scale must be a number.", MACADAM_INVALID_ARGS);
+        c->status = napi_get_value_uint32(env, value, &proxy.scale);
+        REJECT_RETURN;
+        if ((proxy.scale < 2) || (proxy.scale > 16)) REJECT_ERROR_RETURN(
+          "Proxy scale must be from 2 to 16.", MACADAM_OUT_OF_BOUNDS);
+      }
+      c->status = napi_get_named_property(env, item, "width", &value);
+      REJECT_RETURN;
+      c->status = napi_typeof(env, value, &type);
+      REJECT_RETURN;
+      if (type != napi_undefined) {
+        if (type != napi_number) REJECT_ERROR_RETURN(
+          "Proxy width must be a number.", MACADAM_INVALID_ARGS);
+        c->status = napi_get_value_uint32(env, value, &proxy.width);
+        REJECT_RETURN;
+        if ((proxy.width < 16) || ((proxy.width & 1) != 0)) REJECT_ERROR_RETURN(
+          "Proxy width must be an even number of at least 16.", MACADAM_OUT_OF_BOUNDS);
+      }
+      if ((proxy.scale == 0) == (proxy.width == 0)) REJECT_ERROR_RETURN(
+        "Each proxy must have either a scale or a width.", MACADAM_INVALID_ARGS);
+      c->status = napi_get_named_property(env, item, "layout", &value);
+      REJECT_RETURN;
+      c->status = napi_typeof(env, value, &type);
+      REJECT_RETURN;
+      if (type != napi_undefined) {
+        if (type != napi_string) REJECT_ERROR_RETURN(
+          "Proxy layout must be a string, one of 'rgba', 'rgb48', 'yuv422p10' or 'uyvy'.",
+          MACADAM_INVALID_ARGS);
+        c->status = parsePixelLayout(env, value, &proxy.layout);
+        if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+          "Proxy layout must be one of 'rgba', 'rgb48', 'yuv422p10' or 'uyvy'.",
+          MACADAM_INVALID_ARGS);
+        REJECT_RETURN;
+      }
+      c->proxies.push_back(proxy);
+    }
+  }
+
+  c->status = napi_get_named_property(env, options, "proxyOnly", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) REJECT_ERROR_RETURN(
+      "Proxy only must be a boolean.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_bool(env, param, &c->proxyOnly);
+    REJECT_RETURN;
+    if (c->proxyOnly && c->proxies.empty()) REJECT_ERROR_RETURN(
+      "Proxy only requires at least one proxy.", MACADAM_INVALID_ARGS);
+  }
+
+  c->status = napi_get_named_property(env, options, "qc", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if ((type != napi_boolean) && (type != napi_object)) REJECT_ERROR_RETURN(
+      "QC must be a boolean or an object of analysis options.", MACADAM_INVALID_ARGS);
+    bool analyse = true;
+    if (type == napi_boolean) {
+      c->status = napi_get_value_bool(env, param, &analyse);
+      REJECT_RETURN;
+    }
+    if (analyse) {
+      if (!canConvertPixels(c->requestedPixelFormat)) REJECT_ERROR_RETURN(
+        "Only 8-bit and 10-bit YUV pixel formats can be analysed with qc.",
+        MACADAM_NO_CONVERSION);
+      c->qc = new qcOptions;
+      c->status = parseQCOptions(env, param, c->qc);
+      if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+        "QC options are out of range or of the wrong type.", MACADAM_OUT_OF_BOUNDS);
+      REJECT_RETURN;
+    }
+  }
+
+  c->status = napi_get_named_property(env, options, "deliverFrames", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) REJECT_ERROR_RETURN(
+      "Deliver frames must be a boolean.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_bool(env, param, &c->deliverFrames);
+    REJECT_RETURN;
+  }
+
   c->status = napi_create_string_utf8(env, "CreateCapture", NAPI_AUTO_LENGTH, &resourceName);
   REJECT_RETURN;
   c->status = napi_create_async_work(env, NULL, resourceName, captureExecute,
@@ -721,17 +2136,41 @@ napi_value capture(napi_env env, napi_callback_info info) {
   return promise;
 }
 
-napi_value framePromise(napi_env env, napi_callback_info info) {
+// Streams start when the first frame or audio is requested
+static bool startCapture(captureThreadsafe* crts, carrier* c) {
+  HRESULT hresult;
+  if (crts->started) return true;
+  hresult = crts->deckLinkInput->StartStreams();
+  switch (hresult) {
+    case E_FAIL:
+      c->errorMsg = "Call to start streams failed.";
+      c->status = MACADAM_CALL_FAILURE;
+      return false;
+    case E_UNEXPECTED:
+      c->errorMsg = "Video and/or audio inputs are not enabled.";
+      c->status = MACADAM_CALL_FAILURE;
+      return false;
+    case E_ACCESSDENIED: // Streams are already running
+    case S_OK:
+      break;
+  }
+  crts->started = true;
+  return true;
+}
+
+// Shared by frame() and frames(n), the latter having batch set
+static napi_value requestFrames(napi_env env, napi_callback_info info, bool batch) {
   napi_value promise, capture, param;
+  napi_value argv[1];
+  napi_valuetype type;
   captureThreadsafe* crts;
   frameCarrier* c = new frameCarrier;
-  HRESULT hresult;
 
   c->status = napi_create_promise(env, &c->_deferred, &promise);
   REJECT_RETURN;
 
-  size_t argc = 0;
-  c->status = napi_get_cb_info(env, info, &argc, nullptr, &capture, nullptr);
+  size_t argc = 1;
+  c->status = napi_get_cb_info(env, info, &argc, argv, &capture, nullptr);
   REJECT_RETURN;
 
   c->status = napi_get_named_property(env, capture, "deckLinkInput", &param);
@@ -741,27 +2180,468 @@ napi_value framePromise(napi_env env, napi_callback_info info) {
     "Cannot request frames after stream stop.", MACADAM_ALREADY_STOPPED);
   REJECT_RETURN;
 
-  if (!crts->started) {
-    hresult = crts->deckLinkInput->StartStreams();
-    switch (hresult) {
-      case E_FAIL:
-        REJECT_ERROR_RETURN("Call to start streams failed.",
-          MACADAM_CALL_FAILURE);
-        break;
-      case E_UNEXPECTED:
-        REJECT_ERROR_RETURN("Video and/or audio inputs are not enabled.",
-          MACADAM_CALL_FAILURE);
-        break;
-      case E_ACCESSDENIED: // Streams are already running
-      case S_OK:
-        break;
+  if (!startCapture(crts, c)) REJECT_RETURN;
+
+  if (batch) {
+    c->batchSize = UINT32_MAX;
+    if (argc >= 1) {
+      c->status = napi_typeof(env, argv[0], &type);
+      REJECT_RETURN;
+      if (type != napi_undefined) {
+        if (type != napi_number) REJECT_ERROR_RETURN(
+          "Maximum number of frames must be a number.", MACADAM_INVALID_ARGS);
+        c->status = napi_get_value_uint32(env, argv[0], &c->batchSize);
+        REJECT_RETURN;
+        if (c->batchSize == 0) REJECT_ERROR_RETURN(
+          "Maximum number of frames must be greater than zero.", MACADAM_OUT_OF_BOUNDS);
+        if ((crts->metadataRecords != nullptr) && (c->batchSize > crts->metadataRecordCount))
+          REJECT_ERROR_RETURN("Maximum number of frames must be at most the metadata records.",
+            MACADAM_OUT_OF_BOUNDS);
+      }
+    }
+    // Each frame of a batch needs a record of its own
+    if ((crts->metadataRecords != nullptr) && (c->batchSize > crts->metadataRecordCount))
+      c->batchSize = crts->metadataRecordCount;
+    if (!crts->frameQueue.empty()) {
+      resolveFrames(env, crts, nullptr, c);
+      return promise;
+    }
+  } else if (!crts->frameQueue.empty()) {
+    frameData* frame = crts->frameQueue.front();
+    crts->frameQueue.pop_front();
+    resolveFrame(env, crts, frame, c);
+    return promise;
+  }
+
+  crts->framePromises.push(c);
+
+  return promise;
+}
+
+napi_value framePromise(napi_env env, napi_callback_info info) {
+  return requestFrames(env, info, false);
+}
+
+// Resolves with an array of queued frames, up to an optional maximum, or
+// waits for the next frame if none are queued
+napi_value framesPromise(napi_env env, napi_callback_info info) {
+  return requestFrames(env, info, true);
+}
+
+napi_value framesAvailable(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value value, param, capture;
+  captureThreadsafe* crts;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &capture, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, capture, "deckLinkInput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &crts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
+  CHECK_STATUS;
+
+  status = napi_create_uint32(env, (uint32_t) crts->frameQueue.size(), &value);
+  CHECK_STATUS;
+  return value;
+}
+
+// Takes the black, freeze and gamut events raised since the last call
+napi_value qcEvents(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value value, param, capture;
+  captureThreadsafe* crts;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &capture, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, capture, "deckLinkInput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &crts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
+  CHECK_STATUS;
+  if (crts->qc == nullptr) NAPI_THROW_ERROR("Capture was not started with the qc option.");
+
+  status = qcEventsValue(env, crts->qc->takeEvents(), &value);
+  CHECK_STATUS;
+  return value;
+}
+
+// Another reference to the same frame buffers, for a subscriber
+static frameData* shareFrameData(frameData* frame) {
+  frameData* shared = (frameData*) malloc(sizeof(frameData));
+  *shared = *frame;
+  shared->rgbaAuxiliaryBuf = nullptr; // Not shared, and never set for captured frames
+  if (shared->videoFrame != nullptr) shared->videoFrame->AddRef();
+  if (shared->convertedFrame != nullptr) shared->convertedFrame->AddRef();
+  if (shared->audioPacket != nullptr) shared->audioPacket->AddRef();
+  for ( uint32_t x = 0 ; x < MACADAM_MAX_PROXIES ; x++ ) {
+    if (shared->proxies[x] != nullptr) shared->proxies[x]->AddRef();
+  }
+  if (shared->qc != nullptr) shared->qc->addRef();
+  return shared;
+}
+
+// Resolve the subscriber's oldest frame() promise, or queue with its overflow policy
+static void deliverToSubscriber(napi_env env, captureThreadsafe* crts,
+    captureSubscriber* sub, frameData* frame) {
+  sub->delivered++;
+  if (!sub->promises.empty()) {
+    frameCarrier* c = sub->promises.front();
+    sub->promises.pop();
+    resolveFrame(env, crts, frame, c);
+    return;
+  }
+  if (sub->queue.size() >= sub->queueDepth) {
+    if (sub->policy == macadamDropNewest) {
+      releaseFrameData(frame);
+      sub->droppedNewest++;
+      return;
     }
-    crts->started = true;
+    releaseFrameData(sub->queue.front());
+    sub->queue.pop_front();
+    sub->droppedOldest++;
+  }
+  sub->queue.push_back(frame);
+  if (sub->queue.size() > sub->highWater) sub->highWater = (uint32_t) sub->queue.size();
+}
+
+// Finds the capture and subscriber for a method of a subscription object,
+// with the subscriber set to nullptr if it has unsubscribed
+static napi_status getSubscriber(napi_env env, napi_value subscription,
+    captureThreadsafe** crts, captureSubscriber** sub) {
+  napi_status status;
+  napi_value param, capture;
+  uint32_t id;
+
+  status = napi_get_named_property(env, subscription, "capture", &capture);
+  PASS_STATUS;
+  status = napi_get_named_property(env, capture, "deckLinkInput", &param);
+  PASS_STATUS;
+  status = napi_get_value_external(env, param, (void**) crts);
+  PASS_STATUS;
+  status = napi_get_named_property(env, subscription, "id", &param);
+  PASS_STATUS;
+  status = napi_get_value_uint32(env, param, &id);
+  PASS_STATUS;
+  *sub = nullptr;
+  for ( auto s : (*crts)->subscribers ) {
+    if (s->id == id) *sub = s;
+  }
+  return napi_ok;
+}
+
+static napi_value subscriptionFrame(napi_env env, napi_callback_info info) {
+  napi_value promise, subscription;
+  captureThreadsafe* crts;
+  captureSubscriber* sub;
+  frameCarrier* c = new frameCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 0;
+  c->status = napi_get_cb_info(env, info, &argc, nullptr, &subscription, nullptr);
+  REJECT_RETURN;
+  c->status = getSubscriber(env, subscription, &crts, &sub);
+  if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+    "Cannot request frames after stream stop.", MACADAM_ALREADY_STOPPED);
+  REJECT_RETURN;
+  if (sub == nullptr) REJECT_ERROR_RETURN(
+    "Cannot request frames after unsubscribing.", MACADAM_ALREADY_STOPPED);
+
+  if (!startCapture(crts, c)) REJECT_RETURN;
+
+  if (!sub->queue.empty()) {
+    frameData* frame = sub->queue.front();
+    sub->queue.pop_front();
+    resolveFrame(env, crts, frame, c);
+    return promise;
+  }
+  sub->promises.push(c);
+  return promise;
+}
+
+static napi_value subscriptionStats(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value value, param, subscription;
+  captureThreadsafe* crts;
+  captureSubscriber* sub;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &subscription, nullptr);
+  CHECK_STATUS;
+  status = getSubscriber(env, subscription, &crts, &sub);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
+  CHECK_STATUS;
+  if (sub == nullptr) NAPI_THROW_ERROR("Already unsubscribed.");
+
+  status = napi_create_object(env, &value);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, (uint32_t) sub->queue.size(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "queueLength", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, sub->queueDepth, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "queueDepth", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, sub->highWater, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "queueHighWater", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, sub->delivered, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "delivered", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, sub->droppedOldest, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "droppedOldest", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, sub->droppedNewest, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "droppedNewest", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, (uint32_t) sub->promises.size(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "promisesWaiting", param);
+  CHECK_STATUS;
+  return value;
+}
+
+static napi_value unsubscribe(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value value, subscription;
+  captureThreadsafe* crts;
+  captureSubscriber* sub;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &subscription, nullptr);
+  CHECK_STATUS;
+  status = napi_get_undefined(env, &value);
+  CHECK_STATUS;
+  status = getSubscriber(env, subscription, &crts, &sub);
+  if ((status == napi_invalid_arg) || ((status == napi_ok) && (sub == nullptr))) {
+    return value; // Stopping the capture has already closed the subscription
+  }
+  CHECK_STATUS;
+
+  for ( auto it = crts->subscribers.begin() ; it != crts->subscribers.end() ; ++it ) {
+    if (*it == sub) {
+      crts->subscribers.erase(it);
+      break;
+    }
+  }
+  closeSubscriber(env, sub, "Unsubscribed before a frame arrived.");
+  return value;
+}
+
+// capture.subscribe({ queueDepth, queuePolicy }) returns a subscription that
+// receives every frame from now on, independently of other subscriptions and
+// of the capture's own frame() promises
+napi_value subscribe(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, param, capture;
+  napi_value argv[1];
+  napi_valuetype type;
+  captureThreadsafe* crts;
+  uint32_t queueDepth = 3;
+  MacadamOverflowPolicy policy = macadamDropOldest;
+
+  size_t argc = 1;
+  status = napi_get_cb_info(env, info, &argc, argv, &capture, nullptr);
+  CHECK_STATUS;
+  status = napi_get_named_property(env, capture, "deckLinkInput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &crts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Cannot subscribe after stream stop.");
+  CHECK_STATUS;
+
+  if (argc >= 1) {
+    status = napi_typeof(env, argv[0], &type);
+    CHECK_STATUS;
+    if (type != napi_undefined) {
+      if (type != napi_object) NAPI_THROW_ERROR("Subscription options must be an object.");
+      status = napi_get_named_property(env, argv[0], "queueDepth", &param);
+      CHECK_STATUS;
+      status = napi_typeof(env, param, &type);
+      CHECK_STATUS;
+      if (type != napi_undefined) {
+        if (type != napi_number) NAPI_THROW_ERROR("Subscription queue depth must be a number.");
+        status = napi_get_value_uint32(env, param, &queueDepth);
+        CHECK_STATUS;
+        if ((queueDepth == 0) || (queueDepth > 64)) NAPI_THROW_ERROR(
+          "Subscription queue depth must be from 1 to 64.");
+      }
+      status = napi_get_named_property(env, argv[0], "queuePolicy", &param);
+      CHECK_STATUS;
+      status = napi_typeof(env, param, &type);
+      CHECK_STATUS;
+      if (type != napi_undefined) {
+        if (type != napi_string) NAPI_THROW_ERROR(
+          "Subscription queue policy must be either 'dropOldest' or 'dropNewest'.");
+        status = parseOverflowPolicy(env, param, &policy);
+        if (status == napi_invalid_arg) NAPI_THROW_ERROR(
+          "Subscription queue policy must be either 'dropOldest' or 'dropNewest'.");
+        CHECK_STATUS;
+      }
+    }
+  }
+
+  captureSubscriber* sub = new captureSubscriber;
+  sub->id = crts->nextSubscriberId++;
+  sub->queueDepth = queueDepth;
+  sub->policy = policy;
+  crts->subscribers.push_back(sub);
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, sub->id, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "id", param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "capture", capture);
+  CHECK_STATUS;
+  status = napi_create_function(env, "frame", NAPI_AUTO_LENGTH, subscriptionFrame,
+    nullptr, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "frame", param);
+  CHECK_STATUS;
+  status = napi_create_function(env, "stats", NAPI_AUTO_LENGTH, subscriptionStats,
+    nullptr, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "stats", param);
+  CHECK_STATUS;
+  status = napi_create_function(env, "unsubscribe", NAPI_AUTO_LENGTH, unsubscribe,
+    nullptr, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "unsubscribe", param);
+  CHECK_STATUS;
+  return result;
+}
+
+// Resolves with exactly n sample frames from the audio ring, waiting until
+// that many have been captured. Requests are satisfied in order.
+napi_value audioPromise(napi_env env, napi_callback_info info) {
+  napi_value promise, capture, param;
+  napi_value argv[1];
+  napi_valuetype type;
+  captureThreadsafe* crts;
+  audioCarrier* c = new audioCarrier;
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+
+  size_t argc = 1;
+  c->status = napi_get_cb_info(env, info, &argc, argv, &capture, nullptr);
+  REJECT_RETURN;
+
+  c->status = napi_get_named_property(env, capture, "deckLinkInput", &param);
+  REJECT_RETURN;
+  c->status = napi_get_value_external(env, param, (void**) &crts);
+  if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+    "Cannot request audio after stream stop.", MACADAM_ALREADY_STOPPED);
+  REJECT_RETURN;
+
+  if (argc < 1) REJECT_ERROR_RETURN(
+    "Number of sample frames must be provided.", MACADAM_INVALID_ARGS);
+  c->status = napi_typeof(env, argv[0], &type);
+  REJECT_RETURN;
+  if (type != napi_number) REJECT_ERROR_RETURN(
+    "Number of sample frames must be a number.", MACADAM_INVALID_ARGS);
+  c->status = napi_get_value_uint32(env, argv[0], &c->sampleFrames);
+  REJECT_RETURN;
+  if ((c->sampleFrames == 0) || (c->sampleFrames > crts->audioRing->capacity())) REJECT_ERROR_RETURN(
+    "Number of sample frames must be between one and the audio ring capacity.",
+    MACADAM_OUT_OF_BOUNDS);
+
+  if (!startCapture(crts, c)) REJECT_RETURN;
+
+  crts->audioPromises.push_back(c);
+  resolveAudio(env, crts);
+
+  return promise;
+}
+
+napi_value audioAvailable(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value value, param, capture;
+  captureThreadsafe* crts;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &capture, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, capture, "deckLinkInput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &crts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
+  CHECK_STATUS;
+
+  status = napi_create_uint32(env, crts->audioRing->available(), &value);
+  CHECK_STATUS;
+  return value;
+}
+
+static void resolveAudioRequest(napi_env env, captureThreadsafe* crts, audioCarrier* c) {
+  napi_value result, param;
+  void* data;
+  int64_t sampleTime = 0;
+  size_t dataSize = (size_t) c->sampleFrames * crts->sampleByteFactor;
+  std::vector<uint8_t> interleaved;
+
+  c->status = napi_create_object(env, &result);
+  REJECT_STATUS;
+  c->status = napi_create_string_utf8(env, "audioSamples", NAPI_AUTO_LENGTH, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "type", param);
+  REJECT_STATUS;
+
+  if (crts->planarAudio) {
+    interleaved.resize(dataSize);
+    crts->audioRing->read(interleaved.data(), c->sampleFrames, &sampleTime);
+    c->status = planarAudioValue(env, interleaved.data(), crts->sampleType / 8,
+      crts->channels, c->sampleFrames, crts->channelMap, nullptr, &param);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, result, "planar", param);
+    REJECT_STATUS;
+  } else {
+    c->status = napi_create_buffer(env, dataSize, &data, &param);
+    REJECT_STATUS;
+    crts->audioRing->read((uint8_t*) data, c->sampleFrames, &sampleTime);
+    c->status = napi_set_named_property(env, result, "data", param);
+    REJECT_STATUS;
   }
 
-  crts->framePromises.push(c);
+  c->status = napi_create_uint32(env, c->sampleFrames, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "sampleFrameCount", param);
+  REJECT_STATUS;
+  c->status = napi_create_int64(env, sampleTime, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "sampleTime", param);
+  REJECT_STATUS;
+  c->status = napi_create_int32(env, crts->sampleRate, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "sampleRate", param);
+  REJECT_STATUS;
 
-  return promise;
+  c->status = napi_resolve_deferred(env, c->_deferred, result);
+  REJECT_STATUS;
+  tidyCarrier(env, c);
+}
+
+// Resolve waiting audio requests, in order, for as long as the ring holds enough samples
+void resolveAudio(napi_env env, captureThreadsafe* crts) {
+  while (!crts->audioPromises.empty() &&
+      (crts->audioRing->available() >= crts->audioPromises.front()->sampleFrames)) {
+    audioCarrier* c = crts->audioPromises.front();
+    crts->audioPromises.pop_front();
+    resolveAudioRequest(env, crts, c);
+  }
 }
 
 void videoFormatChangeResolver(napi_env env, napi_value func, void *context, void *data) {
@@ -816,10 +2696,352 @@ void videoFormatChangeResolver(napi_env env, napi_value func, void *context, voi
 }
 
 void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
-  napi_value result, obj, param;
   captureThreadsafe* crts = (captureThreadsafe*) context;
   frameData* frame = (frameData*) data;
-  frameCarrier* c = nullptr;
+
+  if (env == nullptr) { // Threadsafe function is closing with frames still queued
+    releaseFrameData(frame);
+    return;
+  }
+
+  if (!crts->audioPromises.empty()) {
+    resolveAudio(env, crts);
+  }
+
+  if (!crts->deliverFrames) { // Only passed on to resolve audio requests
+    releaseFrameData(frame);
+    return;
+  }
+
+  for ( auto sub : crts->subscribers ) {
+    deliverToSubscriber(env, crts, sub, shareFrameData(frame));
+  }
+
+  if (crts->framePromises.empty()) {
+    queueFrame(crts, frame);
+    return;
+  }
+
+  frameCarrier* c = crts->framePromises.front();
+  crts->framePromises.pop();
+  if (c->batchSize > 0) {
+    resolveFrames(env, crts, frame, c);
+  } else {
+    resolveFrame(env, crts, frame, c);
+  }
+}
+
+void resolveFrame(napi_env env, captureThreadsafe* crts, frameData* frame, frameCarrier* c) {
+  napi_value result;
+  if (!frameValue(env, crts, frame, c, &result)) return;
+  c->status = napi_resolve_deferred(env, c->_deferred, result);
+  REJECT_STATUS;
+  tidyCarrier(env, c);
+}
+
+// Resolve with an array of the given frame, if any, followed by queued frames
+void resolveFrames(napi_env env, captureThreadsafe* crts, frameData* frame, frameCarrier* c) {
+  napi_value result, value;
+  uint32_t count = 0;
+
+  c->status = napi_create_array(env, &result);
+  if (c->status != napi_ok) {
+    if (frame != nullptr) releaseFrameData(frame);
+    REJECT_STATUS;
+  }
+  if (frame != nullptr) {
+    if (!frameValue(env, crts, frame, c, &value)) return;
+    c->status = napi_set_element(env, result, count++, value);
+    REJECT_STATUS;
+  }
+  while ((count < c->batchSize) && !crts->frameQueue.empty()) {
+    frame = crts->frameQueue.front();
+    crts->frameQueue.pop_front();
+    if (!frameValue(env, crts, frame, c, &value)) return;
+    c->status = napi_set_element(env, result, count++, value);
+    REJECT_STATUS;
+  }
+
+  c->status = napi_resolve_deferred(env, c->_deferred, result);
+  REJECT_STATUS;
+  tidyCarrier(env, c);
+}
+
+napi_status parseAncillaryMode(napi_env env, napi_value value, MacadamAncillaryMode* mode) {
+  napi_status status;
+  char modeName[10];
+  size_t modeLen;
+
+  status = napi_get_value_string_utf8(env, value, modeName, sizeof(modeName), &modeLen);
+  PASS_STATUS;
+  if (strcmp(modeName, "eager") == 0) {
+    *mode = macadamAncillaryEager;
+  } else if (strcmp(modeName, "lazy") == 0) {
+    *mode = macadamAncillaryLazy;
+  } else if (strcmp(modeName, "none") == 0) {
+    *mode = macadamAncillaryNone;
+  } else {
+    return napi_invalid_arg;
+  }
+  return napi_ok;
+}
+
+// Accepts { did, sdid } or an array of them, where sdid is optional
+napi_status parseAncillaryFilter(napi_env env, napi_value value, ancillaryFilters* filter) {
+  napi_status status;
+  napi_value item, param;
+  napi_valuetype type;
+  bool isArray;
+  uint32_t length = 1;
+  ancillaryFilter match;
+
+  status = napi_is_array(env, value, &isArray);
+  PASS_STATUS;
+  if (isArray) {
+    status = napi_get_array_length(env, value, &length);
+    PASS_STATUS;
+  }
+  for ( uint32_t x = 0 ; x < length ; x++ ) {
+    if (isArray) {
+      status = napi_get_element(env, value, x, &item);
+      PASS_STATUS;
+    } else {
+      item = value;
+    }
+    status = napi_typeof(env, item, &type);
+    PASS_STATUS;
+    if (type != napi_object) return napi_invalid_arg;
+
+    status = napi_get_named_property(env, item, "did", &param);
+    PASS_STATUS;
+    status = napi_typeof(env, param, &type);
+    PASS_STATUS;
+    if (type != napi_number) return napi_invalid_arg;
+    status = napi_get_value_int32(env, param, &match.did);
+    PASS_STATUS;
+
+    status = napi_get_named_property(env, item, "sdid", &param);
+    PASS_STATUS;
+    status = napi_typeof(env, param, &type);
+    PASS_STATUS;
+    if (type == napi_undefined) {
+      match.sdid = -1;
+    } else if (type == napi_number) {
+      status = napi_get_value_int32(env, param, &match.sdid);
+      PASS_STATUS;
+    } else {
+      return napi_invalid_arg;
+    }
+
+    if ((match.did < 0) || (match.did > 255) || (match.sdid > 255)) return napi_invalid_arg;
+    filter->push_back(match);
+  }
+  return napi_ok;
+}
+
+static bool matchesAncillaryFilter(const ancillaryFilters* filter, IDeckLinkAncillaryPacket* packet) {
+  if (filter == nullptr) return true;
+  int32_t did = packet->GetDID();
+  int32_t sdid = packet->GetSDID();
+  for ( auto it = filter->begin() ; it != filter->end() ; ++it ) {
+    if ((it->did == did) && ((it->sdid < 0) || (it->sdid == sdid))) return true;
+  }
+  return false;
+}
+
+static napi_status ancillaryPacketValue(napi_env env, IDeckLinkAncillaryPacket* packet,
+    napi_value* value) {
+  napi_status status;
+  napi_value param;
+  uint32_t packetSize;
+  const void* packetData;
+
+  status = napi_create_object(env, value);
+  PASS_STATUS;
+  status = napi_create_int64(env, packet->GetLineNumber(), &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "lineNumber", param);
+  PASS_STATUS;
+  status = napi_create_int32(env, packet->GetDID(), &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "did", param);
+  PASS_STATUS;
+  status = napi_create_int32(env, packet->GetSDID(), &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "sdid", param);
+  PASS_STATUS;
+  status = napi_create_int32(env, packet->GetDataStreamIndex(), &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "dataStreamIndex", param);
+  PASS_STATUS;
+  if (packet->GetBytes(bmdAncillaryPacketFormatUInt8, &packetData, &packetSize) != S_OK) {
+    packetSize = 0;
+    packetData = nullptr;
+  }
+  status = napi_create_buffer_copy(env, packetSize, packetData, nullptr, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "data", param);
+  return status;
+}
+
+// Copies the packets that match both filters, where set, into a new array.
+// Packets are filtered before anything is copied or allocated for them.
+static napi_status ancillaryArray(napi_env env, IDeckLinkVideoFrameAncillaryPackets* ancillary,
+    const ancillaryFilters* filter, const ancillaryFilters* extraFilter, napi_value* packets) {
+  napi_status status;
+  napi_value value;
+  IDeckLinkAncillaryPacketIterator* iterator;
+  IDeckLinkAncillaryPacket* packet;
+  uint32_t packetSlot = 0;
+
+  status = napi_create_array(env, packets);
+  PASS_STATUS;
+  if ((ancillary == nullptr) || (ancillary->GetPacketIterator(&iterator) != S_OK)) {
+    return napi_ok;
+  }
+
+  while ((status == napi_ok) && (iterator->Next(&packet) == S_OK)) {
+    if (matchesAncillaryFilter(filter, packet) && matchesAncillaryFilter(extraFilter, packet)) {
+      status = ancillaryPacketValue(env, packet, &value);
+      if (status == napi_ok) {
+        status = napi_set_element(env, *packets, packetSlot++, value);
+      }
+    }
+    packet->Release();
+  }
+
+  iterator->Release();
+  return status;
+}
+
+// Sets an ancillaryEvents array of decoded packets on the frame object, only if
+// any of the packets that pass the filter have a decoder
+static napi_status ancillaryEvents(napi_env env, IDeckLinkVideoFrameAncillaryPackets* ancillary,
+    const ancillaryFilters* filter, napi_value frameObj) {
+  napi_status status = napi_ok;
+  napi_value events, value;
+  napi_valuetype type;
+  IDeckLinkAncillaryPacketIterator* iterator;
+  IDeckLinkAncillaryPacket* packet;
+  uint32_t eventSlot = 0;
+  uint32_t packetSize;
+  const void* packetData;
+
+  if (ancillary->GetPacketIterator(&iterator) != S_OK) return napi_ok;
+
+  while ((status == napi_ok) && (iterator->Next(&packet) == S_OK)) {
+    if ((ancillaryType(packet->GetDID(), packet->GetSDID()) != macadamAncillaryUnknown) &&
+        matchesAncillaryFilter(filter, packet) &&
+        (packet->GetBytes(bmdAncillaryPacketFormatUInt8, &packetData, &packetSize) == S_OK)) {
+      status = ancillaryEventValue(env, packet->GetDID(), packet->GetSDID(),
+        (const uint8_t*) packetData, packetSize, &value);
+      if (status == napi_ok) status = napi_typeof(env, value, &type);
+      if ((status == napi_ok) && (type != napi_undefined)) {
+        if (eventSlot == 0) status = napi_create_array(env, &events);
+        if (status == napi_ok) status = napi_set_element(env, events, eventSlot++, value);
+      }
+    }
+    packet->Release();
+  }
+  iterator->Release();
+
+  if ((status == napi_ok) && (eventSlot > 0)) {
+    status = napi_set_named_property(env, frameObj, "ancillaryEvents", events);
+  }
+  return status;
+}
+
+void finalizeLazyAncillary(napi_env env, void* finalize_data, void* finalize_hint) {
+  lazyAncillary* lazy = (lazyAncillary*) finalize_data;
+  if (lazy->packets != nullptr) { lazy->packets->Release(); }
+  delete lazy;
+}
+
+// Sets the ancillary packets of a frame on the given frame object according to
+// the capture's ancillary mode, either as an array or as the ancillary() method
+napi_status ancillaryValue(napi_env env, captureThreadsafe* crts, frameData* frame, napi_value frameObj) {
+  napi_status status;
+  napi_value value;
+  IDeckLinkVideoFrameAncillaryPackets* ancillary;
+
+  if ((crts->ancillaryMode == macadamAncillaryNone) && !crts->decodeAncillary) return napi_ok;
+
+  if (frame->videoFrame->QueryInterface(IID_IDeckLinkVideoFrameAncillaryPackets,
+      (void**) &ancillary) != S_OK) {
+    ancillary = nullptr;
+  }
+
+  if (crts->decodeAncillary && (ancillary != nullptr)) {
+    status = ancillaryEvents(env, ancillary, crts->ancillaryFilter.get(), frameObj);
+    if ((status != napi_ok) || (crts->ancillaryMode == macadamAncillaryNone)) {
+      ancillary->Release();
+      return status;
+    }
+  }
+  if (crts->ancillaryMode == macadamAncillaryNone) return napi_ok;
+
+  if (crts->ancillaryMode == macadamAncillaryLazy) {
+    // Holding the packets interface keeps the frame until the frame object is collected
+    lazyAncillary* lazy = new lazyAncillary;
+    lazy->packets = ancillary;
+    lazy->filters = crts->ancillaryFilter;
+    status = napi_wrap(env, frameObj, lazy, finalizeLazyAncillary, nullptr, nullptr);
+    if (status != napi_ok) {
+      finalizeLazyAncillary(env, lazy, nullptr);
+      return status;
+    }
+    status = napi_get_reference_value(env, crts->refs->ancillaryMethod, &value);
+    PASS_STATUS;
+    return napi_set_named_property(env, frameObj, "ancillary", value);
+  }
+
+  if (ancillary == nullptr) return napi_ok;
+  status = ancillaryArray(env, ancillary, crts->ancillaryFilter.get(), nullptr, &value);
+  ancillary->Release();
+  PASS_STATUS;
+  return napi_set_named_property(env, frameObj, "ancillary", value);
+}
+
+// The ancillary() method of frames captured with lazy ancillary packets,
+// taking an optional filter in the same form as the ancillaryFilter option
+napi_value ancillaryPackets(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value frameObj, result;
+  napi_value argv[1];
+  napi_valuetype type;
+  lazyAncillary* lazy;
+  ancillaryFilters extraFilter;
+  bool hasExtraFilter = false;
+
+  size_t argc = 1;
+  status = napi_get_cb_info(env, info, &argc, argv, &frameObj, nullptr);
+  CHECK_STATUS;
+  status = napi_unwrap(env, frameObj, (void**) &lazy);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Ancillary packets are only available from a captured frame.");
+  CHECK_STATUS;
+
+  if (argc >= 1) {
+    status = napi_typeof(env, argv[0], &type);
+    CHECK_STATUS;
+    if (type != napi_undefined) {
+      status = parseAncillaryFilter(env, argv[0], &extraFilter);
+      if (status == napi_invalid_arg) NAPI_THROW_ERROR("Ancillary filter must have a numeric did.");
+      CHECK_STATUS;
+      hasExtraFilter = true;
+    }
+  }
+
+  status = ancillaryArray(env, lazy->packets, lazy->filters.get(),
+    hasExtraFilter ? &extraFilter : nullptr, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+// Creates the JS object for a frame, passing ownership of the frame to JS.
+// On failure, the carrier's promise is rejected and the carrier tidied.
+bool frameValue(napi_env env, captureThreadsafe* crts, frameData* frame, carrier* c, napi_value* value) {
+  napi_value result, obj, param;
+  bool frameOwnedByJS = false;
   BMDTimeValue frameTime;
   BMDTimeValue frameDuration;
   BMDFrameFlags videoFlags;
@@ -828,57 +3050,20 @@ void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
   int64_t externalMemory;
   void* bytes;
   IDeckLinkTimecode* timecode;
+  IDeckLinkVideoFrame* delivered;
   audioData* audioFinalizeData;
   HRESULT hresult;
 
-  if (!crts->framePromises.empty()) {
-    c = crts->framePromises.front();
+  if (crts->metadataRecords != nullptr) {
+    return frameRecordValue(env, crts, frame, c, value);
+  }
 
+  { // Scoped so that REJECT_BAIL can jump past the declarations within
     c->status = napi_create_object(env, &result);
     REJECT_BAIL;
 
-    // Ancillary data
-
-    IDeckLinkVideoFrameAncillaryPackets *ancillary;
-    if (frame->videoFrame->QueryInterface(IID_IDeckLinkVideoFrameAncillaryPackets, (void**)&ancillary) == S_OK) {
-
-      IDeckLinkAncillaryPacketIterator *iterator;
-      if (ancillary->GetPacketIterator(&iterator) == S_OK) {
-        IDeckLinkAncillaryPacket *packet;
-        napi_value packets_array;
-        int packetSlot = 0;
-
-        napi_create_array(env, &packets_array);
-
-        while (iterator->Next(&packet) == S_OK) {
-          napi_value js_packet, line_number, did, data_stream_index, sdid, packet_data;
-          unsigned int packetSize;
-          uint8_t *packetData;
-          
-          c->status = napi_create_int64(env, packet->GetLineNumber(), &line_number);                  REJECT_BAIL;
-          c->status = napi_create_int32(env, packet->GetDID(), &did);                                 REJECT_BAIL;
-          c->status = napi_create_int32(env, packet->GetDataStreamIndex(), &data_stream_index);       REJECT_BAIL;
-          c->status = napi_create_int32(env, packet->GetSDID(), &sdid);                               REJECT_BAIL;
-          c->status = packet->GetBytes(bmdAncillaryPacketFormatUInt8, 
-                                        (const void**)&packetData, &packetSize);                            REJECT_BAIL;
-          c->status = napi_create_buffer_copy(env, packetSize, packetData, NULL, &packet_data);       REJECT_BAIL;
-          c->status = napi_create_object(env, &js_packet);                                            REJECT_BAIL;
-          c->status = napi_set_named_property(env, js_packet, "lineNumber", line_number);             REJECT_BAIL;
-          c->status = napi_set_named_property(env, js_packet, "did", did);                            REJECT_BAIL;
-          c->status = napi_set_named_property(env, js_packet, "sdid", sdid);                          REJECT_BAIL;
-          c->status = napi_set_named_property(env, js_packet, "dataStreamIndex", data_stream_index);  REJECT_BAIL;
-          c->status = napi_set_named_property(env, js_packet, "data", packet_data);                   REJECT_BAIL;
-          c->status = napi_set_element(env, packets_array, packetSlot++, js_packet);                  REJECT_BAIL;
-        }
-
-        c->status = napi_set_named_property(env, result, "ancillary", packets_array);                 REJECT_BAIL;
-      }
-
-      iterator->Release();
-      ancillary->Release();
-    }
-
-
+    c->status = ancillaryValue(env, crts, frame, result);
+    REJECT_BAIL;
 
     c->status = napi_create_string_utf8(env, "frame", NAPI_AUTO_LENGTH, &param);
     REJECT_BAIL;
@@ -905,7 +3090,9 @@ void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
     c->status = napi_set_named_property(env, obj, "height", param);
     REJECT_BAIL;
 
-    rowBytes = frame->videoFrame->GetRowBytes();
+    // Any RGBA conversion has already been done on a conversion worker
+    delivered = (frame->convertedFrame != nullptr) ? frame->convertedFrame : frame->videoFrame;
+    rowBytes = delivered->GetRowBytes();
     c->status = napi_create_int32(env, rowBytes, &param);
     REJECT_BAIL;
     c->status = napi_set_named_property(env, obj, "rowBytes", param);
@@ -926,70 +3113,49 @@ void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
     c->status = napi_set_named_property(env, obj, "frameDuration", param);
     REJECT_BAIL;
 
-    hresult = frame->videoFrame->GetBytes(&bytes);
-    if (hresult != S_OK) {
-      c->errorMsg = "Failed to access the byte buffer of a video frame.";
-      c->status = MACADAM_CALL_FAILURE;
-      REJECT_BAIL;
-    }
-
-    // Convert the color format
-    int32_t bufferSize = rowBytes * height;
-    BMDPixelFormat outputFormat = crts->pixelFormat;
-
-    if (crts->outputRGBA) {
-      if (outputFormat == bmdFormat8BitARGB || outputFormat == bmdFormat8BitYUV) {
-
-        ConvertedVideoFrame *convertedFrame = new ConvertedVideoFrame(
-          frame->videoFrame->GetWidth(), 
-          frame->videoFrame->GetHeight(), 
-          bmdFormat8BitBGRA, 
-          4 * frame->videoFrame->GetWidth()
-        );
-
-        HRESULT result = crts->deckLinkConversion->ConvertFrame(frame->videoFrame, convertedFrame);
-
-        if (result == E_FAIL) {
-          printf("Failed to convert frame from YUV to BGRA (E_FAIL)\n");
-        } else if (result == E_NOTIMPL) {
-          printf("Failed to convert frame from YUV to BGRA (E_NOTIMPL)\n");
-        } else if (result == E_OUTOFMEMORY) {
-          printf("Failed to convert frame from YUV to BGRA (E_OUTOFMEMORY)\n");
-        }
-
-        if (result == S_OK) {
-          frame->convertedFrame = convertedFrame;
-        } else {
-          delete convertedFrame;
-        }
+    if (!crts->proxyOnly) {
+      hresult = delivered->GetBytes(&bytes);
+      if (hresult != S_OK) {
+        c->errorMsg = "Failed to access the byte buffer of a video frame.";
+        c->status = MACADAM_CALL_FAILURE;
+        REJECT_BAIL;
+      }
 
-        // Assign
+      int32_t bufferSize = rowBytes * height;
 
-        outputFormat = bmdFormat8BitBGRA;
-        convertedFrame->GetBytes(&bytes);
-        rowBytes = convertedFrame->GetRowBytes();
-        bufferSize = rowBytes * frame->videoFrame->GetHeight();
+      c->status = napi_create_external_buffer(env, bufferSize, bytes,
+        finalizeVideoBuffer, frame, &param);
+      REJECT_BAIL;
+      frameOwnedByJS = true;
+      c->status = napi_set_named_property(env, obj, "data", param);
+      REJECT_BAIL;
+      // Matches the accounting in finalizeVideoBuffer, which releases both frames
+      externalMemory = frame->videoFrame->GetRowBytes() * height;
+      if (frame->convertedFrame != nullptr) {
+        externalMemory += frame->convertedFrame->GetRowBytes() * height;
       }
+      c->status = napi_adjust_external_memory(env, externalMemory, &externalMemory);
+      // printf("External memory %li\n", externalMemory);
+      REJECT_BAIL;
+    }
 
-      if (outputFormat == bmdFormat8BitBGRA) {
-        uint8_t *rawData = (uint8_t*)bytes;
-        for (int i = 0, max = bufferSize; i < max; i += 4) {
-          uint8_t blue = rawData[i];
-          rawData[i + 0]     = rawData[i + 2];
-          rawData[i + 2]     = blue;
-          rawData[i + 3] = 255;
-        }
-      }
+    if (!crts->proxies.empty()) {
+      c->status = proxyValues(env, crts, frame, &param);
+      REJECT_BAIL;
+      c->status = napi_set_named_property(env, obj, "proxies", param);
+      REJECT_BAIL;
+      c->status = napi_create_uint32(env, frame->proxyMicros, &param);
+      REJECT_BAIL;
+      c->status = napi_set_named_property(env, obj, "proxyMicros", param);
+      REJECT_BAIL;
     }
 
-    c->status = napi_create_external_buffer(env, bufferSize, bytes,
-      finalizeVideoBuffer, frame, &param);
-    REJECT_BAIL;
-    c->status = napi_set_named_property(env, obj, "data", param);
-    REJECT_BAIL;
-    c->status = napi_adjust_external_memory(env, rowBytes*height, &externalMemory);
-    // printf("External memory %li\n", externalMemory);
-    REJECT_BAIL;
+    if (frame->qc != nullptr) {
+      c->status = qcFrameValue(env, frame->qc, &param);
+      REJECT_BAIL;
+      c->status = napi_set_named_property(env, obj, "qc", param);
+      REJECT_BAIL;
+    }
 
     c->status = napi_get_boolean(env, true, &param);
     REJECT_BAIL;
@@ -1025,55 +3191,32 @@ void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
         c->status = napi_set_named_property(env, obj, "timecode", param);
         REJECT_BAIL;
         break;
-      case S_OK:
-        #ifdef WIN32
-        BSTR timecodeBSTR = NULL;
-        hresult = timecode->GetString(&timecodeBSTR);
-        if (hresult == S_OK) {
-          _bstr_t timecodeString(timecodeBSTR, false);
-          if (crts->roughFps > 30) {
-            timecodeString += ((timecode->GetFlags() & bmdTimecodeFieldMark) == 0) ? ".0" : ".1";
-          }
-          c->status = napi_create_string_utf8(env, (char*) timecodeString, NAPI_AUTO_LENGTH, &param);
-          REJECT_BAIL;
-        }
-        #elif __APPLE__
-        CFStringRef timecodeCFString = NULL;
-        hresult = timecode->GetString(&timecodeCFString);
-        if (hresult == S_OK) {
-          char timecodeString[64];
-          CFStringGetCString(timecodeCFString, timecodeString, sizeof(timecodeString), kCFStringEncodingMacRoman);
-          CFRelease(timecodeCFString);
-          if (crts->roughFps > 30) {
-            timecodeString[11] = '.';
-            timecodeString[12] = ((timecode->GetFlags() & bmdTimecodeFieldMark) == 0) ? '0' : '1';
-            timecodeString[13] = '\0';
-          }
-          c->status = napi_create_string_utf8(env, timecodeString, NAPI_AUTO_LENGTH, &param);
-          REJECT_BAIL;
-        }
-        #else
-        char* timecodeString;
-        hresult = timecode->GetString((const char **) &timecodeString);
-        char tcstr[14];
-        for ( uint32_t x = 0; x < 12 ; x++) tcstr[x] = timecodeString[x];
-        free(timecodeString);
-        if (hresult == S_OK) {
-          if (crts->roughFps > 30) {
-            tcstr[11] = '.';
-            tcstr[12] = ((timecode->GetFlags() & bmdTimecodeFieldMark) == 0) ? '0' : '1';
-            tcstr[13] = '\0';
-          }
+      case S_OK: {
+        // Read as numbers, so that no strings are allocated by the driver or for JS
+        BMDTimecodeBCD timecodeBCD = timecode->GetBCD();
+        BMDTimecodeFlags timecodeFlags = timecode->GetFlags();
+        bool hasUserBits = timecode->GetTimecodeUserBits(&userBits) == S_OK;
+        timecode->Release();
+
+        c->status = napi_create_uint32(env, timecodeBCD, &param);
+        REJECT_BAIL;
+        c->status = napi_set_named_property(env, obj, "timecodeBCD", param);
+        REJECT_BAIL;
+        c->status = napi_create_uint32(env, timecodeFlags, &param);
+        REJECT_BAIL;
+        c->status = napi_set_named_property(env, obj, "timecodeFlags", param);
+        REJECT_BAIL;
+
+        if (crts->timecodeString) {
+          char tcstr[MACADAM_TIMECODE_STRING_SIZE];
+          formatTimecodeBCD(timecodeBCD, timecodeFlags, crts->roughFps > 30, tcstr);
           c->status = napi_create_string_utf8(env, tcstr, NAPI_AUTO_LENGTH, &param);
           REJECT_BAIL;
+          c->status = napi_set_named_property(env, obj, "timecode", param);
+          REJECT_BAIL;
         }
-        #endif
-
-        c->status = napi_set_named_property(env, obj, "timecode", param);
-        REJECT_BAIL;
 
-        hresult = timecode->GetTimecodeUserBits(&userBits);
-        if (hresult == S_OK) {
+        if (hasUserBits) {
           c->status = napi_create_uint32(env, userBits, &param);
           REJECT_BAIL;
         }
@@ -1084,6 +3227,7 @@ void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
         c->status = napi_set_named_property(env, obj, "userbits", param);
         REJECT_BAIL;
         break;
+      }
     } // switch GetTimecode
 
     hresult = frame->videoFrame->GetHardwareReferenceTimestamp(crts->timeScale,
@@ -1121,12 +3265,30 @@ void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
         c->status = MACADAM_CALL_FAILURE;
         REJECT_BAIL;
       }
+      if (crts->planarAudio) { // Converted into new buffers, so the packet is not retained
+        c->status = planarAudioValue(env, (const uint8_t*) bytes, crts->sampleType / 8,
+          crts->channels, sampleFrameCount, crts->channelMap, nullptr, &param);
+        REJECT_BAIL;
+        frame->audioPacket->Release();
+        frame->audioPacket = nullptr;
+        c->status = napi_set_named_property(env, obj, "planar", param);
+        REJECT_BAIL;
+        if (!frameOwnedByJS) releaseUndeliveredVideo(frame);
+        *value = result;
+        return true;
+      }
       audioFinalizeData = (audioData*) malloc(sizeof(audioData));
       audioFinalizeData->audioPacket = frame->audioPacket;
       audioFinalizeData->dataSize = sampleFrameCount * crts->sampleByteFactor;
       c->status = napi_create_external_buffer(env,
         audioFinalizeData->dataSize, bytes, finalizeAudioPacket, audioFinalizeData, &param);
+      if (c->status != napi_ok) { // Video already owned by JS does not release the audio
+        free(audioFinalizeData);
+        frame->audioPacket->Release();
+        frame->audioPacket = nullptr;
+      }
       REJECT_BAIL;
+      frame->audioPacket = nullptr; // Now released when the buffer is collected
       c->status = napi_set_named_property(env, obj, "data", param);
       REJECT_BAIL;
       c->status = napi_adjust_external_memory(env,
@@ -1135,21 +3297,188 @@ void frameResolver(napi_env env, napi_value jsCb, void* context, void* data) {
       REJECT_BAIL;
     }
 
-    c->status = napi_resolve_deferred(env, c->_deferred, result);
+    if (!frameOwnedByJS) releaseUndeliveredVideo(frame);
+    *value = result;
+    return true;
+  }
+
+bail:
+  if (!frameOwnedByJS) releaseFrameData(frame);
+
+  return false;
+}
+
+// Binary metadata alternative to frameValue. Metadata is written into the next
+// record of the capture's metadata ArrayBuffer and the frame object only holds
+// the record index and the data buffers.
+bool frameRecordValue(napi_env env, captureThreadsafe* crts, frameData* frame, carrier* c, napi_value* value) {
+  napi_value result, param;
+  bool frameOwnedByJS = false;
+  macadamFrameRecord* record;
+  uint32_t recordIndex;
+  BMDTimeValue frameTime;
+  BMDTimeValue frameDuration;
+  BMDTimecodeUserBits userBits;
+  int32_t rowBytes, height;
+  int64_t externalMemory;
+  void* bytes;
+  IDeckLinkTimecode* timecode;
+  IDeckLinkVideoFrame* delivered;
+  audioData* audioFinalizeData;
+  HRESULT hresult;
+
+  recordIndex = crts->nextMetadataRecord;
+  crts->nextMetadataRecord = (recordIndex + 1) % crts->metadataRecordCount;
+  record = &crts->metadataRecords[recordIndex];
+  memset(record, 0, sizeof(macadamFrameRecord));
+  record->sequence = crts->metadataSequence++;
+
+  record->frameFlags = frame->videoFrame->GetFlags();
+  record->width = (uint16_t) frame->videoFrame->GetWidth();
+  height = frame->videoFrame->GetHeight();
+  record->height = (uint16_t) height;
+  delivered = (frame->convertedFrame != nullptr) ? frame->convertedFrame : frame->videoFrame;
+  rowBytes = delivered->GetRowBytes();
+  record->rowBytes = rowBytes;
+
+  hresult = frame->videoFrame->GetStreamTime(&frameTime, &frameDuration, crts->timeScale);
+  if (hresult != S_OK) {
+    c->errorMsg = "Failed to retrieve frame time for video frame.";
+    c->status = MACADAM_CALL_FAILURE;
     REJECT_BAIL;
-    tidyCarrier(env, c);
   }
-  else {
-    printf("DEBUG: No promise to receive frame.\n");
+  record->frameTime = frameTime;
+  record->frameDuration = frameDuration;
+
+  if (frame->videoFrame->GetTimecode(bmdTimecodeRP188Any, &timecode) == S_OK) {
+    record->timecodeBCD = timecode->GetBCD();
+    record->timecodeFlags = timecode->GetFlags();
+    record->present |= macadamRecordHasTimecode;
+    if (timecode->GetTimecodeUserBits(&userBits) == S_OK) {
+      record->userbits = userBits;
+      record->present |= macadamRecordHasUserbits;
+    }
+    timecode->Release();
+  }
+
+  if (frame->videoFrame->GetHardwareReferenceTimestamp(crts->timeScale,
+      &frameTime, &frameDuration) == S_OK) {
+    record->hardwareRefFrameTime = frameTime;
+    record->hardwareRefFrameDuration = frameDuration;
+    record->present |= macadamRecordHasHardwareRef;
+  }
+
+  c->status = napi_create_object(env, &result);
+  REJECT_BAIL;
+  c->status = napi_create_string_utf8(env, "frame", NAPI_AUTO_LENGTH, &param);
+  REJECT_BAIL;
+  c->status = napi_set_named_property(env, result, "type", param);
+  REJECT_BAIL;
+  c->status = napi_create_uint32(env, recordIndex, &param);
+  REJECT_BAIL;
+  c->status = napi_set_named_property(env, result, "record", param);
+  REJECT_BAIL;
+  c->status = ancillaryValue(env, crts, frame, result);
+  REJECT_BAIL;
+
+  if (!crts->proxyOnly) {
+    hresult = delivered->GetBytes(&bytes);
+    if (hresult != S_OK) {
+      c->errorMsg = "Failed to access the byte buffer of a video frame.";
+      c->status = MACADAM_CALL_FAILURE;
+      REJECT_BAIL;
+    }
+    c->status = napi_create_external_buffer(env, rowBytes * height, bytes,
+      finalizeVideoBuffer, frame, &param);
+    REJECT_BAIL;
+    frameOwnedByJS = true;
+    c->status = napi_set_named_property(env, result, "video", param);
+    REJECT_BAIL;
+    externalMemory = frame->videoFrame->GetRowBytes() * height;
+    if (frame->convertedFrame != nullptr) {
+      externalMemory += frame->convertedFrame->GetRowBytes() * height;
+    }
+    c->status = napi_adjust_external_memory(env, externalMemory, &externalMemory);
+    REJECT_BAIL;
+  }
+
+  if (!crts->proxies.empty()) {
+    c->status = proxyValues(env, crts, frame, &param);
+    REJECT_BAIL;
+    c->status = napi_set_named_property(env, result, "proxies", param);
+    REJECT_BAIL;
+  }
+
+  if (frame->qc != nullptr) {
+    c->status = qcFrameValue(env, frame->qc, &param);
+    REJECT_BAIL;
+    c->status = napi_set_named_property(env, result, "qc", param);
+    REJECT_BAIL;
+  }
+
+  if (frame->audioPacket != nullptr) {
+    record->sampleFrameCount = frame->audioPacket->GetSampleFrameCount();
+    record->present |= macadamRecordHasAudio;
+    hresult = frame->audioPacket->GetBytes(&bytes);
+    if (hresult != S_OK) {
+      c->errorMsg = "Failed to access the byte buffer of an audio packet.";
+      c->status = MACADAM_CALL_FAILURE;
+      REJECT_BAIL;
+    }
+    if (crts->planarAudio) {
+      c->status = planarAudioValue(env, (const uint8_t*) bytes, crts->sampleType / 8,
+        crts->channels, record->sampleFrameCount, crts->channelMap, nullptr, &param);
+      REJECT_BAIL;
+      frame->audioPacket->Release();
+      frame->audioPacket = nullptr;
+      c->status = napi_set_named_property(env, result, "audio", param);
+      REJECT_BAIL;
+      if (!frameOwnedByJS) releaseUndeliveredVideo(frame);
+      *value = result;
+      return true;
+    }
+    audioFinalizeData = (audioData*) malloc(sizeof(audioData));
+    audioFinalizeData->audioPacket = frame->audioPacket;
+    audioFinalizeData->dataSize = record->sampleFrameCount * crts->sampleByteFactor;
+    c->status = napi_create_external_buffer(env,
+      audioFinalizeData->dataSize, bytes, finalizeAudioPacket, audioFinalizeData, &param);
+    if (c->status != napi_ok) { // Video already owned by JS does not release the audio
+      free(audioFinalizeData);
+      frame->audioPacket->Release();
+      frame->audioPacket = nullptr;
+    }
+    REJECT_BAIL;
+    frame->audioPacket = nullptr; // Now released when the buffer is collected
+    c->status = napi_set_named_property(env, result, "audio", param);
+    REJECT_BAIL;
+    c->status = napi_adjust_external_memory(env,
+      audioFinalizeData->dataSize, &externalMemory);
+    REJECT_BAIL;
   }
 
+  if (!frameOwnedByJS) releaseUndeliveredVideo(frame);
+  *value = result;
+  return true;
+
 bail:
-  if (!crts->framePromises.empty()) crts->framePromises.pop();
+  if (!frameOwnedByJS) releaseFrameData(frame);
 
-  return;
+  return false;
 }
 
 void captureTsFnFinalize(napi_env env, void* data, void* hint) {
+  // Not crts, which may already be deleted when the environment is torn down
+  napi_status status;
+  captureRefs* refs = (captureRefs*) data;
+  if (refs->metadata != nullptr) {
+    status = napi_delete_reference(env, refs->metadata);
+    FLOATING_STATUS;
+  }
+  if (refs->ancillaryMethod != nullptr) {
+    status = napi_delete_reference(env, refs->ancillaryMethod);
+    FLOATING_STATUS;
+  }
+  delete refs;
   /* printf("Threadsafe capture finalizer called with data %p and hint %p.\n", data, hint);
   captureThreadsafe* cpts = (captureThreadsafe*) hint;
   delete cpts; */
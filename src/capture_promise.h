@@ -44,6 +44,12 @@
 #define CAPTURE_PROMISE_H
 
 #include <queue>
+#include <deque>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
 
 #ifdef WIN32
 #include <tchar.h>
@@ -54,17 +60,82 @@
 
 #define NAPI_EXPERIMENTAL
 #include "macadam_util.h"
+#include "worker_pool.h"
+#include "converted_frame.h"
+#include "pixel_convert.h"
+#include "input_allocator.h"
+#include "ancillary_decode.h"
+#include "audio_convert.h"
+#include "audio_ring.h"
+#include "timecode.h"
+#include "recorder.h"
+#include "shared_ring.h"
+#include "video_qc.h"
 #include "node_api.h"
 #include "DeckLinkAPI.h"
 
 napi_value capture(napi_env env, napi_callback_info info);
 napi_value framePromise(napi_env env, napi_callback_info info);
+napi_value framesPromise(napi_env env, napi_callback_info info);
+napi_value framesAvailable(napi_env env, napi_callback_info info);
+napi_value subscribe(napi_env env, napi_callback_info info);
+napi_value qcEvents(napi_env env, napi_callback_info info);
+napi_value audioPromise(napi_env env, napi_callback_info info);
+napi_value audioAvailable(napi_env env, napi_callback_info info);
 napi_value stopStreams(napi_env env, napi_callback_info info);
+napi_value captureStats(napi_env env, napi_callback_info info);
 
 void videoFormatChangeResolver(napi_env env, napi_value func, void *context, void *data);
 void frameResolver(napi_env env, napi_value jsCb, void* context, void* data);
 void captureTsFnFinalize(napi_env env, void* data, void* hint);
 
+// How ancillary packets are presented on captured frames
+typedef uint32_t MacadamAncillaryMode;
+enum _MacadamAncillaryMode {
+  macadamAncillaryEager = 1, // Copied into an ancillary array on every frame
+  macadamAncillaryLazy = 2, // Copied when the frame's ancillary() method is called
+  macadamAncillaryNone = 3
+};
+
+// Selects packets by DID and, unless negative, SDID
+struct ancillaryFilter {
+  int32_t did;
+  int32_t sdid;
+};
+typedef std::vector<ancillaryFilter> ancillaryFilters;
+
+// Held by a frame object with lazy ancillary packets, released when it is collected
+struct lazyAncillary {
+  IDeckLinkVideoFrameAncillaryPackets* packets;
+  std::shared_ptr<const ancillaryFilters> filters;
+};
+
+// Downscaled copies of each frame, made on the conversion workers
+#define MACADAM_MAX_PROXIES 4
+
+// A proxy as asked for, by whole factor or by width, and once the size is known
+struct proxyRequest {
+  uint32_t scale = 0;
+  uint32_t width = 0;
+  macadamPixelLayout layout = macadamLayoutRGBA;
+  uint32_t outWidth = 0;
+  uint32_t outHeight = 0;
+};
+
+struct captureProxy {
+  uint32_t width;
+  uint32_t height;
+  macadamPixelLayout layout;
+  uint32_t rowBytes;
+  ConvertedFramePool* pool; // Shared with the proxy frames it supplies
+};
+
+// References deleted when the capture threadsafe function finalizes
+struct captureRefs {
+  napi_ref metadata = nullptr;
+  napi_ref ancillaryMethod = nullptr;
+};
+
 // Carrier used to create a capture instance off-thread
 struct captureCarrier : carrier {
   IDeckLinkInput* deckLinkInput = nullptr;
@@ -80,23 +151,108 @@ struct captureCarrier : carrier {
   napi_ref onVideoInputChangedCallback;
 
   uint32_t channels = 0; // Set to zero for no channels
+  uint32_t frameQueueDepth = 3; // Frames held natively while no frame() promise is waiting
+  MacadamOverflowPolicy frameQueuePolicy = macadamDropOldest;
+  uint32_t callbackQueueSize = 20;
+  bool callbackQueueBlocking = false;
+  uint32_t conversionThreads = 2;
+  macadamPixelLayout convertTo = macadamLayoutNone;
+  uint32_t inputBuffers = 0; // Set to zero to leave input frame allocation to the driver
+  bool inputHugePages = false;
+  int32_t inputNumaNode = -1;
+  macadamInputAllocator* inputAllocator = nullptr;
+  bool binaryMetadata = false;
+  uint32_t metadataRecords = 32;
+  MacadamAncillaryMode ancillaryMode = macadamAncillaryEager;
+  std::shared_ptr<const ancillaryFilters> ancillaryFilter; // Not set for all packets
+  bool decodeAncillary = false;
+  bool timecodeString = false;
+  bool planarAudio = false;
+  std::vector<uint32_t> channelMap; // Empty for all channels in order
+  uint32_t audioRing = 0; // Capacity in sample frames, zero for no audio ring
+  recorderOptions* recordOptions = nullptr; // Set to record to disk
+  macadamRecorder* recorder = nullptr;
+  bool deliverFrames = true;
+  std::string sharedRingName; // Empty for no shared memory ring
+  uint32_t sharedRingSlots = 8;
+  macadamSharedRing* sharedRing = nullptr;
+  std::vector<proxyRequest> proxies;
+  bool proxyOnly = false;
+  qcOptions* qc = nullptr; // Set to analyse every frame
   IDeckLinkDisplayMode* selectedDisplayMode = nullptr;
   ~captureCarrier() {
+    if (qc != nullptr) { delete qc; }
+    if (recorder != nullptr) { delete recorder; }
+    if (sharedRing != nullptr) { delete sharedRing; }
+    if (recordOptions != nullptr) { delete recordOptions; }
+    if (inputAllocator != nullptr) { inputAllocator->Release(); }
     if (deckLinkInput != nullptr) { deckLinkInput->Release(); }
     if (selectedDisplayMode != nullptr) { selectedDisplayMode->Release(); }
   }
 };
 
+// Fixed layout of a binary metadata record, written to the capture's metadata
+// ArrayBuffer in place of per-frame objects. Byte offsets are part of the API
+// and are documented in the README. Host byte order, little-endian in practice.
+struct macadamFrameRecord {
+  uint32_t sequence; // 0 - Count of frames delivered, wraps at 2^32
+  uint32_t frameFlags; // 4 - BMDFrameFlags
+  int64_t frameTime; // 8
+  int64_t frameDuration; // 16
+  int64_t hardwareRefFrameTime; // 24
+  int64_t hardwareRefFrameDuration; // 32
+  uint32_t timecodeBCD; // 40
+  uint32_t userbits; // 44
+  uint32_t timecodeFlags; // 48 - BMDTimecodeFlags
+  uint32_t sampleFrameCount; // 52
+  int32_t rowBytes; // 56
+  uint16_t width; // 60
+  uint16_t height; // 62
+  uint32_t present; // 64 - macadamRecordHas* bits for the optional fields
+  uint32_t reserved; // 68
+};
+
+#define macadamRecordHasTimecode 0x01
+#define macadamRecordHasUserbits 0x02
+#define macadamRecordHasHardwareRef 0x04
+#define macadamRecordHasAudio 0x08
+
+static_assert(sizeof(macadamFrameRecord) == 72, "Binary metadata record layout has changed.");
+
 struct frameCarrier : carrier {
+  uint32_t batchSize = 0; // Set for frames(n), resolved with an array of up to n frames
   ~frameCarrier() { }
 };
 
+struct audioCarrier : carrier {
+  uint32_t sampleFrames = 0;
+  ~audioCarrier() { }
+};
+
 struct VideoInputFormatChange {
   BMDVideoInputFormatChangedEvents notificationEvents;
   IDeckLinkDisplayMode *newDisplayMode;
   BMDDetectedVideoInputFormatFlags detectedSignalFlags;
 };
 
+struct frameData;
+void releaseFrameData(frameData* frame);
+
+// A consumer of every frame, with its own queue, from capture.subscribe().
+// Frames are shared with the capture and other subscribers, not copied.
+// Only touched on the main thread.
+struct captureSubscriber {
+  uint32_t id;
+  uint32_t queueDepth = 3;
+  MacadamOverflowPolicy policy = macadamDropOldest;
+  std::deque<frameData*> queue;
+  std::queue<frameCarrier*> promises;
+  uint32_t highWater = 0;
+  uint64_t delivered = 0;
+  uint64_t droppedOldest = 0;
+  uint64_t droppedNewest = 0;
+};
+
 struct captureThreadsafe : IDeckLinkInputCallback {
   HRESULT VideoInputFrameArrived(IDeckLinkVideoInputFrame *videoFrame, IDeckLinkAudioInputPacket *audioPacket);
   HRESULT VideoInputFormatChanged(BMDVideoInputFormatChangedEvents notificationEvents,
@@ -115,8 +271,49 @@ struct captureThreadsafe : IDeckLinkInputCallback {
   bool outputRGBA;
   IDeckLinkVideoFrame *convertedFrame = nullptr;
 
-  IDeckLinkVideoConversion *deckLinkConversion;
-  
+  // Conversions run on native workers. DeckLink conversion for outputRGBA
+  // uses one instance per worker, otherwise YUV frames are converted natively.
+  macadamPixelLayout convertTo = macadamLayoutNone;
+  std::vector<IDeckLinkVideoConversion*> deckLinkConversions;
+  std::vector<pixelScratch*> conversionScratch; // Line buffers of each worker
+  macadamWorkerPool* conversionPool = nullptr;
+  ConvertedFramePool* framePool = nullptr; // Shared with the converted frames it supplies
+  macadamInputAllocator* inputAllocator = nullptr; // Also referenced by the driver
+  uint32_t conversionThreads = 2;
+  uint64_t nextConversionSequence = 0; // Only used on the DeckLink callback thread
+  std::atomic<uint64_t> conversionQueueFull { 0 };
+  // Converted frames are dispatched to the main thread in arrival order
+  // under dispatchLock, which is never taken on the main thread as dispatch
+  // may block. Conversion stats are under statsLock, so stats() cannot stall.
+  std::mutex dispatchLock;
+  uint64_t nextDispatchSequence = 0;
+  std::map<uint64_t, frameData*> convertedFrames;
+  std::mutex statsLock;
+  uint64_t conversionCount = 0;
+  uint64_t conversionFailures = 0;
+  long long conversionMicrosLast = 0;
+  long long conversionMicrosMax = 0;
+  long long conversionMicrosTotal = 0;
+  // Proxies are made after any conversion, with stats also under statsLock
+  std::vector<captureProxy> proxies;
+  bool proxyOnly = false; // Frames carry proxies but not the full frame's data
+  uint64_t proxyFrames = 0;
+  uint64_t proxyFailures = 0;
+  long long proxyMicrosLast = 0;
+  long long proxyMicrosMax = 0;
+  long long proxyMicrosTotal = 0;
+  // Black, freeze and gamut analysis, also on the conversion workers
+  macadamVideoQC* qc = nullptr;
+  void convertFrame(frameData* frame, uint32_t workerIndex);
+  bool convertToRGBA(frameData* frame, uint32_t workerIndex);
+  bool convertNative(frameData* frame, uint32_t workerIndex);
+  bool makeProxies(frameData* frame, uint32_t workerIndex);
+  void analyseQC(frameData* frame, uint32_t workerIndex);
+  void dispatchConverted(frameData* frame, long long conversionMicros, bool converted, bool proxied);
+  napi_status dispatchFrame(frameData* frame);
+  void recordFrame(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket);
+  void publishFrame(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket);
+
   BMDTimeScale timeScale;
   uint16_t roughFps = 25; // Used for timecode formatting
   BMDAudioSampleRate sampleRate;
@@ -124,10 +321,65 @@ struct captureThreadsafe : IDeckLinkInputCallback {
   uint32_t sampleByteFactor;
   uint32_t channels = 0; // Set to zero for no channels
   std::queue<frameCarrier*> framePromises;
+  // Frames that arrived with no promise waiting. Only touched on the main thread.
+  std::deque<frameData*> frameQueue;
+  uint32_t frameQueueDepth = 3;
+  MacadamOverflowPolicy frameQueuePolicy = macadamDropOldest;
+  uint32_t frameQueueHighWater = 0;
+  uint64_t droppedOldest = 0;
+  uint64_t droppedNewest = 0;
+  // Threadsafe function queue between the DeckLink callback thread and the main thread
+  uint32_t callbackQueueSize = 20;
+  bool callbackQueueBlocking = false;
+  std::atomic<uint64_t> callbackQueueFull { 0 };
+  std::atomic<uint64_t> callbackFailures { 0 };
+  // Binary metadata records, reused in turn. Only touched on the main thread.
+  macadamFrameRecord* metadataRecords = nullptr;
+  uint32_t metadataRecordCount = 0;
+  uint32_t nextMetadataRecord = 0;
+  uint32_t metadataSequence = 0;
+  captureRefs* refs = nullptr; // Deleted when the threadsafe function finalizes
+  MacadamAncillaryMode ancillaryMode = macadamAncillaryEager;
+  std::shared_ptr<const ancillaryFilters> ancillaryFilter;
+  bool decodeAncillary = false;
+  bool timecodeString = false; // Also format timecode as a string, otherwise only BCD
+  // Audio delivered as planar float32, from the source channels in channelMap
+  bool planarAudio = false;
+  std::vector<uint32_t> channelMap;
+  // Audio ring written on the DeckLink callback thread, read by audio(n) promises
+  macadamAudioRing* audioRing = nullptr;
+  std::deque<audioCarrier*> audioPromises;
+  // Frames written to disk on the recorder's own thread
+  macadamRecorder* recorder = nullptr;
+  bool deliverFrames = true; // Otherwise frames are not passed to the main thread
+  // Every frame copied to shared memory for readers in other processes
+  macadamSharedRing* sharedRing = nullptr;
+  std::vector<captureSubscriber*> subscribers;
+  uint32_t nextSubscriberId = 1;
   ~captureThreadsafe() {
+    if (conversionPool != nullptr) { delete conversionPool; }
+    if (framePool != nullptr) { framePool->Release(); }
+    for ( auto proxy : proxies ) proxy.pool->Release();
+    if (inputAllocator != nullptr) { inputAllocator->Release(); }
+    for ( auto it = deckLinkConversions.begin() ; it != deckLinkConversions.end() ; ++it ) {
+      (*it)->Release();
+    }
+    for ( auto scratch : conversionScratch ) delete scratch;
+    while (!frameQueue.empty()) {
+      releaseFrameData(frameQueue.front());
+      frameQueue.pop_front();
+    }
+    for ( auto sub : subscribers ) {
+      for ( auto frame : sub->queue ) releaseFrameData(frame);
+      delete sub;
+    }
     if (deckLinkInput != nullptr) { deckLinkInput->Release(); }
     if (displayMode != nullptr) { displayMode->Release(); }
     if (convertedFrame != nullptr) { convertedFrame->Release(); }
+    if (audioRing != nullptr) { delete audioRing; }
+    if (recorder != nullptr) { delete recorder; }
+    if (sharedRing != nullptr) { delete sharedRing; }
+    if (qc != nullptr) { delete qc; }
   }
 };
 
@@ -136,6 +388,10 @@ struct frameData {
   IDeckLinkVideoFrame* convertedFrame;
   IDeckLinkAudioInputPacket* audioPacket;
   uint8_t* rgbaAuxiliaryBuf;
+  uint64_t sequence; // Arrival order, used to dispatch converted frames in order
+  IDeckLinkVideoFrame* proxies[MACADAM_MAX_PROXIES]; // As captureThreadsafe::proxies, or nullptr
+  uint32_t proxyMicros; // Time taken to make the proxies
+  qcFrameResult* qc; // Set when the capture analyses frames
 };
 
 struct audioData {
@@ -143,4 +399,15 @@ struct audioData {
   uint32_t dataSize;
 };
 
+void queueFrame(captureThreadsafe* crts, frameData* frame);
+void resolveFrame(napi_env env, captureThreadsafe* crts, frameData* frame, frameCarrier* c);
+void resolveFrames(napi_env env, captureThreadsafe* crts, frameData* frame, frameCarrier* c);
+bool frameValue(napi_env env, captureThreadsafe* crts, frameData* frame, carrier* c, napi_value* value);
+napi_status ancillaryValue(napi_env env, captureThreadsafe* crts, frameData* frame, napi_value frameObj);
+napi_value ancillaryPackets(napi_env env, napi_callback_info info);
+napi_status parseAncillaryMode(napi_env env, napi_value value, MacadamAncillaryMode* mode);
+napi_status parseAncillaryFilter(napi_env env, napi_value value, ancillaryFilters* filter);
+void resolveAudio(napi_env env, captureThreadsafe* crts);
+bool frameRecordValue(napi_env env, captureThreadsafe* crts, frameData* frame, carrier* c, napi_value* value);
+
 #endif // CAPTURE_PROMISE_H
@@ -8,8 +8,125 @@
 #   define IID_IUnknown		(REFIID){0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC0,0x00,0x00,0x00,0x00,0x00,0x00,0x46}
 #endif
 
-ConvertedVideoFrame::ConvertedVideoFrame(long width, long height, BMDPixelFormat pixelFormat, long rowSize) {
-    this->data = (uint8_t*)malloc(rowSize * height);
+#define CONVERTED_FRAME_ALIGNMENT 4096
+
+static uint8_t* allocAligned(size_t size) {
+    void* data = nullptr;
+    #ifdef WIN32
+    data = _aligned_malloc(size, CONVERTED_FRAME_ALIGNMENT);
+    #else
+    if (posix_memalign(&data, CONVERTED_FRAME_ALIGNMENT, size) != 0) data = nullptr;
+    #endif
+    return (uint8_t*) data;
+}
+
+static void freeAligned(uint8_t* data) {
+    #ifdef WIN32
+    _aligned_free(data);
+    #else
+    free(data);
+    #endif
+}
+
+ConvertedFramePool::ConvertedFramePool(uint32_t poolSize, size_t bufferSize, uint32_t preallocate) {
+    this->poolSize = poolSize;
+    this->bufferSize = bufferSize;
+    if (bufferSize == 0) return;
+    for ( uint32_t x = 0 ; (x < preallocate) && (x < poolSize) ; x++ ) {
+        uint8_t* data = allocAligned(bufferSize);
+        if (data == nullptr) break;
+        freeBuffers.push_back(data);
+        allocated++;
+        allocations++;
+    }
+}
+
+ConvertedFramePool::~ConvertedFramePool() {
+    for ( auto it = freeBuffers.begin() ; it != freeBuffers.end() ; ++it ) {
+        freeAligned(*it);
+    }
+}
+
+uint8_t* ConvertedFramePool::acquire(size_t size) {
+    uint8_t* data = nullptr;
+    std::lock_guard<std::mutex> guard(lock);
+    if (size != bufferSize) {
+        // Frame size has changed, so the free buffers are no longer any use
+        for ( auto it = freeBuffers.begin() ; it != freeBuffers.end() ; ++it ) {
+            freeAligned(*it);
+            allocated--;
+        }
+        freeBuffers.clear();
+        bufferSize = size;
+    }
+    if (!freeBuffers.empty()) {
+        data = freeBuffers.back();
+        freeBuffers.pop_back();
+        reuses++;
+    } else {
+        data = allocAligned(size);
+        if (data == nullptr) return nullptr;
+        allocated++;
+        allocations++;
+    }
+    inUse++;
+    if (inUse > highWater) highWater = inUse;
+    return data;
+}
+
+void ConvertedFramePool::recycle(uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> guard(lock);
+    inUse--;
+    if ((size == bufferSize) && (freeBuffers.size() < poolSize)) {
+        freeBuffers.push_back(data);
+    } else {
+        freeAligned(data);
+        allocated--;
+    }
+}
+
+void ConvertedFramePool::getStats(convertedFramePoolStats* stats) {
+    std::lock_guard<std::mutex> guard(lock);
+    stats->poolSize = poolSize;
+    stats->allocated = allocated;
+    stats->inUse = inUse;
+    stats->highWater = highWater;
+    stats->allocations = allocations;
+    stats->reuses = reuses;
+}
+
+ULONG ConvertedFramePool::Release() {
+    ULONG ulRefCount;
+
+    #ifdef WIN32
+    ulRefCount = InterlockedDecrement(&referenceCount);
+    #else
+    ulRefCount = __sync_sub_and_fetch(&referenceCount, 1);
+    #endif
+
+    if (ulRefCount == 0)
+        delete this;
+
+    return ulRefCount;
+}
+
+ULONG ConvertedFramePool::AddRef() {
+    #ifdef WIN32
+    return InterlockedIncrement(&referenceCount);
+    #else
+    return __sync_add_and_fetch(&referenceCount, 1);
+    #endif
+}
+
+ConvertedVideoFrame::ConvertedVideoFrame(long width, long height, BMDPixelFormat pixelFormat, long rowSize,
+        ConvertedFramePool* pool) {
+    this->pool = pool;
+    if (pool != nullptr) {
+        pool->AddRef();
+        this->data = pool->acquire(rowSize * height);
+    } else {
+        this->data = (uint8_t*)malloc(rowSize * height);
+    }
     this->width = width;
     this->height = height;
     this->pixelFormat = pixelFormat;
@@ -17,7 +134,11 @@ ConvertedVideoFrame::ConvertedVideoFrame(long width, long height, BMDPixelFormat
 }
 
 ConvertedVideoFrame::~ConvertedVideoFrame() {
-    if (this->data) {
+    if (this->pool != nullptr) {
+        if (this->data) pool->recycle(this->data, rowSize * height);
+        pool->Release();
+        this->data = nullptr;
+    } else if (this->data) {
         free(this->data);
         this->data = nullptr;
     }
@@ -89,7 +210,7 @@ ULONG ConvertedVideoFrame::Release() {
     #ifdef WIN32
     ulRefCount = InterlockedDecrement(&referenceCount);
     #else
-    ulRefCount = __sync_fetch_and_sub(&referenceCount, 1);
+    ulRefCount = __sync_sub_and_fetch(&referenceCount, 1);
     #endif
 
     if (ulRefCount == 0)
@@ -1,6 +1,49 @@
+#ifndef CONVERTED_FRAME_H
+#define CONVERTED_FRAME_H
+
 #include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+#include <mutex>
 #include "DeckLinkAPI.h"
 
+struct convertedFramePoolStats {
+    uint32_t poolSize;
+    uint32_t allocated;
+    uint32_t inUse;
+    uint32_t highWater;
+    uint64_t allocations;
+    uint64_t reuses;
+};
+
+// Recycles page-aligned buffers for converted frames, so that steady-state
+// capture makes no large allocations. Reference counted as frames holding a
+// buffer may outlive the capture that created the pool.
+class ConvertedFramePool {
+    std::mutex lock;
+    std::vector<uint8_t*> freeBuffers;
+    size_t bufferSize = 0;
+    uint32_t poolSize;
+    uint32_t allocated = 0;
+    uint32_t inUse = 0;
+    uint32_t highWater = 0;
+    uint64_t allocations = 0;
+    uint64_t reuses = 0;
+    long referenceCount = 1;
+
+    ~ConvertedFramePool();
+
+    public:
+        // Keeps up to poolSize buffers, with preallocate of them allocated up front
+        ConvertedFramePool(uint32_t poolSize, size_t bufferSize = 0, uint32_t preallocate = 0);
+
+        uint8_t* acquire(size_t size);
+        void recycle(uint8_t* data, size_t size);
+        void getStats(convertedFramePoolStats* stats);
+        ULONG Release();
+        ULONG AddRef();
+};
+
 class ConvertedVideoFrame : public IDeckLinkVideoFrame {
     uint8_t *data;
     long width;
@@ -8,9 +51,11 @@ class ConvertedVideoFrame : public IDeckLinkVideoFrame {
     long rowSize;
     BMDPixelFormat pixelFormat;
     long referenceCount = 1;
+    ConvertedFramePool* pool;
 
     public:
-        ConvertedVideoFrame(long width, long height, BMDPixelFormat pixelFormat, long rowSize);
+        ConvertedVideoFrame(long width, long height, BMDPixelFormat pixelFormat, long rowSize,
+            ConvertedFramePool* pool = nullptr);
         ~ConvertedVideoFrame();
 
         virtual long STDMETHODCALLTYPE GetWidth();
@@ -29,4 +74,6 @@ class ConvertedVideoFrame : public IDeckLinkVideoFrame {
         virtual HRESULT QueryInterface (REFIID   riid, LPVOID * ppvObj);
         virtual ULONG Release();
         virtual ULONG AddRef();
-};
\ No newline at end of file
+};
+
+#endif // CONVERTED_FRAME_H
@@ -0,0 +1,239 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "input_allocator.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MACADAM_MPOL_BIND 2
+#endif
+
+#if __APPLE__
+#   define IID_IUnknown		(REFIID){0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC0,0x00,0x00,0x00,0x00,0x00,0x00,0x46}
+#endif
+
+#define INPUT_PAGE_SIZE 4096
+#define INPUT_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static void* allocAligned(size_t size, size_t alignment) {
+  void* data = nullptr;
+  #ifdef WIN32
+  data = _aligned_malloc(size, alignment);
+  #else
+  if (posix_memalign(&data, alignment, size) != 0) data = nullptr;
+  #endif
+  return data;
+}
+
+static void freeAligned(void* data) {
+  #ifdef WIN32
+  _aligned_free(data);
+  #else
+  free(data);
+  #endif
+}
+
+macadamInputAllocator::macadamInputAllocator(uint32_t bufferCount, bool useHugePages, int32_t numaNode) {
+  this->bufferCount = bufferCount;
+  this->useHugePages = useHugePages;
+  this->numaNode = numaNode;
+}
+
+macadamInputAllocator::~macadamInputAllocator() {
+  // Buffers still held by the driver at this point are lost with it
+  for ( auto it = freeBuffers.begin() ; it != freeBuffers.end() ; ++it ) {
+    freePooled(*it);
+  }
+}
+
+void macadamInputAllocator::freePooled(void* buffer) {
+  auto it = poolBuffers.find(buffer);
+  #ifdef __linux__
+  if (it->second.hugePage) {
+    munmap(buffer, it->second.size);
+    poolBuffers.erase(it);
+    return;
+  }
+  #endif
+  freeAligned(buffer);
+  poolBuffers.erase(it);
+}
+
+// Called with the lock held
+void macadamInputAllocator::createPool(uint32_t size) {
+  for ( auto it = freeBuffers.begin() ; it != freeBuffers.end() ; ++it ) {
+    freePooled(*it);
+  }
+  freeBuffers.clear();
+  bufferSize = size;
+  hugePages = false;
+  generation++;
+
+  #ifdef __linux__
+  if (useHugePages) {
+    // Explicit hugepages need pages reserved in /proc/sys/vm/nr_hugepages.
+    // Without them, fall back to transparent hugepages below.
+    allocationSize = ((size + INPUT_HUGE_PAGE_SIZE - 1) / INPUT_HUGE_PAGE_SIZE) * INPUT_HUGE_PAGE_SIZE;
+    void* probe = mmap(nullptr, allocationSize, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (probe != MAP_FAILED) {
+      hugePages = true;
+      munmap(probe, allocationSize);
+    }
+  }
+  #endif
+  if (!hugePages) {
+    size_t page = useHugePages ? INPUT_HUGE_PAGE_SIZE : INPUT_PAGE_SIZE;
+    allocationSize = ((size + page - 1) / page) * page;
+  }
+
+  for ( uint32_t x = 0 ; x < bufferCount ; x++ ) {
+    void* buffer = nullptr;
+    #ifdef __linux__
+    if (hugePages) {
+      buffer = mmap(nullptr, allocationSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (buffer == MAP_FAILED) buffer = nullptr;
+    } else {
+      buffer = allocAligned(allocationSize, useHugePages ? INPUT_HUGE_PAGE_SIZE : INPUT_PAGE_SIZE);
+      if ((buffer != nullptr) && useHugePages) madvise(buffer, allocationSize, MADV_HUGEPAGE);
+    }
+    if ((buffer != nullptr) && (numaNode >= 0)) {
+      // Bind before the pages are first touched, so they are faulted in on the node
+      unsigned long nodeMask[4] = { 0, 0, 0, 0 };
+      if (numaNode < 256) nodeMask[numaNode / (8 * sizeof(unsigned long))] =
+        1UL << (numaNode % (8 * sizeof(unsigned long)));
+      if (syscall(SYS_mbind, buffer, allocationSize, MACADAM_MPOL_BIND, nodeMask, 256, 0) != 0) {
+        numaFailures++;
+      }
+    }
+    #else
+    buffer = allocAligned(allocationSize, INPUT_PAGE_SIZE);
+    #endif
+    if (buffer == nullptr) break;
+    memset(buffer, 0, allocationSize); // Pre-fault every page
+    freeBuffers.push_back(buffer);
+    poolBuffers[buffer] = { allocationSize, hugePages, generation };
+  }
+}
+
+HRESULT macadamInputAllocator::AllocateBuffer(uint32_t bufferSize, void **allocatedBuffer) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (bufferSize != this->bufferSize) createPool(bufferSize);
+  if (!freeBuffers.empty()) {
+    *allocatedBuffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    hits++;
+  } else {
+    *allocatedBuffer = allocAligned(bufferSize, INPUT_PAGE_SIZE);
+    if (*allocatedBuffer == nullptr) return E_OUTOFMEMORY;
+    misses++;
+  }
+  inUse++;
+  if (inUse > highWater) highWater = inUse;
+  return S_OK;
+}
+
+HRESULT macadamInputAllocator::ReleaseBuffer(void *buffer) {
+  std::lock_guard<std::mutex> guard(lock);
+  inUse--;
+  auto it = poolBuffers.find(buffer);
+  if (it == poolBuffers.end()) {
+    freeAligned(buffer);
+  } else if (committed && (it->second.generation == generation)) {
+    freeBuffers.push_back(buffer);
+  } else {
+    freePooled(buffer);
+  }
+  return S_OK;
+}
+
+HRESULT macadamInputAllocator::Commit() {
+  std::lock_guard<std::mutex> guard(lock);
+  committed = true;
+  return S_OK;
+}
+
+// The driver has finished with the allocator for now, so give memory back
+HRESULT macadamInputAllocator::Decommit() {
+  std::lock_guard<std::mutex> guard(lock);
+  committed = false;
+  for ( auto it = freeBuffers.begin() ; it != freeBuffers.end() ; ++it ) {
+    freePooled(*it);
+  }
+  freeBuffers.clear();
+  bufferSize = 0; // Recreate the pool on the next allocation
+  generation++;
+  return S_OK;
+}
+
+void macadamInputAllocator::getStats(inputAllocatorStats* stats) {
+  std::lock_guard<std::mutex> guard(lock);
+  stats->bufferCount = (uint32_t) poolBuffers.size();
+  stats->bufferSize = bufferSize;
+  stats->inUse = inUse;
+  stats->highWater = highWater;
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->hugePages = hugePages;
+  stats->numaNode = numaNode;
+  stats->numaFailures = numaFailures;
+}
+
+HRESULT macadamInputAllocator::QueryInterface(REFIID riid, LPVOID *ppvObj) {
+  if (!ppvObj)
+    return E_INVALIDARG;
+
+  *ppvObj = NULL;
+
+  REFIID IUnknown = IID_IUnknown;
+  REFIID IAllocator = IID_IDeckLinkMemoryAllocator;
+
+  if ((0 == memcmp(&riid, &IUnknown, sizeof(REFIID))) ||
+      (0 == memcmp(&riid, &IAllocator, sizeof(REFIID)))) {
+    *ppvObj = (LPVOID)this;
+    AddRef();
+    return S_OK;
+  }
+
+  return E_NOINTERFACE;
+}
+
+ULONG macadamInputAllocator::AddRef() {
+  #ifdef WIN32
+  return InterlockedIncrement(&referenceCount);
+  #else
+  return __sync_add_and_fetch(&referenceCount, 1);
+  #endif
+}
+
+ULONG macadamInputAllocator::Release() {
+  ULONG ulRefCount;
+
+  #ifdef WIN32
+  ulRefCount = InterlockedDecrement(&referenceCount);
+  #else
+  ulRefCount = __sync_sub_and_fetch(&referenceCount, 1);
+  #endif
+
+  if (ulRefCount == 0)
+    delete this;
+
+  return ulRefCount;
+}
@@ -0,0 +1,91 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef INPUT_ALLOCATOR_H
+#define INPUT_ALLOCATOR_H
+
+#ifdef WIN32
+#include <tchar.h>
+#include <conio.h>
+#include <objbase.h>		// Necessary for COM
+#include <comdef.h>
+#endif
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include "DeckLinkAPI.h"
+
+struct inputAllocatorStats {
+  uint32_t bufferCount;
+  uint32_t bufferSize;
+  uint32_t inUse;
+  uint32_t highWater;
+  uint64_t hits;
+  uint64_t misses;
+  bool hugePages; // True if the pool is backed by explicit hugepages
+  int32_t numaNode;
+  uint32_t numaFailures;
+};
+
+// Memory allocator for capture input frames. Holds a fixed pool of aligned,
+// pre-faulted buffers, optionally backed by 2MB hugepages and bound to a NUMA
+// node (Linux only), created when the driver first asks for a buffer size.
+// Requests that the pool cannot meet are allocated individually and counted
+// as misses.
+class macadamInputAllocator final : public IDeckLinkMemoryAllocator {
+  std::mutex lock;
+  std::vector<void*> freeBuffers;
+  // Every pooled buffer, free or in use, with the size it was mapped with.
+  // Buffers from a pool replaced after a size change are freed on release.
+  struct pooledBuffer { size_t size; bool hugePage; uint32_t generation; };
+  std::unordered_map<void*, pooledBuffer> poolBuffers;
+  uint32_t generation = 0;
+  uint32_t bufferCount;
+  uint32_t bufferSize = 0;
+  size_t allocationSize = 0; // bufferSize rounded up to the page size used
+  bool useHugePages;
+  bool hugePages = false;
+  int32_t numaNode;
+  bool committed = true;
+  uint32_t inUse = 0;
+  uint32_t highWater = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint32_t numaFailures = 0;
+  long referenceCount = 1;
+
+  void createPool(uint32_t size);
+  void freePooled(void* buffer);
+  ~macadamInputAllocator(); // Deleted by Release()
+
+  public:
+    // A numaNode of -1 leaves placement to the operating system
+    macadamInputAllocator(uint32_t bufferCount, bool useHugePages = false, int32_t numaNode = -1);
+
+    virtual HRESULT STDMETHODCALLTYPE AllocateBuffer(uint32_t bufferSize, void **allocatedBuffer);
+    virtual HRESULT STDMETHODCALLTYPE ReleaseBuffer(void *buffer);
+    virtual HRESULT STDMETHODCALLTYPE Commit();
+    virtual HRESULT STDMETHODCALLTYPE Decommit();
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, LPVOID *ppvObj);
+    virtual ULONG STDMETHODCALLTYPE AddRef();
+    virtual ULONG STDMETHODCALLTYPE Release();
+
+    void getStats(inputAllocatorStats* stats);
+};
+
+#endif // INPUT_ALLOCATOR_H
@@ -61,6 +61,13 @@
 #include "capture_promise.h"
 #include "playback_promise.h"
 #include "timecode.h"
+#include "pixel_convert.h"
+#include "ancillary_decode.h"
+#include "audio_convert.h"
+#include "recorder.h"
+#include "shared_ring.h"
+#include "video_qc.h"
+#include "output_pool.h"
 #include "node_api.h"
 
 // List of known pixel formats and their matching display names
@@ -2050,11 +2057,29 @@ napi_value Init(napi_env env, napi_value exports) {
     DECLARE_NAPI_METHOD("setDeviceConfig", setDeviceConfig),
     DECLARE_NAPI_METHOD("capture", capture),
     DECLARE_NAPI_METHOD("playback", playback),
-    DECLARE_NAPI_METHOD("timecodeTest", timecodeTest)
+    DECLARE_NAPI_METHOD("timecodeTest", timecodeTest),
+    DECLARE_NAPI_METHOD("formatTimecode", formatTimecode),
+    DECLARE_NAPI_METHOD("swizzleBGRA", swizzleBGRA),
+    DECLARE_NAPI_METHOD("convertPixels", convertPixels),
+    DECLARE_NAPI_METHOD("pixelConvertTest", pixelConvertTest),
+    DECLARE_NAPI_METHOD("decodeAncillary", decodeAncillary),
+    DECLARE_NAPI_METHOD("audioToFloat", audioToFloat),
+    DECLARE_NAPI_METHOD("recorderTest", recorderTest),
+    DECLARE_NAPI_METHOD("openSharedRing", openSharedRing),
+    DECLARE_NAPI_METHOD("sharedRingTest", sharedRingTest),
+    DECLARE_NAPI_METHOD("analyseFrame", analyseFrame),
+    DECLARE_NAPI_METHOD("qcKernelTest", qcKernelTest),
+    DECLARE_NAPI_METHOD("pendingPlayTest", pendingPlayTest),
+    DECLARE_NAPI_METHOD("frameCopyTest", frameCopyTest)
    };
-  status = napi_define_properties(env, exports, 8, desc);
+  status = napi_define_properties(env, exports, 21, desc);
   CHECK_STATUS;
 
+  selectPixelKernels();
+  selectAudioKernels();
+  selectQCKernels();
+  selectCopyKernels();
+
   #ifdef WIN32
   HRESULT result;
   result = CoInitializeEx(NULL, COINIT_MULTITHREADED);
@@ -16,6 +16,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <chrono>
 #include <string>
 #include "macadam_util.h"
@@ -160,6 +161,40 @@ int32_t rejectStatus(napi_env env, carrier* c, char* file, int32_t line) {
   return c->status;
 }
 
+napi_status parseOverflowPolicy(napi_env env, napi_value value, MacadamOverflowPolicy* policy) {
+  napi_status status;
+  char policyName[20];
+  size_t policyLen;
+
+  status = napi_get_value_string_utf8(env, value, policyName, sizeof(policyName), &policyLen);
+  PASS_STATUS;
+  if (strcmp(policyName, "dropOldest") == 0) {
+    *policy = macadamDropOldest;
+  } else if (strcmp(policyName, "dropNewest") == 0) {
+    *policy = macadamDropNewest;
+  } else {
+    return napi_invalid_arg;
+  }
+  return napi_ok;
+}
+
+napi_status parseCallbackQueueMode(napi_env env, napi_value value, bool* blocking) {
+  napi_status status;
+  char modeName[10];
+  size_t modeLen;
+
+  status = napi_get_value_string_utf8(env, value, modeName, sizeof(modeName), &modeLen);
+  PASS_STATUS;
+  if (strcmp(modeName, "drop") == 0) {
+    *blocking = false;
+  } else if (strcmp(modeName, "block") == 0) {
+    *blocking = true;
+  } else {
+    return napi_invalid_arg;
+  }
+  return napi_ok;
+}
+
 // Should never get called
 napi_value nop(napi_env env, napi_callback_info info) {
   napi_value value;
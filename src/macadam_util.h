@@ -113,6 +113,16 @@ enum _MacadamConfigType {
     macadamString = 4
 };
 
+// Behaviour of bounded native queues when a new item arrives and the queue is full
+typedef uint32_t MacadamOverflowPolicy;
+enum _MacadamOverflowPolicy {
+    macadamDropOldest = 1,
+    macadamDropNewest = 2
+};
+
+napi_status parseOverflowPolicy(napi_env env, napi_value value, MacadamOverflowPolicy* policy);
+napi_status parseCallbackQueueMode(napi_env env, napi_value value, bool* blocking);
+
 extern const BMDDeckLinkConfigurationID knownConfigValues[];
 extern const char* knownConfigNames[];
 extern const MacadamConfigType knownConfigTypes[];
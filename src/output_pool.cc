@@ -0,0 +1,217 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <string.h>
+#include <chrono>
+#include "output_pool.h"
+#include "macadam_util.h"
+#include "simd_util.h"
+
+macadamOutputPool::~macadamOutputPool() {
+  for ( auto frame : frames ) {
+    frame->video->Release();
+    delete frame;
+  }
+}
+
+HRESULT macadamOutputPool::create(IDeckLinkOutput* deckLinkOutput, uint32_t frameCount,
+    int32_t width, int32_t height, int32_t rowBytes, BMDPixelFormat pixelFormat) {
+  HRESULT hresult;
+  for ( uint32_t x = 0 ; x < frameCount ; x++ ) {
+    outputPoolFrame* frame = new outputPoolFrame;
+    hresult = deckLinkOutput->CreateVideoFrame(width, height, rowBytes, pixelFormat,
+      bmdFrameFlagDefault, &frame->video);
+    if (hresult != S_OK) {
+      delete frame;
+      return hresult;
+    }
+    frame->video->GetBytes(&frame->bytes);
+    frames.push_back(frame);
+    freeFrames.push_back(frame);
+    lookup.emplace(frame->video, frame);
+  }
+  stats.frameCount = frameCount;
+  return S_OK;
+}
+
+outputPoolFrame* macadamOutputPool::take() {
+  std::lock_guard<std::mutex> guard(lock);
+  if (freeFrames.empty()) {
+    stats.exhausted++;
+    return nullptr;
+  }
+  outputPoolFrame* frame = freeFrames.back();
+  freeFrames.pop_back();
+  stats.taken++;
+  stats.inUse++;
+  if (stats.inUse > stats.highWater) stats.highWater = stats.inUse;
+  return frame;
+}
+
+outputPoolFrame* macadamOutputPool::find(IDeckLinkVideoFrame* video) {
+  auto it = lookup.find(video);
+  return (it != lookup.end()) ? it->second : nullptr;
+}
+
+void macadamOutputPool::recycle(outputPoolFrame* frame) {
+  std::lock_guard<std::mutex> guard(lock);
+  freeFrames.push_back(frame);
+  stats.inUse--;
+}
+
+void macadamOutputPool::recordCopy(long long micros) {
+  std::lock_guard<std::mutex> guard(lock);
+  stats.copies++;
+  stats.copyMicrosLast = micros;
+  if (micros > stats.copyMicrosMax) stats.copyMicrosMax = micros;
+  stats.copyMicrosTotal += micros;
+}
+
+void macadamOutputPool::getStats(outputPoolStats* stats) {
+  std::lock_guard<std::mutex> guard(lock);
+  *stats = this->stats;
+}
+
+static void copyMemcpy(uint8_t* dst, const uint8_t* src, size_t size) {
+  memcpy(dst, src, size);
+}
+
+#ifdef MACADAM_X86
+
+// Streams whole frames past the cache, as the driver reads them back from
+// memory and the CPU does not touch them again
+MACADAM_TARGET("avx2")
+static void copyStreamAVX2(uint8_t* dst, const uint8_t* src, size_t size) {
+  size_t head = (32 - ((uintptr_t) dst & 31)) & 31;
+  if (head > size) head = size;
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+  size_t x = 0;
+  for ( ; x + 128 <= size ; x += 128 ) {
+    __m256i a = _mm256_loadu_si256((const __m256i*) (src + x));
+    __m256i b = _mm256_loadu_si256((const __m256i*) (src + x + 32));
+    __m256i c = _mm256_loadu_si256((const __m256i*) (src + x + 64));
+    __m256i d = _mm256_loadu_si256((const __m256i*) (src + x + 96));
+    _mm256_stream_si256((__m256i*) (dst + x), a);
+    _mm256_stream_si256((__m256i*) (dst + x + 32), b);
+    _mm256_stream_si256((__m256i*) (dst + x + 64), c);
+    _mm256_stream_si256((__m256i*) (dst + x + 96), d);
+  }
+  _mm_sfence();
+  memcpy(dst + x, src + x, size - x);
+}
+
+#endif // MACADAM_X86
+
+static frameCopyKernel selectedCopy = copyMemcpy;
+static const char* selectedCopyName = "memcpy";
+
+void selectCopyKernels() {
+  #ifdef MACADAM_X86
+  if (cpuHasAVX2()) {
+    selectedCopy = copyStreamAVX2;
+    selectedCopyName = "avx2";
+  }
+  #endif
+}
+
+void copyFrameBytes(void* dst, const void* src, size_t size) {
+  selectedCopy((uint8_t*) dst, (const uint8_t*) src, size);
+}
+
+const char* copyKernelName() {
+  return selectedCopyName;
+}
+
+frameCopyKernel getCopyKernel(const char* name) {
+  if (strcmp(name, "memcpy") == 0) return copyMemcpy;
+  #ifdef MACADAM_X86
+  if ((strcmp(name, "avx2") == 0) && cpuHasAVX2()) return copyStreamAVX2;
+  #endif
+  return nullptr;
+}
+
+// frameCopyTest(bytes, iterations, kernel) - copies bytes of data iterations
+// times into eight frames in turn with the named kernel, or the selected
+// kernel if none is given, checking a copy at every alignment first
+napi_value frameCopyTest(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, param;
+  napi_valuetype type;
+  uint32_t bytes, iterations;
+  frameCopyKernel kernel = selectedCopy;
+  const char* kernelName = selectedCopyName;
+  char name[16];
+  size_t nameLength;
+
+  size_t argc = 3;
+  napi_value argv[3];
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 2) NAPI_THROW_ERROR("Frame copy test requires a size and an iteration count.");
+  status = napi_get_value_uint32(env, argv[0], &bytes);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, argv[1], &iterations);
+  CHECK_STATUS;
+  if (argc >= 3) {
+    status = napi_typeof(env, argv[2], &type);
+    CHECK_STATUS;
+    if (type != napi_string) NAPI_THROW_ERROR("Copy kernel must be named with a string.");
+    status = napi_get_value_string_utf8(env, argv[2], name, sizeof(name), &nameLength);
+    CHECK_STATUS;
+    kernel = getCopyKernel(name);
+    if (kernel == nullptr) NAPI_THROW_ERROR("Copy kernel is not available on this CPU.");
+    kernelName = (strcmp(name, "avx2") == 0) ? "avx2" : "memcpy";
+  }
+
+  std::vector<uint8_t> src(bytes + 64), dst(bytes + 64);
+  for ( size_t x = 0 ; x < src.size() ; x++ ) src[x] = (uint8_t) (x * 7 + (x >> 8));
+  bool ok = true;
+  for ( uint32_t offset = 0 ; (offset < 32) && ok ; offset++ ) {
+    size_t size = (bytes > offset) ? bytes - offset : 0;
+    memset(dst.data(), 0, dst.size());
+    kernel(dst.data() + offset, src.data() + (31 - offset), size);
+    ok = (memcmp(dst.data() + offset, src.data() + (31 - offset), size) == 0) &&
+      (dst[offset + size] == 0) && ((offset == 0) || (dst[offset - 1] == 0));
+  }
+
+  // Copy into a pool's worth of frames in turn, as in playback
+  std::vector<std::vector<uint8_t>> pool(8, std::vector<uint8_t>(bytes, 0));
+  auto start = std::chrono::high_resolution_clock::now();
+  for ( uint32_t x = 0 ; x < iterations ; x++ ) {
+    kernel(pool[x % pool.size()].data(), src.data(), bytes);
+  }
+  long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::high_resolution_clock::now() - start).count();
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = napi_get_boolean(env, ok, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "ok", param);
+  CHECK_STATUS;
+  status = napi_create_string_utf8(env, kernelName, NAPI_AUTO_LENGTH, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "kernel", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, nanos, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "nanos", param);
+  CHECK_STATUS;
+
+  return result;
+}
@@ -0,0 +1,92 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef OUTPUT_POOL_H
+#define OUTPUT_POOL_H
+
+#ifdef WIN32
+#include <tchar.h>
+#include <conio.h>
+#include <objbase.h>		// Necessary for COM
+#include <comdef.h>
+#endif
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include "node_api.h"
+#include "DeckLinkAPI.h"
+
+// Copies frame data, with a kernel selected at module load
+typedef void (*frameCopyKernel)(uint8_t* dst, const uint8_t* src, size_t size);
+
+struct outputPoolFrame {
+  IDeckLinkMutableVideoFrame* video = nullptr;
+  void* bytes = nullptr; // Of the video frame, fixed for its lifetime
+  BMDTimeValue scheduledTime = 0;
+};
+
+struct outputPoolStats {
+  uint32_t frameCount = 0;
+  uint32_t inUse = 0; // Being copied into or scheduled with the driver
+  uint32_t highWater = 0;
+  uint64_t taken = 0;
+  uint64_t exhausted = 0; // Frames asked for when none were free
+  uint64_t copies = 0;
+  long long copyMicrosLast = 0;
+  long long copyMicrosMax = 0;
+  long long copyMicrosTotal = 0;
+};
+
+// Pool of video frames created by the driver with IDeckLinkOutput::CreateVideoFrame,
+// so that scheduled playback copies into memory the driver can transfer
+// directly and no JS buffer is held while a frame waits to be played. A frame
+// is taken to schedule, then recycled when its completion callback arrives.
+class macadamOutputPool {
+  std::mutex lock;
+  std::vector<outputPoolFrame*> frames;
+  // Every pooled frame by its driver interface, fixed once the pool is created
+  std::unordered_map<IDeckLinkVideoFrame*, outputPoolFrame*> lookup;
+  std::vector<outputPoolFrame*> freeFrames;
+  outputPoolStats stats;
+
+  public:
+    ~macadamOutputPool();
+
+    // Creates frameCount frames. Not thread safe, so call before any frame is taken.
+    HRESULT create(IDeckLinkOutput* deckLinkOutput, uint32_t frameCount, int32_t width,
+      int32_t height, int32_t rowBytes, BMDPixelFormat pixelFormat);
+    // Returns nullptr when every frame is in use
+    outputPoolFrame* take();
+    // The pooled frame for a completed frame, or nullptr if not from this pool
+    outputPoolFrame* find(IDeckLinkVideoFrame* video);
+    void recycle(outputPoolFrame* frame);
+    void recordCopy(long long micros);
+    void getStats(outputPoolStats* stats);
+};
+
+// Select the fastest copy kernel supported by the CPU. Called once at module load.
+void selectCopyKernels();
+
+void copyFrameBytes(void* dst, const void* src, size_t size);
+const char* copyKernelName();
+
+// Named kernel - "memcpy" or "avx2" - or nullptr when not available
+frameCopyKernel getCopyKernel(const char* name);
+
+napi_value frameCopyTest(napi_env env, napi_callback_info info);
+
+#endif // OUTPUT_POOL_H
@@ -0,0 +1,1079 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "pixel_convert.h"
+#include "macadam_util.h"
+#include "simd_util.h"
+
+static void swizzleScalar(uint8_t* data, size_t bytes) {
+  for ( size_t i = 0 ; i + 3 < bytes ; i += 4 ) {
+    uint8_t blue = data[i];
+    data[i + 0] = data[i + 2];
+    data[i + 2] = blue;
+    data[i + 3] = 255;
+  }
+}
+
+#ifdef MACADAM_X86
+
+MACADAM_TARGET("ssse3")
+static void swizzleSSSE3(uint8_t* data, size_t bytes) {
+  const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+  size_t i = 0;
+  for ( ; i + 16 <= bytes ; i += 16 ) {
+    __m128i px = _mm_loadu_si128((__m128i*) (data + i));
+    px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), alpha);
+    _mm_storeu_si128((__m128i*) (data + i), px);
+  }
+  swizzleScalar(data + i, bytes - i);
+}
+
+MACADAM_TARGET("avx2")
+static void swizzleAVX2(uint8_t* data, size_t bytes) {
+  const __m256i shuffle = _mm256_setr_epi8(
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m256i alpha = _mm256_set1_epi32((int) 0xff000000);
+  size_t i = 0;
+  for ( ; i + 64 <= bytes ; i += 64 ) {
+    __m256i px0 = _mm256_loadu_si256((__m256i*) (data + i));
+    __m256i px1 = _mm256_loadu_si256((__m256i*) (data + i + 32));
+    px0 = _mm256_or_si256(_mm256_shuffle_epi8(px0, shuffle), alpha);
+    px1 = _mm256_or_si256(_mm256_shuffle_epi8(px1, shuffle), alpha);
+    _mm256_storeu_si256((__m256i*) (data + i), px0);
+    _mm256_storeu_si256((__m256i*) (data + i + 32), px1);
+  }
+  for ( ; i + 32 <= bytes ; i += 32 ) {
+    __m256i px = _mm256_loadu_si256((__m256i*) (data + i));
+    px = _mm256_or_si256(_mm256_shuffle_epi8(px, shuffle), alpha);
+    _mm256_storeu_si256((__m256i*) (data + i), px);
+  }
+  swizzleScalar(data + i, bytes - i);
+}
+
+#endif // MACADAM_X86
+
+#ifdef MACADAM_NEON
+
+static void swizzleNEON(uint8_t* data, size_t bytes) {
+  size_t i = 0;
+  for ( ; i + 64 <= bytes ; i += 64 ) {
+    uint8x16x4_t px = vld4q_u8(data + i);
+    uint8x16_t blue = px.val[0];
+    px.val[0] = px.val[2];
+    px.val[2] = blue;
+    px.val[3] = vdupq_n_u8(255);
+    vst4q_u8(data + i, px);
+  }
+  swizzleScalar(data + i, bytes - i);
+}
+
+#endif // MACADAM_NEON
+
+static inline uint32_t readWord(const uint8_t* src) {
+  uint32_t word;
+  memcpy(&word, src, 4); // v210 is little-endian, as are all supported hosts
+  return word;
+}
+
+// v210 packs 6 pixels into 4 words, 3 10-bit components per word
+static void unpackV210Scalar(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width) {
+  for ( uint32_t x = 0 ; x < width ; x += 6, src += 16, y += 6, cb += 3, cr += 3 ) {
+    uint32_t w0 = readWord(src), w1 = readWord(src + 4), w2 = readWord(src + 8), w3 = readWord(src + 12);
+    cb[0] = w0 & 0x3ff; y[0] = (w0 >> 10) & 0x3ff; cr[0] = (w0 >> 20) & 0x3ff;
+    y[1] = w1 & 0x3ff; cb[1] = (w1 >> 10) & 0x3ff; y[2] = (w1 >> 20) & 0x3ff;
+    cr[1] = w2 & 0x3ff; y[3] = (w2 >> 10) & 0x3ff; cb[2] = (w2 >> 20) & 0x3ff;
+    y[4] = w3 & 0x3ff; cr[2] = (w3 >> 10) & 0x3ff; y[5] = (w3 >> 20) & 0x3ff;
+  }
+}
+
+// 2vuy is 8-bit Cb Y0 Cr Y1, scaled up to 10 bits
+static void unpack2vuyScalar(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width) {
+  for ( uint32_t x = 0 ; x < width ; x += 2, src += 4 ) {
+    cb[x >> 1] = src[0] << 2;
+    y[x] = src[1] << 2;
+    cr[x >> 1] = src[2] << 2;
+    y[x + 1] = src[3] << 2;
+  }
+}
+
+#ifdef MACADAM_X86
+
+MACADAM_TARGET("ssse3")
+static void unpackV210SSSE3(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width) {
+  const __m128i mask = _mm_set1_epi32(0x3ff);
+  // After packing, a holds the low and middle components of the 4 words and b the high
+  const __m128i yA = _mm_setr_epi8(8, 9, 2, 3, -1, -1, 12, 13, 6, 7, -1, -1, -1, -1, -1, -1);
+  const __m128i yB = _mm_setr_epi8(-1, -1, -1, -1, 2, 3, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1);
+  const __m128i cbA = _mm_setr_epi8(0, 1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i cbB = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i crA = _mm_setr_epi8(-1, -1, 4, 5, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i crB = _mm_setr_epi8(0, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  for ( uint32_t x = 0 ; x < width ; x += 6, src += 16, y += 6, cb += 3, cr += 3 ) {
+    __m128i words = _mm_loadu_si128((__m128i*) src);
+    __m128i c0 = _mm_and_si128(words, mask);
+    __m128i c1 = _mm_and_si128(_mm_srli_epi32(words, 10), mask);
+    __m128i c2 = _mm_and_si128(_mm_srli_epi32(words, 20), mask);
+    __m128i a = _mm_packs_epi32(c0, c1);
+    __m128i b = _mm_packs_epi32(c2, c2);
+    _mm_storeu_si128((__m128i*) y, _mm_or_si128(_mm_shuffle_epi8(a, yA), _mm_shuffle_epi8(b, yB)));
+    _mm_storeu_si128((__m128i*) cb, _mm_or_si128(_mm_shuffle_epi8(a, cbA), _mm_shuffle_epi8(b, cbB)));
+    _mm_storeu_si128((__m128i*) cr, _mm_or_si128(_mm_shuffle_epi8(a, crA), _mm_shuffle_epi8(b, crB)));
+  }
+}
+
+MACADAM_TARGET("ssse3")
+static void unpack2vuySSSE3(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width) {
+  const __m128i ySh = _mm_setr_epi8(1, -1, 3, -1, 5, -1, 7, -1, 9, -1, 11, -1, 13, -1, 15, -1);
+  const __m128i cbSh = _mm_setr_epi8(0, -1, 4, -1, 8, -1, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i crSh = _mm_setr_epi8(2, -1, 6, -1, 10, -1, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  uint32_t x = 0;
+  for ( ; x + 8 <= width ; x += 8, src += 16 ) {
+    __m128i px = _mm_loadu_si128((__m128i*) src);
+    _mm_storeu_si128((__m128i*) (y + x), _mm_slli_epi16(_mm_shuffle_epi8(px, ySh), 2));
+    _mm_storeu_si128((__m128i*) (cb + (x >> 1)), _mm_slli_epi16(_mm_shuffle_epi8(px, cbSh), 2));
+    _mm_storeu_si128((__m128i*) (cr + (x >> 1)), _mm_slli_epi16(_mm_shuffle_epi8(px, crSh), 2));
+  }
+  if (x < width) unpack2vuyScalar(src, y + x, cb + (x >> 1), cr + (x >> 1), width - x);
+}
+
+#endif // MACADAM_X86
+
+#ifdef MACADAM_NEON
+
+static void unpack2vuyNEON(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width) {
+  uint32_t x = 0;
+  for ( ; x + 32 <= width ; x += 32, src += 64 ) {
+    uint8x16x4_t px = vld4q_u8(src); // Cb, Y0, Cr, Y1
+    uint8x16x2_t luma = vzipq_u8(px.val[1], px.val[3]);
+    vst1q_u16(y + x, vshll_n_u8(vget_low_u8(luma.val[0]), 2));
+    vst1q_u16(y + x + 8, vshll_n_u8(vget_high_u8(luma.val[0]), 2));
+    vst1q_u16(y + x + 16, vshll_n_u8(vget_low_u8(luma.val[1]), 2));
+    vst1q_u16(y + x + 24, vshll_n_u8(vget_high_u8(luma.val[1]), 2));
+    vst1q_u16(cb + (x >> 1), vshll_n_u8(vget_low_u8(px.val[0]), 2));
+    vst1q_u16(cb + (x >> 1) + 8, vshll_n_u8(vget_high_u8(px.val[0]), 2));
+    vst1q_u16(cr + (x >> 1), vshll_n_u8(vget_low_u8(px.val[2]), 2));
+    vst1q_u16(cr + (x >> 1) + 8, vshll_n_u8(vget_high_u8(px.val[2]), 2));
+  }
+  if (x < width) unpack2vuyScalar(src, y + x, cb + (x >> 1), cr + (x >> 1), width - x);
+}
+
+#endif // MACADAM_NEON
+
+static unpackKernel selectedV210 = unpackV210Scalar;
+static unpackKernel selected2vuy = unpack2vuyScalar;
+
+// Fixed point YCbCr to RGB, 13 fractional bits, for limited range 10-bit input
+struct colourMatrix {
+  int32_t y, crR, cbG, crG, cbB;
+};
+static const colourMatrix bt709 = { 9539, 14686, 1747, 4366, 17305 };
+static const colourMatrix bt601 = { 9539, 13075, 3209, 6660, 16525 };
+
+static MACADAM_INLINE int32_t clamp10(int32_t v) {
+  return (v < 0) ? 0 : ((v > 1023) ? 1023 : v);
+}
+
+// Writes a line of R, G and B planes as 10-bit full range values. Chroma is
+// first upsampled, interpolating for odd pixels, so that the matrix loop is
+// branch free and can be vectorized by the compiler.
+static MACADAM_INLINE void matrixLine(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+    uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b) {
+  uint32_t chromaWidth = (width + 1) >> 1;
+  cb[chromaWidth] = cb[chromaWidth - 1];
+  cr[chromaWidth] = cr[chromaWidth - 1];
+  // Upsampled chroma is held in the output planes until the matrix overwrites it
+  for ( uint32_t c = 0 ; c < chromaWidth ; c++ ) {
+    r[2 * c] = cb[c];
+    r[2 * c + 1] = (cb[c] + cb[c + 1] + 1) >> 1;
+    b[2 * c] = cr[c];
+    b[2 * c + 1] = (cr[c] + cr[c + 1] + 1) >> 1;
+  }
+  for ( uint32_t x = 0 ; x < width ; x++ ) {
+    int32_t yScaled = m.y * ((int32_t) y[x] - 64) + 4096;
+    int32_t cbv = (int32_t) r[x] - 512;
+    int32_t crv = (int32_t) b[x] - 512;
+    r[x] = (uint16_t) clamp10((yScaled + m.crR * crv) >> 13);
+    g[x] = (uint16_t) clamp10((yScaled - m.cbG * cbv - m.crG * crv) >> 13);
+    b[x] = (uint16_t) clamp10((yScaled + m.cbB * cbv) >> 13);
+  }
+}
+
+// Matrix and pack a line to RGBA or RGB48, using r, g and b as scratch planes.
+// There are no hand-written versions, only the generic loops below built for
+// each target and vectorized by the compiler.
+typedef void (*rgbLineKernel)(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+  uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* dst);
+
+static MACADAM_INLINE void rgbaLine(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+    uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* out) {
+  matrixLine(m, y, cb, cr, width, r, g, b);
+  for ( uint32_t x = 0 ; x < width ; x++ ) {
+    out[4 * x] = (uint8_t) (r[x] >> 2);
+    out[4 * x + 1] = (uint8_t) (g[x] >> 2);
+    out[4 * x + 2] = (uint8_t) (b[x] >> 2);
+    out[4 * x + 3] = 255;
+  }
+}
+
+static MACADAM_INLINE void rgb48Line(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+    uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* dst) {
+  uint16_t* out = (uint16_t*) dst;
+  matrixLine(m, y, cb, cr, width, r, g, b);
+  for ( uint32_t x = 0 ; x < width ; x++ ) {
+    out[3 * x] = (r[x] << 6) | (r[x] >> 4);
+    out[3 * x + 1] = (g[x] << 6) | (g[x] >> 4);
+    out[3 * x + 2] = (b[x] << 6) | (b[x] >> 4);
+  }
+}
+
+static void rgbaLineDefault(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+    uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* dst) {
+  rgbaLine(m, y, cb, cr, width, r, g, b, dst);
+}
+
+static void rgb48LineDefault(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+    uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* dst) {
+  rgb48Line(m, y, cb, cr, width, r, g, b, dst);
+}
+
+#ifdef MACADAM_X86
+
+MACADAM_TARGET("avx2")
+static void rgbaLineAutoAVX2(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+    uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* dst) {
+  rgbaLine(m, y, cb, cr, width, r, g, b, dst);
+}
+
+MACADAM_TARGET("avx2")
+static void rgb48LineAutoAVX2(const colourMatrix& m, const uint16_t* y, uint16_t* cb, uint16_t* cr,
+    uint32_t width, uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* dst) {
+  rgb48Line(m, y, cb, cr, width, r, g, b, dst);
+}
+
+#endif // MACADAM_X86
+
+static rgbLineKernel selectedRGBA = rgbaLineDefault;
+static rgbLineKernel selectedRGB48 = rgb48LineDefault;
+
+// Downscaling adds each source line into accumulators, one per output
+// sample, over the source samples that the output sample covers. Whole
+// factors have kernels that the compiler can vectorize, built for AVX2 too.
+typedef void (*boxLineKernel)(const uint16_t* in, uint32_t outCount, uint32_t* acc);
+
+template <uint32_t factor>
+static MACADAM_INLINE void boxLine(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  for ( uint32_t o = 0 ; o < outCount ; o++ ) {
+    uint32_t sum = 0;
+    for ( uint32_t k = 0 ; k < factor ; k++ ) sum += in[o * factor + k];
+    acc[o] += sum;
+  }
+}
+
+static void boxLine1Default(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<1>(in, outCount, acc);
+}
+
+static void boxLine2Default(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<2>(in, outCount, acc);
+}
+
+static void boxLine4Default(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<4>(in, outCount, acc);
+}
+
+static void boxLine8Default(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<8>(in, outCount, acc);
+}
+
+#ifdef MACADAM_X86
+
+MACADAM_TARGET("avx2")
+static void boxLine1AutoAVX2(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<1>(in, outCount, acc);
+}
+
+MACADAM_TARGET("avx2")
+static void boxLine2AutoAVX2(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<2>(in, outCount, acc);
+}
+
+MACADAM_TARGET("avx2")
+static void boxLine4AutoAVX2(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<4>(in, outCount, acc);
+}
+
+MACADAM_TARGET("avx2")
+static void boxLine8AutoAVX2(const uint16_t* in, uint32_t outCount, uint32_t* acc) {
+  boxLine<8>(in, outCount, acc);
+}
+
+#endif // MACADAM_X86
+
+// Indexed by the base 2 logarithm of the factor
+static boxLineKernel selectedBox[4] = {
+  boxLine1Default, boxLine2Default, boxLine4Default, boxLine8Default };
+
+// Any other ratio, where output sample o covers starts[o] up to starts[o + 1]
+static void spanLine(const uint16_t* in, const uint32_t* starts, uint32_t outCount, uint32_t* acc) {
+  for ( uint32_t o = 0 ; o < outCount ; o++ ) {
+    uint32_t sum = 0;
+    for ( uint32_t x = starts[o] ; x < starts[o + 1] ; x++ ) sum += in[x];
+    acc[o] += sum;
+  }
+}
+
+// Rounded mean of each accumulator, over rows lines of its span
+static void averageLine(const uint32_t* acc, const uint32_t* starts, uint32_t outCount,
+    uint32_t rows, uint16_t* out) {
+  for ( uint32_t o = 0 ; o < outCount ; o++ ) {
+    uint32_t count = rows * (starts[o + 1] - starts[o]);
+    out[o] = (uint16_t) ((acc[o] + (count >> 1)) / count);
+  }
+}
+
+napi_status parsePixelLayout(napi_env env, napi_value value, macadamPixelLayout* layout) {
+  napi_status status;
+  char name[16];
+  status = napi_get_value_string_utf8(env, value, name, sizeof(name), nullptr);
+  PASS_STATUS;
+  if (strcmp(name, "rgba") == 0) {
+    *layout = macadamLayoutRGBA;
+  } else if (strcmp(name, "rgb48") == 0) {
+    *layout = macadamLayoutRGB48;
+  } else if (strcmp(name, "yuv422p10") == 0) {
+    *layout = macadamLayoutYUV422P10;
+  } else if (strcmp(name, "uyvy") == 0) {
+    *layout = macadamLayoutUYVY;
+  } else {
+    return napi_invalid_arg;
+  }
+  return napi_ok;
+}
+
+unpackKernel getUnpackKernel(BMDPixelFormat from) {
+  switch (from) {
+    case bmdFormat10BitYUV: return selectedV210;
+    case bmdFormat8BitYUV: return selected2vuy;
+    default: return nullptr;
+  }
+}
+
+const char* pixelLayoutName(macadamPixelLayout layout) {
+  switch (layout) {
+    case macadamLayoutRGBA: return "rgba";
+    case macadamLayoutRGB48: return "rgb48";
+    case macadamLayoutYUV422P10: return "yuv422p10";
+    case macadamLayoutUYVY: return "uyvy";
+    default: return "none";
+  }
+}
+
+bool canConvertPixels(BMDPixelFormat from) {
+  return (from == bmdFormat10BitYUV) || (from == bmdFormat8BitYUV);
+}
+
+uint32_t pixelLayoutRowBytes(macadamPixelLayout layout, uint32_t width) {
+  switch (layout) {
+    case macadamLayoutRGBA: return 4 * width;
+    case macadamLayoutRGB48: return 6 * width;
+    case macadamLayoutYUV422P10: return 2 * width + 4 * ((width + 1) >> 1);
+    case macadamLayoutUYVY: return 4 * ((width + 1) >> 1);
+    default: return 0;
+  }
+}
+
+uint64_t pixelLayoutFrameBytes(macadamPixelLayout layout, uint32_t width, uint32_t height) {
+  uint64_t chromaWidth = ((uint64_t) width + 1) >> 1;
+  uint64_t rowBytes;
+  switch (layout) {
+    case macadamLayoutRGBA: rowBytes = 4 * (uint64_t) width; break;
+    case macadamLayoutRGB48: rowBytes = 6 * (uint64_t) width; break;
+    case macadamLayoutYUV422P10: rowBytes = 2 * (uint64_t) width + 4 * chromaWidth; break;
+    case macadamLayoutUYVY: rowBytes = 4 * chromaWidth; break;
+    default: return 0;
+  }
+  uint64_t frameBytes = rowBytes * height;
+  return (frameBytes > MACADAM_MAX_FRAME_BYTES) ? 0 : frameBytes;
+}
+
+uint64_t pixelFormatMinRowBytes(BMDPixelFormat from, uint32_t width) {
+  switch (from) {
+    case bmdFormat10BitYUV: return (((uint64_t) width + 47) / 48) * 128;
+    case bmdFormat8BitYUV: return 4 * (((uint64_t) width + 1) >> 1);
+    default: return 0;
+  }
+}
+
+// Writes line row of a frame in the given layout from 10-bit planar YUV,
+// using r, g and b as scratch and cb and cr as for matrixLine
+static void layoutLine(macadamPixelLayout to, const colourMatrix& matrix, const uint16_t* y,
+    uint16_t* cb, uint16_t* cr, uint32_t width, uint32_t height, uint32_t row,
+    uint16_t* r, uint16_t* g, uint16_t* b, uint8_t* dst) {
+  uint32_t chromaWidth = (width + 1) >> 1;
+  switch (to) {
+    case macadamLayoutRGBA:
+      selectedRGBA(matrix, y, cb, cr, width, r, g, b, dst + row * 4 * width);
+      break;
+    case macadamLayoutRGB48:
+      selectedRGB48(matrix, y, cb, cr, width, r, g, b, dst + row * 6 * width);
+      break;
+    case macadamLayoutYUV422P10: {
+      uint8_t* cbPlane = dst + 2 * width * height;
+      uint8_t* crPlane = cbPlane + 2 * chromaWidth * height;
+      memcpy(dst + row * 2 * width, y, 2 * width);
+      memcpy(cbPlane + row * 2 * chromaWidth, cb, 2 * chromaWidth);
+      memcpy(crPlane + row * 2 * chromaWidth, cr, 2 * chromaWidth);
+      break;
+    }
+    case macadamLayoutUYVY: {
+      uint8_t* out = dst + row * 4 * chromaWidth;
+      for ( uint32_t c = 0 ; c < chromaWidth ; c++, out += 4 ) {
+        out[0] = (uint8_t) (cb[c] >> 2);
+        out[1] = (uint8_t) (y[2 * c] >> 2);
+        out[2] = (uint8_t) (cr[c] >> 2);
+        out[3] = (uint8_t) (y[2 * c + 1] >> 2);
+      }
+      break;
+    }
+  }
+}
+
+pixelScratch::~pixelScratch() {
+  free(buffer);
+}
+
+void* pixelScratch::get(size_t bytes) {
+  if (bytes > size) {
+    void* grown = malloc(bytes);
+    if (grown == nullptr) return nullptr;
+    free(buffer);
+    buffer = grown;
+    size = bytes;
+  }
+  return buffer;
+}
+
+bool convertPixelLayout(BMDPixelFormat from, const uint8_t* src, uint32_t srcRowBytes,
+    uint32_t width, uint32_t height, macadamPixelLayout to, uint8_t* dst,
+    pixelScratch* scratch) {
+  unpackKernel unpack;
+  switch (from) {
+    case bmdFormat10BitYUV: unpack = selectedV210; break;
+    case bmdFormat8BitYUV: unpack = selected2vuy; break;
+    default: return false;
+  }
+  if ((to == macadamLayoutNone) || (width == 0)) return false;
+
+  uint32_t chromaWidth = (width + 1) >> 1;
+  pixelScratch callScratch;
+  if (scratch == nullptr) scratch = &callScratch;
+  uint16_t* line = (uint16_t*) scratch->get(sizeof(uint16_t) *
+    (width + chromaWidth * 2 + 3 * UNPACK_PADDING + 3 * (width + 1)));
+  if (line == nullptr) return false;
+  uint16_t* y = line;
+  uint16_t* cb = y + width + UNPACK_PADDING;
+  uint16_t* cr = cb + chromaWidth + UNPACK_PADDING;
+  uint16_t* r = cr + chromaWidth + UNPACK_PADDING;
+  uint16_t* g = r + width + 1;
+  uint16_t* b = g + width + 1;
+  const colourMatrix& matrix = (height > 576) ? bt709 : bt601;
+
+  for ( uint32_t row = 0 ; row < height ; row++ ) {
+    unpack(src + row * srcRowBytes, y, cb, cr, width);
+    layoutLine(to, matrix, y, cb, cr, width, height, row, r, g, b, dst);
+  }
+
+  return true;
+}
+
+bool scalePixelLayout(BMDPixelFormat from, const uint8_t* src, uint32_t srcRowBytes,
+    uint32_t width, uint32_t height, uint32_t outWidth, uint32_t outHeight,
+    macadamPixelLayout to, uint8_t* dst, pixelScratch* scratch) {
+  unpackKernel unpack;
+  switch (from) {
+    case bmdFormat10BitYUV: unpack = selectedV210; break;
+    case bmdFormat8BitYUV: unpack = selected2vuy; break;
+    default: return false;
+  }
+  if ((to == macadamLayoutNone) || (outWidth == 0) || (outHeight == 0) ||
+      ((outWidth & 1) != 0) || (outWidth > width) || (outHeight > height)) return false;
+
+  uint32_t chromaWidth = (width + 1) >> 1;
+  uint32_t outChroma = outWidth >> 1;
+  boxLineKernel box = nullptr;
+  uint32_t factor = width / outWidth;
+  if ((factor * outWidth == width) && (factor * outChroma == chromaWidth)) {
+    switch (factor) {
+      case 1: box = selectedBox[0]; break;
+      case 2: box = selectedBox[1]; break;
+      case 4: box = selectedBox[2]; break;
+      case 8: box = selectedBox[3]; break;
+      default: break;
+    }
+  }
+
+  // Lines, then the sums and spans, in one buffer
+  size_t lineBytes = sizeof(uint16_t) * (width + chromaWidth * 2 +
+    outWidth + outChroma * 2 + 6 * UNPACK_PADDING + 3 * (outWidth + 1));
+  lineBytes = (lineBytes + 15) & ~((size_t) 15);
+  pixelScratch callScratch;
+  if (scratch == nullptr) scratch = &callScratch;
+  uint16_t* line = (uint16_t*) scratch->get(lineBytes +
+    sizeof(uint32_t) * (2 * outWidth + 4 * outChroma + 2));
+  if (line == nullptr) return false;
+  uint32_t* sums = (uint32_t*) ((uint8_t*) line + lineBytes);
+  uint16_t* y = line;
+  uint16_t* cb = y + width + UNPACK_PADDING;
+  uint16_t* cr = cb + chromaWidth + UNPACK_PADDING;
+  uint16_t* outY = cr + chromaWidth + UNPACK_PADDING;
+  uint16_t* outCb = outY + outWidth + UNPACK_PADDING;
+  uint16_t* outCr = outCb + outChroma + UNPACK_PADDING;
+  uint16_t* r = outCr + outChroma + UNPACK_PADDING;
+  uint16_t* g = r + outWidth + 1;
+  uint16_t* b = g + outWidth + 1;
+  uint32_t* accY = sums;
+  uint32_t* accCb = accY + outWidth;
+  uint32_t* accCr = accCb + outChroma;
+  uint32_t* lumaStarts = accCr + outChroma;
+  uint32_t* chromaStarts = lumaStarts + outWidth + 1;
+  for ( uint32_t o = 0 ; o <= outWidth ; o++ ) {
+    lumaStarts[o] = (uint32_t) (((uint64_t) o * width) / outWidth);
+  }
+  for ( uint32_t o = 0 ; o <= outChroma ; o++ ) {
+    chromaStarts[o] = (uint32_t) (((uint64_t) o * chromaWidth) / outChroma);
+  }
+  // Chosen by the source size, as the colour space does not change with scale
+  const colourMatrix& matrix = (height > 576) ? bt709 : bt601;
+
+  uint32_t row = 0;
+  for ( uint32_t outRow = 0 ; outRow < outHeight ; outRow++ ) {
+    uint32_t rowEnd = (uint32_t) (((uint64_t) (outRow + 1) * height) / outHeight);
+    uint32_t rows = rowEnd - row;
+    memset(accY, 0, sizeof(uint32_t) * (outWidth + 2 * outChroma));
+    for ( ; row < rowEnd ; row++ ) {
+      unpack(src + row * srcRowBytes, y, cb, cr, width);
+      if (box != nullptr) {
+        box(y, outWidth, accY);
+        box(cb, outChroma, accCb);
+        box(cr, outChroma, accCr);
+      } else {
+        spanLine(y, lumaStarts, outWidth, accY);
+        spanLine(cb, chromaStarts, outChroma, accCb);
+        spanLine(cr, chromaStarts, outChroma, accCr);
+      }
+    }
+    averageLine(accY, lumaStarts, outWidth, rows, outY);
+    averageLine(accCb, chromaStarts, outChroma, rows, outCb);
+    averageLine(accCr, chromaStarts, outChroma, rows, outCr);
+    layoutLine(to, matrix, outY, outCb, outCr, outWidth, outHeight, outRow, r, g, b, dst);
+  }
+
+  return true;
+}
+
+static swizzleKernel selectedSwizzle = swizzleScalar;
+static const char* selectedSwizzleName = "scalar";
+
+void selectPixelKernels() {
+  #ifdef MACADAM_X86
+  if (cpuHasSSSE3()) {
+    selectedV210 = unpackV210SSSE3;
+    selected2vuy = unpack2vuySSSE3;
+  }
+  if (cpuHasAVX2()) {
+    selectedRGBA = rgbaLineAutoAVX2;
+    selectedRGB48 = rgb48LineAutoAVX2;
+    selectedBox[0] = boxLine1AutoAVX2;
+    selectedBox[1] = boxLine2AutoAVX2;
+    selectedBox[2] = boxLine4AutoAVX2;
+    selectedBox[3] = boxLine8AutoAVX2;
+  }
+  #endif
+  #ifdef MACADAM_NEON
+  selected2vuy = unpack2vuyNEON;
+  #endif
+
+  static const char* preference[] = { "avx2", "ssse3", "neon", nullptr };
+  for ( int x = 0 ; preference[x] != nullptr ; x++ ) {
+    swizzleKernel kernel = getSwizzleKernel(preference[x]);
+    if (kernel != nullptr) {
+      selectedSwizzle = kernel;
+      selectedSwizzleName = preference[x];
+      return;
+    }
+  }
+}
+
+void swizzleBGRAtoRGBA(uint8_t* data, size_t bytes) {
+  selectedSwizzle(data, bytes);
+}
+
+const char* swizzleKernelName() {
+  return selectedSwizzleName;
+}
+
+swizzleKernel getSwizzleKernel(const char* name) {
+  if (strcmp(name, "scalar") == 0) return swizzleScalar;
+  #ifdef MACADAM_X86
+  if ((strcmp(name, "ssse3") == 0) && cpuHasSSSE3()) return swizzleSSSE3;
+  if ((strcmp(name, "avx2") == 0) && cpuHasAVX2()) return swizzleAVX2;
+  #endif
+  #ifdef MACADAM_NEON
+  if (strcmp(name, "neon") == 0) return swizzleNEON;
+  #endif
+  return nullptr;
+}
+
+// swizzleBGRA(buffer[, kernel]) - swizzles a buffer in place, returning the
+// name of the kernel used. The kernel may be named to compare implementations.
+napi_value swizzleBGRA(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[2];
+  napi_value result;
+  napi_valuetype type;
+  size_t argc = 2;
+  bool isBuffer;
+  void* data;
+  size_t dataSize;
+  swizzleKernel kernel = selectedSwizzle;
+  const char* kernelName = selectedSwizzleName;
+  char name[16];
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("A buffer of BGRA pixels must be provided to swizzle.");
+
+  status = napi_is_buffer(env, argv[0], &isBuffer);
+  CHECK_STATUS;
+  if (!isBuffer) NAPI_THROW_ERROR("Pixel data must be provided as a node buffer.");
+  status = napi_get_buffer_info(env, argv[0], &data, &dataSize);
+  CHECK_STATUS;
+
+  if (argc >= 2) {
+    status = napi_typeof(env, argv[1], &type);
+    CHECK_STATUS;
+    if (type != napi_undefined) {
+      if (type != napi_string) NAPI_THROW_ERROR("Kernel name must be a string.");
+      status = napi_get_value_string_utf8(env, argv[1], name, sizeof(name), nullptr);
+      CHECK_STATUS;
+      kernel = getSwizzleKernel(name);
+      if (kernel == nullptr) NAPI_THROW_ERROR("Requested kernel is not available on this CPU.");
+      kernelName = name;
+    }
+  }
+
+  kernel((uint8_t*) data, dataSize);
+
+  status = napi_create_string_utf8(env, kernelName, NAPI_AUTO_LENGTH, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+// convertPixels(buffer, options) - converts a whole 2vuy or v210 frame to a
+// new buffer, with options pixelFormat, width, height, convertTo and, if the
+// source lines are padded beyond the format's usual size, rowBytes. With
+// outWidth and outHeight, the frame is also downscaled to that size.
+napi_value convertPixels(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[2];
+  napi_value result, param;
+  napi_valuetype type;
+  size_t argc = 2;
+  bool isBuffer;
+  void* data;
+  void* resultData;
+  size_t dataSize;
+  BMDPixelFormat pixelFormat;
+  uint32_t width, height, rowBytes, outWidth, outHeight;
+  uint64_t minRowBytes, frameBytes;
+  macadamPixelLayout layout;
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 2) NAPI_THROW_ERROR("A buffer and conversion options must be provided.");
+
+  status = napi_is_buffer(env, argv[0], &isBuffer);
+  CHECK_STATUS;
+  if (!isBuffer) NAPI_THROW_ERROR("Pixel data must be provided as a node buffer.");
+  status = napi_get_buffer_info(env, argv[0], &data, &dataSize);
+  CHECK_STATUS;
+  status = napi_typeof(env, argv[1], &type);
+  CHECK_STATUS;
+  if (type != napi_object) NAPI_THROW_ERROR("Conversion options must be an object.");
+
+  status = napi_get_named_property(env, argv[1], "pixelFormat", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, (uint32_t*) &pixelFormat);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Pixel format must be an enumeration value.");
+  CHECK_STATUS;
+  if (!canConvertPixels(pixelFormat))
+    NAPI_THROW_ERROR("Only 8-bit and 10-bit YUV pixel formats can be converted.");
+
+  status = napi_get_named_property(env, argv[1], "width", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, &width);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Width must be a number.");
+  CHECK_STATUS;
+  status = napi_get_named_property(env, argv[1], "height", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, &height);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Height must be a number.");
+  CHECK_STATUS;
+  if ((width == 0) || (height == 0)) NAPI_THROW_ERROR("Width and height must be greater than zero.");
+
+  minRowBytes = pixelFormatMinRowBytes(pixelFormat, width);
+  if (minRowBytes > UINT32_MAX) NAPI_THROW_ERROR("Width is too large.");
+  rowBytes = (uint32_t) minRowBytes;
+  status = napi_get_named_property(env, argv[1], "rowBytes", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_undefined) {
+    if (type != napi_number) NAPI_THROW_ERROR("Row bytes must be a number.");
+    status = napi_get_value_uint32(env, param, &rowBytes);
+    CHECK_STATUS;
+  }
+  if (rowBytes < minRowBytes)
+    NAPI_THROW_ERROR("Row bytes is too small for the width and pixel format.");
+  if ((uint64_t) rowBytes * height > dataSize)
+    NAPI_THROW_ERROR("Buffer is too small for the given dimensions and pixel format.");
+
+  status = napi_get_named_property(env, argv[1], "convertTo", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_string) NAPI_THROW_ERROR(
+    "Conversion target must be a string, one of 'rgba', 'rgb48', 'yuv422p10' or 'uyvy'.");
+  status = parsePixelLayout(env, param, &layout);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR(
+    "Conversion target must be one of 'rgba', 'rgb48', 'yuv422p10' or 'uyvy'.");
+  CHECK_STATUS;
+
+  outWidth = width;
+  outHeight = height;
+  status = napi_get_named_property(env, argv[1], "outWidth", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_undefined) {
+    if (type != napi_number) NAPI_THROW_ERROR("Output width must be a number.");
+    status = napi_get_value_uint32(env, param, &outWidth);
+    CHECK_STATUS;
+  }
+  status = napi_get_named_property(env, argv[1], "outHeight", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_undefined) {
+    if (type != napi_number) NAPI_THROW_ERROR("Output height must be a number.");
+    status = napi_get_value_uint32(env, param, &outHeight);
+    CHECK_STATUS;
+  }
+
+  if ((outWidth == width) && (outHeight == height)) {
+    frameBytes = pixelLayoutFrameBytes(layout, width, height);
+    if (frameBytes == 0) NAPI_THROW_ERROR("Converted frame would be too large.");
+    status = napi_create_buffer(env, frameBytes, &resultData, &result);
+    CHECK_STATUS;
+    if (!convertPixelLayout(pixelFormat, (const uint8_t*) data, rowBytes, width, height,
+        layout, (uint8_t*) resultData))
+      NAPI_THROW_ERROR("Failed to convert pixels.");
+    return result;
+  }
+
+  if ((outWidth == 0) || (outHeight == 0) || ((outWidth & 1) != 0) ||
+      (outWidth > width) || (outHeight > height))
+    NAPI_THROW_ERROR("Output width must be even and the output no larger than the source.");
+  frameBytes = pixelLayoutFrameBytes(layout, outWidth, outHeight);
+  if (frameBytes == 0) NAPI_THROW_ERROR("Scaled frame would be too large.");
+  status = napi_create_buffer(env, frameBytes, &resultData, &result);
+  CHECK_STATUS;
+  if (!scalePixelLayout(pixelFormat, (const uint8_t*) data, rowBytes, width, height,
+      outWidth, outHeight, layout, (uint8_t*) resultData))
+    NAPI_THROW_ERROR("Failed to scale pixels.");
+
+  return result;
+}
+
+// Packs a line of v210 from 10-bit components, as the reverse of unpackV210Scalar
+static void packV210Line(const uint16_t* y, const uint16_t* cb, const uint16_t* cr,
+    uint32_t width, uint8_t* dst) {
+  for ( uint32_t x = 0 ; x < width ; x += 6, dst += 16, y += 6, cb += 3, cr += 3 ) {
+    uint32_t w[4] = {
+      (uint32_t) cb[0] | ((uint32_t) y[0] << 10) | ((uint32_t) cr[0] << 20),
+      (uint32_t) y[1] | ((uint32_t) cb[1] << 10) | ((uint32_t) y[2] << 20),
+      (uint32_t) cr[1] | ((uint32_t) y[3] << 10) | ((uint32_t) cb[2] << 20),
+      (uint32_t) y[4] | ((uint32_t) cr[2] << 10) | ((uint32_t) y[5] << 20) };
+    memcpy(dst, w, 16);
+  }
+}
+
+static bool near(int32_t a, int32_t b, int32_t tolerance) {
+  return (a - b <= tolerance) && (b - a <= tolerance);
+}
+
+// Checks the unpack kernels against the scalar versions on random lines, and
+// conversion of known colours from synthetic v210 and 2vuy frames
+static bool unpackTests() {
+  bool pass = true;
+  const uint32_t width = 1920 + 6;
+  uint16_t* ref = (uint16_t*) calloc(6 * (width + UNPACK_PADDING), sizeof(uint16_t));
+  uint16_t* test = ref + 3 * (width + UNPACK_PADDING);
+  uint8_t* src = (uint8_t*) malloc(((width + 47) / 48) * 128);
+  for ( uint32_t x = 0 ; x < ((width + 47) / 48) * 128 ; x++ ) src[x] = (uint8_t) rand();
+
+  struct { unpackKernel scalar; unpackKernel simd; } kernels[] = {
+    #ifdef MACADAM_X86
+    { unpackV210Scalar, cpuHasSSSE3() ? unpackV210SSSE3 : nullptr },
+    { unpack2vuyScalar, cpuHasSSSE3() ? unpack2vuySSSE3 : nullptr },
+    #endif
+    #ifdef MACADAM_NEON
+    { unpack2vuyScalar, unpack2vuyNEON },
+    #endif
+    { unpackV210Scalar, selectedV210 },
+    { unpack2vuyScalar, selected2vuy }
+  };
+  for ( size_t k = 0 ; k < sizeof(kernels) / sizeof(kernels[0]) ; k++ ) {
+    if (kernels[k].simd == nullptr) continue;
+    for ( uint32_t w = width - 11 ; w <= width ; w++ ) { // Cover each ragged end
+      uint16_t* r = ref;
+      uint16_t* t = test;
+      uint32_t c = (w + 1) >> 1;
+      kernels[k].scalar(src, r, r + width + UNPACK_PADDING, r + 2 * (width + UNPACK_PADDING), w);
+      kernels[k].simd(src, t, t + width + UNPACK_PADDING, t + 2 * (width + UNPACK_PADDING), w);
+      pass = pass && (memcmp(r, t, w * 2) == 0);
+      pass = pass && (memcmp(r + width + UNPACK_PADDING, t + width + UNPACK_PADDING, c * 2) == 0);
+      pass = pass && (memcmp(r + 2 * (width + UNPACK_PADDING), t + 2 * (width + UNPACK_PADDING), c * 2) == 0);
+    }
+  }
+
+  {
+    // Selected matrix kernels against the generic build of the same code, for
+    // each ragged end. Chroma is copied for each call, as the kernels pad it.
+    uint16_t* planes = (uint16_t*) malloc(sizeof(uint16_t) * 10 * (width + 1));
+    uint8_t* out = (uint8_t*) malloc(12 * width);
+    uint16_t* y = ref;
+    uint16_t* cb = planes + 6 * (width + 1);
+    uint16_t* cr = planes + 8 * (width + 1);
+    unpackV210Scalar(src, y, ref + width + UNPACK_PADDING, ref + 2 * (width + UNPACK_PADDING), width);
+    struct { rgbLineKernel scalar; rgbLineKernel selected; const colourMatrix& matrix;
+      uint32_t pixelBytes; } matrixKernels[] = {
+      { rgbaLineDefault, selectedRGBA, bt709, 4 },
+      { rgb48LineDefault, selectedRGB48, bt601, 6 }
+    };
+    for ( size_t k = 0 ; k < sizeof(matrixKernels) / sizeof(matrixKernels[0]) ; k++ ) {
+      for ( uint32_t w = width - 11 ; w <= width ; w++ ) {
+        uint32_t c = (w + 1) >> 1;
+        memcpy(cb, ref + width + UNPACK_PADDING, 2 * c);
+        memcpy(cr, ref + 2 * (width + UNPACK_PADDING), 2 * c);
+        matrixKernels[k].scalar(matrixKernels[k].matrix, y, cb, cr, w,
+          planes, planes + width + 1, planes + 2 * (width + 1), out);
+        memcpy(cb, ref + width + UNPACK_PADDING, 2 * c);
+        memcpy(cr, ref + 2 * (width + UNPACK_PADDING), 2 * c);
+        matrixKernels[k].selected(matrixKernels[k].matrix, y, cb, cr, w, planes + 3 * (width + 1),
+          planes + 4 * (width + 1), planes + 5 * (width + 1), out + 6 * width);
+        pass = pass && (memcmp(out, out + 6 * width, matrixKernels[k].pixelBytes * w) == 0);
+      }
+    }
+    free(planes);
+    free(out);
+  }
+
+  // Selected box kernels against the generic build, on source lines of 10-bit values
+  {
+    boxLineKernel scalar[4] = { boxLine1Default, boxLine2Default, boxLine4Default, boxLine8Default };
+    uint16_t* in = ref;
+    uint32_t* acc = (uint32_t*) calloc(2 * width, sizeof(uint32_t));
+    for ( uint32_t x = 0 ; x < width ; x++ ) in[x] = (uint16_t) (rand() & 0x3ff);
+    for ( int k = 0 ; k < 4 ; k++ ) {
+      for ( uint32_t outCount = (width >> k) - 11 ; outCount <= (width >> k) ; outCount++ ) {
+        memset(acc, 0, 2 * width * sizeof(uint32_t));
+        scalar[k](in, outCount, acc);
+        selectedBox[k](in, outCount, acc + width);
+        pass = pass && (memcmp(acc, acc + width, outCount * sizeof(uint32_t)) == 0);
+      }
+    }
+    free(acc);
+  }
+
+  free(ref);
+  free(src);
+
+  // BT.709 colours as 10-bit limited range Y, Cb, Cr, and the expected 8-bit RGB
+  static const uint16_t colours[][6] = {
+    { 940, 512, 512, 255, 255, 255 }, // White
+    { 64, 512, 512, 0, 0, 0 }, // Black
+    { 250, 409, 960, 255, 0, 0 }, // Red
+    { 691, 167, 105, 0, 255, 0 }, // Green
+    { 127, 960, 471, 0, 0, 255 } // Blue
+  };
+  const uint32_t cw = 12, ch = 720; // HD height selects BT.709
+  uint32_t v210Row = ((cw + 47) / 48) * 128;
+  uint16_t y[cw], cb[cw / 2], cr[cw / 2];
+  uint8_t* v210 = (uint8_t*) calloc(v210Row * ch, 1);
+  uint8_t* uyvy = (uint8_t*) calloc(2 * cw * ch, 1);
+  uint8_t* rgba = (uint8_t*) malloc(pixelLayoutRowBytes(macadamLayoutRGBA, cw) * ch);
+  uint8_t* planar = (uint8_t*) malloc(pixelLayoutRowBytes(macadamLayoutYUV422P10, cw) * ch);
+  uint16_t* rgb48 = (uint16_t*) malloc(pixelLayoutRowBytes(macadamLayoutRGB48, cw) * ch);
+
+  for ( size_t c = 0 ; c < sizeof(colours) / sizeof(colours[0]) ; c++ ) {
+    for ( uint32_t x = 0 ; x < cw ; x++ ) y[x] = colours[c][0];
+    for ( uint32_t x = 0 ; x < cw / 2 ; x++ ) { cb[x] = colours[c][1]; cr[x] = colours[c][2]; }
+    for ( uint32_t row = 0 ; row < ch ; row++ ) {
+      packV210Line(y, cb, cr, cw, v210 + row * v210Row);
+      for ( uint32_t x = 0 ; x < cw ; x += 2 ) {
+        uint8_t* p = uyvy + row * 2 * cw + 2 * x;
+        p[0] = cb[x / 2] >> 2; p[1] = y[x] >> 2; p[2] = cr[x / 2] >> 2; p[3] = y[x + 1] >> 2;
+      }
+    }
+
+    pass = pass && convertPixelLayout(bmdFormat10BitYUV, v210, v210Row, cw, ch, macadamLayoutRGBA, rgba);
+    for ( uint32_t x = 0 ; x < cw * ch ; x++ ) {
+      pass = pass && near(rgba[4 * x], colours[c][3], 1) && near(rgba[4 * x + 1], colours[c][4], 1) &&
+        near(rgba[4 * x + 2], colours[c][5], 1) && (rgba[4 * x + 3] == 255);
+    }
+    pass = pass && convertPixelLayout(bmdFormat8BitYUV, uyvy, 2 * cw, cw, ch, macadamLayoutRGBA, rgba);
+    for ( uint32_t x = 0 ; x < cw * ch ; x++ ) {
+      pass = pass && near(rgba[4 * x], colours[c][3], 2) && near(rgba[4 * x + 1], colours[c][4], 2) &&
+        near(rgba[4 * x + 2], colours[c][5], 2);
+    }
+    pass = pass && convertPixelLayout(bmdFormat10BitYUV, v210, v210Row, cw, ch, macadamLayoutRGB48, (uint8_t*) rgb48);
+    pass = pass && near(rgb48[0], colours[c][3] * 257, 300) && near(rgb48[1], colours[c][4] * 257, 300) &&
+      near(rgb48[2], colours[c][5] * 257, 300);
+    pass = pass && convertPixelLayout(bmdFormat10BitYUV, v210, v210Row, cw, ch, macadamLayoutYUV422P10, planar);
+    uint16_t* py = (uint16_t*) planar;
+    uint16_t* pcb = py + cw * ch;
+    uint16_t* pcr = pcb + (cw / 2) * ch;
+    pass = pass && (py[cw * ch - 1] == colours[c][0]) && (pcb[(cw / 2) * ch - 1] == colours[c][1]) &&
+      (pcr[0] == colours[c][2]);
+  }
+
+  pass = pass && !convertPixelLayout(bmdFormat8BitBGRA, v210, v210Row, cw, ch, macadamLayoutRGBA, rgba);
+
+  free(v210);
+  free(uyvy);
+  free(rgba);
+  free(planar);
+  free(rgb48);
+  return pass;
+}
+
+// Checks the box kernels against spans of the same size, and that a flat
+// frame keeps its colour when scaled by whole and fractional factors
+static bool scaleTests() {
+  bool pass = true;
+  const uint32_t outCount = 243;
+  uint16_t* in = (uint16_t*) malloc(sizeof(uint16_t) * 8 * outCount);
+  uint32_t* starts = (uint32_t*) malloc(sizeof(uint32_t) * (outCount + 1));
+  uint32_t* ref = (uint32_t*) calloc(2 * outCount, sizeof(uint32_t));
+  uint32_t* test = ref + outCount;
+  for ( uint32_t x = 0 ; x < 8 * outCount ; x++ ) in[x] = rand() & 0x3ff;
+
+  for ( uint32_t k = 0 ; k < 4 ; k++ ) {
+    uint32_t factor = 1 << k;
+    for ( uint32_t o = 0 ; o <= outCount ; o++ ) starts[o] = o * factor;
+    memset(ref, 0, sizeof(uint32_t) * 2 * outCount);
+    spanLine(in, starts, outCount, ref);
+    selectedBox[k](in, outCount, test);
+    pass = pass && (memcmp(ref, test, sizeof(uint32_t) * outCount) == 0);
+  }
+
+  const uint32_t width = 1920, height = 1080;
+  uint32_t rowBytes = ((width + 47) / 48) * 128;
+  uint8_t* frame = (uint8_t*) malloc(rowBytes * height);
+  uint16_t* y = (uint16_t*) malloc(sizeof(uint16_t) * width * 2);
+  uint16_t* cb = y + width;
+  uint16_t* cr = cb + width / 2;
+  for ( uint32_t x = 0 ; x < width ; x++ ) y[x] = 250;
+  for ( uint32_t x = 0 ; x < width / 2 ; x++ ) { cb[x] = 409; cr[x] = 960; }
+  packV210Line(y, cb, cr, width, frame);
+  for ( uint32_t row = 1 ; row < height ; row++ ) memcpy(frame + row * rowBytes, frame, rowBytes);
+  uint8_t* scaled = (uint8_t*) malloc(pixelLayoutRowBytes(macadamLayoutRGBA, width / 2) * height / 2);
+  static const uint32_t sizes[][2] = { { 960, 540 }, { 480, 270 }, { 240, 135 }, { 320, 180 } };
+  for ( uint32_t s = 0 ; s < 4 ; s++ ) {
+    uint32_t outWidth = sizes[s][0], outHeight = sizes[s][1];
+    pass = pass && scalePixelLayout(bmdFormat10BitYUV, frame, rowBytes, width, height,
+      outWidth, outHeight, macadamLayoutRGBA, scaled);
+    uint8_t* last = scaled + (outWidth * outHeight - 1) * 4;
+    pass = pass && (scaled[0] == 255) && (scaled[1] == 0) && (scaled[2] == 0) &&
+      (last[0] == 255) && (last[1] == 0) && (last[2] == 0);
+    pass = pass && scalePixelLayout(bmdFormat10BitYUV, frame, rowBytes, width, height,
+      outWidth, outHeight, macadamLayoutUYVY, scaled);
+    last = scaled + (outWidth * outHeight - 2) * 2;
+    pass = pass && (scaled[0] == 409 >> 2) && (scaled[1] == 250 >> 2) &&
+      (scaled[2] == 960 >> 2) && (last[3] == 250 >> 2);
+  }
+  pass = pass && !scalePixelLayout(bmdFormat10BitYUV, frame, rowBytes, width, height,
+    241, 135, macadamLayoutRGBA, scaled);
+
+  free(in);
+  free(starts);
+  free(ref);
+  free(frame);
+  free(y);
+  free(scaled);
+  return pass;
+}
+
+// Compares every available kernel with the scalar reference on random
+// buffers, including lengths that leave a tail for the scalar loop.
+napi_value pixelConvertTest(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  bool pass = true;
+  static const char* kernels[] = { "ssse3", "avx2", "neon", nullptr };
+  static const size_t sizes[] = { 0, 4, 60, 64, 68, 252, 1920 * 4 + 12, 1920 * 1080 * 4 };
+
+  srand(42);
+  for ( size_t s = 0 ; s < sizeof(sizes) / sizeof(size_t) ; s++ ) {
+    size_t size = sizes[s];
+    // Offset by one byte so unaligned access is exercised too
+    uint8_t* source = (uint8_t*) malloc(size + 1);
+    uint8_t* reference = (uint8_t*) malloc(size + 1);
+    uint8_t* test = (uint8_t*) malloc(size + 1);
+    for ( size_t x = 0 ; x < size + 1 ; x++ ) source[x] = (uint8_t) rand();
+    memcpy(reference, source, size + 1);
+    swizzleScalar(reference + 1, size);
+
+    pass = pass && (size < 4 || (reference[1] == source[3] && reference[3] == source[1] &&
+      reference[2] == source[2] && reference[4] == 255));
+
+    for ( int k = 0 ; kernels[k] != nullptr ; k++ ) {
+      swizzleKernel kernel = getSwizzleKernel(kernels[k]);
+      if (kernel == nullptr) continue;
+      memcpy(test, source, size + 1);
+      kernel(test + 1, size);
+      pass = pass && (memcmp(test, reference, size + 1) == 0);
+    }
+    memcpy(test, source, size + 1);
+    swizzleBGRAtoRGBA(test + 1, size);
+    pass = pass && (memcmp(test, reference, size + 1) == 0);
+
+    free(source);
+    free(reference);
+    free(test);
+  }
+
+  pass = pass && unpackTests();
+  pass = pass && scaleTests();
+
+  status = napi_get_boolean(env, pass, &result);
+  CHECK_STATUS;
+  return result;
+}
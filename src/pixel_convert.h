@@ -0,0 +1,105 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "node_api.h"
+#include "DeckLinkAPI.h"
+
+// Swaps the red and blue channels of 8-bit BGRA pixels in place, producing
+// RGBA with an opaque alpha channel. bytes is rounded down to whole pixels.
+typedef void (*swizzleKernel)(uint8_t* data, size_t bytes);
+
+// Select the fastest kernels supported by the CPU. Called once at module load.
+void selectPixelKernels();
+
+// Kernel chosen by selectPixelKernels, or the scalar reference if not yet run
+void swizzleBGRAtoRGBA(uint8_t* data, size_t bytes);
+const char* swizzleKernelName();
+
+// Named kernel - "scalar", "ssse3", "avx2" or "neon" - or nullptr when the
+// kernel is not built into this binary or not supported by the CPU
+swizzleKernel getSwizzleKernel(const char* name);
+
+// Unpacking of a line of YUV 4:2:2 into 16-bit planar Y, Cb and Cr holding
+// 10-bit values. Kernels may write up to 16 values past the end of each line.
+typedef void (*unpackKernel)(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width);
+
+#define UNPACK_PADDING 16
+
+// Kernel chosen by selectPixelKernels for 2vuy or v210, otherwise nullptr
+unpackKernel getUnpackKernel(BMDPixelFormat from);
+
+// Layouts that 8-bit (2vuy) and 10-bit (v210) YUV frames can be converted to
+// natively, without IDeckLinkVideoConversion. RGB outputs use the BT.709
+// matrix for HD and BT.601 for SD, treating the input as limited range.
+typedef uint32_t macadamPixelLayout;
+enum _macadamPixelLayout {
+  macadamLayoutNone = 0,
+  macadamLayoutRGBA = 1, // 8-bit RGBA, alpha 255
+  macadamLayoutRGB48 = 2, // 16-bit little-endian RGB
+  macadamLayoutYUV422P10 = 3, // 16-bit little-endian Y, Cb and Cr planes
+  macadamLayoutUYVY = 4 // 8-bit Cb Y0 Cr Y1, as bmdFormat8BitYUV
+};
+
+// Largest frame that conversions will allocate, as for a node buffer
+#define MACADAM_MAX_FRAME_BYTES 0x7fffffffULL
+
+// Line buffers for whole frame conversions, grown as needed and kept between
+// frames so that each conversion worker reuses its own. Not thread safe.
+class pixelScratch {
+  void* buffer = nullptr;
+  size_t size = 0;
+
+  public:
+    pixelScratch() {}
+    ~pixelScratch();
+    pixelScratch(const pixelScratch&) = delete;
+    pixelScratch& operator=(const pixelScratch&) = delete;
+    // At least bytes of memory, or nullptr if that cannot be allocated
+    void* get(size_t bytes);
+};
+
+// Parse 'rgba', 'rgb48', 'yuv422p10' or 'uyvy', returning napi_invalid_arg otherwise
+napi_status parsePixelLayout(napi_env env, napi_value value, macadamPixelLayout* layout);
+const char* pixelLayoutName(macadamPixelLayout layout);
+bool canConvertPixels(BMDPixelFormat from);
+// Bytes per line summed over all planes, so that the frame is rowBytes * height
+uint32_t pixelLayoutRowBytes(macadamPixelLayout layout, uint32_t width);
+// Bytes of a whole frame in the given layout, or 0 if that is larger than
+// MACADAM_MAX_FRAME_BYTES
+uint64_t pixelLayoutFrameBytes(macadamPixelLayout layout, uint32_t width, uint32_t height);
+// Smallest rowBytes of a source line in a convertible format
+uint64_t pixelFormatMinRowBytes(BMDPixelFormat from, uint32_t width);
+// Converts a whole frame. Returns false if the source format is not supported.
+// Without scratch, line buffers are allocated for the call.
+bool convertPixelLayout(BMDPixelFormat from, const uint8_t* src, uint32_t srcRowBytes,
+  uint32_t width, uint32_t height, macadamPixelLayout to, uint8_t* dst,
+  pixelScratch* scratch = nullptr);
+// Downscales a whole frame, averaging the source pixels that each output
+// pixel covers. outWidth must be even and neither output dimension may be
+// larger than the source. Returns false if the arguments are not supported.
+bool scalePixelLayout(BMDPixelFormat from, const uint8_t* src, uint32_t srcRowBytes,
+  uint32_t width, uint32_t height, uint32_t outWidth, uint32_t outHeight,
+  macadamPixelLayout to, uint8_t* dst, pixelScratch* scratch = nullptr);
+
+napi_value swizzleBGRA(napi_env env, napi_callback_info info);
+napi_value convertPixels(napi_env env, napi_callback_info info);
+napi_value pixelConvertTest(napi_env env, napi_callback_info info);
+
+#endif // PIXEL_CONVERT_H
@@ -45,7 +45,7 @@
 HRESULT playbackThreadsafe::ScheduledFrameCompleted(
   IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result) {
 
-  macadamFrame* frame = (macadamFrame*) completedFrame;
+  macadamFrame* frame;
   napi_status status, hangover;
 
   status = napi_acquire_threadsafe_function(tsFn);
@@ -54,17 +54,48 @@ HRESULT playbackThreadsafe::ScheduledFrameCompleted(
     return E_FAIL;
   }
 
-  frame->deckLinkOutput->GetFrameCompletionReferenceTimestamp(frame, frame->timeScale,
-    &frame->completionTimestamp);
+  outputPoolFrame* pooled = (outputPool != nullptr) ? outputPool->find(completedFrame) : nullptr;
+  if (pooled != nullptr) {
+    // Carry the result of a pooled frame to the main thread, recycling the frame now
+    frame = new macadamFrame;
+    frame->scheduledTime = pooled->scheduledTime;
+    frame->timeScale = timeScale;
+    frame->deckLinkOutput = deckLinkOutput;
+    frame->tc = timecode;
+    deckLinkOutput->GetFrameCompletionReferenceTimestamp(completedFrame, timeScale,
+      &frame->completionTimestamp);
+    outputPool->recycle(pooled);
+  } else {
+    frame = (macadamFrame*) completedFrame;
+    frame->deckLinkOutput->GetFrameCompletionReferenceTimestamp(frame, frame->timeScale,
+      &frame->completionTimestamp);
+  }
   frame->result = result;
 
   if (frame->tc != nullptr) {
     frame->tc->Update();
   }
 
-  hangover = napi_call_threadsafe_function(tsFn, frame, napi_tsfn_nonblocking);
+  if (frame->playout) {
+    std::lock_guard<std::mutex> lock(playoutLock);
+    playoutScheduled--;
+    // Ran dry, with nothing left for the driver, before the end of the stream
+    if ((playoutScheduled == 0) && playoutQueue.empty() && !playoutStopping && !playoutEnded)
+      playoutUnderruns++;
+    fillPlayout();
+  }
+
+  hangover = napi_call_threadsafe_function(tsFn, frame,
+    callbackQueueBlocking ? napi_tsfn_blocking : napi_tsfn_nonblocking);
   if (hangover != napi_ok) {
-    printf("DEBUG: Failed to call NAPI threadsafe function on scheduled frame completion.");
+    if (hangover == napi_queue_full) {
+      callbackQueueFull++;
+    } else {
+      callbackFailures++;
+      printf("DEBUG: Failed to call NAPI threadsafe function on scheduled frame completion.");
+    }
+    std::lock_guard<std::mutex> lock(missedLock);
+    missedCompletions.push_back(frame);
   }
 
   status = napi_release_threadsafe_function(tsFn, napi_tsfn_release);
@@ -77,6 +108,147 @@ HRESULT playbackThreadsafe::ScheduledFrameCompleted(
   return S_OK;
 }
 
+// Schedules waiting frames at consecutive times until playoutDepth frames are
+// with the driver, then asks JS for more if few are left waiting. Called with
+// playoutLock held.
+void playbackThreadsafe::fillPlayout() {
+  HRESULT hresult;
+  napi_status status;
+  BMDTimeValue streamTime;
+  double speed;
+  uint32_t sampleFramesWritten;
+
+  if (playoutStopping) return;
+  while ((playoutScheduled < playoutDepth) && !playoutQueue.empty()) {
+    macadamFrame* frame = playoutQueue.front();
+    if (started && (playoutScheduled == 0) &&
+        (deckLinkOutput->GetScheduledStreamTime(timeScale, &streamTime, &speed) == S_OK) &&
+        (nextPlayoutTime <= streamTime)) {
+      // Ran dry, so carry on a frame ahead of the output rather than late
+      BMDTimeValue resumeTime = (streamTime / frameDuration + 2) * frameDuration;
+      playoutSkipped += (resumeTime - nextPlayoutTime) / frameDuration;
+      nextPlayoutTime = resumeTime;
+    }
+    frame->scheduledTime = nextPlayoutTime;
+    hresult = deckLinkOutput->ScheduleVideoFrame(frame, frame->scheduledTime,
+      frameDuration, timeScale);
+    if (hresult != S_OK) { // Try again on the next completion or enqueue()
+      playoutFailures++;
+      break;
+    }
+    if (frame->audioData != nullptr) {
+      hresult = deckLinkOutput->ScheduleAudioSamples(frame->audioData, frame->sampleFrameCount,
+        frame->scheduledTime, timeScale, &sampleFramesWritten);
+      if (hresult != S_OK) sampleFramesWritten = 0;
+      // Samples the driver could not take are lost, so are counted
+      if (sampleFramesWritten < frame->sampleFrameCount) {
+        playoutAudioDropped += frame->sampleFrameCount - sampleFramesWritten;
+        audioShortWrites++;
+      }
+    }
+    playoutQueue.pop_front();
+    nextPlayoutTime += frameDuration;
+    playoutScheduled++;
+    playoutFrames++;
+  }
+
+  if (!refillPending && !playoutEnded && (playoutQueue.size() <= playoutLowWater) &&
+      (refillTsFn != nullptr)) {
+    uint32_t wanted = playoutQueueSize - (uint32_t) playoutQueue.size();
+    status = napi_call_threadsafe_function(refillTsFn, (void*) (uintptr_t) wanted,
+      napi_tsfn_nonblocking);
+    if (status == napi_ok) {
+      refillPending = true;
+      playoutRefills++;
+    }
+  }
+}
+
+// Runs on the copy worker. Copies a frame from schedule() into its pooled
+// frame and schedules it, then passes the result to the main thread.
+void playbackThreadsafe::copyFrame(outputCopy* copy) {
+  napi_status status;
+
+  if (copyStopping) {
+    copy->result = E_ABORT;
+  } else {
+    auto start = std::chrono::high_resolution_clock::now();
+    copyFrameBytes(copy->frame->bytes, copy->src, copy->size);
+    copy->copyMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::high_resolution_clock::now() - start).count();
+    outputPool->recordCopy(copy->copyMicros);
+    if (copy->hasTimecode) {
+      copy->frame->video->SetTimecodeFromComponents(copy->timecodeFormat, copy->hours,
+        copy->minutes, copy->seconds, copy->frames, copy->timecodeFlags);
+    }
+    copy->result = deckLinkOutput->ScheduleVideoFrame(copy->frame->video,
+      copy->frame->scheduledTime, frameDuration, timeScale);
+  }
+  if (copy->result != S_OK) {
+    outputPool->recycle(copy->frame);
+  } else if (copy->audio != nullptr) { // Only once its video is scheduled
+    uint32_t sampleFramesWritten;
+    copy->audioResult = deckLinkOutput->ScheduleAudioSamples(copy->audio,
+      copy->sampleFrameCount, copy->frame->scheduledTime, timeScale, &sampleFramesWritten);
+    if ((copy->audioResult == S_OK) && (sampleFramesWritten < copy->sampleFrameCount))
+      audioShortWrites++;
+  }
+
+  status = napi_call_threadsafe_function(copyTsFn, copy, napi_tsfn_blocking);
+  if (status != napi_ok) {
+    // Settled by the next call on the main thread. A scheduled frame is
+    // recycled on completion, as any other.
+    std::lock_guard<std::mutex> lock(missedLock);
+    missedCopies.push_back(copy);
+  }
+}
+
+// Called by the driver on its audio thread, both during preroll and while
+// playing. Tops up the samples buffered with the driver to the target level
+// from the FIFO, first scheduling any samples the last call could not.
+HRESULT playbackThreadsafe::RenderAudioSamples(bool preroll) {
+  uint32_t buffered, wanted, taken, available, sampleFramesWritten;
+  int64_t fifoTime;
+  HRESULT hresult;
+
+  hresult = deckLinkOutput->GetBufferedAudioSampleFrameCount(&buffered);
+  if (hresult != S_OK) return hresult;
+  audioBuffered = buffered;
+  if (buffered >= audioTargetLevel) return S_OK;
+
+  wanted = audioTargetLevel - buffered;
+  taken = (wanted > audioPendingFrames) ? wanted - audioPendingFrames : 0;
+  available = audioFifo->available();
+  if (available < taken) {
+    if (started) { // Running short before playback starts is expected
+      audioUnderruns++;
+      audioUnderrunFrames += taken - available;
+    }
+    taken = available;
+  }
+  // The render buffer holds audioTargetLevel sample frames, as do wanted and pending together
+  if ((taken > 0) && !audioFifo->read(audioRenderBuffer.data() +
+      (size_t) audioPendingFrames * audioFifo->bytesPerFrame(), taken, &fifoTime)) {
+    taken = 0;
+  }
+  uint32_t frames = audioPendingFrames + taken;
+  if (frames == 0) return S_OK;
+
+  hresult = deckLinkOutput->ScheduleAudioSamples(audioRenderBuffer.data(), frames,
+    audioNextTime, sampleRate, &sampleFramesWritten);
+  if (hresult != S_OK) sampleFramesWritten = 0;
+  audioNextTime += sampleFramesWritten;
+  audioScheduled += sampleFramesWritten;
+  audioPendingFrames = frames - sampleFramesWritten;
+  if (audioPendingFrames > 0) { // Keep what was not written for the next call
+    audioShortWrites++;
+    memmove(audioRenderBuffer.data(), audioRenderBuffer.data() +
+      (size_t) sampleFramesWritten * audioFifo->bytesPerFrame(),
+      (size_t) audioPendingFrames * audioFifo->bytesPerFrame());
+  }
+  return hresult;
+}
+
 HRESULT playbackThreadsafe::ScheduledPlaybackHasStopped() {
 
   return S_OK;
@@ -88,6 +260,28 @@ void finalizePlaybackCarrier(napi_env env, void* finalize_data, void* finalize_h
   delete c;
 }
 
+// Bytes per row of a frame, or -1 for an unsupported pixel format
+static int32_t playbackRowBytes(BMDPixelFormat pixelFormat, int32_t width) {
+  switch (pixelFormat) {
+    case bmdFormat8BitYUV:
+      return width * 2;
+    case bmdFormat10BitYUV:
+      return ((int32_t) ((width + 47) / 48)) * 128;
+    case bmdFormat8BitARGB:
+    case bmdFormat8BitBGRA:
+      return width * 4;
+    case bmdFormat10BitRGB:
+    case bmdFormat10BitRGBXLE:
+    case bmdFormat10BitRGBX:
+      return ((int32_t) ((width + 63) / 64)) * 256;
+    case bmdFormat12BitRGB:
+    case bmdFormat12BitRGBLE:
+      return (int32_t) ((width * 36) / 8);
+    default:
+      return -1;
+  }
+}
+
 void playbackExecute(napi_env env, void* data) {
   playbackCarrier* c = (playbackCarrier*) data;
 
@@ -240,6 +434,19 @@ void playbackExecute(napi_env env, void* data) {
     // printf("Enabled decklink %s keying at level %i.\n",
     //   c->isExternal ? "external" : "internal", c->keyLevel);
   }
+
+  if (c->framePool > 0) {
+    int32_t width = c->selectedDisplayMode->GetWidth();
+    c->outputPool = new macadamOutputPool;
+    hresult = c->outputPool->create(deckLinkOutput, c->framePool, width,
+      c->selectedDisplayMode->GetHeight(), playbackRowBytes(c->requestedPixelFormat, width),
+      c->requestedPixelFormat);
+    if (hresult != S_OK) {
+      c->status = MACADAM_OUT_OF_MEMORY;
+      c->errorMsg = "Unable to create the video frames of the output frame pool.";
+      return;
+    }
+  }
 }
 
 void playbackComplete(napi_env env, napi_status asyncStatus, void* data) {
@@ -297,30 +504,7 @@ void playbackComplete(napi_env env, napi_status asyncStatus, void* data) {
   int32_t width, height, rowBytes;
   width = c->selectedDisplayMode->GetWidth();
   height = c->selectedDisplayMode->GetHeight();
-  switch (c->requestedPixelFormat) {
-    case bmdFormat8BitYUV:
-      rowBytes = width * 2;
-      break;
-    case bmdFormat10BitYUV:
-      rowBytes = ((int32_t) ((width + 47) / 48)) * 128;
-      break;
-    case bmdFormat8BitARGB:
-    case bmdFormat8BitBGRA:
-      rowBytes = width * 4;
-      break;
-    case bmdFormat10BitRGB:
-    case bmdFormat10BitRGBXLE:
-    case bmdFormat10BitRGBX:
-      rowBytes = ((int32_t) ((width + 63) / 64)) * 256;
-      break;
-    case bmdFormat12BitRGB:
-    case bmdFormat12BitRGBLE:
-      rowBytes = (int32_t) ((width * 36) / 8);
-      break;
-    default:
-      rowBytes = -1;
-      break;
-  }
+  rowBytes = playbackRowBytes(c->requestedPixelFormat, width);
 
   c->status = napi_create_int32(env, width, &param);
   REJECT_STATUS;
@@ -437,8 +621,8 @@ void playbackComplete(napi_env env, napi_status asyncStatus, void* data) {
   }
 
   if (c->timecode != nullptr) {
-    const char* tcstr;
-    hresult = c->timecode->formatTimecodeString(&tcstr, true);
+    char tcstr[MACADAM_TIMECODE_STRING_SIZE];
+    hresult = c->timecode->formatTimecodeString(tcstr, true);
     if (hresult != S_OK) {
       c->status = MACADAM_CALL_FAILURE;
       c->errorMsg = "Unable to format timecode string.";
@@ -483,6 +667,11 @@ void playbackComplete(napi_env env, napi_status asyncStatus, void* data) {
   }
   pbts->timecode = c->timecode;
   c->timecode = nullptr;
+  pbts->callbackQueueSize = c->callbackQueueSize;
+  pbts->callbackQueueBlocking = c->callbackQueueBlocking;
+  pbts->outputPool = c->outputPool;
+  c->outputPool = nullptr;
+  pbts->displayQueueSize = c->displayQueueSize;
 
   // printf("Address of %s keyer at level %i in pbts is %p.\n",
   //   pbts->isExternal ? "external" : "internal", pbts->keyLevel,
@@ -525,6 +714,32 @@ void playbackComplete(napi_env env, napi_status asyncStatus, void* data) {
   c->status = napi_set_named_property(env, result, "played", param);
   REJECT_STATUS;
 
+  c->status = napi_create_function(env, "playout", NAPI_AUTO_LENGTH, playout,
+    nullptr, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "playout", param);
+  REJECT_STATUS;
+
+  c->status = napi_create_function(env, "enqueue", NAPI_AUTO_LENGTH, enqueue,
+    nullptr, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "enqueue", param);
+  REJECT_STATUS;
+
+  if (pbts->channels > 0) {
+    c->status = napi_create_function(env, "pullAudio", NAPI_AUTO_LENGTH, pullAudio,
+      nullptr, &param);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, result, "pullAudio", param);
+    REJECT_STATUS;
+
+    c->status = napi_create_function(env, "writeAudio", NAPI_AUTO_LENGTH, writeAudio,
+      nullptr, &param);
+    REJECT_STATUS;
+    c->status = napi_set_named_property(env, result, "writeAudio", param);
+    REJECT_STATUS;
+  }
+
   c->status = napi_create_function(env, "referenceStatus", NAPI_AUTO_LENGTH,
     referenceStatus, nullptr, &param);
   REJECT_STATUS;
@@ -555,6 +770,12 @@ void playbackComplete(napi_env env, napi_status asyncStatus, void* data) {
   c->status = napi_set_named_property(env, result, "bufferedAudioFrames", param);
   REJECT_STATUS;
 
+  c->status = napi_create_function(env, "stats", NAPI_AUTO_LENGTH,
+    playbackStats, nullptr, &param);
+  REJECT_STATUS;
+  c->status = napi_set_named_property(env, result, "stats", param);
+  REJECT_STATUS;
+
   if (pbts->enableKeying) {
     c->status = napi_create_function(env, "rampUp", NAPI_AUTO_LENGTH,
       rampUp, nullptr, &param);
@@ -606,9 +827,18 @@ void playbackComplete(napi_env env, napi_status asyncStatus, void* data) {
   c->status = napi_create_function(env, "nop", NAPI_AUTO_LENGTH, nop, nullptr, &param);
   REJECT_STATUS;
   c->status = napi_create_threadsafe_function(env, param, nullptr, asyncName,
-    20, 1, nullptr, playbackTsFnFinalize, pbts, playedFrame, &pbts->tsFn);
+    pbts->callbackQueueSize, 1, nullptr, playbackTsFnFinalize, pbts, playedFrame, &pbts->tsFn);
   REJECT_STATUS;
 
+  if (pbts->outputPool != nullptr) {
+    c->status = napi_create_string_utf8(env, "playbackCopy", NAPI_AUTO_LENGTH, &asyncName);
+    REJECT_STATUS;
+    c->status = napi_create_threadsafe_function(env, param, nullptr, asyncName,
+      0, 1, nullptr, nullptr, pbts, copiedFrame, &pbts->copyTsFn);
+    REJECT_STATUS;
+    pbts->copyPool = new macadamWorkerPool(1);
+  }
+
   c->status = napi_create_external(env, pbts, finalizePlaybackCarrier, nullptr, &param);
   REJECT_STATUS;
   c->status = napi_set_named_property(env, result, "deckLinkOutput", param);
@@ -857,6 +1087,58 @@ napi_value playback(napi_env env, napi_callback_info info) {
     }
   }
 
+  c->status = napi_get_named_property(env, options, "callbackQueueSize", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Callback queue size must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->callbackQueueSize);
+    REJECT_RETURN;
+    if (c->callbackQueueSize == 0) REJECT_ERROR_RETURN(
+      "Callback queue size must be greater than zero.", MACADAM_OUT_OF_BOUNDS);
+  }
+
+  c->status = napi_get_named_property(env, options, "callbackQueueMode", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_string) REJECT_ERROR_RETURN(
+      "Callback queue mode must be a string, either 'drop' or 'block'.", MACADAM_INVALID_ARGS);
+    c->status = parseCallbackQueueMode(env, param, &c->callbackQueueBlocking);
+    if (c->status == napi_invalid_arg) REJECT_ERROR_RETURN(
+      "Callback queue mode must be either 'drop' or 'block'.", MACADAM_INVALID_ARGS);
+    REJECT_RETURN;
+  }
+
+  c->status = napi_get_named_property(env, options, "framePool", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Output frame pool size must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->framePool);
+    REJECT_RETURN;
+    if (c->framePool > 64) REJECT_ERROR_RETURN(
+      "Output frame pool size must be from 0 to 64.", MACADAM_OUT_OF_BOUNDS);
+  }
+
+  c->status = napi_get_named_property(env, options, "displayQueueSize", &param);
+  REJECT_RETURN;
+  c->status = napi_typeof(env, param, &type);
+  REJECT_RETURN;
+  if (type != napi_undefined) {
+    if (type != napi_number) REJECT_ERROR_RETURN(
+      "Display queue size must be a number.", MACADAM_INVALID_ARGS);
+    c->status = napi_get_value_uint32(env, param, &c->displayQueueSize);
+    REJECT_RETURN;
+    if ((c->displayQueueSize == 0) || (c->displayQueueSize > 64)) REJECT_ERROR_RETURN(
+      "Display queue size must be from 1 to 64.", MACADAM_OUT_OF_BOUNDS);
+  }
+
   c->status = napi_create_string_utf8(env, "CreatePlayback", NAPI_AUTO_LENGTH, &resourceName);
   REJECT_RETURN;
   c->status = napi_create_async_work(env, NULL, resourceName, playbackExecute,
@@ -869,43 +1151,241 @@ napi_value playback(napi_env env, napi_callback_info info) {
 }
 
 void playedFrame(napi_env env, napi_value jsCb, void* context, void* data) {
-  napi_status status;
-  napi_value resres, param, errorValue, errorCode, errorMsg;
   macadamFrame* frame = (macadamFrame*) data;
   playbackThreadsafe* pbts = (playbackThreadsafe*) context;
+
+  if (env == nullptr) { // Threadsafe function is closing with completions still queued
+    delete frame;
+    return;
+  }
+
+  resolveMissedCompletions(env, pbts);
+  resolvePlayed(env, pbts, frame);
+}
+
+// Catch up on completions that arrived while the threadsafe function queue was full
+void resolveMissedCompletions(napi_env env, playbackThreadsafe* pbts) {
+  std::vector<macadamFrame*> missed;
+  {
+    std::lock_guard<std::mutex> lock(pbts->missedLock);
+    if (pbts->missedCompletions.empty()) return;
+    missed.swap(pbts->missedCompletions);
+  }
+  for ( auto it = missed.begin() ; it != missed.end() ; ++it ) {
+    resolvePlayed(env, pbts, *it);
+  }
+}
+
+pendingPlayRing::pendingPlayRing(size_t capacity) {
+  size_t size = 16;
+  while (size < capacity) size <<= 1;
+  slots.assign(size, slot { 0, nullptr });
+}
+
+scheduleCarrier* pendingPlayRing::findInRing(int64_t frame) {
+  slot& s = at(frame);
+  return ((s.carrier != nullptr) && (s.frame == frame)) ? s.carrier : nullptr;
+}
+
+scheduleCarrier* pendingPlayRing::find(int64_t frame) {
+  scheduleCarrier* carrier = findInRing(frame);
+  if ((carrier != nullptr) || outliers.empty()) return carrier;
+  auto it = outliers.find(frame);
+  return (it != outliers.end()) ? it->second : nullptr;
+}
+
+void pendingPlayRing::insert(int64_t frame, scheduleCarrier* carrier) {
+  if (count == 0) {
+    oldest = frame;
+    newest = frame;
+  }
+  if ((frame > newest) && ((uint64_t) (frame - oldest) >= PENDING_RING_MAX)) {
+    outliers.emplace(frame, carrier);
+    return;
+  }
+  // The ring follows the earliest frames, which are played first
+  if ((frame < oldest) && ((uint64_t) (newest - frame) >= PENDING_RING_MAX)) {
+    evictFrom(frame + PENDING_RING_MAX);
+    if (count == 0) newest = frame;
+  }
+  if (frame < oldest) oldest = frame;
+  if (frame > newest) newest = frame;
+  while ((uint64_t) (newest - oldest) >= slots.size()) grow();
+  slot& s = at(frame);
+  s.frame = frame;
+  s.carrier = carrier;
+  count++;
+}
+
+// Moves the promises for frame limit onwards from the ring to the outliers
+void pendingPlayRing::evictFrom(int64_t limit) {
+  int64_t last = oldest;
+  for ( auto& s : slots ) {
+    if (s.carrier == nullptr) continue;
+    if (s.frame >= limit) {
+      outliers.emplace(s.frame, s.carrier);
+      s.carrier = nullptr;
+      count--;
+    } else if (s.frame > last) {
+      last = s.frame;
+    }
+  }
+  newest = last;
+}
+
+// Moves outliers that now fall within the span of the ring into it
+void pendingPlayRing::admitOutliers() {
+  if (count == 0) {
+    if (outliers.empty()) return;
+    oldest = newest = outliers.begin()->first;
+  }
+  auto it = outliers.lower_bound(oldest);
+  while ((it != outliers.end()) && ((uint64_t) (it->first - oldest) < slots.size())) {
+    slot& s = at(it->first);
+    s.frame = it->first;
+    s.carrier = it->second;
+    count++;
+    if (it->first > newest) newest = it->first;
+    it = outliers.erase(it);
+  }
+}
+
+scheduleCarrier* pendingPlayRing::take(int64_t frame) {
+  slot& s = at(frame);
+  if ((s.carrier == nullptr) || (s.frame != frame)) {
+    auto it = outliers.find(frame);
+    if (it == outliers.end()) return nullptr;
+    scheduleCarrier* carrier = it->second;
+    outliers.erase(it);
+    return carrier;
+  }
+  scheduleCarrier* carrier = s.carrier;
+  s.carrier = nullptr;
+  count--;
+  // Each frame number is passed over at most once, so this is constant on average
+  while ((count > 0) && (findInRing(oldest) == nullptr)) oldest++;
+  if (!outliers.empty()) admitOutliers();
+  return carrier;
+}
+
+void pendingPlayRing::expire(int64_t upTo, std::vector<scheduleCarrier*>* expired) {
+  if (!outliers.empty()) {
+    auto end = outliers.upper_bound(upTo);
+    for ( auto it = outliers.begin() ; it != end ; it++ ) expired->push_back(it->second);
+    outliers.erase(outliers.begin(), end);
+  }
+  if ((count == 0) || (upTo < oldest)) {
+    if (!outliers.empty()) admitOutliers();
+    return;
+  }
+  if ((uint64_t) (upTo - oldest) >= slots.size()) { // Every slot is in range
+    for ( auto& s : slots ) {
+      if ((s.carrier != nullptr) && (s.frame <= upTo)) {
+        expired->push_back(s.carrier);
+        s.carrier = nullptr;
+        count--;
+      }
+    }
+  } else {
+    for ( int64_t frame = oldest ; (frame <= upTo) && (count > 0) ; frame++ ) {
+      scheduleCarrier* carrier = findInRing(frame);
+      if (carrier == nullptr) continue;
+      expired->push_back(carrier);
+      at(frame).carrier = nullptr;
+      count--;
+    }
+  }
+  oldest = upTo + 1;
+  while ((count > 0) && (findInRing(oldest) == nullptr)) oldest++;
+  if (!outliers.empty()) admitOutliers();
+}
+
+void pendingPlayRing::grow() {
+  std::vector<slot> previous(slots.size() * 2, slot { 0, nullptr });
+  previous.swap(slots);
+  for ( auto& s : previous ) {
+    if (s.carrier != nullptr) at(s.frame) = s;
+  }
+}
+
+// Frame number of a scheduled time, rounding down
+static int64_t frameNumber(BMDTimeValue time, BMDTimeValue frameDuration) {
+  int64_t frame = time / frameDuration;
+  return ((time % frameDuration) < 0) ? frame - 1 : frame;
+}
+
+// Counts the result of a frame from the playout queue, which has no promise,
+// and lets go of its buffers
+static void playoutPlayed(napi_env env, playbackThreadsafe* pbts, macadamFrame* frame) {
+  napi_status status;
+  switch (frame->result) {
+    case bmdOutputFrameCompleted:
+      pbts->playoutCompleted++;
+      break;
+    case bmdOutputFrameDisplayedLate:
+      pbts->playoutLate++;
+      break;
+    case bmdOutputFrameDropped:
+      pbts->playoutDropped++;
+      break;
+    case bmdOutputFrameFlushed:
+      pbts->playoutFlushed++;
+      break;
+    default:
+      break;
+  }
+  status = napi_delete_reference(env, frame->sourceBufferRef);
+  FLOATING_STATUS;
+  if (frame->audioBufferRef != nullptr) {
+    status = napi_delete_reference(env, frame->audioBufferRef);
+    FLOATING_STATUS;
+  }
+  delete frame;
+}
+
+void resolvePlayed(napi_env env, playbackThreadsafe* pbts, macadamFrame* frame) {
+  napi_status status;
+  napi_value resres, param, errorValue, errorCode, errorMsg;
   scheduleCarrier* c = nullptr;
 
+  if (frame->playout) {
+    playoutPlayed(env, pbts, frame);
+    return;
+  }
+
   //printf("Scheduled frame %lld playback completed with timestamp %lld and result %i.\n",
   //  frame->scheduledTime, frame->completionTimestamp, frame->result);
 
-  for (std::map<BMDTimeValue, scheduleCarrier*>::iterator it = pbts->pendingPlays.begin() ;
-    it != pbts->pendingPlays.end() ; ++it) {
-
-    if (it->first > frame->scheduledTime - pbts->pendingTimeoutTicks) break;
-    char* extMsg = (char *) malloc(sizeof(char) * 200);
-    sprintf(extMsg, "Pending frame promise timed out for scheduled time %lld as just played %lld.",
-      (long long) it->second->scheduledTime, (long long) frame->scheduledTime);
+  // Reject promises for frames that should have been played by now
+  pbts->pendingPlays.expire(frameNumber(frame->scheduledTime - pbts->pendingTimeoutTicks,
+    pbts->frameDuration), &pbts->expiredPlays);
+  if (!pbts->expiredPlays.empty()) {
     char errorCodeChars[20];
     sprintf(errorCodeChars, "%d", MACADAM_FRAME_TIMEOUT);
-    status = napi_create_string_utf8(env, errorCodeChars,
-      NAPI_AUTO_LENGTH, &errorCode);
-    FLOATING_STATUS;
-    status = napi_create_string_utf8(env, extMsg, NAPI_AUTO_LENGTH, &errorMsg);
+    status = napi_create_string_utf8(env, errorCodeChars, NAPI_AUTO_LENGTH, &errorCode);
     FLOATING_STATUS;
-    status = napi_create_error(env, errorCode, errorMsg, &errorValue);
-    FLOATING_STATUS;
-    status = napi_reject_deferred(env, it->second->_deferred, errorValue);
-    FLOATING_STATUS;
-
-    tidyCarrier(env, it->second);
-    pbts->pendingPlays.erase(it->first);
-    if (pbts->pendingPlays.empty()) break;
+    for ( auto expired : pbts->expiredPlays ) {
+      char extMsg[200];
+      snprintf(extMsg, sizeof(extMsg),
+        "Pending frame promise timed out for scheduled time %lld as just played %lld.",
+        (long long) expired->scheduledTime, (long long) frame->scheduledTime);
+      status = napi_create_string_utf8(env, extMsg, NAPI_AUTO_LENGTH, &errorMsg);
+      FLOATING_STATUS;
+      status = napi_create_error(env, errorCode, errorMsg, &errorValue);
+      FLOATING_STATUS;
+      status = napi_reject_deferred(env, expired->_deferred, errorValue);
+      FLOATING_STATUS;
+      tidyCarrier(env, expired);
+    }
+    pbts->playedTimeouts += pbts->expiredPlays.size();
+    pbts->expiredPlays.clear();
   }
 
-  // See if any pending play promises exist in map and fulfil
-  auto played = pbts->pendingPlays.find(frame->scheduledTime);
-  if (played != pbts->pendingPlays.end()) {
-    c = played->second;
+  // See if a promise is waiting for this frame and fulfil it
+  if ((frame->scheduledTime % pbts->frameDuration) == 0) {
+    c = pbts->pendingPlays.take(frame->scheduledTime / pbts->frameDuration);
+  }
+  if (c != nullptr) {
     c->status = napi_create_object(env, &resres);
     REJECT_BAIL;
 
@@ -958,7 +1438,6 @@ void playedFrame(napi_env env, napi_value jsCb, void* context, void* data) {
     c->status = napi_resolve_deferred(env, c->_deferred, resres);
     REJECT_BAIL;
 
-    pbts->pendingPlays.erase(frame->scheduledTime);
     tidyCarrier(env, c);
   }
   else {
@@ -967,6 +1446,10 @@ void playedFrame(napi_env env, napi_value jsCb, void* context, void* data) {
   }
 
 bail:
+  if (frame->sourceBufferRef == nullptr) { // Pooled frames hold no buffer
+    delete frame;
+    return;
+  }
   status = napi_delete_reference(env, frame->sourceBufferRef);
   if (status != napi_ok) {
     printf("DEBUG: Failed to delete video buffer reference for scheduled frame %lld.\n",
@@ -981,7 +1464,7 @@ void displayFrameExecute(napi_env env, void* data) {
   uint32_t sampleFramesWritten;
   HRESULT hresult;
 
-  // This call may block - make sure thread pool is large enough
+  // This call blocks, so runs on the display thread of the output
   hresult = c->deckLinkOutput->DisplayVideoFrameSync(c);
   switch (hresult) {
     case E_FAIL:
@@ -1018,6 +1501,12 @@ void displayFrameComplete(napi_env env, napi_status asyncStatus, void* data) {
   displayFrameCarrier* c = (displayFrameCarrier*) data;
   napi_value result;
 
+  if (c->audioRef != nullptr) {
+    napi_status status = napi_delete_reference(env, c->audioRef);
+    FLOATING_STATUS;
+    c->audioRef = nullptr;
+  }
+
   if (asyncStatus != napi_ok) {
     c->status = asyncStatus;
     c->errorMsg = "Display frame failed to complete.";
@@ -1027,11 +1516,6 @@ void displayFrameComplete(napi_env env, napi_status asyncStatus, void* data) {
   c->status = napi_create_object(env, &result);
   REJECT_STATUS;
 
-  if (c->audioRef != nullptr) {
-    c->status = napi_delete_reference(env, c->audioRef);
-    REJECT_STATUS;
-  }
-
   if (c->tc != nullptr) {
     c->tc->Update();
   }
@@ -1043,6 +1527,61 @@ void displayFrameComplete(napi_env env, napi_status asyncStatus, void* data) {
   tidyCarrier(env, c);
 }
 
+// Runs on the display thread of an output
+static void displayOnThread(playbackThreadsafe* pbts, displayFrameCarrier* c) {
+  napi_status status;
+
+  if (pbts->displayStopping) {
+    c->status = MACADAM_ALREADY_STOPPED;
+    c->errorMsg = "Output stopped before the frame was displayed.";
+  } else {
+    auto start = std::chrono::high_resolution_clock::now();
+    displayFrameExecute(nullptr, c);
+    c->totalTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::high_resolution_clock::now() - start).count();
+  }
+
+  status = napi_call_threadsafe_function(pbts->displayTsFn, c, napi_tsfn_blocking);
+  if (status != napi_ok) {
+    // Rejected by the next call on the main thread, as the result is lost
+    if (c->status == MACADAM_SUCCESS) {
+      c->status = MACADAM_CALL_FAILURE;
+      c->errorMsg = "Failed to pass the result of displaying a frame to the main thread.";
+    }
+    std::lock_guard<std::mutex> lock(pbts->missedLock);
+    pbts->missedDisplays.push_back(c);
+  }
+}
+
+// Catch up on displayed frames whose results could not be passed to the main thread
+void settleMissedDisplays(napi_env env, playbackThreadsafe* pbts) {
+  std::vector<displayFrameCarrier*> missed;
+  {
+    std::lock_guard<std::mutex> lock(pbts->missedLock);
+    if (pbts->missedDisplays.empty()) return;
+    missed.swap(pbts->missedDisplays);
+  }
+  for ( auto c : missed ) displayedFrame(env, nullptr, pbts, c);
+}
+
+void displayedFrame(napi_env env, napi_value jsCb, void* context, void* data) {
+  displayFrameCarrier* c = (displayFrameCarrier*) data;
+  playbackThreadsafe* pbts = (playbackThreadsafe*) context;
+
+  if (env == nullptr) { // Threadsafe function is closing with frames still queued
+    delete c;
+    return;
+  }
+  settleMissedDisplays(env, pbts);
+
+  if (c->status == MACADAM_SUCCESS) {
+    pbts->displayFrames++;
+    pbts->displayMicrosLast = c->totalTime;
+    if (c->totalTime > pbts->displayMicrosMax) pbts->displayMicrosMax = c->totalTime;
+  }
+  displayFrameComplete(env, napi_ok, c);
+}
+
 napi_value displayFrame(napi_env env, napi_callback_info info) {
   napi_value promise, resourceName, playback, param;
   playbackThreadsafe* pbts;
@@ -1116,13 +1655,29 @@ napi_value displayFrame(napi_env env, napi_callback_info info) {
     c->tc = pbts->timecode;
   }
 
-  c->status = napi_create_string_utf8(env, "DisplayFrame", NAPI_AUTO_LENGTH, &resourceName);
-  REJECT_RETURN;
-  c->status = napi_create_async_work(env, nullptr, resourceName, displayFrameExecute,
-    displayFrameComplete, c, &c->_request);
-  REJECT_RETURN;
-  c->status = napi_queue_async_work(env, c->_request);
-  REJECT_RETURN;
+  settleMissedDisplays(env, pbts);
+  if (pbts->displayPool == nullptr) {
+    c->status = napi_create_string_utf8(env, "DisplayFrame", NAPI_AUTO_LENGTH, &resourceName);
+    REJECT_RETURN;
+    c->status = napi_create_function(env, "nop", NAPI_AUTO_LENGTH, nop, nullptr, &param);
+    REJECT_RETURN;
+    c->status = napi_create_threadsafe_function(env, param, nullptr, resourceName,
+      0, 1, nullptr, nullptr, pbts, displayedFrame, &pbts->displayTsFn);
+    REJECT_RETURN;
+    pbts->displayPool = new macadamWorkerPool(1, pbts->displayQueueSize);
+  }
+
+  if (!pbts->displayPool->submit([pbts, c](uint32_t workerIndex) {
+      displayOnThread(pbts, c);
+    })) {
+    pbts->displayQueueFull++;
+    if (c->audioRef != nullptr) {
+      c->status = napi_delete_reference(env, c->audioRef);
+      REJECT_RETURN;
+    }
+    REJECT_ERROR_RETURN("Display queue is full. Wait for earlier frames to be displayed.",
+      MACADAM_OUT_OF_BOUNDS);
+  }
 
   return promise;
 }
@@ -1185,8 +1740,9 @@ napi_value schedule(napi_env env, napi_callback_info info) {
   if (status == napi_invalid_arg)
     NAPI_THROW_ERROR("Cannot schedule frames after playout has stopped.");
   CHECK_STATUS;
+  if (pbts->playout) NAPI_THROW_ERROR("Frames are scheduled by the playout queue. Use enqueue().");
 
-  if (pbts->channels > 0) {
+  if ((pbts->channels > 0) && (pbts->audioFifo == nullptr)) {
     status = napi_has_named_property(env, argv[0], "audio", &hasProp);
     CHECK_STATUS;
     if (!hasProp) NAPI_THROW_ERROR("To schedule a frame, an audio buffer must be provided.");
@@ -1210,6 +1766,12 @@ napi_value schedule(napi_env env, napi_callback_info info) {
     else {
       sampleFrameCount = 0;
     }
+
+    status = napi_get_buffer_info(env, audioBuffer, &audioData, &audioDataSize);
+    CHECK_STATUS;
+    if (sampleFrameCount == 0) { // Not provided
+      sampleFrameCount = audioDataSize / pbts->sampleByteFactor;
+    }
   }
 
   if (((int32_t) frame->dataSize) < (pbts->rowBytes * pbts->height))
@@ -1226,29 +1788,68 @@ napi_value schedule(napi_env env, napi_callback_info info) {
     frame->tc = pbts->timecode;
   }
 
-  hresult = pbts->deckLinkOutput->ScheduleVideoFrame(frame, frame->scheduledTime,
-    pbts->frameDuration, pbts->timeScale);
+  if (pbts->outputPool != nullptr) {
+    settleMissedCopies(env, pbts);
+    outputCopy* copy = new outputCopy;
+    copy->frame = nullptr;
+    copy->src = frame->data;
+    copy->size = pbts->rowBytes * pbts->height;
+    if (pbts->timecode != nullptr) {
+      copy->hasTimecode = true;
+      copy->timecodeFormat = (pbts->height <= 576) ? bmdTimecodeVITC : bmdTimecodeRP188Any;
+      pbts->timecode->GetComponents(&copy->hours, &copy->minutes, &copy->seconds, &copy->frames);
+      copy->timecodeFlags = pbts->timecode->GetFlags();
+    }
+    if ((pbts->channels > 0) && (pbts->audioFifo == nullptr)) {
+      copy->audio = audioData;
+      copy->sampleFrameCount = sampleFrameCount;
+    }
+    // Ensure that buffers are not garbage collected until copied and scheduled
+    status = napi_create_reference(env, videoBuffer, 1, &copy->sourceBufferRef);
+    if ((status == napi_ok) && (copy->audio != nullptr)) {
+      status = napi_create_reference(env, audioBuffer, 1, &copy->audioBufferRef);
+    }
+    if (status == napi_ok) { // Only take a frame from the pool once nothing else can fail
+      copy->frame = pbts->outputPool->take();
+      if (copy->frame == nullptr) {
+        abandonCopy(env, pbts, copy);
+        NAPI_THROW_ERROR("No free frame in the output pool. Wait for frames to play.");
+      }
+      copy->frame->scheduledTime = frame->scheduledTime;
+      status = napi_create_promise(env, &copy->deferred, &value);
+    }
+    if (status != napi_ok) {
+      abandonCopy(env, pbts, copy);
+      CHECK_STATUS;
+    }
+    if (!pbts->copyPool->submit([pbts, copy](uint32_t workerIndex) {
+        pbts->copyFrame(copy);
+      })) { // Only when stopping, so reject as for a copy that was queued
+      pbts->outputPool->recycle(copy->frame);
+      copy->result = E_ABORT;
+      copiedFrame(env, nullptr, pbts, copy);
+    }
+  } else {
+    hresult = pbts->deckLinkOutput->ScheduleVideoFrame(frame, frame->scheduledTime,
+      pbts->frameDuration, pbts->timeScale);
 
-  switch (hresult) {
-    case S_OK:
-      break;
-    case E_ACCESSDENIED:
-      NAPI_THROW_ERROR("Failed to schedule frame as the video output is not enabled.");
-    case E_INVALIDARG:
-      NAPI_THROW_ERROR("Failed to schedule frame as the attributes are invalid.");
-    case E_OUTOFMEMORY:
-      NAPI_THROW_ERROR("Fauled to schedule frame as too many frames are already scheduled.");
-    case E_FAIL:
-    default:
-      NAPI_THROW_ERROR("Failed to schedule frame - general failure.");
+    switch (hresult) {
+      case S_OK:
+        break;
+      case E_ACCESSDENIED:
+        NAPI_THROW_ERROR("Failed to schedule frame as the video output is not enabled.");
+      case E_INVALIDARG:
+        NAPI_THROW_ERROR("Failed to schedule frame as the attributes are invalid.");
+      case E_OUTOFMEMORY:
+        NAPI_THROW_ERROR("Fauled to schedule frame as too many frames are already scheduled.");
+      case E_FAIL:
+      default:
+        NAPI_THROW_ERROR("Failed to schedule frame - general failure.");
+    }
   }
 
-  if (pbts->channels > 0) {
-    status = napi_get_buffer_info(env, audioBuffer, &audioData, &audioDataSize);
-    CHECK_STATUS;
-    if (sampleFrameCount == 0) { // Not provided
-      sampleFrameCount = audioDataSize / pbts->sampleByteFactor;
-    }
+  // Audio for a pooled frame is scheduled by the copy worker after its video
+  if ((pbts->channels > 0) && (pbts->audioFifo == nullptr) && (pbts->outputPool == nullptr)) {
     // TODO Assuming audio data is copied
     hresult = pbts->deckLinkOutput->ScheduleAudioSamples(audioData, sampleFrameCount,
       frame->scheduledTime, pbts->timeScale, &sampleFramesWritten);
@@ -1262,8 +1863,13 @@ napi_value schedule(napi_env env, napi_callback_info info) {
       case E_FAIL:
         NAPI_THROW_ERROR("Failed to schedule audio for frame - general failure.");
     }
-    // TODO check sample frames provided and written are the same
-    // printf("Sample frame count %u frames written %u.\n", sampleFrameCount, sampleFramesWritten);
+    // Samples the driver could not take are lost. Use pullAudio() to avoid this.
+    if (sampleFramesWritten < sampleFrameCount) pbts->audioShortWrites++;
+  }
+
+  if (pbts->outputPool != nullptr) { // Resolves once copied and scheduled
+    delete frame;
+    return value;
   }
 
   // Ensure that buffer is not garbage collected during playback
@@ -1275,6 +1881,130 @@ napi_value schedule(napi_env env, napi_callback_info info) {
   return value;
 }
 
+// Releases a copy that schedule() could not pass to the copy worker, and its frame
+void abandonCopy(napi_env env, playbackThreadsafe* pbts, outputCopy* copy) {
+  napi_status status;
+  if (copy->frame != nullptr) pbts->outputPool->recycle(copy->frame);
+  if (copy->sourceBufferRef != nullptr) {
+    status = napi_delete_reference(env, copy->sourceBufferRef);
+    FLOATING_STATUS;
+  }
+  if (copy->audioBufferRef != nullptr) {
+    status = napi_delete_reference(env, copy->audioBufferRef);
+    FLOATING_STATUS;
+  }
+  delete copy;
+}
+
+// Catch up on copies whose results could not be passed to the main thread
+void settleMissedCopies(napi_env env, playbackThreadsafe* pbts) {
+  std::vector<outputCopy*> missed;
+  {
+    std::lock_guard<std::mutex> lock(pbts->missedLock);
+    if (pbts->missedCopies.empty()) return;
+    missed.swap(pbts->missedCopies);
+  }
+  for ( auto copy : missed ) copiedFrame(env, nullptr, pbts, copy);
+}
+
+// Settles the promise from schedule() for a frame copied into the output pool
+void copiedFrame(napi_env env, napi_value jsCb, void* context, void* data) {
+  outputCopy* copy = (outputCopy*) data;
+  napi_status status;
+  napi_value result, param, errorCode, errorMsg;
+  const char* message;
+
+  if (env == nullptr) { // Threadsafe function is closing with copies still queued
+    delete copy;
+    return;
+  }
+  settleMissedCopies(env, (playbackThreadsafe*) context);
+
+  status = napi_delete_reference(env, copy->sourceBufferRef);
+  FLOATING_STATUS;
+  if (copy->audioBufferRef != nullptr) {
+    status = napi_delete_reference(env, copy->audioBufferRef);
+    FLOATING_STATUS;
+  }
+
+  if ((copy->result == S_OK) && (copy->audioResult == S_OK)) {
+    status = napi_create_object(env, &result);
+    FLOATING_STATUS;
+    status = napi_create_string_utf8(env, "scheduled", NAPI_AUTO_LENGTH, &param);
+    FLOATING_STATUS;
+    status = napi_set_named_property(env, result, "type", param);
+    FLOATING_STATUS;
+    status = napi_create_int64(env, copy->frame->scheduledTime, &param);
+    FLOATING_STATUS;
+    status = napi_set_named_property(env, result, "scheduledTime", param);
+    FLOATING_STATUS;
+    status = napi_create_int64(env, copy->copyMicros, &param);
+    FLOATING_STATUS;
+    status = napi_set_named_property(env, result, "copyMicros", param);
+    FLOATING_STATUS;
+    status = napi_resolve_deferred(env, copy->deferred, result);
+    FLOATING_STATUS;
+    delete copy;
+    return;
+  }
+
+  if (copy->result == S_OK) { // Video is scheduled and plays without the audio
+    switch (copy->audioResult) {
+      case E_ACCESSDENIED:
+        message = "Audio output has not been enabled or audio sample write in progress.";
+        break;
+      case E_INVALIDARG:
+        message = "No timescale was provided when scheduling audio samples.";
+        break;
+      default:
+        message = "Failed to schedule audio for frame - general failure.";
+        break;
+    }
+  } else {
+    switch (copy->result) {
+      case E_ABORT:
+        message = "Playback stopped before the frame was copied into the output pool.";
+        break;
+      case E_ACCESSDENIED:
+        message = "Failed to schedule frame as the video output is not enabled.";
+        break;
+      case E_INVALIDARG:
+        message = "Failed to schedule frame as the attributes are invalid.";
+        break;
+      case E_OUTOFMEMORY:
+        message = "Failed to schedule frame as too many frames are already scheduled.";
+        break;
+      default:
+        message = "Failed to schedule frame - general failure.";
+        break;
+    }
+  }
+  char errorCodeChars[20];
+  sprintf(errorCodeChars, "%d", MACADAM_CALL_FAILURE);
+  status = napi_create_string_utf8(env, errorCodeChars, NAPI_AUTO_LENGTH, &errorCode);
+  FLOATING_STATUS;
+  status = napi_create_string_utf8(env, message, NAPI_AUTO_LENGTH, &errorMsg);
+  FLOATING_STATUS;
+  status = napi_create_error(env, errorCode, errorMsg, &result);
+  FLOATING_STATUS;
+  status = napi_reject_deferred(env, copy->deferred, result);
+  FLOATING_STATUS;
+  delete copy;
+}
+
+// Ends any audio preroll and starts the scheduled playback clock
+HRESULT startScheduled(playbackThreadsafe* pbts, BMDTimeValue startTime, double playbackSpeed) {
+  HRESULT hresult;
+  if (pbts->channels > 0) {
+    hresult = pbts->deckLinkOutput->EndAudioPreroll();
+    if (hresult != S_OK) return hresult;
+  }
+  hresult = pbts->deckLinkOutput->StartScheduledPlayback(
+    startTime, pbts->timeScale, playbackSpeed);
+  if (hresult == S_OK) pbts->started = true;
+  return hresult;
+}
+
 napi_value startPlayback(napi_env env, napi_callback_info info) {
   napi_status status;
   napi_value playback, param, value;
@@ -1284,102 +2014,557 @@ napi_value startPlayback(napi_env env, napi_callback_info info) {
   BMDTimeValue startTime = 0;
   double playbackSpeed = 1.0;
 
-  size_t argc = 1;
-  napi_value argv[1];
+  size_t argc = 1;
+  napi_value argv[1];
+  status = napi_get_cb_info(env, info, &argc, argv, &playback, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &pbts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already started and then stopped.");
+  CHECK_STATUS;
+
+  if (pbts->started) NAPI_THROW_ERROR("Already started.");
+
+  if (argc >= 1) {
+    status = napi_typeof(env, argv[0], &type);
+    CHECK_STATUS;
+    if (type != napi_object) NAPI_THROW_ERROR("Parameters must be provided in an object.");
+
+    status = napi_get_named_property(env, argv[0], "startTime", &param);
+    CHECK_STATUS;
+    status = napi_typeof(env, param, &type);
+    CHECK_STATUS;
+    if (type == napi_number) {
+      status = napi_get_value_int64(env, param, &startTime);
+      CHECK_STATUS;
+    } else if (type != napi_undefined) NAPI_THROW_ERROR("Playback start time must be a number.");
+
+    status = napi_get_named_property(env, argv[0], "playbackSpeed", &param);
+    CHECK_STATUS;
+    status = napi_typeof(env, param, &type);
+    CHECK_STATUS;
+    if (type == napi_number) {
+      status = napi_get_value_double(env, param, &playbackSpeed);
+      CHECK_STATUS;
+    } else if (type != napi_undefined) NAPI_THROW_ERROR("Playback speed must be a number.");
+  }
+
+  hresult = startScheduled(pbts, startTime, playbackSpeed);
+  if (hresult != S_OK) NAPI_THROW_ERROR("Failed to start scheduled playback.");
+
+  status = napi_get_undefined(env, &value);
+  CHECK_STATUS;
+  return value;
+}
+
+// Reads the scheduled time for played() into the carrier, setting the
+// carrier's status and message if it is not valid
+static void playedArguments(napi_env env, napi_callback_info info, scheduleCarrier* c,
+    playbackThreadsafe** pbts) {
+  napi_value playback, param;
+  napi_valuetype type;
+
+  size_t argc = 1;
+  napi_value argv[1];
+  c->status = napi_get_cb_info(env, info, &argc, argv, &playback, nullptr);
+  if (c->status != napi_ok) return;
+
+  if (argc != 1) {
+    c->errorMsg = "Scheduled play time for played frame must be provided.";
+    c->status = MACADAM_INVALID_ARGS;
+    return;
+  }
+
+  c->status = napi_typeof(env, argv[0], &type);
+  if (c->status != napi_ok) return;
+  if (type != napi_number) {
+    c->errorMsg = "Played frame promise requires the scheduled time.";
+    c->status = MACADAM_INVALID_ARGS;
+    return;
+  }
+
+  c->status = napi_get_value_int64(env, argv[0], &c->scheduledTime);
+  if (c->status != napi_ok) return;
+
+  c->status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
+  if (c->status != napi_ok) return;
+  c->status = napi_get_value_external(env, param, (void**) pbts);
+  if (c->status != napi_ok) return;
+
+  if ((c->scheduledTime % (*pbts)->frameDuration) != 0) {
+    c->errorMsg = "Played frame time must be a multiple of the frame duration.";
+    c->status = MACADAM_INVALID_ARGS;
+  }
+}
+
+napi_value played(napi_env env, napi_callback_info info) {
+  napi_value promise;
+  scheduleCarrier* c = new scheduleCarrier;
+  playbackThreadsafe* pbts = nullptr;
+  int32_t argumentStatus;
+  int64_t frame = 0;
+
+  // Look for a promise already waiting for the frame before making another
+  playedArguments(env, info, c, &pbts);
+  if (c->status == MACADAM_SUCCESS) {
+    frame = c->scheduledTime / pbts->frameDuration;
+    scheduleCarrier* existing = pbts->pendingPlays.find(frame);
+    if (existing != nullptr) { // Share it
+      delete c;
+      napi_status status = napi_get_reference_value(env, existing->passthru, &promise);
+      FLOATING_STATUS;
+      return promise;
+    }
+  }
+
+  if ((c->status != MACADAM_SUCCESS) && (c->status < MACADAM_ERROR_START)) {
+    // Keep the N-API error message, as making the promise clears it
+    const napi_extended_error_info* errorInfo;
+    if ((napi_get_last_error_info(env, &errorInfo) == napi_ok) &&
+        (errorInfo->error_message != nullptr)) {
+      c->errorMsg = errorInfo->error_message;
+    }
+    c->status = MACADAM_CALL_FAILURE;
+  }
+  argumentStatus = c->status;
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+  c->status = argumentStatus;
+  REJECT_RETURN;
+
+  c->status = napi_create_reference(env, promise, 1, &c->passthru);
+  REJECT_RETURN;
+
+  pbts->pendingPlays.insert(frame, c);
+  return promise;
+}
+
+// Switches audio to pull mode, with options targetLevel, the sample frames
+// to keep buffered with the driver, fifoSize, the sample frames the FIFO
+// holds, and startTime, the scheduled time of the first sample in units of
+// the playback frame rate. Audio is then only taken from writeAudio().
+napi_value pullAudio(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value playback, param, value;
+  napi_valuetype type;
+  playbackThreadsafe* pbts;
+  HRESULT hresult;
+  uint32_t fifoSize;
+  BMDTimeValue startTime = 0;
+
+  size_t argc = 1;
+  napi_value argv[1];
+  status = napi_get_cb_info(env, info, &argc, argv, &playback, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &pbts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Cannot pull audio after playback has stopped.");
+  CHECK_STATUS;
+
+  if (pbts->audioFifo != nullptr) NAPI_THROW_ERROR("Audio is already being pulled.");
+  if (pbts->started) NAPI_THROW_ERROR("Audio must be pulled from before scheduled playback starts.");
+
+  // Default to three frames of audio with the driver and a second in the FIFO
+  pbts->audioTargetLevel = (uint32_t) ((pbts->sampleRate * pbts->frameDuration * 3) / pbts->timeScale);
+  fifoSize = (uint32_t) pbts->sampleRate;
+  if (argc >= 1) {
+    status = napi_typeof(env, argv[0], &type);
+    CHECK_STATUS;
+    if (type != napi_object) NAPI_THROW_ERROR("Pull audio options must be an object.");
+
+    status = napi_get_named_property(env, argv[0], "targetLevel", &param);
+    CHECK_STATUS;
+    status = napi_typeof(env, param, &type);
+    CHECK_STATUS;
+    if (type == napi_number) {
+      status = napi_get_value_uint32(env, param, &pbts->audioTargetLevel);
+      CHECK_STATUS;
+    } else if (type != napi_undefined) NAPI_THROW_ERROR("Audio target level must be a number.");
+    if ((pbts->audioTargetLevel == 0) || (pbts->audioTargetLevel > (uint32_t) pbts->sampleRate))
+      NAPI_THROW_ERROR("Audio target level must be from 1 sample frame to 1 second.");
+
+    status = napi_get_named_property(env, argv[0], "fifoSize", &param);
+    CHECK_STATUS;
+    status = napi_typeof(env, param, &type);
+    CHECK_STATUS;
+    if (type == napi_number) {
+      status = napi_get_value_uint32(env, param, &fifoSize);
+      CHECK_STATUS;
+    } else if (type != napi_undefined) NAPI_THROW_ERROR("Audio FIFO size must be a number.");
+
+    status = napi_get_named_property(env, argv[0], "startTime", &param);
+    CHECK_STATUS;
+    status = napi_typeof(env, param, &type);
+    CHECK_STATUS;
+    if (type == napi_number) {
+      status = napi_get_value_int64(env, param, &startTime);
+      CHECK_STATUS;
+    } else if (type != napi_undefined) NAPI_THROW_ERROR("Audio start time must be a number.");
+  }
+  if ((fifoSize < pbts->audioTargetLevel) || (fifoSize > 10 * (uint32_t) pbts->sampleRate))
+    NAPI_THROW_ERROR("Audio FIFO size must be from the target level to 10 seconds.");
+
+  pbts->audioFifo = new macadamAudioRing(fifoSize, pbts->sampleByteFactor);
+  if (!pbts->audioFifo->allocated()) {
+    delete pbts->audioFifo;
+    pbts->audioFifo = nullptr;
+    NAPI_THROW_ERROR("Unable to allocate the audio FIFO - out of memory.");
+  }
+  pbts->audioRenderBuffer.resize((size_t) pbts->audioTargetLevel * pbts->sampleByteFactor);
+  pbts->audioNextTime = (startTime * pbts->sampleRate) / pbts->timeScale;
+  hresult = pbts->deckLinkOutput->SetAudioCallback(pbts);
+  if (hresult != S_OK) {
+    delete pbts->audioFifo;
+    pbts->audioFifo = nullptr;
+    NAPI_THROW_ERROR("Failed to set the audio callback for the output.");
+  }
+
+  status = napi_get_undefined(env, &value);
+  CHECK_STATUS;
+  return value;
+}
+
+// Adds interleaved samples, any whole number of sample frames, to the audio
+// FIFO. Samples already queued are never overwritten, so only as many sample
+// frames as fit are taken. Returns the number of sample frames taken.
+napi_value writeAudio(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value playback, param, value;
+  playbackThreadsafe* pbts;
+  bool isBuffer;
+  void* audioData;
+  size_t audioDataSize;
+
+  size_t argc = 1;
+  napi_value argv[1];
+  status = napi_get_cb_info(env, info, &argc, argv, &playback, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &pbts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Cannot write audio after playback has stopped.");
+  CHECK_STATUS;
+
+  if (pbts->audioFifo == nullptr) NAPI_THROW_ERROR("Call pullAudio() before writing audio.");
+  if (argc < 1) NAPI_THROW_ERROR("Audio data must be provided as a node buffer.");
+  status = napi_is_buffer(env, argv[0], &isBuffer);
+  CHECK_STATUS;
+  if (!isBuffer) NAPI_THROW_ERROR("Audio data must be provided as a node buffer.");
+  status = napi_get_buffer_info(env, argv[0], &audioData, &audioDataSize);
+  CHECK_STATUS;
+
+  // Any partial sample frame at the end is ignored
+  uint32_t frames = (uint32_t) (audioDataSize / pbts->sampleByteFactor);
+  if (frames > 0) {
+    frames = pbts->audioFifo->writeAvailable((const uint8_t*) audioData, frames,
+      pbts->audioWritten);
+    pbts->audioWritten += frames;
+  }
+
+  status = napi_create_uint32(env, frames, &value);
+  CHECK_STATUS;
+  return value;
+}
+
+// Starts the playout queue, with options depth, lowWater, queueSize,
+// startTime, playbackSpeed and refill, a function called with the number of
+// frames wanted whenever lowWater or fewer frames are waiting. Playback
+// starts once depth frames have been scheduled.
+napi_value playout(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value playback, param, value, refill, asyncName;
+  napi_valuetype type;
+  playbackThreadsafe* pbts;
+
+  size_t argc = 1;
+  napi_value argv[1];
+  status = napi_get_cb_info(env, info, &argc, argv, &playback, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &pbts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Cannot start playout after playback has stopped.");
+  CHECK_STATUS;
+
+  if (pbts->playout) NAPI_THROW_ERROR("Playout queue has already been started.");
+  if (pbts->started) NAPI_THROW_ERROR("Playout queue cannot be used once scheduled playback has started.");
+  if (pbts->pendingPlays.size() > 0) NAPI_THROW_ERROR("Playout queue cannot be used with frames scheduled by JS.");
+  if (argc < 1) NAPI_THROW_ERROR("Playout options must be provided, including a refill function.");
+  status = napi_typeof(env, argv[0], &type);
+  CHECK_STATUS;
+  if (type != napi_object) NAPI_THROW_ERROR("Playout options must be an object.");
+
+  status = napi_get_named_property(env, argv[0], "refill", &refill);
+  CHECK_STATUS;
+  status = napi_typeof(env, refill, &type);
+  CHECK_STATUS;
+  if (type != napi_function) NAPI_THROW_ERROR("Playout refill must be a function.");
+
+  status = napi_get_named_property(env, argv[0], "depth", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type == napi_number) {
+    status = napi_get_value_uint32(env, param, &pbts->playoutDepth);
+    CHECK_STATUS;
+    if ((pbts->playoutDepth < 2) || (pbts->playoutDepth > 64))
+      NAPI_THROW_ERROR("Playout depth must be from 2 to 64 frames.");
+  } else if (type != napi_undefined) NAPI_THROW_ERROR("Playout depth must be a number.");
+
+  pbts->playoutLowWater = pbts->playoutDepth;
+  status = napi_get_named_property(env, argv[0], "lowWater", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type == napi_number) {
+    status = napi_get_value_uint32(env, param, &pbts->playoutLowWater);
+    CHECK_STATUS;
+  } else if (type != napi_undefined) NAPI_THROW_ERROR("Playout low water mark must be a number.");
+
+  pbts->playoutQueueSize = pbts->playoutLowWater + pbts->playoutDepth * 2;
+  status = napi_get_named_property(env, argv[0], "queueSize", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type == napi_number) {
+    status = napi_get_value_uint32(env, param, &pbts->playoutQueueSize);
+    CHECK_STATUS;
+  } else if (type != napi_undefined) NAPI_THROW_ERROR("Playout queue size must be a number.");
+  if ((pbts->playoutQueueSize <= pbts->playoutLowWater) || (pbts->playoutQueueSize > 1024))
+    NAPI_THROW_ERROR("Playout queue size must be more than the low water mark and at most 1024.");
+
+  status = napi_get_named_property(env, argv[0], "startTime", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type == napi_number) {
+    status = napi_get_value_int64(env, param, &pbts->playoutStartTime);
+    CHECK_STATUS;
+  } else if (type != napi_undefined) NAPI_THROW_ERROR("Playout start time must be a number.");
+
+  status = napi_get_named_property(env, argv[0], "playbackSpeed", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type == napi_number) {
+    status = napi_get_value_double(env, param, &pbts->playoutSpeed);
+    CHECK_STATUS;
+  } else if (type != napi_undefined) NAPI_THROW_ERROR("Playback speed must be a number.");
+
+  status = napi_create_string_utf8(env, "playoutRefill", NAPI_AUTO_LENGTH, &asyncName);
+  CHECK_STATUS;
+  status = napi_create_threadsafe_function(env, refill, nullptr, asyncName,
+    0, 1, nullptr, nullptr, pbts, playoutRefill, &pbts->refillTsFn);
+  CHECK_STATUS;
+
+  pbts->nextPlayoutTime = pbts->playoutStartTime;
+  pbts->playout = true;
+  {
+    std::lock_guard<std::mutex> lock(pbts->playoutLock);
+    pbts->fillPlayout(); // Asks for the first frames
+  }
+
+  status = napi_get_undefined(env, &value);
+  CHECK_STATUS;
+  return value;
+}
+
+// Reads one frame for the playout queue, { video, audio, sampleFrameCount },
+// holding references to its buffers until it has been played
+static napi_status parsePlayoutFrame(napi_env env, playbackThreadsafe* pbts, napi_value value,
+    macadamFrame** result, std::string* error) {
+  napi_status status;
+  napi_value videoBuffer, audioBuffer, param;
+  napi_valuetype type;
+  bool isBuffer;
+  size_t audioDataSize;
+
+  status = napi_typeof(env, value, &type);
+  PASS_STATUS;
+  if (type != napi_object) {
+    *error = "Each frame to enqueue must be an object with a video buffer.";
+    return napi_invalid_arg;
+  }
+  status = napi_get_named_property(env, value, "video", &videoBuffer);
+  PASS_STATUS;
+  status = napi_is_buffer(env, videoBuffer, &isBuffer);
+  PASS_STATUS;
+  if (!isBuffer) {
+    *error = "Video data must be provided as a node buffer.";
+    return napi_invalid_arg;
+  }
+
+  macadamFrame* frame = new macadamFrame;
+  status = napi_get_buffer_info(env, videoBuffer, &frame->data, &frame->dataSize);
+  if ((status == napi_ok) && (((int32_t) frame->dataSize) < (pbts->rowBytes * pbts->height))) {
+    *error = "Insufficient bytes provided to enqueue video frame.";
+    status = napi_invalid_arg;
+  }
+  if ((status == napi_ok) && (pbts->channels > 0) && (pbts->audioFifo == nullptr)) {
+    status = napi_get_named_property(env, value, "audio", &audioBuffer);
+    if (status == napi_ok) status = napi_is_buffer(env, audioBuffer, &isBuffer);
+    if ((status == napi_ok) && !isBuffer) {
+      *error = "To enqueue a frame, an audio buffer must be provided.";
+      status = napi_invalid_arg;
+    }
+    if (status == napi_ok) {
+      status = napi_get_buffer_info(env, audioBuffer, &frame->audioData, &audioDataSize);
+    }
+    if (status == napi_ok) {
+      frame->sampleFrameCount = (uint32_t) (audioDataSize / pbts->sampleByteFactor);
+      status = napi_get_named_property(env, value, "sampleFrameCount", &param);
+    }
+    if (status == napi_ok) status = napi_typeof(env, param, &type);
+    if ((status == napi_ok) && (type == napi_number)) {
+      uint32_t sampleFrameCount;
+      status = napi_get_value_uint32(env, param, &sampleFrameCount);
+      if ((status == napi_ok) && (sampleFrameCount < frame->sampleFrameCount)) {
+        frame->sampleFrameCount = sampleFrameCount;
+      }
+    }
+  }
+  if (status != napi_ok) {
+    delete frame;
+    return status;
+  }
+
+  frame->width = pbts->width;
+  frame->height = pbts->height;
+  frame->rowBytes = pbts->rowBytes;
+  frame->pixelFormat = pbts->pixelFormat;
+  frame->timeScale = pbts->timeScale;
+  frame->deckLinkOutput = pbts->deckLinkOutput;
+  frame->tc = pbts->timecode;
+  frame->playout = true;
+  status = napi_create_reference(env, videoBuffer, 1, &frame->sourceBufferRef);
+  if ((status == napi_ok) && (frame->audioData != nullptr)) {
+    status = napi_create_reference(env, audioBuffer, 1, &frame->audioBufferRef);
+  }
+  if (status != napi_ok) {
+    if (frame->sourceBufferRef != nullptr) napi_delete_reference(env, frame->sourceBufferRef);
+    delete frame;
+    return status;
+  }
+  *result = frame;
+  return napi_ok;
+}
+
+// Adds a frame, or an array of frames, to the playout queue, with options
+// { end } to mark the last of the stream. Returns the number of frames
+// waiting to be scheduled.
+napi_value enqueue(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value playback, param, value, element;
+  napi_valuetype type;
+  playbackThreadsafe* pbts;
+  bool isArray;
+  bool end = false;
+  uint32_t count = 1;
+  size_t waiting;
+  bool startNow = false;
+  std::vector<macadamFrame*> frames;
+  std::string error;
+  HRESULT hresult;
+
+  size_t argc = 2;
+  napi_value argv[2];
   status = napi_get_cb_info(env, info, &argc, argv, &playback, nullptr);
   CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("A frame or an array of frames must be provided to enqueue.");
+  if (argc == 2) {
+    status = napi_typeof(env, argv[1], &type);
+    CHECK_STATUS;
+    if (type == napi_object) {
+      status = napi_get_named_property(env, argv[1], "end", &param);
+      CHECK_STATUS;
+      status = napi_coerce_to_bool(env, param, &param);
+      CHECK_STATUS;
+      status = napi_get_value_bool(env, param, &end);
+      CHECK_STATUS;
+    } else if (type != napi_undefined) NAPI_THROW_ERROR("Enqueue options must be an object.");
+  }
 
   status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
   CHECK_STATUS;
   status = napi_get_value_external(env, param, (void**) &pbts);
-  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already started and then stopped.");
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Cannot enqueue frames after playback has stopped.");
   CHECK_STATUS;
+  if (!pbts->playout) NAPI_THROW_ERROR("Start the playout queue with playout() before enqueuing frames.");
+  if (pbts->playoutEnded) NAPI_THROW_ERROR("Frames cannot be enqueued after the end of the playout.");
 
-  if (pbts->started) NAPI_THROW_ERROR("Already started.");
-
-  if (argc >= 1) {
-    status = napi_typeof(env, argv[0], &type);
-    CHECK_STATUS;
-    if (type != napi_object) NAPI_THROW_ERROR("Parameters must be provided in an object.");
-
-    status = napi_get_named_property(env, argv[0], "startTime", &param);
-    CHECK_STATUS;
-    status = napi_typeof(env, param, &type);
-    CHECK_STATUS;
-    if (type == napi_number) {
-      status = napi_get_value_int64(env, param, &startTime);
-      CHECK_STATUS;
-    } else if (type != napi_undefined) NAPI_THROW_ERROR("Playback start time must be a number.");
-
-    status = napi_get_named_property(env, argv[0], "playbackSpeed", &param);
-    CHECK_STATUS;
-    status = napi_typeof(env, param, &type);
+  status = napi_is_array(env, argv[0], &isArray);
+  CHECK_STATUS;
+  if (isArray) {
+    status = napi_get_array_length(env, argv[0], &count);
     CHECK_STATUS;
-    if (type == napi_number) {
-      status = napi_get_value_double(env, param, &playbackSpeed);
+  }
+  frames.reserve(count);
+  for ( uint32_t x = 0 ; x < count ; x++ ) {
+    macadamFrame* frame = nullptr;
+    element = argv[0];
+    status = isArray ? napi_get_element(env, argv[0], x, &element) : napi_ok;
+    if (status == napi_ok) status = parsePlayoutFrame(env, pbts, element, &frame, &error);
+    if (status != napi_ok) {
+      for ( auto parsed : frames ) {
+        napi_delete_reference(env, parsed->sourceBufferRef);
+        if (parsed->audioBufferRef != nullptr) napi_delete_reference(env, parsed->audioBufferRef);
+        delete parsed;
+      }
+      if (status == napi_invalid_arg) {
+        napi_throw_error(env, nullptr, error.c_str());
+        return nullptr;
+      }
       CHECK_STATUS;
-    } else if (type != napi_undefined) NAPI_THROW_ERROR("Playback speed must be a number.");
+    }
+    frames.push_back(frame);
   }
 
-  if (pbts->channels > 0) {
-    hresult = pbts->deckLinkOutput->EndAudioPreroll();
-    if (hresult != S_OK) NAPI_THROW_ERROR("Failed to end audio preroll.\n");
+  {
+    std::lock_guard<std::mutex> lock(pbts->playoutLock);
+    pbts->playoutQueue.insert(pbts->playoutQueue.end(), frames.begin(), frames.end());
+    if (end) pbts->playoutEnded = true;
+    pbts->fillPlayout();
+    waiting = pbts->playoutQueue.size();
+    // Start once depth frames are with the driver, or all there are of a shorter stream
+    startNow = !pbts->started && !pbts->playoutStopping &&
+      ((pbts->playoutScheduled >= pbts->playoutDepth) ||
+        (pbts->playoutEnded && (pbts->playoutScheduled > 0)));
   }
 
-  hresult = pbts->deckLinkOutput->StartScheduledPlayback(
-    startTime, pbts->timeScale, playbackSpeed);
-  if (hresult != S_OK) NAPI_THROW_ERROR("Failed to start scheduled playback.");
-
-  pbts->started = true;
+  if (startNow) {
+    hresult = startScheduled(pbts, pbts->playoutStartTime, pbts->playoutSpeed);
+    if (hresult != S_OK) NAPI_THROW_ERROR("Failed to start scheduled playback.");
+  }
 
-  status = napi_get_undefined(env, &value);
+  status = napi_create_uint32(env, (uint32_t) waiting, &value);
   CHECK_STATUS;
   return value;
 }
 
-napi_value played(napi_env env, napi_callback_info info) {
-  napi_value promise, playback, param;
-  napi_valuetype type;
-  scheduleCarrier* c = new scheduleCarrier;
-  playbackThreadsafe* pbts;
-
-  c->status = napi_create_promise(env, &c->_deferred, &promise);
-  REJECT_RETURN;
-
-  size_t argc = 1;
-  napi_value argv[1];
-  c->status = napi_get_cb_info(env, info, &argc, argv, &playback, nullptr);
-  REJECT_RETURN;
-
-  if (argc != 1) REJECT_ERROR_RETURN(
-    "Scheduled play time for played frame must be provided.", MACADAM_INVALID_ARGS);
-
-  c->status = napi_typeof(env, argv[0], &type);
-  REJECT_RETURN;
-  if (type != napi_number) REJECT_ERROR_RETURN(
-    "Played frame promise requires the scheduled time.",
-    MACADAM_INVALID_ARGS);
-
-  c->status = napi_get_value_int64(env, argv[0], &c->scheduledTime);
-  REJECT_RETURN;
-
-  c->status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
-  REJECT_RETURN;
-  c->status = napi_get_value_external(env, param, (void**) &pbts);
-  REJECT_RETURN;
+// Calls the playout refill function on the main thread with the number of frames wanted
+void playoutRefill(napi_env env, napi_value jsCb, void* context, void* data) {
+  napi_status status;
+  napi_value wanted, recv;
+  playbackThreadsafe* pbts = (playbackThreadsafe*) context;
 
-  auto existing = pbts->pendingPlays.find(c->scheduledTime);
-  if (existing != pbts->pendingPlays.end()) { // Should always go in here
-    c->status = napi_get_reference_value(env, existing->second->passthru, &promise);
-    REJECT_RETURN;
-    return promise;
-  }
+  if (env == nullptr) return; // Closing with a refill still queued
 
-  c->status = napi_create_reference(env, promise, 1, &c->passthru);
-  REJECT_RETURN;
+  status = napi_create_uint32(env, (uint32_t) (uintptr_t) data, &wanted);
+  FLOATING_STATUS;
+  status = napi_get_undefined(env, &recv);
+  FLOATING_STATUS;
+  status = napi_call_function(env, recv, jsCb, 1, &wanted, nullptr);
+  if (status != napi_ok) pbts->playoutRefillFailures++;
 
-  pbts->pendingPlays.insert(std::make_pair(c->scheduledTime, c));
-  return promise;
+  // Asks again from the next completion if frames are still short
+  std::lock_guard<std::mutex> lock(pbts->playoutLock);
+  pbts->refillPending = false;
 }
 
 napi_value scheduledStreamTime(napi_env env, napi_callback_info info) {
@@ -1584,6 +2769,51 @@ napi_value stopPlayback(napi_env env, napi_callback_info info) {
   if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
   CHECK_STATUS;
 
+  if (pbts->callbackQueueBlocking) {
+    // Wake any DeckLink callback blocked on a full queue so that stopping cannot deadlock
+    status = napi_release_threadsafe_function(pbts->tsFn, napi_tsfn_abort);
+    CHECK_STATUS;
+  }
+
+  if (pbts->playout) {
+    // No more frames are scheduled or refills asked for once stopping is set
+    std::deque<macadamFrame*> waiting;
+    {
+      std::lock_guard<std::mutex> lock(pbts->playoutLock);
+      pbts->playoutStopping = true;
+      waiting.swap(pbts->playoutQueue);
+    }
+    status = napi_release_threadsafe_function(pbts->refillTsFn, napi_tsfn_release);
+    CHECK_STATUS;
+    pbts->refillTsFn = nullptr;
+    for ( auto frame : waiting ) {
+      frame->result = bmdOutputFrameFlushed;
+      playoutPlayed(env, pbts, frame);
+    }
+  }
+
+  if (pbts->displayPool != nullptr) {
+    // Waits for a frame being displayed, rejecting those still queued
+    pbts->displayStopping = true;
+    delete pbts->displayPool;
+    pbts->displayPool = nullptr;
+    settleMissedDisplays(env, pbts);
+    status = napi_release_threadsafe_function(pbts->displayTsFn, napi_tsfn_release);
+    CHECK_STATUS;
+    pbts->displayTsFn = nullptr;
+  }
+
+  if (pbts->copyPool != nullptr) {
+    // Copies still waiting are rejected rather than scheduled
+    pbts->copyStopping = true;
+    delete pbts->copyPool;
+    pbts->copyPool = nullptr;
+    settleMissedCopies(env, pbts);
+    status = napi_release_threadsafe_function(pbts->copyTsFn, napi_tsfn_release);
+    CHECK_STATUS;
+    pbts->copyTsFn = nullptr;
+  }
+
   if (pbts->started) {
     hresult = pbts->deckLinkOutput->StopScheduledPlayback(0, nullptr, 0);
     if (hresult != S_OK) NAPI_THROW_ERROR("Failed to stop scheduled playback.");
@@ -1602,15 +2832,22 @@ napi_value stopPlayback(napi_env env, napi_callback_info info) {
   hresult = pbts->deckLinkOutput->SetScheduledFrameCompletionCallback(nullptr);
   if (hresult != S_OK) NAPI_THROW_ERROR("Failed to clear the frame completion callback.");
 
+  if (pbts->audioFifo != nullptr) {
+    hresult = pbts->deckLinkOutput->SetAudioCallback(nullptr);
+    if (hresult != S_OK) NAPI_THROW_ERROR("Failed to clear the audio callback.");
+  }
+
   if (pbts->channels > 0) {
     hresult = pbts->deckLinkOutput->DisableAudioOutput();
     if (hresult != S_OK) NAPI_THROW_ERROR("Failed to disable audio output.");
   }
 
-  // TODO consider clearing audio callback as a matter of course
+  if (!pbts->callbackQueueBlocking) {
+    status = napi_release_threadsafe_function(pbts->tsFn, napi_tsfn_release);
+    CHECK_STATUS;
+  }
 
-  status = napi_release_threadsafe_function(pbts->tsFn, napi_tsfn_release);
-  CHECK_STATUS;
+  resolveMissedCompletions(env, pbts);
 
   status = napi_get_undefined(env, &value);
   CHECK_STATUS;
@@ -1762,7 +2999,7 @@ napi_value setTimecode(napi_env env, napi_callback_info info) {
   playbackThreadsafe* pbts;
   HRESULT hresult;
   char tcstr[14];
-  const char* ftc;
+  char ftc[MACADAM_TIMECODE_STRING_SIZE];
   size_t tclen;
 
   size_t argc = 1;
@@ -1790,7 +3027,7 @@ napi_value setTimecode(napi_env env, napi_callback_info info) {
   if (pbts->timecode != nullptr) { delete pbts->timecode; }
   pbts->timecode = timecode;
 
-  pbts->timecode->formatTimecodeString(&ftc, pbts->timecode->fps > 30);
+  pbts->timecode->formatTimecodeString(ftc, pbts->timecode->fps > 30);
   status = napi_create_string_utf8(env, ftc, NAPI_AUTO_LENGTH, &result);
   CHECK_STATUS;
   status = napi_set_named_property(env, playback, "timecode", result);
@@ -1804,7 +3041,7 @@ napi_value getTimecode(napi_env env, napi_callback_info info) {
   napi_value result, playback, param;
   playbackThreadsafe* pbts;
   HRESULT hresult;
-  const char* ftc;
+  char ftc[MACADAM_TIMECODE_STRING_SIZE];
 
   size_t argc = 0;
   status = napi_get_cb_info(env, info, &argc, nullptr, &playback, nullptr);
@@ -1822,7 +3059,7 @@ napi_value getTimecode(napi_env env, napi_callback_info info) {
     return result;
   }
 
-  hresult = pbts->timecode->formatTimecodeString(&ftc, pbts->timecode->fps > 30);
+  hresult = pbts->timecode->formatTimecodeString(ftc, pbts->timecode->fps > 30);
   if (hresult != S_OK) NAPI_THROW_ERROR("Error parsing timecode.");
   status = napi_create_string_utf8(env, ftc, NAPI_AUTO_LENGTH, &result);
   CHECK_STATUS;
@@ -1890,6 +3127,366 @@ napi_value getTimecodeUserbits(napi_env env, napi_callback_info info) {
   return result;
 }
 
+napi_value playbackStats(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value playback, param, value;
+  playbackThreadsafe* pbts;
+  size_t missedCount;
+
+  size_t argc = 0;
+  status = napi_get_cb_info(env, info, &argc, nullptr, &playback, nullptr);
+  CHECK_STATUS;
+
+  status = napi_get_named_property(env, playback, "deckLinkOutput", &param);
+  CHECK_STATUS;
+  status = napi_get_value_external(env, param, (void**) &pbts);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Already stopped.");
+  CHECK_STATUS;
+
+  {
+    std::lock_guard<std::mutex> lock(pbts->missedLock);
+    missedCount = pbts->missedCompletions.size();
+  }
+
+  status = napi_create_object(env, &value);
+  CHECK_STATUS;
+  status = napi_create_string_utf8(env, "playbackStats", NAPI_AUTO_LENGTH, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "type", param);
+  CHECK_STATUS;
+
+  status = napi_create_uint32(env, pbts->callbackQueueSize, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "callbackQueueSize", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, pbts->callbackQueueFull.load(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "callbackQueueFull", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, pbts->callbackFailures.load(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "callbackFailures", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, (uint32_t) missedCount, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "missedCompletions", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, (uint32_t) pbts->pendingPlays.size(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "playedPending", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, (uint32_t) pbts->pendingPlays.capacity(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "playedRingSize", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, pbts->playedTimeouts, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, value, "playedTimeouts", param);
+  CHECK_STATUS;
+
+  if (pbts->channels > 0) {
+    status = napi_create_int64(env, pbts->audioShortWrites.load(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioShortWrites", param);
+    CHECK_STATUS;
+  }
+
+  if (pbts->audioFifo != nullptr) {
+    audioRingStats fifoStats;
+    pbts->audioFifo->getStats(&fifoStats);
+    status = napi_create_uint32(env, fifoStats.capacity, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioFifoSize", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, fifoStats.level, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioFifoLevel", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, pbts->audioTargetLevel, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioTargetLevel", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, pbts->audioBuffered.load(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioBuffered", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->audioScheduled.load(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioScheduled", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->audioUnderruns.load(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioUnderruns", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->audioUnderrunFrames.load(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioUnderrunFrames", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, fifoStats.overruns, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioOverruns", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, fifoStats.overrunFrames, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "audioOverrunFrames", param);
+    CHECK_STATUS;
+  }
+
+  if (pbts->displayPool != nullptr) {
+    status = napi_create_uint32(env, pbts->displayPool->queued(), &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "displayQueued", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, pbts->displayQueueSize, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "displayQueueSize", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->displayFrames, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "displayFrames", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->displayQueueFull, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "displayQueueFull", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->displayMicrosLast, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "displayMicrosLast", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->displayMicrosMax, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "displayMicrosMax", param);
+    CHECK_STATUS;
+  }
+
+  if (pbts->outputPool != nullptr) {
+    outputPoolStats poolStats;
+    pbts->outputPool->getStats(&poolStats);
+    status = napi_create_uint32(env, poolStats.frameCount, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "framePool", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, poolStats.inUse, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "framePoolInUse", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, poolStats.highWater, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "framePoolHighWater", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, poolStats.taken, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "framePoolTaken", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, poolStats.exhausted, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "framePoolExhausted", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, poolStats.copies, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "copies", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, poolStats.copyMicrosLast, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "copyMicrosLast", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, poolStats.copyMicrosMax, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "copyMicrosMax", param);
+    CHECK_STATUS;
+    status = napi_create_double(env, (poolStats.copies > 0) ?
+      ((double) poolStats.copyMicrosTotal) / poolStats.copies : 0.0, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "copyMicrosMean", param);
+    CHECK_STATUS;
+    status = napi_create_string_utf8(env, copyKernelName(), NAPI_AUTO_LENGTH, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "copyKernel", param);
+    CHECK_STATUS;
+  }
+
+  if (pbts->playout) {
+    size_t waiting;
+    uint32_t scheduled;
+    uint64_t frames, failures, underruns, skipped, refills, audioDropped;
+    bool ended;
+    {
+      std::lock_guard<std::mutex> lock(pbts->playoutLock);
+      ended = pbts->playoutEnded;
+      waiting = pbts->playoutQueue.size();
+      scheduled = pbts->playoutScheduled;
+      frames = pbts->playoutFrames;
+      failures = pbts->playoutFailures;
+      underruns = pbts->playoutUnderruns;
+      skipped = pbts->playoutSkipped;
+      refills = pbts->playoutRefills;
+      audioDropped = pbts->playoutAudioDropped;
+    }
+    status = napi_create_uint32(env, (uint32_t) waiting, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutWaiting", param);
+    CHECK_STATUS;
+    status = napi_create_uint32(env, scheduled, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutScheduled", param);
+    CHECK_STATUS;
+    status = napi_get_boolean(env, ended, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutEnded", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, frames, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutFrames", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, failures, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutFailures", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, underruns, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutUnderruns", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, skipped, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutSkipped", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, refills, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutRefills", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->playoutRefillFailures, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutRefillFailures", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, audioDropped, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutAudioDropped", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->playoutCompleted, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutCompleted", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->playoutLate, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutLate", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->playoutDropped, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutDropped", param);
+    CHECK_STATUS;
+    status = napi_create_int64(env, pbts->playoutFlushed, &param);
+    CHECK_STATUS;
+    status = napi_set_named_property(env, value, "playoutFlushed", param);
+    CHECK_STATUS;
+  }
+
+  return value;
+}
+
+// pendingPlayTest(depth, frames) - exercises the ring of pending played()
+// promises as a playback loop would, with a promise made depth frames ahead
+// of each frame played and every fourth promise left to time out. A promise
+// for a frame hours ahead is also left waiting throughout. Checks the ring
+// against a std::map of the same promises and times both.
+napi_value pendingPlayTest(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, param;
+  int64_t depth, frames;
+
+  size_t argc = 2;
+  napi_value argv[2];
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc != 2) NAPI_THROW_ERROR("Pending play test requires a depth and a frame count.");
+  status = napi_get_value_int64(env, argv[0], &depth);
+  CHECK_STATUS;
+  status = napi_get_value_int64(env, argv[1], &frames);
+  CHECK_STATUS;
+  if ((depth < 1) || (frames < 1)) NAPI_THROW_ERROR("Depth and frame count must be positive.");
+
+  const int64_t timeout = depth / 2 + 1; // Frames after which a skipped promise expires
+  std::vector<scheduleCarrier> carriers(depth + frames + 1);
+  for ( int64_t x = 0 ; x < (int64_t) carriers.size() ; x++ ) {
+    carriers[x].scheduledTime = x;
+  }
+  const int64_t far = depth + frames + 1000000; // Beyond the largest ring
+  scheduleCarrier* farCarrier = &carriers[depth + frames];
+  bool ok = true;
+  uint64_t ringFound = 0, ringExpired = 0, mapFound = 0, mapExpired = 0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  pendingPlayRing ring(8);
+  std::vector<scheduleCarrier*> expired;
+  ring.insert(far, farCarrier);
+  for ( int64_t x = 0 ; x < depth ; x++ ) ring.insert(x, &carriers[x]);
+  for ( int64_t x = 0 ; x < frames ; x++ ) {
+    ring.insert(x + depth, &carriers[x + depth]);
+    expired.clear();
+    ring.expire(x - timeout, &expired);
+    ringExpired += expired.size();
+    for ( auto e : expired ) ok = ok && ((e->scheduledTime % 4) == 3);
+    if ((x % 4) != 3) {
+      scheduleCarrier* c = ring.take(x);
+      ok = ok && (c == &carriers[x]);
+      ringFound++;
+    }
+  }
+  long long ringNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::high_resolution_clock::now() - start).count();
+
+  start = std::chrono::high_resolution_clock::now();
+  std::map<BMDTimeValue, scheduleCarrier*> pending;
+  pending.emplace(far, farCarrier);
+  for ( int64_t x = 0 ; x < depth ; x++ ) pending.emplace(x, &carriers[x]);
+  for ( int64_t x = 0 ; x < frames ; x++ ) {
+    pending.emplace(x + depth, &carriers[x + depth]);
+    auto end = pending.upper_bound(x - timeout);
+    for ( auto it = pending.begin() ; it != end ; it++ ) mapExpired++;
+    pending.erase(pending.begin(), end);
+    if ((x % 4) != 3) {
+      auto it = pending.find(x);
+      if (it != pending.end()) {
+        pending.erase(it);
+        mapFound++;
+      }
+    }
+  }
+  long long mapNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::high_resolution_clock::now() - start).count();
+
+  ok = ok && (ringFound == mapFound) && (ringExpired == mapExpired) &&
+    (ring.size() == pending.size()) && (ring.find(far) == farCarrier) &&
+    (ring.capacity() <= PENDING_RING_MAX);
+  expired.clear();
+  ring.expire(far, &expired);
+  ok = ok && (expired.size() == pending.size()) && (ring.size() == 0);
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = napi_get_boolean(env, ok, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "ok", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, (int64_t) ringExpired, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "expired", param);
+  CHECK_STATUS;
+  status = napi_create_uint32(env, (uint32_t) ring.capacity(), &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "ringSize", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, ringNanos, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "ringNanos", param);
+  CHECK_STATUS;
+  status = napi_create_int64(env, mapNanos, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "mapNanos", param);
+  CHECK_STATUS;
+
+  return result;
+}
+
 void playbackTsFnFinalize(napi_env env, void* data, void* hint) {
   // Decided to let the garbage collector clear this up.
   /* printf("Threadsafe playback finalizer called with data %p and hint %p.\n", data, hint);
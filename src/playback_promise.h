@@ -44,6 +44,11 @@
 #define PLAYBACK_PROMISE_H
 
 #include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 #ifdef WIN32
 #include <tchar.h>
@@ -55,6 +60,9 @@
 #define NAPI_EXPERIMENTAL
 #include "macadam_util.h"
 #include "timecode.h"
+#include "output_pool.h"
+#include "audio_ring.h"
+#include "worker_pool.h"
 #include "node_api.h"
 #include "DeckLinkAPI.h"
 
@@ -66,6 +74,13 @@ napi_value startPlayback(napi_env env, napi_callback_info info);
 napi_value stopPlayback(napi_env env, napi_callback_info info);
 napi_value schedule(napi_env env, napi_callback_info info);
 napi_value played(napi_env env, napi_callback_info info);
+napi_value playout(napi_env env, napi_callback_info info);
+napi_value enqueue(napi_env env, napi_callback_info info);
+void playoutRefill(napi_env env, napi_value jsCb, void* context, void* data);
+void copiedFrame(napi_env env, napi_value jsCb, void* context, void* data);
+void displayedFrame(napi_env env, napi_value jsCb, void* context, void* data);
+napi_value pullAudio(napi_env env, napi_callback_info info);
+napi_value writeAudio(napi_env env, napi_callback_info info);
 napi_value referenceStatus(napi_env env, napi_callback_info info);
 napi_value scheduledStreamTime(napi_env env, napi_callback_info info);
 napi_value hardwareReferenceClock(napi_env env, napi_callback_info info);
@@ -78,6 +93,7 @@ napi_value setTimecode(napi_env env, napi_callback_info info);
 napi_value getTimecode(napi_env env, napi_callback_info info);
 napi_value getTimecodeUserbits(napi_env env, napi_callback_info info);
 napi_value setTimecodeUserbits(napi_env env, napi_callback_info info);
+napi_value playbackStats(napi_env env, napi_callback_info info);
 
 struct playbackCarrier : carrier {
   IDeckLinkOutput* deckLinkOutput = nullptr;
@@ -94,7 +110,13 @@ struct playbackCarrier : carrier {
   bool isExternal = false;
   uint8_t keyLevel = 255;
   macadamTimecode* timecode = nullptr;
+  uint32_t callbackQueueSize = 20;
+  bool callbackQueueBlocking = false;
+  uint32_t framePool = 0; // Frames created with the driver for schedule(), zero for none
+  uint32_t displayQueueSize = 4;
+  macadamOutputPool* outputPool = nullptr;
   ~playbackCarrier() {
+    if (outputPool != nullptr) { delete outputPool; }
     if (deckLinkOutput != nullptr) { deckLinkOutput->Release(); }
     if (deckLinkKeyer != nullptr) { deckLinkKeyer->Release(); }
     if (selectedDisplayMode != nullptr) { selectedDisplayMode->Release(); }
@@ -116,6 +138,10 @@ struct macadamFrame : IDeckLinkVideoFrame {
   IDeckLinkOutput* deckLinkOutput = nullptr;
   napi_ref sourceBufferRef = nullptr;
   macadamTimecode* tc = nullptr;
+  bool playout = false; // Queued with enqueue() rather than scheduled by JS
+  void* audioData = nullptr; // Scheduled with the video by the playout queue
+  uint32_t sampleFrameCount = 0;
+  napi_ref audioBufferRef = nullptr;
   BMDOutputFrameCompletionResult result;
   long GetWidth (void) { return width; };
   long GetHeight (void) { return height; };
@@ -147,15 +173,75 @@ struct displayFrameCarrier : carrier, macadamFrame {
   ~displayFrameCarrier() {}
 };
 
+// Frame from schedule() waiting to be copied into a pooled frame on the copy
+// worker, then scheduled with the driver from there
+struct outputCopy {
+  outputPoolFrame* frame;
+  const void* src;
+  size_t size;
+  napi_ref sourceBufferRef = nullptr; // Held until the copy is made
+  void* audio = nullptr; // Scheduled once the video has been scheduled
+  uint32_t sampleFrameCount = 0;
+  napi_ref audioBufferRef = nullptr;
+  napi_deferred deferred;
+  bool hasTimecode = false;
+  BMDTimecodeFormat timecodeFormat = bmdTimecodeRP188Any;
+  uint8_t hours = 0;
+  uint8_t minutes = 0;
+  uint8_t seconds = 0;
+  uint8_t frames = 0;
+  BMDTimecodeFlags timecodeFlags = bmdTimecodeFlagDefault;
+  HRESULT result = S_OK;
+  HRESULT audioResult = S_OK;
+  long long copyMicros = 0;
+};
+
 struct scheduleCarrier : carrier {
   BMDTimeValue scheduledTime;
   ~scheduleCarrier () { };
 };
 
-struct playbackThreadsafe : IDeckLinkVideoOutputCallback {
+// Promises from played(), in a ring indexed by frame number - scheduled time
+// over frame duration - so that each is found, resolved or expired in
+// constant time. The ring doubles when the span of pending frames outgrows it.
+#define PENDING_RING_MAX 16384
+
+class pendingPlayRing {
+  struct slot {
+    int64_t frame;
+    scheduleCarrier* carrier;
+  };
+  std::vector<slot> slots; // Power of two in size
+  int64_t oldest = 0; // No promises in the ring are pending for earlier frames
+  int64_t newest = 0;
+  size_t count = 0; // In the ring
+  // Promises for frames too far from the others for the ring, which grows
+  // no larger than PENDING_RING_MAX slots
+  std::map<int64_t, scheduleCarrier*> outliers;
+
+  slot& at(int64_t frame) { return slots[(uint64_t) frame & (slots.size() - 1)]; }
+  scheduleCarrier* findInRing(int64_t frame);
+  void grow();
+  void evictFrom(int64_t limit);
+  void admitOutliers();
+
+  public:
+    pendingPlayRing(size_t capacity = 64);
+    scheduleCarrier* find(int64_t frame);
+    void insert(int64_t frame, scheduleCarrier* carrier);
+    // Removes and returns the promise for a frame, if any
+    scheduleCarrier* take(int64_t frame);
+    // Removes the promises for frames up to and including upTo, adding them to expired
+    void expire(int64_t upTo, std::vector<scheduleCarrier*>* expired);
+    size_t size() { return count + outliers.size(); }
+    size_t capacity() { return slots.size(); }
+};
+
+struct playbackThreadsafe : IDeckLinkVideoOutputCallback, IDeckLinkAudioOutputCallback {
   playbackThreadsafe() { };
   HRESULT ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result);
   HRESULT ScheduledPlaybackHasStopped();
+  HRESULT RenderAudioSamples(bool preroll);
   HRESULT	QueryInterface (REFIID iid, LPVOID *ppv) { return E_NOINTERFACE; }
   ULONG AddRef() { return 1; }
   ULONG Release() { return 1; }
@@ -173,14 +259,99 @@ struct playbackThreadsafe : IDeckLinkVideoOutputCallback {
   int32_t width;
   int32_t height;
   int32_t rowBytes;
-  bool started = false;
-  std::map<BMDTimeValue, scheduleCarrier*> pendingPlays;
+  std::atomic<bool> started { false }; // Also read when scheduling from the callback thread
+  pendingPlayRing pendingPlays; // Only touched on the main thread
+  std::vector<scheduleCarrier*> expiredPlays; // Reused for each completion
+  uint64_t playedTimeouts = 0;
   BMDTimeValue pendingTimeoutTicks = 1000;
   bool enableKeying = false;
   bool isExternal = false;
   uint8_t keyLevel = 255;
   macadamTimecode* timecode = nullptr;
+  // Threadsafe function queue between the DeckLink callback thread and the main thread
+  uint32_t callbackQueueSize = 20;
+  bool callbackQueueBlocking = false;
+  std::atomic<uint64_t> callbackQueueFull { 0 };
+  std::atomic<uint64_t> callbackFailures { 0 };
+  // Completions that could not be queued, resolved on the next main thread callback
+  std::mutex missedLock;
+  std::vector<macadamFrame*> missedCompletions;
+  // Playout queue, where frames from enqueue() are scheduled at consecutive
+  // times to keep playoutDepth frames with the driver. Scheduled from the
+  // main thread and on completion from the DeckLink callback thread.
+  bool playout = false;
+  std::mutex playoutLock;
+  std::deque<macadamFrame*> playoutQueue; // Waiting to be scheduled
+  uint32_t playoutDepth = 4;
+  uint32_t playoutLowWater = 4; // Ask JS for more at or below this many waiting
+  uint32_t playoutQueueSize = 12; // Refills ask for enough frames to fill to this
+  uint32_t playoutScheduled = 0; // With the driver
+  BMDTimeValue playoutStartTime = 0;
+  double playoutSpeed = 1.0;
+  BMDTimeValue nextPlayoutTime = 0;
+  bool playoutStopping = false;
+  bool playoutEnded = false; // Set by enqueue() when no more frames will follow
+  bool refillPending = false; // Until the refill function returns
+  napi_threadsafe_function refillTsFn = nullptr;
+  uint64_t playoutFrames = 0;
+  uint64_t playoutFailures = 0;
+  uint64_t playoutUnderruns = 0;
+  uint64_t playoutSkipped = 0; // Frame times passed over after running dry
+  uint64_t playoutRefills = 0;
+  uint64_t playoutAudioDropped = 0; // Sample frames the driver would not take
+  // Results of played playout frames and refills, only touched on the main thread
+  uint64_t playoutCompleted = 0;
+  uint64_t playoutLate = 0;
+  uint64_t playoutDropped = 0;
+  uint64_t playoutFlushed = 0;
+  uint64_t playoutRefillFailures = 0;
+  void fillPlayout();
+  // Output frame pool, where schedule() copies frames into driver frames on
+  // a native worker thread and they are recycled on completion
+  macadamOutputPool* outputPool = nullptr;
+  macadamWorkerPool* copyPool = nullptr;
+  napi_threadsafe_function copyTsFn = nullptr;
+  std::atomic<bool> copyStopping { false };
+  std::vector<outputCopy*> missedCopies; // Guarded by missedLock
+  void copyFrame(outputCopy* copy);
+  // Synchronous display on a native thread of this output, created on the
+  // first displayFrame(), so blocking driver calls never hold a libuv thread
+  uint32_t displayQueueSize = 4; // Frames waiting for the display thread
+  macadamWorkerPool* displayPool = nullptr;
+  napi_threadsafe_function displayTsFn = nullptr;
+  std::vector<displayFrameCarrier*> missedDisplays; // Guarded by missedLock
+  std::atomic<bool> displayStopping { false };
+  // Only touched on the main thread
+  uint64_t displayFrames = 0;
+  uint64_t displayQueueFull = 0;
+  long long displayMicrosLast = 0;
+  long long displayMicrosMax = 0;
+  // Pull mode audio, where JS writes samples in chunks of any length to a
+  // FIFO and the driver's RenderAudioSamples callback schedules them to keep
+  // audioTargetLevel sample frames buffered with the driver
+  macadamAudioRing* audioFifo = nullptr;
+  uint32_t audioTargetLevel = 0; // Sample frames
+  int64_t audioWritten = 0; // Sample frames written to the FIFO, only touched on the main thread
+  // Only touched on the driver's audio callback thread
+  int64_t audioNextTime = 0; // Of the next sample frame to schedule, in samples
+  std::vector<uint8_t> audioRenderBuffer;
+  uint32_t audioPendingFrames = 0; // Left at the front of audioRenderBuffer by a short write
+  std::atomic<uint32_t> audioBuffered { 0 }; // With the driver at the last callback
+  std::atomic<uint64_t> audioScheduled { 0 };
+  std::atomic<uint64_t> audioUnderruns { 0 };
+  std::atomic<uint64_t> audioUnderrunFrames { 0 };
+  std::atomic<uint64_t> audioShortWrites { 0 }; // Also counted for schedule() and playout
   ~playbackThreadsafe() {
+    if (audioFifo != nullptr) { delete audioFifo; }
+    if (displayPool != nullptr) { delete displayPool; }
+    if (copyPool != nullptr) { delete copyPool; }
+    if (outputPool != nullptr) { delete outputPool; }
+    for ( auto it = missedCompletions.begin() ; it != missedCompletions.end() ; ++it ) {
+      delete *it;
+    }
+    for ( auto copy : missedCopies ) delete copy;
+    for ( auto c : missedDisplays ) delete c;
+    for ( auto frame : playoutQueue ) delete frame;
     if (deckLinkOutput != nullptr) { deckLinkOutput->Release(); }
     if (deckLinkKeyer != nullptr) { deckLinkKeyer->Release(); }
     if (displayMode != nullptr) { displayMode->Release(); }
@@ -188,4 +359,12 @@ struct playbackThreadsafe : IDeckLinkVideoOutputCallback {
   }
 };
 
+void resolveMissedCompletions(napi_env env, playbackThreadsafe* pbts);
+void settleMissedCopies(napi_env env, playbackThreadsafe* pbts);
+void abandonCopy(napi_env env, playbackThreadsafe* pbts, outputCopy* copy);
+void settleMissedDisplays(napi_env env, playbackThreadsafe* pbts);
+void resolvePlayed(napi_env env, playbackThreadsafe* pbts, macadamFrame* frame);
+HRESULT startScheduled(playbackThreadsafe* pbts, BMDTimeValue startTime, double playbackSpeed);
+napi_value pendingPlayTest(napi_env env, napi_callback_info info);
+
 #endif // PLAYBACK_PROMISE_H
@@ -0,0 +1,819 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE 1 // For O_DIRECT
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <chrono>
+#include <vector>
+#include "recorder.h"
+#include "macadam_util.h"
+
+#ifdef WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+static int fileOpen(const std::string& path, bool direct) {
+  #ifdef WIN32
+  return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+  #elif defined(__linux__)
+  return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+  #else
+  return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  #endif
+}
+
+static int64_t fileWrite(int fd, const uint8_t* data, size_t size) {
+  #ifdef WIN32
+  return _write(fd, data, (unsigned int) size);
+  #else
+  return ::write(fd, data, size);
+  #endif
+}
+
+static bool fileSeek(int fd, uint64_t offset) {
+  #ifdef WIN32
+  return _lseeki64(fd, offset, SEEK_SET) >= 0;
+  #else
+  return lseek(fd, (off_t) offset, SEEK_SET) >= 0;
+  #endif
+}
+
+static void fileClose(int fd) {
+  #ifdef WIN32
+  _close(fd);
+  #else
+  ::close(fd);
+  #endif
+}
+
+static void* allocAligned(size_t size, size_t alignment) {
+  void* data = nullptr;
+  #ifdef WIN32
+  data = _aligned_malloc(size, alignment);
+  #else
+  if (posix_memalign(&data, alignment, size) != 0) data = nullptr;
+  #endif
+  return data;
+}
+
+static void freeAligned(void* data) {
+  #ifdef WIN32
+  _aligned_free(data);
+  #else
+  free(data);
+  #endif
+}
+
+recorderFile::~recorderFile() {
+  close();
+}
+
+bool recorderFile::open(const std::string& path, bool tryDirect, size_t size, std::string* error) {
+  direct = false;
+  #ifdef __linux__
+  if (tryDirect) {
+    fd = fileOpen(path, true);
+    // Some file systems, such as tmpfs, do not support O_DIRECT
+    if (fd >= 0) direct = true;
+  }
+  #endif
+  if (fd < 0) fd = fileOpen(path, false);
+  if (fd < 0) {
+    *error = "Unable to open " + path + " for recording: " + strerror(errno);
+    return false;
+  }
+  #ifdef __APPLE__
+  if (tryDirect) direct = fcntl(fd, F_NOCACHE, 1) == 0;
+  #endif
+
+  bufferSize = size;
+  fill = 0;
+  flushed = 0;
+  buffer = (uint8_t*) allocAligned(bufferSize, RECORDER_ALIGNMENT);
+  if (buffer == nullptr) {
+    *error = "Unable to allocate a recording buffer.";
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool recorderFile::writeOut(const uint8_t* data, size_t size) {
+  auto start = std::chrono::high_resolution_clock::now();
+  while (size > 0) {
+    int64_t written = fileWrite(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      error = errno;
+      return false;
+    }
+    data += written;
+    size -= (size_t) written;
+    flushed += (uint64_t) written;
+  }
+  long long micros = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::high_resolution_clock::now() - start).count();
+  writes++;
+  writeMicrosLast = micros;
+  writeMicrosTotal += micros;
+  if (micros > writeMicrosMax) writeMicrosMax = micros;
+  return true;
+}
+
+bool recorderFile::append(const uint8_t* data, size_t size) {
+  error = 0;
+  bytesAppended += size;
+  // Aligned source data, such as frames from the input allocator, is written
+  // without copying when the staging buffer holds only whole blocks
+  if ((((uintptr_t) data % RECORDER_ALIGNMENT) == 0) && (size >= RECORDER_ALIGNMENT) &&
+      ((fill % RECORDER_ALIGNMENT) == 0)) {
+    size_t alignedSize = size - size % RECORDER_ALIGNMENT;
+    if ((fill > 0) && !writeOut(buffer, fill)) return false;
+    fill = 0;
+    if (!writeOut(data, alignedSize)) return false;
+    data += alignedSize;
+    size -= alignedSize;
+  }
+
+  while (size > 0) {
+    size_t chunk = (size < bufferSize - fill) ? size : bufferSize - fill;
+    memcpy(buffer + fill, data, chunk);
+    fill += chunk;
+    data += chunk;
+    size -= chunk;
+    if (fill == bufferSize) {
+      if (!writeOut(buffer, fill)) return false;
+      fill = 0;
+    }
+  }
+  return true;
+}
+
+bool recorderFile::finish() {
+  error = 0;
+  if (fd < 0) return false;
+  size_t alignedSize = fill - fill % RECORDER_ALIGNMENT;
+  if ((alignedSize > 0) && !writeOut(buffer, alignedSize)) return false;
+  #ifdef __linux__
+  if (direct) { // Neither the tail nor later header updates are whole blocks
+    int flags = fcntl(fd, F_GETFL);
+    if ((flags < 0) || (fcntl(fd, F_SETFL, flags & ~O_DIRECT) < 0)) {
+      error = errno;
+      return false;
+    }
+  }
+  #endif
+  if ((fill > alignedSize) && !writeOut(buffer + alignedSize, fill - alignedSize)) return false;
+  fill = 0;
+  return true;
+}
+
+bool recorderFile::flush() {
+  error = 0;
+  if ((fd < 0) || direct) return false;
+  if ((fill > 0) && !writeOut(buffer, fill)) return false;
+  fill = 0;
+  return true;
+}
+
+bool recorderFile::writeAt(uint64_t offset, const uint8_t* data, size_t size) {
+  error = 0;
+  if ((fd < 0) || (fill > 0)) return false;
+  uint64_t end = flushed;
+  if (!fileSeek(fd, offset)) {
+    error = errno;
+    return false;
+  }
+  bool result = writeOut(data, size);
+  flushed = end;
+  if (result && !fileSeek(fd, end)) {
+    error = errno;
+    return false;
+  }
+  return result;
+}
+
+void recorderFile::close() {
+  if (fd >= 0) {
+    fileClose(fd);
+    fd = -1;
+  }
+  if (buffer != nullptr) {
+    freeAligned(buffer);
+    buffer = nullptr;
+  }
+}
+
+static inline void putLE16(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xff; p[1] = (v >> 8) & 0xff;
+}
+
+static inline void putLE32(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; p[2] = (v >> 16) & 0xff; p[3] = (v >> 24) & 0xff;
+}
+
+static inline void putLE64(uint8_t* p, uint64_t v) {
+  putLE32(p, (uint32_t) (v & 0xffffffff));
+  putLE32(p + 4, (uint32_t) (v >> 32));
+}
+
+std::string segmentPath(const std::string& path, uint32_t segment) {
+  char number[16];
+  snprintf(number, sizeof(number), "_%06u", segment);
+  size_t slash = path.find_last_of("/\\");
+  size_t dot = path.find_last_of('.');
+  if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)) ||
+      (dot == ((slash == std::string::npos) ? 0 : slash + 1))) {
+    return path + number; // No extension, or a dot file
+  }
+  return path.substr(0, dot) + number + path.substr(dot);
+}
+
+// RIFF/WAVE header with fmt, bext and JUNK chunks, sized so that the data
+// chunk's samples start at RECORDER_WAV_HEADER_SIZE. Sizes beyond the 4GB
+// limit of WAV are clamped.
+void writeWavHeader(uint8_t* header, uint32_t channels, uint32_t sampleRate,
+    uint32_t sampleType, uint64_t dataBytes, int64_t timeReference) {
+  uint8_t* p = header;
+  uint32_t blockAlign = channels * sampleType / 8;
+  bool extensible = channels > 2;
+  uint64_t riffSize = RECORDER_WAV_HEADER_SIZE - 8 + dataBytes;
+
+  memset(header, 0, RECORDER_WAV_HEADER_SIZE);
+  memcpy(p, "RIFF", 4);
+  putLE32(p + 4, (riffSize > 0xffffffff) ? 0xffffffff : (uint32_t) riffSize);
+  memcpy(p + 8, "WAVE", 4);
+  p += 12;
+
+  memcpy(p, "fmt ", 4);
+  putLE32(p + 4, extensible ? 40 : 16);
+  putLE16(p + 8, extensible ? 0xfffe : 1); // WAVE_FORMAT_EXTENSIBLE or WAVE_FORMAT_PCM
+  putLE16(p + 10, channels);
+  putLE32(p + 12, sampleRate);
+  putLE32(p + 16, sampleRate * blockAlign);
+  putLE16(p + 20, blockAlign);
+  putLE16(p + 22, sampleType);
+  if (extensible) {
+    static const uint8_t pcmGuid[16] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+      0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 };
+    putLE16(p + 24, 22);
+    putLE16(p + 26, sampleType); // Valid bits
+    putLE32(p + 28, 0); // No speaker positions
+    memcpy(p + 32, pcmGuid, 16);
+    p += 48;
+  } else {
+    p += 24;
+  }
+
+  // Broadcast extension (EBU Tech 3285) version 1, 602 bytes
+  memcpy(p, "bext", 4);
+  putLE32(p + 4, 602);
+  uint8_t* bext = p + 8;
+  strcpy((char*) bext, "Recorded by macadam"); // Description
+  strcpy((char*) bext + 256, "macadam"); // Originator
+  time_t now = time(nullptr);
+  struct tm local;
+  #ifdef WIN32
+  localtime_s(&local, &now);
+  #else
+  localtime_r(&now, &local);
+  #endif
+  char date[20];
+  strftime(date, sizeof(date), "%Y-%m-%d%H:%M:%S", &local);
+  memcpy(bext + 320, date, 18); // OriginationDate and OriginationTime
+  putLE64(bext + 338, (uint64_t) timeReference);
+  putLE16(bext + 346, 1); // Version
+  p += 8 + 602;
+
+  uint32_t junkSize = (uint32_t) (RECORDER_WAV_HEADER_SIZE - 8 - (p - header) - 8);
+  memcpy(p, "JUNK", 4);
+  putLE32(p + 4, junkSize);
+  p += 8 + junkSize;
+
+  memcpy(p, "data", 4);
+  putLE32(p + 4, (dataBytes > 0xffffffff) ? 0xffffffff : (uint32_t) dataBytes);
+}
+
+macadamRecorder::macadamRecorder(const recorderOptions& options) : options(options) {
+  if ((this->options.segmentSeconds > 0) && (this->options.frameDuration > 0)) {
+    uint64_t frames = ((uint64_t) this->options.segmentSeconds * this->options.timeScale +
+      this->options.frameDuration / 2) / this->options.frameDuration;
+    this->options.segmentFrames = (frames > 0xffffffff) ? 0xffffffff :
+      ((frames > 0) ? (uint32_t) frames : 1);
+  }
+}
+
+macadamRecorder::~macadamRecorder() {
+  close();
+}
+
+bool macadamRecorder::open(std::string* error) {
+  if (!openSegment(error)) return false;
+  writer = new macadamWorkerPool(1, options.queueDepth);
+  return true;
+}
+
+// Opens the files for the current segment, with their headers written
+bool macadamRecorder::openSegment(std::string* error) {
+  bool segmented = options.segmentFrames > 0;
+  hasTimeReference = false;
+  timeReference = 0;
+  segmentFrameCount = 0;
+
+  if (!options.videoPath.empty() && !videoFile.open(segmented ?
+      segmentPath(options.videoPath, segment) : options.videoPath,
+      options.directIO, options.writeSize, error)) {
+    return false;
+  }
+  if (!options.audioPath.empty() && (options.channels > 0)) {
+    if (!audioFile.open(segmented ? segmentPath(options.audioPath, segment) : options.audioPath,
+        options.directIO, options.writeSize, error)) {
+      videoFile.close();
+      return false;
+    }
+    uint8_t header[RECORDER_WAV_HEADER_SIZE];
+    writeWavHeader(header, options.channels, options.sampleRate, options.sampleType, 0, 0);
+    if (!audioFile.append(header, RECORDER_WAV_HEADER_SIZE)) {
+      *error = "Unable to write the audio file header.";
+      videoFile.close();
+      audioFile.close();
+      return false;
+    }
+  }
+  if (!options.indexPath.empty()) {
+    // Records are small and must be visible as soon as they are written
+    if (!indexFile.open(segmented ? segmentPath(options.indexPath, segment) : options.indexPath,
+        false, RECORDER_ALIGNMENT, error)) {
+      videoFile.close();
+      audioFile.close();
+      return false;
+    }
+    uint8_t header[RECORDER_INDEX_HEADER_SIZE];
+    memset(header, 0, RECORDER_INDEX_HEADER_SIZE);
+    memcpy(header, "MCDMIDX1", 8);
+    putLE32(header + 8, RECORDER_INDEX_HEADER_SIZE);
+    putLE32(header + 12, RECORDER_INDEX_RECORD_SIZE);
+    putLE32(header + 16, segment);
+    putLE32(header + 20, options.timeScale);
+    putLE64(header + 24, frameNumber);
+    putLE32(header + 32, options.frameDuration);
+    putLE32(header + 36, options.sampleRate);
+    putLE32(header + 40, options.channels);
+    putLE32(header + 44, options.sampleType);
+    if (!indexFile.append(header, RECORDER_INDEX_HEADER_SIZE) || !indexFile.flush()) {
+      *error = "Unable to write the index file header.";
+      videoFile.close();
+      audioFile.close();
+      indexFile.close();
+      return false;
+    }
+  }
+  return true;
+}
+
+// Completes and closes the current segment's files, returning false on any error
+bool macadamRecorder::closeSegment() {
+  uint64_t errorsBefore = errors;
+  if (videoFile.isOpen()) {
+    if (!videoFile.finish()) fail("Failed to complete video file", videoFile.lastError());
+  }
+  if (audioFile.isOpen()) {
+    if (audioFile.finish()) {
+      uint8_t header[RECORDER_WAV_HEADER_SIZE];
+      writeWavHeader(header, options.channels, options.sampleRate, options.sampleType,
+        audioFile.size() - RECORDER_WAV_HEADER_SIZE, timeReference);
+      if (!audioFile.writeAt(0, header, RECORDER_WAV_HEADER_SIZE)) {
+        fail("Failed to update audio file header", audioFile.lastError());
+      }
+    } else {
+      fail("Failed to complete audio file", audioFile.lastError());
+    }
+  }
+  // With the essence complete, every remaining record can be written
+  if (indexFile.isOpen() && !flushIndex()) fail("Failed to write index", indexFile.lastError());
+  pendingRecords.clear();
+  videoFile.close();
+  audioFile.close();
+  indexFile.close();
+  return errors == errorsBefore;
+}
+
+bool macadamRecorder::submit(const recorderFrame& frame) {
+  if ((writer == nullptr) || !writer->submit([this, frame](uint32_t workerIndex) {
+        writeFrame(frame);
+      })) {
+    framesDropped++;
+    if (frame.release != nullptr) frame.release(frame.releaseData);
+    return false;
+  }
+  uint32_t queued = writer->queued();
+  if (queued > queueHighWater) queueHighWater = queued;
+  return true;
+}
+
+void macadamRecorder::setError(const std::string& message) {
+  std::lock_guard<std::mutex> guard(errorLock);
+  errors++;
+  lastError = message;
+}
+
+void macadamRecorder::fail(const char* what, int error) {
+  setError((error != 0) ? std::string(what) + ": " + strerror(error) : std::string(what) + ".");
+}
+
+void macadamRecorder::addIndexRecord(const recorderFrame& frame, uint64_t videoOffset,
+    uint64_t audioOffset) {
+  pendingIndex pending;
+  uint8_t* r = pending.record;
+  putLE64(r, frameNumber);
+  putLE64(r + 8, videoOffset);
+  putLE64(r + 16, (uint64_t) frame.frameTime);
+  putLE64(r + 24, audioOffset);
+  putLE32(r + 32, (frame.video != nullptr) ? frame.videoBytes : 0);
+  putLE32(r + 36, (frame.audio != nullptr) ? frame.audioBytes : 0);
+  putLE32(r + 40, frame.timecodeBCD);
+  putLE16(r + 44, frame.timecodeFlags);
+  putLE16(r + 46, frame.indexFlags);
+  pending.videoEnd = videoFile.isOpen() ? videoFile.size() : 0;
+  pending.audioEnd = audioFile.isOpen() ? audioFile.size() : 0;
+  pendingRecords.push_back(pending);
+}
+
+// Writes the records of frames whose essence has reached the files
+bool macadamRecorder::flushIndex() {
+  bool added = false;
+  while (!pendingRecords.empty()) {
+    pendingIndex& pending = pendingRecords.front();
+    if ((pending.videoEnd > videoFile.written()) || (pending.audioEnd > audioFile.written())) break;
+    if (!indexFile.append(pending.record, RECORDER_INDEX_RECORD_SIZE)) return false;
+    pendingRecords.pop_front();
+    indexRecords++;
+    added = true;
+  }
+  return !added || indexFile.flush();
+}
+
+void macadamRecorder::writeFrame(const recorderFrame& frame) {
+  if (!failed && (options.segmentFrames > 0) && (segmentFrameCount == options.segmentFrames)) {
+    std::string error;
+    if (!closeSegment()) {
+      failed = true;
+    } else {
+      segment++;
+      if (!openSegment(&error)) {
+        setError(error);
+        failed = true;
+      }
+    }
+  }
+  if (failed) { // Stop after the first failure rather than leave holes in the files
+    framesDropped++;
+  } else {
+    uint64_t videoOffset = videoFile.size();
+    uint64_t audioOffset = audioFile.size();
+    if ((frame.video != nullptr) && videoFile.isOpen() &&
+        !videoFile.append(frame.video, frame.videoBytes)) {
+      fail("Failed to write video", videoFile.lastError());
+      failed = true;
+    }
+    if ((frame.audio != nullptr) && audioFile.isOpen() && !failed) {
+      if (!hasTimeReference) {
+        timeReference = frame.audioTime;
+        hasTimeReference = true;
+      }
+      if (!audioFile.append(frame.audio, frame.audioBytes)) {
+        fail("Failed to write audio", audioFile.lastError());
+        failed = true;
+      }
+    }
+    if (indexFile.isOpen() && !failed) {
+      addIndexRecord(frame, videoOffset, audioOffset);
+      if (!flushIndex()) {
+        fail("Failed to write index", indexFile.lastError());
+        failed = true;
+      }
+    }
+    if (failed) {
+      framesDropped++;
+    } else {
+      framesWritten++;
+      frameNumber++;
+      segmentFrameCount++;
+    }
+  }
+  if (frame.release != nullptr) frame.release(frame.releaseData);
+}
+
+void macadamRecorder::close() {
+  if (writer == nullptr) return;
+  delete writer; // Writes out any queued frames
+  writer = nullptr;
+  closeSegment();
+}
+
+void macadamRecorder::getStats(recorderStats* stats) {
+  stats->framesWritten = framesWritten;
+  stats->framesDropped = framesDropped;
+  stats->videoBytes = videoFile.bytesAppended;
+  stats->audioBytes = audioFile.bytesAppended;
+  stats->writes = videoFile.writes + audioFile.writes;
+  stats->writeMicrosTotal = videoFile.writeMicrosTotal + audioFile.writeMicrosTotal;
+  stats->writeMicrosMax = (videoFile.writeMicrosMax > audioFile.writeMicrosMax) ?
+    videoFile.writeMicrosMax : audioFile.writeMicrosMax;
+  stats->writeMicrosLast = videoFile.writeMicrosLast;
+  stats->queueLength = (writer != nullptr) ? writer->queued() : 0;
+  stats->queueHighWater = queueHighWater;
+  stats->queueDepth = options.queueDepth;
+  stats->directIO = (!options.videoPath.empty() || !options.audioPath.empty()) &&
+    (options.videoPath.empty() || videoFile.isDirect()) &&
+    (options.audioPath.empty() || audioFile.isDirect());
+  stats->errors = errors;
+  stats->segment = segment;
+  stats->indexRecords = indexRecords;
+}
+
+std::string macadamRecorder::getLastError() {
+  std::lock_guard<std::mutex> guard(errorLock);
+  return lastError;
+}
+
+// Adds record* properties to a stats object
+napi_status recorderStatsValue(napi_env env, macadamRecorder* recorder, napi_value obj) {
+  napi_status status;
+  napi_value param;
+  recorderStats stats;
+  recorder->getStats(&stats);
+
+  status = napi_create_int64(env, stats.framesWritten, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordFrames", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.framesDropped, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordDropped", param);
+  PASS_STATUS;
+  status = napi_create_double(env, (double) stats.videoBytes, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordVideoBytes", param);
+  PASS_STATUS;
+  status = napi_create_double(env, (double) stats.audioBytes, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordAudioBytes", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.writes, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordWrites", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.writeMicrosLast, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordWriteMicrosLast", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.writeMicrosMax, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordWriteMicrosMax", param);
+  PASS_STATUS;
+  status = napi_create_double(env, (stats.writes > 0) ?
+    (double) stats.writeMicrosTotal / stats.writes : 0.0, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordWriteMicrosMean", param);
+  PASS_STATUS;
+  status = napi_create_uint32(env, stats.queueLength, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordQueueLength", param);
+  PASS_STATUS;
+  status = napi_create_uint32(env, stats.queueHighWater, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordQueueHighWater", param);
+  PASS_STATUS;
+  status = napi_create_uint32(env, stats.queueDepth, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordQueueDepth", param);
+  PASS_STATUS;
+  status = napi_get_boolean(env, stats.directIO, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordDirectIO", param);
+  PASS_STATUS;
+  status = napi_create_uint32(env, stats.segment, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordSegment", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.indexRecords, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordIndexRecords", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.errors, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "recordErrors", param);
+  PASS_STATUS;
+  if (stats.errors > 0) {
+    std::string lastError = recorder->getLastError();
+    status = napi_create_string_utf8(env, lastError.c_str(), NAPI_AUTO_LENGTH, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, obj, "recordLastError", param);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+static napi_status getOptionalUint32(napi_env env, napi_value options, const char* name,
+    uint32_t* value) {
+  napi_status status;
+  napi_value param;
+  napi_valuetype type;
+  status = napi_get_named_property(env, options, name, &param);
+  PASS_STATUS;
+  status = napi_typeof(env, param, &type);
+  PASS_STATUS;
+  if (type == napi_undefined) return napi_ok;
+  return napi_get_value_uint32(env, param, value);
+}
+
+static napi_status getOptionalString(napi_env env, napi_value options, const char* name,
+    std::string* value) {
+  napi_status status;
+  napi_value param;
+  napi_valuetype type;
+  size_t length;
+  status = napi_get_named_property(env, options, name, &param);
+  PASS_STATUS;
+  status = napi_typeof(env, param, &type);
+  PASS_STATUS;
+  if (type == napi_undefined) return napi_ok;
+  status = napi_get_value_string_utf8(env, param, nullptr, 0, &length);
+  PASS_STATUS;
+  std::vector<char> chars(length + 1);
+  status = napi_get_value_string_utf8(env, param, chars.data(), length + 1, &length);
+  PASS_STATUS;
+  *value = chars.data();
+  return napi_ok;
+}
+
+// Parses { video, audio, index, directIO, queueDepth, writeSize,
+// segmentFrames, segmentSeconds }, returning
+// napi_invalid_arg for values out of range
+napi_status parseRecorderOptions(napi_env env, napi_value value, recorderOptions* options) {
+  napi_status status;
+  napi_value param;
+  napi_valuetype type;
+
+  status = napi_typeof(env, value, &type);
+  PASS_STATUS;
+  if (type != napi_object) return napi_invalid_arg;
+  status = getOptionalString(env, value, "video", &options->videoPath);
+  if (status == napi_string_expected) return napi_invalid_arg;
+  PASS_STATUS;
+  status = getOptionalString(env, value, "audio", &options->audioPath);
+  if (status == napi_string_expected) return napi_invalid_arg;
+  PASS_STATUS;
+  status = getOptionalString(env, value, "index", &options->indexPath);
+  if (status == napi_string_expected) return napi_invalid_arg;
+  PASS_STATUS;
+  status = getOptionalUint32(env, value, "segmentFrames", &options->segmentFrames);
+  if (status == napi_number_expected) return napi_invalid_arg;
+  PASS_STATUS;
+  status = getOptionalUint32(env, value, "segmentSeconds", &options->segmentSeconds);
+  if (status == napi_number_expected) return napi_invalid_arg;
+  PASS_STATUS;
+  if ((options->segmentFrames > 0) && (options->segmentSeconds > 0)) return napi_invalid_arg;
+  status = getOptionalUint32(env, value, "queueDepth", &options->queueDepth);
+  if (status == napi_number_expected) return napi_invalid_arg;
+  PASS_STATUS;
+  if ((options->queueDepth == 0) || (options->queueDepth > 1024)) return napi_invalid_arg;
+  status = getOptionalUint32(env, value, "writeSize", &options->writeSize);
+  if (status == napi_number_expected) return napi_invalid_arg;
+  PASS_STATUS;
+  if ((options->writeSize == 0) || ((options->writeSize % RECORDER_ALIGNMENT) != 0) ||
+      (options->writeSize > 256 * 1024 * 1024)) {
+    return napi_invalid_arg;
+  }
+  status = napi_get_named_property(env, value, "directIO", &param);
+  PASS_STATUS;
+  status = napi_typeof(env, param, &type);
+  PASS_STATUS;
+  if (type != napi_undefined) {
+    if (type != napi_boolean) return napi_invalid_arg;
+    status = napi_get_value_bool(env, param, &options->directIO);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+// recorderTest({ video, audio, index, frames, videoBytes, channels, sampleType,
+// sampleFrames, directIO, queueDepth, writeSize, segmentFrames, segmentSeconds })
+// records synthetic frames through the writer thread and returns its stats, so
+// that recording can be tested without a device. Every byte of video frame n
+// is n & 0xff. Audio sample frame n, channel c, has value (n * channels + c) & 0x7fff.
+// Frames are at 25fps, with frame n at stream time n * 1000 and timecode
+// 01:00:SS:FF counting from 01:00:00:00.
+napi_value recorderTest(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[1];
+  napi_value result;
+  napi_valuetype type;
+  size_t argc = 1;
+  recorderOptions options;
+  uint32_t frames = 25, videoBytes = 1 << 20, sampleFrames = 1920;
+  std::string error;
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("Recorder test options must be provided.");
+  status = napi_typeof(env, argv[0], &type);
+  CHECK_STATUS;
+  if (type != napi_object) NAPI_THROW_ERROR("Recorder test options must be an object.");
+
+  status = getOptionalUint32(env, argv[0], "frames", &frames);
+  CHECK_STATUS;
+  options.queueDepth = (frames > 0) ? frames : 1;
+  status = parseRecorderOptions(env, argv[0], &options);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Invalid recorder options.");
+  CHECK_STATUS;
+  options.channels = 2;
+  options.timeScale = 25000;
+  options.frameDuration = 1000;
+  status = getOptionalUint32(env, argv[0], "videoBytes", &videoBytes);
+  CHECK_STATUS;
+  status = getOptionalUint32(env, argv[0], "channels", &options.channels);
+  CHECK_STATUS;
+  status = getOptionalUint32(env, argv[0], "sampleType", &options.sampleType);
+  CHECK_STATUS;
+  if ((options.sampleType != 16) && (options.sampleType != 32)) NAPI_THROW_ERROR("Sample type must be 16 or 32.");
+  status = getOptionalUint32(env, argv[0], "sampleFrames", &sampleFrames);
+  CHECK_STATUS;
+
+  macadamRecorder* recorder = new macadamRecorder(options);
+  if (!recorder->open(&error)) {
+    delete recorder;
+    napi_throw_error(env, nullptr, error.c_str());
+    return nullptr;
+  }
+
+  uint32_t sampleBytes = options.sampleType / 8;
+  uint32_t audioBytes = sampleFrames * options.channels * sampleBytes;
+  uint64_t sample = 0;
+  for ( uint32_t n = 0 ; n < frames ; n++ ) {
+    recorderFrame frame;
+    // Video and audio share one block, freed when the frame is written.
+    // Odd frames are unaligned, so that both the copying and direct paths are used.
+    uint8_t* block = (uint8_t*) allocAligned(videoBytes + RECORDER_ALIGNMENT + audioBytes,
+      RECORDER_ALIGNMENT);
+    if (block == nullptr) {
+      delete recorder;
+      NAPI_THROW_ERROR("Unable to allocate a test frame.");
+    }
+    frame.video = block + (n & 1);
+    frame.videoBytes = videoBytes;
+    memset(block, n & 0xff, videoBytes + 1);
+    uint8_t* audio = block + videoBytes + RECORDER_ALIGNMENT;
+    for ( uint32_t i = 0 ; i < sampleFrames * options.channels ; i++ ) {
+      uint32_t value = (uint32_t) ((sample * options.channels + i) & 0x7fff);
+      if (sampleBytes == 2) {
+        ((int16_t*) audio)[i] = (int16_t) value;
+      } else {
+        ((int32_t*) audio)[i] = (int32_t) value;
+      }
+    }
+    frame.audio = audio;
+    frame.audioBytes = audioBytes;
+    frame.audioTime = (int64_t) sample + 1000;
+    sample += sampleFrames;
+    frame.frameTime = (int64_t) n * 1000;
+    uint32_t seconds = (n / 25) % 60, frameCount = n % 25;
+    frame.timecodeBCD = 0x01000000 | ((seconds / 10) << 12) | ((seconds % 10) << 8) |
+      ((frameCount / 10) << 4) | (frameCount % 10);
+    frame.indexFlags = recorderIndexHasTimecode;
+    frame.release = freeAligned;
+    frame.releaseData = block;
+    recorder->submit(frame);
+  }
+  recorder->close();
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = recorderStatsValue(env, recorder, result);
+  CHECK_STATUS;
+  delete recorder;
+  return result;
+}
@@ -0,0 +1,196 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include "worker_pool.h"
+#include "node_api.h"
+
+// Alignment of file offsets, sizes and buffers for direct I/O
+#define RECORDER_ALIGNMENT 4096
+// The WAV header is padded so that sample data starts on an aligned offset
+#define RECORDER_WAV_HEADER_SIZE RECORDER_ALIGNMENT
+// Index files are a fixed header followed by one fixed size record per frame
+#define RECORDER_INDEX_HEADER_SIZE 64
+#define RECORDER_INDEX_RECORD_SIZE 48
+
+// Bits of an index record's flags
+#define recorderIndexHasTimecode 0x01
+#define recorderIndexNoInputSource 0x02
+
+struct recorderOptions {
+  std::string videoPath; // Raw video essence, empty for none
+  std::string audioPath; // Broadcast WAV, empty for none
+  std::string indexPath; // Per-frame index, empty for none
+  uint32_t channels = 0;
+  uint32_t sampleRate = 48000;
+  uint32_t sampleType = 16; // Bits per sample
+  bool directIO = true; // Bypass the page cache where the file system allows
+  uint32_t queueDepth = 32; // Frames waiting for the writer thread
+  uint32_t writeSize = 4 * 1024 * 1024; // Bytes per write, a multiple of RECORDER_ALIGNMENT
+  // Start new files every segmentFrames frames, or every segmentSeconds when
+  // the frame rate is known. Zero for a single set of files.
+  uint32_t segmentFrames = 0;
+  uint32_t segmentSeconds = 0;
+  uint32_t timeScale = 0; // Frame rate, as timeScale / frameDuration
+  uint32_t frameDuration = 0;
+};
+
+// One frame of essence to be written. The data must remain valid until
+// release is called with releaseData, which happens on the writer thread
+// once the frame is written, or straight away if it is dropped.
+struct recorderFrame {
+  const uint8_t* video = nullptr;
+  uint32_t videoBytes = 0;
+  const uint8_t* audio = nullptr;
+  uint32_t audioBytes = 0;
+  int64_t audioTime = 0; // Stream time of the first sample frame, in samples
+  int64_t frameTime = 0; // Stream time of the video frame, in timeScale units
+  uint32_t timecodeBCD = 0;
+  uint16_t timecodeFlags = 0;
+  uint16_t indexFlags = 0; // recorderIndex* bits
+  void (*release)(void*) = nullptr;
+  void* releaseData = nullptr;
+};
+
+struct recorderStats {
+  uint64_t framesWritten;
+  uint64_t framesDropped; // Arrived while the writer queue was full
+  uint64_t videoBytes;
+  uint64_t audioBytes;
+  uint64_t writes; // Calls to write the file system
+  long long writeMicrosLast;
+  long long writeMicrosMax;
+  long long writeMicrosTotal;
+  uint32_t queueLength;
+  uint32_t queueHighWater;
+  uint32_t queueDepth;
+  bool directIO; // Whether every open file is using direct I/O
+  uint64_t errors;
+  uint32_t segment; // Number of the segment being written, from 0
+  uint64_t indexRecords; // Records written to index files
+};
+
+// Appends to a file through an aligned staging buffer, so that the file
+// system sees large writes of whole blocks at aligned offsets.
+class recorderFile {
+  int fd = -1;
+  bool direct = false;
+  uint8_t* buffer = nullptr;
+  size_t bufferSize = 0;
+  size_t fill = 0;
+  uint64_t flushed = 0; // Bytes written to the file
+  int error = 0; // errno of the last failed system call
+
+  bool writeOut(const uint8_t* data, size_t size);
+
+  public:
+    ~recorderFile();
+    std::atomic<uint64_t> bytesAppended { 0 }; // Readable from other threads, unlike size()
+    std::atomic<uint64_t> writes { 0 };
+    std::atomic<long long> writeMicrosLast { 0 };
+    std::atomic<long long> writeMicrosMax { 0 };
+    std::atomic<long long> writeMicrosTotal { 0 };
+
+    bool open(const std::string& path, bool tryDirect, size_t bufferSize, std::string* error);
+    bool append(const uint8_t* data, size_t size);
+    // Writes out the partial final block, leaving the file at its exact size
+    bool finish();
+    // Writes out everything appended, only for files opened without direct I/O
+    bool flush();
+    // Overwrites bytes already written, only after finish
+    bool writeAt(uint64_t offset, const uint8_t* data, size_t size);
+    void close();
+    bool isOpen() { return fd >= 0; }
+    bool isDirect() { return direct; }
+    // errno of the system call that failed the last operation, or 0 if it
+    // failed without one
+    int lastError() { return error; }
+    uint64_t size() { return flushed + fill; }
+    uint64_t written() { return flushed; } // Bytes that readers of the file can see
+};
+
+// Writes captured essence to disk on its own thread. Video frames are
+// appended to a raw essence file as captured, e.g. v210 or 2vuy, and audio
+// to a Broadcast WAV file whose header is completed when it is closed.
+// Optionally, files are rotated into numbered segments and an index file
+// gets a record for each frame once the frame's essence is on disk, so that
+// growing files can be read by frame.
+class macadamRecorder {
+  struct pendingIndex {
+    uint8_t record[RECORDER_INDEX_RECORD_SIZE];
+    uint64_t videoEnd; // File sizes at which the frame can be read
+    uint64_t audioEnd;
+  };
+
+  recorderOptions options;
+  macadamWorkerPool* writer = nullptr;
+  recorderFile videoFile;
+  recorderFile audioFile;
+  recorderFile indexFile;
+  // Only touched on the writer thread, apart from open and close
+  bool failed = false;
+  bool hasTimeReference = false;
+  int64_t timeReference = 0;
+  uint64_t frameNumber = 0; // Frames written since recording started
+  uint32_t segmentFrameCount = 0; // Frames written to the current segment
+  std::deque<pendingIndex> pendingRecords;
+  std::atomic<uint32_t> segment { 0 };
+  std::atomic<uint64_t> indexRecords { 0 };
+  std::atomic<uint64_t> framesWritten { 0 };
+  std::atomic<uint64_t> framesDropped { 0 };
+  std::atomic<uint64_t> errors { 0 };
+  std::atomic<uint32_t> queueHighWater { 0 };
+  std::mutex errorLock;
+  std::string lastError;
+
+  void writeFrame(const recorderFrame& frame);
+  bool openSegment(std::string* error);
+  bool closeSegment();
+  void addIndexRecord(const recorderFrame& frame, uint64_t videoOffset, uint64_t audioOffset);
+  bool flushIndex();
+  // Records an error, with the reason for a failed system call when error is set
+  void fail(const char* what, int error);
+  void setError(const std::string& message);
+
+  public:
+    macadamRecorder(const recorderOptions& options);
+    // Closes the files if still open
+    ~macadamRecorder();
+
+    bool open(std::string* error);
+    // Thread safe. Returns false, having released the frame, if it is dropped.
+    bool submit(const recorderFrame& frame);
+    // Writes any queued frames, then completes and closes the files
+    void close();
+    void getStats(recorderStats* stats);
+    std::string getLastError();
+};
+
+// Path of a numbered segment, with _NNNNNN inserted before the extension
+std::string segmentPath(const std::string& path, uint32_t segment);
+void writeWavHeader(uint8_t* header, uint32_t channels, uint32_t sampleRate,
+  uint32_t sampleType, uint64_t dataBytes, int64_t timeReference);
+napi_status parseRecorderOptions(napi_env env, napi_value value, recorderOptions* options);
+napi_status recorderStatsValue(napi_env env, macadamRecorder* recorder, napi_value obj);
+napi_value recorderTest(napi_env env, napi_callback_info info);
+
+#endif // RECORDER_H
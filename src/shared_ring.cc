@@ -0,0 +1,998 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "shared_ring.h"
+#include "macadam_util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static_assert(sizeof(sharedRingHeader) <= SHARED_RING_HEADER_SIZE, "Shared ring header is too large.");
+static_assert(sizeof(sharedRingSlot) <= SHARED_RING_ALIGNMENT, "Shared ring slot header is too large.");
+
+static inline uint64_t alignUp(uint64_t size) {
+  return (size + SHARED_RING_ALIGNMENT - 1) & ~((uint64_t) SHARED_RING_ALIGNMENT - 1);
+}
+
+uint32_t sharedRingRowBytes(uint32_t pixelFormat, uint32_t width) {
+  switch (pixelFormat) {
+    case bmdFormat8BitYUV: return width * 2;
+    case bmdFormat10BitYUV: return ((width + 47) / 48) * 128;
+    case bmdFormat8BitARGB:
+    case bmdFormat8BitBGRA: return width * 4;
+    case bmdFormat10BitRGB:
+    case bmdFormat10BitRGBXLE:
+    case bmdFormat10BitRGBX: return ((width + 63) / 64) * 256;
+    case bmdFormat12BitRGB:
+    case bmdFormat12BitRGBLE: return ((width + 7) / 8) * 36;
+    default: return width * 6;
+  }
+}
+
+bool validSharedRingName(const std::string& name) {
+  if (name.empty() || (name.length() > SHARED_RING_NAME_MAX)) return false;
+  for ( char ch : name ) {
+    if (!(((ch >= 'a') && (ch <= 'z')) || ((ch >= 'A') && (ch <= 'Z')) ||
+        ((ch >= '0') && (ch <= '9')) || (ch == '_') || (ch == '-'))) return false;
+  }
+  return true;
+}
+
+static std::string systemName(const std::string& name) {
+  #ifdef WIN32
+  return "Local\\" + name;
+  #else
+  return "/" + name;
+  #endif
+}
+
+static sharedMapping* mapOpen(const std::string& name, std::string* error);
+
+#ifndef WIN32
+// True for a ring whose producer closed it or exited without closing it.
+// Anything else by the same name, including a ring being written, is kept.
+static bool abandonedRing(const std::string& name) {
+  std::string error;
+  sharedMapping* existing = mapOpen(name, &error);
+  if (existing == nullptr) return false;
+  sharedRingHeader* header = existing->header();
+  bool abandoned = (header->state.load(std::memory_order_acquire) != SHARED_RING_OPEN) ||
+    ((kill((pid_t) header->producerId, 0) != 0) && (errno == ESRCH));
+  existing->release();
+  return abandoned;
+}
+#endif
+
+static sharedMapping* mapCreate(const std::string& name, size_t size, std::string* error) {
+  sharedMapping* mapping = new sharedMapping;
+  bool inUse = false;
+  mapping->size = size;
+  #ifdef WIN32
+  // The mapping only outlives its last handle, so an existing one is in use
+  mapping->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+    (DWORD) ((uint64_t) size >> 32), (DWORD) (size & 0xffffffff), systemName(name).c_str());
+  if ((mapping->handle != NULL) && (GetLastError() == ERROR_ALREADY_EXISTS)) {
+    CloseHandle(mapping->handle);
+    mapping->handle = NULL;
+    inUse = true;
+  }
+  if (mapping->handle != NULL) {
+    mapping->base = (uint8_t*) MapViewOfFile(mapping->handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  }
+  #else
+  std::string path = systemName(name);
+  int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if ((fd < 0) && (errno == EEXIST)) {
+    if (abandonedRing(name)) { // Replaces a ring left behind by a producer that did not close
+      shm_unlink(path.c_str());
+      fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    } else {
+      inUse = true;
+    }
+  }
+  if (fd >= 0) {
+    if (ftruncate(fd, (off_t) size) == 0) {
+      void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (base != MAP_FAILED) mapping->base = (uint8_t*) base;
+    }
+    close(fd);
+    if (mapping->base == nullptr) shm_unlink(path.c_str());
+  }
+  #endif
+  if (inUse) {
+    *error = "Shared memory " + name + " is in use by another producer.";
+    mapping->release();
+    return nullptr;
+  }
+  if (mapping->base == nullptr) {
+    *error = "Unable to create shared memory " + name + ": " + strerror(errno);
+    mapping->release();
+    return nullptr;
+  }
+  // Fault the pages in now, rather than on the capture callback thread
+  memset(mapping->base, 0, size);
+  return mapping;
+}
+
+// Maps an existing ring, read only
+static sharedMapping* mapOpen(const std::string& name, std::string* error) {
+  sharedMapping* mapping = new sharedMapping;
+  #ifdef WIN32
+  mapping->handle = OpenFileMappingA(FILE_MAP_READ, FALSE, systemName(name).c_str());
+  if (mapping->handle != NULL) {
+    mapping->base = (uint8_t*) MapViewOfFile(mapping->handle, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if ((mapping->base != nullptr) && (VirtualQuery(mapping->base, &info, sizeof(info)) > 0)) {
+      mapping->size = info.RegionSize;
+    }
+  }
+  #else
+  int fd = shm_open(systemName(name).c_str(), O_RDONLY, 0);
+  struct stat st;
+  if (fd >= 0) {
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+      void* base = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (base != MAP_FAILED) {
+        mapping->base = (uint8_t*) base;
+        mapping->size = (size_t) st.st_size;
+      }
+    }
+    close(fd);
+  }
+  #endif
+  if (mapping->base == nullptr) {
+    *error = "Unable to open shared ring " + name + ": " + strerror(errno);
+    mapping->release();
+    return nullptr;
+  }
+  sharedRingHeader* header = mapping->header();
+  if ((mapping->size < SHARED_RING_HEADER_SIZE) || (memcmp(header->magic, "MCDMSHM1", 8) != 0) ||
+      (header->headerSize != SHARED_RING_HEADER_SIZE) || (header->slotCount == 0) ||
+      (mapping->size < SHARED_RING_HEADER_SIZE + header->slotCount * header->slotSize)) {
+    *error = "Shared memory " + name + " is not a macadam frame ring.";
+    mapping->release();
+    return nullptr;
+  }
+  return mapping;
+}
+
+void sharedMapping::release() {
+  if (--references > 0) return;
+  #ifdef WIN32
+  if (base != nullptr) UnmapViewOfFile(base);
+  if (handle != NULL) CloseHandle(handle);
+  #else
+  if (base != nullptr) munmap(base, size);
+  #endif
+  delete this;
+}
+
+macadamSharedRing* macadamSharedRing::create(const std::string& name, uint32_t slots,
+    const sharedRingFormat& format, std::string* error) {
+  uint64_t slotSize = SHARED_RING_ALIGNMENT + alignUp(format.videoCapacity) +
+    alignUp(format.audioCapacity);
+  sharedMapping* mapping = mapCreate(name, (size_t) (SHARED_RING_HEADER_SIZE + slots * slotSize), error);
+  if (mapping == nullptr) return nullptr;
+
+  sharedRingHeader* header = mapping->header();
+  header->headerSize = SHARED_RING_HEADER_SIZE;
+  header->slotCount = slots;
+  header->slotSize = slotSize;
+  header->videoCapacity = format.videoCapacity;
+  header->audioCapacity = format.audioCapacity;
+  header->width = format.width;
+  header->height = format.height;
+  header->pixelFormat = format.pixelFormat;
+  header->timeScale = format.timeScale;
+  header->frameDuration = format.frameDuration;
+  header->sampleRate = format.sampleRate;
+  header->channels = format.channels;
+  header->sampleType = format.sampleType;
+  #ifdef WIN32
+  header->producerId = (uint32_t) GetCurrentProcessId();
+  #else
+  header->producerId = (uint32_t) getpid();
+  #endif
+  memcpy(header->magic, "MCDMSHM1", 8);
+  header->state.store(SHARED_RING_OPEN, std::memory_order_release);
+
+  macadamSharedRing* ring = new macadamSharedRing;
+  ring->name = name;
+  ring->mapping = mapping;
+  ring->linked = true;
+  return ring;
+}
+
+macadamSharedRing::~macadamSharedRing() {
+  close();
+  mapping->release();
+}
+
+void macadamSharedRing::publish(const sharedRingFrame& frame) {
+  sharedRingHeader* header = mapping->header();
+  uint64_t n = header->writeSequence.load(std::memory_order_relaxed);
+  sharedRingSlot* slot = mapping->slot(n);
+  uint8_t* video = (uint8_t*) slot + SHARED_RING_ALIGNMENT;
+  uint8_t* audio = video + alignUp(header->videoCapacity);
+
+  // Readers that see the odd sequence, or a changed one after reading, know
+  // that the slot has been overwritten
+  slot->sequence.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint32_t flags = frame.hasTimecode ? sharedRingHasTimecode : 0;
+  uint32_t videoBytes = frame.videoBytes;
+  if (videoBytes > header->videoCapacity) {
+    videoBytes = header->videoCapacity;
+    flags |= sharedRingTruncated;
+  }
+  uint32_t frameBytes = (header->channels * header->sampleType) / 8;
+  uint32_t sampleFrames = frame.sampleFrameCount;
+  if ((frameBytes > 0) && (sampleFrames > header->audioCapacity / frameBytes)) {
+    sampleFrames = header->audioCapacity / frameBytes;
+    flags |= sharedRingTruncated;
+  }
+  if (frame.video != nullptr) memcpy(video, frame.video, videoBytes);
+  if ((frame.audio != nullptr) && (frameBytes > 0)) {
+    memcpy(audio, frame.audio, (size_t) sampleFrames * frameBytes);
+  } else {
+    sampleFrames = 0;
+  }
+
+  slot->frameTime = frame.frameTime;
+  slot->frameDuration = frame.frameDuration;
+  slot->audioTime = frame.audioTime;
+  slot->videoBytes = (frame.video != nullptr) ? videoBytes : 0;
+  slot->rowBytes = frame.rowBytes;
+  slot->width = frame.width;
+  slot->height = frame.height;
+  slot->pixelFormat = frame.pixelFormat;
+  slot->frameFlags = frame.frameFlags;
+  slot->timecodeBCD = frame.timecodeBCD;
+  slot->timecodeFlags = frame.timecodeFlags;
+  slot->userbits = frame.userbits;
+  slot->sampleFrameCount = sampleFrames;
+  slot->flags = flags;
+
+  slot->sequence.store(2 * n + 2, std::memory_order_release);
+  header->writeSequence.store(n + 1, std::memory_order_release);
+  published++;
+  if (flags & sharedRingTruncated) truncated++;
+}
+
+void macadamSharedRing::close() {
+  if (!linked) return;
+  mapping->header()->state.store(SHARED_RING_CLOSED, std::memory_order_release);
+  #ifndef WIN32
+  shm_unlink(systemName(name).c_str());
+  #endif
+  linked = false;
+}
+
+struct sharedRingReader {
+  sharedMapping* mapping = nullptr; // Released by close
+  std::string name;
+  uint64_t next = 0; // Sequence of the next frame to read
+  uint64_t framesRead = 0;
+  uint64_t overruns = 0; // Times the reader fell more than a ring behind
+  uint64_t framesLost = 0; // Frames overwritten before they were read
+  uint64_t lag = 0; // Frames published after the last frame read
+  uint64_t maxLag = 0;
+};
+
+struct sharedRingCarrier : carrier {
+  sharedRingReader* reader;
+  sharedMapping* mapping; // Held while waiting
+  uint64_t next;
+  uint32_t timeout = 1000;
+  std::chrono::steady_clock::time_point deadline;
+  bool timedOut = false;
+  napi_threadsafe_function tsFn = nullptr; // Completes the wait on the main thread
+  ~sharedRingCarrier() { }
+};
+
+// Waits for the frames of every reader's frame() calls on a single native
+// thread, so that waiting readers never hold libuv pool threads. Polls, as
+// the producer never waits on or signals its readers.
+class sharedRingWaiter {
+  std::mutex lock;
+  std::condition_variable wake;
+  std::vector<sharedRingCarrier*> waiting;
+  std::thread thread;
+  bool stopping = false;
+
+  void run();
+
+  public:
+    ~sharedRingWaiter();
+    void add(sharedRingCarrier* c);
+};
+
+static sharedRingWaiter waiter;
+
+void sharedRingWaiter::add(sharedRingCarrier* c) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!thread.joinable()) thread = std::thread(&sharedRingWaiter::run, this);
+  waiting.push_back(c);
+  wake.notify_one();
+}
+
+void sharedRingWaiter::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  while (!stopping) {
+    if (waiting.empty()) {
+      wake.wait(guard);
+      continue;
+    }
+    auto now = std::chrono::steady_clock::now();
+    for ( auto it = waiting.begin() ; it != waiting.end() ; ) {
+      sharedRingCarrier* c = *it;
+      sharedRingHeader* header = c->mapping->header();
+      bool ready = (header->writeSequence.load(std::memory_order_acquire) > c->next) ||
+        (header->state.load(std::memory_order_acquire) != SHARED_RING_OPEN);
+      if (!ready && (now < c->deadline)) {
+        ++it;
+        continue;
+      }
+      c->timedOut = !ready;
+      it = waiting.erase(it);
+      napi_threadsafe_function tsFn = c->tsFn;
+      if (napi_call_threadsafe_function(tsFn, c, napi_tsfn_nonblocking) != napi_ok) {
+        c->mapping->release(); // Closing, so the promise cannot be settled
+        delete c;
+      }
+      napi_release_threadsafe_function(tsFn, napi_tsfn_release);
+    }
+    wake.wait_for(guard, std::chrono::milliseconds(1));
+  }
+}
+
+sharedRingWaiter::~sharedRingWaiter() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_one();
+  if (thread.joinable()) thread.join();
+}
+
+// Takes a consistent copy of the next slot's header, skipping frames that
+// have been overwritten. Returns false if no frame is ready.
+static bool readNext(sharedRingReader* reader, sharedRingSlot* copy, uint64_t* sequence) {
+  sharedRingHeader* header = reader->mapping->header();
+  uint32_t slots = header->slotCount;
+  for (;;) {
+    uint64_t written = header->writeSequence.load(std::memory_order_acquire);
+    if (reader->next >= written) return false;
+    // The producer may be writing the slot of frame written - slots
+    if (written - reader->next > slots - 1) {
+      uint64_t oldest = written - slots + 1;
+      reader->overruns++;
+      reader->framesLost += oldest - reader->next;
+      reader->next = oldest;
+    }
+    sharedRingSlot* slot = reader->mapping->slot(reader->next);
+    uint64_t expected = 2 * reader->next + 2;
+    uint64_t before = slot->sequence.load(std::memory_order_acquire);
+    if (before != expected) continue; // Overwritten since writeSequence was read
+    copy->frameTime = slot->frameTime;
+    copy->frameDuration = slot->frameDuration;
+    copy->audioTime = slot->audioTime;
+    copy->videoBytes = slot->videoBytes;
+    copy->rowBytes = slot->rowBytes;
+    copy->width = slot->width;
+    copy->height = slot->height;
+    copy->pixelFormat = slot->pixelFormat;
+    copy->frameFlags = slot->frameFlags;
+    copy->timecodeBCD = slot->timecodeBCD;
+    copy->timecodeFlags = slot->timecodeFlags;
+    copy->userbits = slot->userbits;
+    copy->sampleFrameCount = slot->sampleFrameCount;
+    copy->flags = slot->flags;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->sequence.load(std::memory_order_relaxed) != before) continue;
+
+    *sequence = reader->next;
+    reader->lag = written - reader->next - 1;
+    if (reader->lag > reader->maxLag) reader->maxLag = reader->lag;
+    reader->next++;
+    reader->framesRead++;
+    return true;
+  }
+}
+
+static void finalizeSharedBuffer(napi_env env, void* data, void* hint) {
+  ((sharedMapping*) hint)->release();
+}
+
+static napi_status setUint32(napi_env env, napi_value obj, const char* name, uint32_t value) {
+  napi_status status;
+  napi_value param;
+  status = napi_create_uint32(env, value, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, obj, name, param);
+}
+
+static napi_status setInt64(napi_env env, napi_value obj, const char* name, int64_t value) {
+  napi_status status;
+  napi_value param;
+  status = napi_create_int64(env, value, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, obj, name, param);
+}
+
+static napi_status setBoolean(napi_env env, napi_value obj, const char* name, bool value) {
+  napi_status status;
+  napi_value param;
+  status = napi_get_boolean(env, value, &param);
+  PASS_STATUS;
+  return napi_set_named_property(env, obj, name, param);
+}
+
+// Builds a frame object whose data Buffers point into the ring
+static napi_status sharedFrameValue(napi_env env, sharedRingReader* reader,
+    const sharedRingSlot& slot, uint64_t sequence, napi_value* result) {
+  napi_status status;
+  napi_value obj, param;
+  sharedMapping* mapping = reader->mapping;
+  uint8_t* video = (uint8_t*) mapping->slot(sequence) + SHARED_RING_ALIGNMENT;
+  uint8_t* audio = video + alignUp(mapping->header()->videoCapacity);
+
+  status = napi_create_object(env, result);
+  PASS_STATUS;
+  status = napi_create_string_utf8(env, "frame", NAPI_AUTO_LENGTH, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *result, "type", param);
+  PASS_STATUS;
+  status = setInt64(env, *result, "sequence", (int64_t) sequence);
+  PASS_STATUS;
+  status = setInt64(env, *result, "lag", (int64_t) reader->lag);
+  PASS_STATUS;
+  status = setBoolean(env, *result, "truncated", (slot.flags & sharedRingTruncated) != 0);
+  PASS_STATUS;
+
+  status = napi_create_object(env, &obj);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *result, "video", obj);
+  PASS_STATUS;
+  status = napi_create_string_utf8(env, "videoFrame", NAPI_AUTO_LENGTH, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "type", param);
+  PASS_STATUS;
+  status = setUint32(env, obj, "width", slot.width);
+  PASS_STATUS;
+  status = setUint32(env, obj, "height", slot.height);
+  PASS_STATUS;
+  status = setUint32(env, obj, "rowBytes", slot.rowBytes);
+  PASS_STATUS;
+  status = setUint32(env, obj, "pixelFormat", slot.pixelFormat);
+  PASS_STATUS;
+  status = setInt64(env, obj, "frameTime", slot.frameTime);
+  PASS_STATUS;
+  status = setInt64(env, obj, "frameDuration", slot.frameDuration);
+  PASS_STATUS;
+  status = setUint32(env, obj, "frameFlags", slot.frameFlags);
+  PASS_STATUS;
+  if (slot.flags & sharedRingHasTimecode) {
+    status = setUint32(env, obj, "timecodeBCD", slot.timecodeBCD);
+    PASS_STATUS;
+    status = setUint32(env, obj, "timecodeFlags", slot.timecodeFlags);
+    PASS_STATUS;
+    status = setUint32(env, obj, "userbits", slot.userbits);
+    PASS_STATUS;
+  }
+  mapping->addRef();
+  status = napi_create_external_buffer(env, slot.videoBytes, video,
+    finalizeSharedBuffer, mapping, &param);
+  if (status != napi_ok) mapping->release();
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "data", param);
+  PASS_STATUS;
+
+  if (slot.sampleFrameCount > 0) {
+    sharedRingHeader* header = mapping->header();
+    status = napi_create_object(env, &obj);
+    PASS_STATUS;
+    status = napi_set_named_property(env, *result, "audio", obj);
+    PASS_STATUS;
+    status = napi_create_string_utf8(env, "audioPacket", NAPI_AUTO_LENGTH, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, obj, "type", param);
+    PASS_STATUS;
+    status = setUint32(env, obj, "sampleFrameCount", slot.sampleFrameCount);
+    PASS_STATUS;
+    status = setInt64(env, obj, "packetTime", slot.audioTime);
+    PASS_STATUS;
+    mapping->addRef();
+    status = napi_create_external_buffer(env,
+      slot.sampleFrameCount * ((header->channels * header->sampleType) / 8), audio,
+      finalizeSharedBuffer, mapping, &param);
+    if (status != napi_ok) mapping->release();
+    PASS_STATUS;
+    status = napi_set_named_property(env, obj, "data", param);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+static napi_status getReader(napi_env env, napi_callback_info info, size_t* argc,
+    napi_value* argv, napi_value* readerObj, sharedRingReader** reader) {
+  napi_status status;
+  napi_value param, thisArg;
+  status = napi_get_cb_info(env, info, argc, argv, &thisArg, nullptr);
+  PASS_STATUS;
+  status = napi_get_named_property(env, thisArg, "sharedRing", &param);
+  PASS_STATUS;
+  status = napi_get_value_external(env, param, (void**) reader);
+  PASS_STATUS;
+  if (readerObj != nullptr) *readerObj = thisArg;
+  return napi_ok;
+}
+
+// reader.read() returns the next frame, or undefined when none is ready
+static napi_value sharedRingRead(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  sharedRingReader* reader;
+  sharedRingSlot copy;
+  uint64_t sequence;
+  size_t argc = 0;
+
+  status = getReader(env, info, &argc, nullptr, nullptr, &reader);
+  CHECK_STATUS;
+  if (reader->mapping == nullptr) NAPI_THROW_ERROR("Shared ring reader is closed.");
+  if (!readNext(reader, &copy, &sequence)) {
+    status = napi_get_undefined(env, &result);
+    CHECK_STATUS;
+    return result;
+  }
+  status = sharedFrameValue(env, reader, copy, sequence, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+// Called on the main thread by the waiter once a frame is ready or the wait times out
+static void sharedRingAwaitComplete(napi_env env, napi_value jsCb, void* context, void* data) {
+  sharedRingCarrier* c = (sharedRingCarrier*) data;
+  napi_value result;
+  sharedRingSlot copy;
+  uint64_t sequence;
+  c->mapping->release();
+
+  if (env == nullptr) { // Closing with the completion still queued
+    delete c;
+    return;
+  }
+  if (c->timedOut) {
+    c->status = MACADAM_FRAME_TIMEOUT;
+    c->errorMsg = "Timed out waiting for a frame from the shared ring.";
+  }
+  REJECT_STATUS;
+
+  // Undefined once the ring is closed with no frames left, or if closed while waiting
+  if ((c->reader->mapping != nullptr) && readNext(c->reader, &copy, &sequence)) {
+    c->status = sharedFrameValue(env, c->reader, copy, sequence, &result);
+  } else {
+    c->status = napi_get_undefined(env, &result);
+  }
+  REJECT_STATUS;
+
+  napi_status status;
+  status = napi_resolve_deferred(env, c->_deferred, result);
+  FLOATING_STATUS;
+  tidyCarrier(env, c);
+}
+
+// reader.frame(timeout) resolves to the next frame, waiting up to timeout milliseconds
+static napi_value sharedRingAwaitFrame(napi_env env, napi_callback_info info) {
+  napi_value promise, readerObj, resourceName, nopFn;
+  napi_valuetype type;
+  sharedRingCarrier* c = new sharedRingCarrier;
+  size_t argc = 1;
+  napi_value argv[1];
+
+  c->status = napi_create_promise(env, &c->_deferred, &promise);
+  REJECT_RETURN;
+  c->status = getReader(env, info, &argc, argv, &readerObj, &c->reader);
+  REJECT_RETURN;
+  if (c->reader->mapping == nullptr) REJECT_ERROR_RETURN(
+    "Shared ring reader is closed.", MACADAM_ALREADY_STOPPED);
+  if (argc >= 1) {
+    c->status = napi_typeof(env, argv[0], &type);
+    REJECT_RETURN;
+    if (type != napi_undefined) {
+      if (type != napi_number) REJECT_ERROR_RETURN(
+        "Shared ring frame timeout must be a number of milliseconds.", MACADAM_INVALID_ARGS);
+      c->status = napi_get_value_uint32(env, argv[0], &c->timeout);
+      REJECT_RETURN;
+    }
+  }
+  // Keeps the reader alive while waiting
+  c->status = napi_create_reference(env, readerObj, 1, &c->passthru);
+  REJECT_RETURN;
+
+  c->status = napi_create_string_utf8(env, "SharedRingFrame", NAPI_AUTO_LENGTH, &resourceName);
+  REJECT_RETURN;
+  c->status = napi_create_function(env, "nop", NAPI_AUTO_LENGTH, nop, nullptr, &nopFn);
+  REJECT_RETURN;
+  c->status = napi_create_threadsafe_function(env, nopFn, nullptr, resourceName,
+    0, 1, nullptr, nullptr, nullptr, sharedRingAwaitComplete, &c->tsFn);
+  REJECT_RETURN;
+
+  c->mapping = c->reader->mapping;
+  c->mapping->addRef();
+  c->next = c->reader->next;
+  c->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(c->timeout);
+  waiter.add(c);
+
+  return promise;
+}
+
+// reader.valid(frame) is false once the frame's slot has been overwritten,
+// after which its data Buffers no longer hold the frame
+static napi_value sharedRingValid(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result, param;
+  sharedRingReader* reader;
+  int64_t sequence;
+  size_t argc = 1;
+  napi_value argv[1];
+
+  status = getReader(env, info, &argc, argv, nullptr, &reader);
+  CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("A frame read from the shared ring must be provided.");
+  if (reader->mapping == nullptr) NAPI_THROW_ERROR("Shared ring reader is closed.");
+  status = napi_get_named_property(env, argv[0], "sequence", &param);
+  CHECK_STATUS;
+  status = napi_get_value_int64(env, param, &sequence);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Frame must have a sequence number.");
+  CHECK_STATUS;
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  status = napi_get_boolean(env, (sequence >= 0) &&
+    (reader->mapping->slot((uint64_t) sequence)->sequence.load(std::memory_order_acquire) ==
+      2 * (uint64_t) sequence + 2), &result);
+  CHECK_STATUS;
+  return result;
+}
+
+static napi_value sharedRingStats(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  sharedRingReader* reader;
+  size_t argc = 0;
+
+  status = getReader(env, info, &argc, nullptr, nullptr, &reader);
+  CHECK_STATUS;
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = setInt64(env, result, "framesRead", (int64_t) reader->framesRead);
+  CHECK_STATUS;
+  status = setInt64(env, result, "overruns", (int64_t) reader->overruns);
+  CHECK_STATUS;
+  status = setInt64(env, result, "framesLost", (int64_t) reader->framesLost);
+  CHECK_STATUS;
+  status = setInt64(env, result, "lag", (int64_t) reader->lag);
+  CHECK_STATUS;
+  status = setInt64(env, result, "maxLag", (int64_t) reader->maxLag);
+  CHECK_STATUS;
+  if (reader->mapping != nullptr) {
+    sharedRingHeader* header = reader->mapping->header();
+    uint64_t written = header->writeSequence.load(std::memory_order_acquire);
+    status = setInt64(env, result, "published", (int64_t) written);
+    CHECK_STATUS;
+    status = setInt64(env, result, "waiting", (int64_t) ((written > reader->next) ?
+      written - reader->next : 0));
+    CHECK_STATUS;
+    status = setBoolean(env, result, "producerClosed",
+      header->state.load(std::memory_order_acquire) != SHARED_RING_OPEN);
+    CHECK_STATUS;
+  }
+  return result;
+}
+
+// reader.close() unmaps the ring once Buffers from it have been collected
+static napi_value sharedRingClose(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  sharedRingReader* reader;
+  size_t argc = 0;
+
+  status = getReader(env, info, &argc, nullptr, nullptr, &reader);
+  CHECK_STATUS;
+  if (reader->mapping != nullptr) {
+    reader->mapping->release();
+    reader->mapping = nullptr;
+  }
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+static void finalizeSharedRingReader(napi_env env, void* data, void* hint) {
+  sharedRingReader* reader = (sharedRingReader*) data;
+  if (reader->mapping != nullptr) reader->mapping->release();
+  delete reader;
+}
+
+static napi_status setMethod(napi_env env, napi_value obj, const char* name, napi_callback cb) {
+  napi_status status;
+  napi_value fn;
+  status = napi_create_function(env, name, NAPI_AUTO_LENGTH, cb, nullptr, &fn);
+  PASS_STATUS;
+  return napi_set_named_property(env, obj, name, fn);
+}
+
+static napi_status getString(napi_env env, napi_value value, std::string* result) {
+  napi_status status;
+  size_t length;
+  status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+  PASS_STATUS;
+  std::vector<char> chars(length + 1);
+  status = napi_get_value_string_utf8(env, value, chars.data(), length + 1, &length);
+  PASS_STATUS;
+  *result = chars.data();
+  return napi_ok;
+}
+
+// openSharedRing({ name, start }) maps a ring published by a capture, in this
+// or another process. Reading starts with the next frame published, or with
+// the oldest frame still held for start: 'oldest'.
+napi_value openSharedRing(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[1];
+  napi_value result, param;
+  napi_valuetype type;
+  size_t argc = 1;
+  std::string name, start = "next", error;
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("Shared ring options must be provided.");
+  status = napi_typeof(env, argv[0], &type);
+  CHECK_STATUS;
+  if (type != napi_object) NAPI_THROW_ERROR("Shared ring options must be an object.");
+  status = napi_get_named_property(env, argv[0], "name", &param);
+  CHECK_STATUS;
+  status = getString(env, param, &name);
+  if ((status == napi_string_expected) || !validSharedRingName(name)) NAPI_THROW_ERROR(
+    "Shared ring name must be 1 to 30 letters, digits, '_' or '-'.");
+  CHECK_STATUS;
+  status = napi_get_named_property(env, argv[0], "start", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_undefined) {
+    if (type == napi_string) {
+      status = getString(env, param, &start);
+      CHECK_STATUS;
+    }
+    if ((start != "next") && (start != "oldest")) NAPI_THROW_ERROR(
+      "Shared ring start must be 'next' or 'oldest'.");
+  }
+
+  sharedMapping* mapping = mapOpen(name, &error);
+  if (mapping == nullptr) {
+    napi_throw_error(env, nullptr, error.c_str());
+    return nullptr;
+  }
+  sharedRingReader* reader = new sharedRingReader;
+  reader->mapping = mapping;
+  reader->name = name;
+  sharedRingHeader* header = mapping->header();
+  uint64_t written = header->writeSequence.load(std::memory_order_acquire);
+  reader->next = written;
+  if (start == "oldest") {
+    reader->next = (written > header->slotCount - 1) ? written - header->slotCount + 1 : 0;
+  }
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = napi_create_external(env, reader, finalizeSharedRingReader, nullptr, &param);
+  if (status != napi_ok) {
+    finalizeSharedRingReader(env, reader, nullptr);
+    CHECK_STATUS;
+  }
+  status = napi_set_named_property(env, result, "sharedRing", param);
+  CHECK_STATUS;
+  status = napi_create_string_utf8(env, name.c_str(), NAPI_AUTO_LENGTH, &param);
+  CHECK_STATUS;
+  status = napi_set_named_property(env, result, "name", param);
+  CHECK_STATUS;
+  status = setUint32(env, result, "slots", header->slotCount);
+  CHECK_STATUS;
+  status = setUint32(env, result, "width", header->width);
+  CHECK_STATUS;
+  status = setUint32(env, result, "height", header->height);
+  CHECK_STATUS;
+  status = setUint32(env, result, "pixelFormat", header->pixelFormat);
+  CHECK_STATUS;
+  status = setUint32(env, result, "timeScale", header->timeScale);
+  CHECK_STATUS;
+  status = setUint32(env, result, "frameDuration", header->frameDuration);
+  CHECK_STATUS;
+  status = setUint32(env, result, "sampleRate", header->sampleRate);
+  CHECK_STATUS;
+  status = setUint32(env, result, "channels", header->channels);
+  CHECK_STATUS;
+  status = setUint32(env, result, "sampleType", header->sampleType);
+  CHECK_STATUS;
+  status = setUint32(env, result, "producerId", header->producerId);
+  CHECK_STATUS;
+  status = setMethod(env, result, "read", sharedRingRead);
+  CHECK_STATUS;
+  status = setMethod(env, result, "frame", sharedRingAwaitFrame);
+  CHECK_STATUS;
+  status = setMethod(env, result, "valid", sharedRingValid);
+  CHECK_STATUS;
+  status = setMethod(env, result, "stats", sharedRingStats);
+  CHECK_STATUS;
+  status = setMethod(env, result, "close", sharedRingClose);
+  CHECK_STATUS;
+  return result;
+}
+
+static void finalizeSharedRingProducer(napi_env env, void* data, void* hint) {
+  delete (macadamSharedRing*) data;
+}
+
+static napi_status getProducer(napi_env env, napi_callback_info info, size_t* argc,
+    napi_value* argv, macadamSharedRing** ring) {
+  napi_status status;
+  napi_value param, thisArg;
+  status = napi_get_cb_info(env, info, argc, argv, &thisArg, nullptr);
+  PASS_STATUS;
+  status = napi_get_named_property(env, thisArg, "sharedRing", &param);
+  PASS_STATUS;
+  return napi_get_value_external(env, param, (void**) ring);
+}
+
+// Synthetic frame n has every video byte n & 0xff, frame time n * 1000,
+// timecode 01:00:SS:FF at 25fps and 16-bit samples (n + i) & 0x7fff
+static napi_value sharedRingTestPublish(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  macadamSharedRing* ring;
+  uint32_t count = 1;
+  size_t argc = 1;
+  napi_value argv[1];
+
+  status = getProducer(env, info, &argc, argv, &ring);
+  CHECK_STATUS;
+  if (argc >= 1) {
+    status = napi_get_value_uint32(env, argv[0], &count);
+    CHECK_STATUS;
+  }
+  uint32_t width = 64, height = 4, channels = 2, sampleFrames = 1920;
+  uint32_t rowBytes = sharedRingRowBytes(bmdFormat8BitYUV, width);
+  std::vector<uint8_t> video(rowBytes * height);
+  std::vector<int16_t> audio(sampleFrames * channels);
+  for ( uint32_t x = 0 ; x < count ; x++ ) {
+    uint64_t n = ring->framesPublished();
+    sharedRingFrame frame;
+    memset(video.data(), (int) (n & 0xff), video.size());
+    for ( uint32_t i = 0 ; i < audio.size() ; i++ ) audio[i] = (int16_t) ((n + i) & 0x7fff);
+    uint32_t seconds = (uint32_t) ((n / 25) % 60), frames = (uint32_t) (n % 25);
+    frame.video = video.data();
+    frame.videoBytes = (uint32_t) video.size();
+    frame.rowBytes = rowBytes;
+    frame.width = width;
+    frame.height = height;
+    frame.pixelFormat = bmdFormat8BitYUV;
+    frame.frameTime = (int64_t) n * 1000;
+    frame.frameDuration = 1000;
+    frame.hasTimecode = true;
+    frame.timecodeBCD = 0x01000000 | ((seconds / 10) << 12) | ((seconds % 10) << 8) |
+      ((frames / 10) << 4) | (frames % 10);
+    frame.audio = (const uint8_t*) audio.data();
+    frame.sampleFrameCount = sampleFrames;
+    frame.audioTime = (int64_t) n * sampleFrames;
+    ring->publish(frame);
+  }
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+static napi_value sharedRingTestClose(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  macadamSharedRing* ring;
+  size_t argc = 0;
+
+  status = getProducer(env, info, &argc, nullptr, &ring);
+  CHECK_STATUS;
+  ring->close();
+  status = napi_get_undefined(env, &result);
+  CHECK_STATUS;
+  return result;
+}
+
+// sharedRingTest({ name, slots }) creates a ring of small 8-bit YUV frames
+// with stereo 16-bit audio, returning a producer with publish(count) and
+// close() methods, so that readers can be tested without a device
+napi_value sharedRingTest(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[1];
+  napi_value result, param;
+  napi_valuetype type;
+  size_t argc = 1;
+  uint32_t slots = 4;
+  std::string name, error;
+  sharedRingFormat format;
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("Shared ring test options must be provided.");
+  status = napi_get_named_property(env, argv[0], "name", &param);
+  CHECK_STATUS;
+  status = getString(env, param, &name);
+  if ((status == napi_string_expected) || !validSharedRingName(name)) NAPI_THROW_ERROR(
+    "Shared ring name must be 1 to 30 letters, digits, '_' or '-'.");
+  CHECK_STATUS;
+  status = napi_get_named_property(env, argv[0], "slots", &param);
+  CHECK_STATUS;
+  status = napi_typeof(env, param, &type);
+  CHECK_STATUS;
+  if (type != napi_undefined) {
+    status = napi_get_value_uint32(env, param, &slots);
+    CHECK_STATUS;
+  }
+  if ((slots < 2) || (slots > 256)) NAPI_THROW_ERROR("Shared ring slots must be from 2 to 256.");
+
+  format.width = 64;
+  format.height = 4;
+  format.pixelFormat = bmdFormat8BitYUV;
+  format.videoCapacity = sharedRingRowBytes(bmdFormat8BitYUV, 64) * 4;
+  format.timeScale = 25000;
+  format.frameDuration = 1000;
+  format.sampleRate = 48000;
+  format.channels = 2;
+  format.sampleType = 16;
+  format.audioCapacity = 1920 * 4;
+  macadamSharedRing* ring = macadamSharedRing::create(name, slots, format, &error);
+  if (ring == nullptr) {
+    napi_throw_error(env, nullptr, error.c_str());
+    return nullptr;
+  }
+
+  status = napi_create_object(env, &result);
+  CHECK_STATUS;
+  status = napi_create_external(env, ring, finalizeSharedRingProducer, nullptr, &param);
+  if (status != napi_ok) {
+    delete ring;
+    CHECK_STATUS;
+  }
+  status = napi_set_named_property(env, result, "sharedRing", param);
+  CHECK_STATUS;
+  status = setMethod(env, result, "publish", sharedRingTestPublish);
+  CHECK_STATUS;
+  status = setMethod(env, result, "close", sharedRingTestClose);
+  CHECK_STATUS;
+  return result;
+}
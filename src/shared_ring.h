@@ -0,0 +1,167 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef SHARED_RING_H
+#define SHARED_RING_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include "node_api.h"
+
+// Frames published to a named shared memory ring, so that processes other
+// than the one that owns the input can read every frame. There is a single
+// producer and any number of readers, which never write to the ring. Each
+// slot carries a sequence number that is odd while the producer is writing
+// it, so a reader that falls more than a ring behind sees that its frame has
+// been overwritten, counts the frames lost and skips forward.
+
+#define SHARED_RING_ALIGNMENT 4096
+#define SHARED_RING_HEADER_SIZE SHARED_RING_ALIGNMENT
+#define SHARED_RING_NAME_MAX 30 // Mac limits shared memory names to 31 characters
+#define SHARED_RING_OPEN 1
+#define SHARED_RING_CLOSED 2
+
+// Bits of a slot's flags
+#define sharedRingHasTimecode 0x01
+#define sharedRingTruncated 0x02 // Video or audio larger than the slot was cut short
+
+struct sharedRingHeader {
+  char magic[8]; // MCDMSHM1
+  uint32_t headerSize;
+  uint32_t slotCount;
+  uint64_t slotSize; // Bytes per slot, including its header
+  uint32_t videoCapacity; // Bytes of video per slot
+  uint32_t audioCapacity; // Bytes of audio per slot
+  uint32_t width;
+  uint32_t height;
+  uint32_t pixelFormat;
+  uint32_t timeScale;
+  uint32_t frameDuration;
+  uint32_t sampleRate;
+  uint32_t channels;
+  uint32_t sampleType;
+  std::atomic<uint64_t> writeSequence; // Frames published
+  std::atomic<uint32_t> state; // SHARED_RING_OPEN or SHARED_RING_CLOSED
+  uint32_t producerId; // Process identifier of the producer
+};
+
+// Starts each slot, with video at SHARED_RING_ALIGNMENT and audio after it
+struct sharedRingSlot {
+  std::atomic<uint64_t> sequence; // 2n + 1 while frame n is written, 2n + 2 once complete
+  int64_t frameTime;
+  int64_t frameDuration;
+  int64_t audioTime; // Packet time, in samples
+  uint32_t videoBytes;
+  uint32_t rowBytes;
+  uint32_t width;
+  uint32_t height;
+  uint32_t pixelFormat;
+  uint32_t frameFlags; // BMDFrameFlags
+  uint32_t timecodeBCD;
+  uint32_t timecodeFlags;
+  uint32_t userbits;
+  uint32_t sampleFrameCount;
+  uint32_t flags; // sharedRing* bits
+};
+
+struct sharedRingFormat {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t pixelFormat = 0;
+  uint32_t videoCapacity = 0;
+  uint32_t timeScale = 0;
+  uint32_t frameDuration = 0;
+  uint32_t sampleRate = 0;
+  uint32_t channels = 0;
+  uint32_t sampleType = 0;
+  uint32_t audioCapacity = 0;
+};
+
+// A frame to publish, copied into the ring before publish returns
+struct sharedRingFrame {
+  const uint8_t* video = nullptr;
+  uint32_t videoBytes = 0;
+  uint32_t rowBytes = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t pixelFormat = 0;
+  uint32_t frameFlags = 0;
+  int64_t frameTime = 0;
+  int64_t frameDuration = 0;
+  bool hasTimecode = false;
+  uint32_t timecodeBCD = 0;
+  uint32_t timecodeFlags = 0;
+  uint32_t userbits = 0;
+  const uint8_t* audio = nullptr;
+  uint32_t sampleFrameCount = 0;
+  int64_t audioTime = 0;
+};
+
+// A mapping of a ring's shared memory, counted so that it stays mapped while
+// Buffers that point into it are alive
+struct sharedMapping {
+  uint8_t* base = nullptr;
+  size_t size = 0;
+  #ifdef WIN32
+  HANDLE handle = NULL;
+  #endif
+  std::atomic<uint32_t> references { 1 };
+
+  void addRef() { references++; }
+  void release(); // Unmaps and deletes on the last release
+  sharedRingHeader* header() { return (sharedRingHeader*) base; }
+  sharedRingSlot* slot(uint64_t sequence) {
+    return (sharedRingSlot*) (base + SHARED_RING_HEADER_SIZE +
+      (sequence % header()->slotCount) * header()->slotSize);
+  }
+};
+
+// Producer side, written from the DeckLink callback thread
+class macadamSharedRing {
+  std::string name;
+  sharedMapping* mapping = nullptr;
+  bool linked = false;
+  std::atomic<uint64_t> published { 0 };
+  std::atomic<uint64_t> truncated { 0 };
+
+  macadamSharedRing() { }
+
+  public:
+    ~macadamSharedRing();
+    // Creates the named ring, replacing one whose producer has closed it or
+    // exited, but failing while another producer is using the name
+    static macadamSharedRing* create(const std::string& name, uint32_t slots,
+      const sharedRingFormat& format, std::string* error);
+    void publish(const sharedRingFrame& frame);
+    // Tells readers that no more frames will be published and removes the name,
+    // leaving existing mappings valid
+    void close();
+    uint32_t slots() { return mapping->header()->slotCount; }
+    uint64_t framesPublished() { return published; }
+    uint64_t framesTruncated() { return truncated; }
+};
+
+// Worst case bytes per line for a DeckLink pixel format
+uint32_t sharedRingRowBytes(uint32_t pixelFormat, uint32_t width);
+bool validSharedRingName(const std::string& name);
+napi_value openSharedRing(napi_env env, napi_callback_info info);
+napi_value sharedRingTest(napi_env env, napi_callback_info info);
+
+#endif // SHARED_RING_H
@@ -0,0 +1,74 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Compiler and CPU feature support for kernels selected at run time
+
+#ifndef SIMD_UTIL_H
+#define SIMD_UTIL_H
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MACADAM_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MACADAM_TARGET(t)
+#else
+#define MACADAM_TARGET(t) __attribute__((target(t)))
+#endif
+#endif
+
+// Generic code inlined into a MACADAM_TARGET function is vectorized for that target
+#ifdef _MSC_VER
+#define MACADAM_INLINE __forceinline
+#else
+#define MACADAM_INLINE inline __attribute__((always_inline))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MACADAM_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef MACADAM_X86
+
+static inline bool cpuHasSSSE3() {
+  #ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 9)) != 0;
+  #else
+  return __builtin_cpu_supports("ssse3");
+  #endif
+}
+
+static inline bool cpuHasAVX2() {
+  #ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+  __cpuid(info, 1);
+  // OSXSAVE and AVX, then check the OS saves the YMM registers
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+  if ((_xgetbv(0) & 6) != 6) return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+  #else
+  return __builtin_cpu_supports("avx2");
+  #endif
+}
+
+#endif // MACADAM_X86
+
+#endif // SIMD_UTIL_H
@@ -161,7 +161,31 @@ HRESULT macadamTimecode::SetComponents (
   return S_OK;
 }
 
-HRESULT macadamTimecode::formatTimecodeString(const char** timecode, bool fieldFlag) {
+static inline char* writeTwoDigits(char* p, uint8_t value) {
+  *p++ = '0' + (value / 10) % 10;
+  *p++ = '0' + value % 10;
+  return p;
+}
+
+static void writeTimecodeString(char* timecode, uint8_t hours, uint8_t minutes,
+  uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags, bool fieldFlag) {
+
+  char* p = timecode;
+  p = writeTwoDigits(p, hours & 0x3fU);
+  *p++ = ':';
+  p = writeTwoDigits(p, minutes & 0x3fU);
+  *p++ = ':';
+  p = writeTwoDigits(p, seconds & 0x3fU);
+  *p++ = ((flags & bmdTimecodeIsDropFrame) != 0) ? ';' : ':';
+  p = writeTwoDigits(p, frames & 0x3fU);
+  if (fieldFlag) {
+    *p++ = '.';
+    *p++ = ((flags & bmdTimecodeFieldMark) == 0) ? '0' : '1';
+  }
+  *p = '\0';
+}
+
+HRESULT macadamTimecode::formatTimecodeString(char* timecode, bool fieldFlag) {
   uint8_t hours;
   uint8_t minutes;
   uint8_t seconds;
@@ -169,57 +193,46 @@ HRESULT macadamTimecode::formatTimecodeString(const char** timecode, bool fieldF
   HRESULT hresult;
 
   hresult = GetComponents(&hours, &minutes, &seconds, &frames);
-
-  hours = hours & 0x3fU;
-  minutes = minutes & 0x3fU;
-  seconds = seconds & 0x3fU;
-  frames = frames & 0x3fU;
-
-  char* tcstr;
-  if (fieldFlag) {
-    tcstr = (char *) malloc(14 * sizeof(char));
-    sprintf(tcstr, "%02i:%02i:%02i%c%02i%s", hours, minutes, seconds,
-      ((flags & bmdTimecodeIsDropFrame) != 0) ? ';' : ':', frames,
-      ((flags & bmdTimecodeFieldMark) == 0) ? ".0" : ".1");
-    tcstr[13] = '\0';
-  }
-  else {
-    tcstr = (char *) malloc(12 * sizeof(char));
-    sprintf(tcstr, "%02i:%02i:%02i%c%02i", hours, minutes, seconds,
-      ((flags & bmdTimecodeIsDropFrame) != 0) ? ';' : ':', frames);
-    tcstr[11] = '\0';
-  }
-  *timecode = (const char*) tcstr;
+  writeTimecodeString(timecode, hours, minutes, seconds, frames, flags, fieldFlag);
 
   return hresult;
 }
 
+void formatTimecodeBCD(BMDTimecodeBCD bcd, BMDTimecodeFlags flags, bool fieldFlag, char* timecode) {
+  writeTimecodeString(timecode,
+    ((bcd >> 28) & 0xf) * 10 + ((bcd >> 24) & 0xf),
+    ((bcd >> 20) & 0xf) * 10 + ((bcd >> 16) & 0xf),
+    ((bcd >> 12) & 0xf) * 10 + ((bcd >> 8) & 0xf),
+    ((bcd >> 4) & 0xf) * 10 + (bcd & 0xf),
+    flags, fieldFlag);
+}
+
+// The caller of GetString owns the returned string
 #ifdef WIN32
 HRESULT macadamTimecode::GetString (/* out */ BSTR *timecode) {
-  const char* tcstr;
+  char tcstr[MACADAM_TIMECODE_STRING_SIZE];
   HRESULT hresult;
 
-  hresult = formatTimecodeString(&tcstr);
+  hresult = formatTimecodeString(tcstr);
   _bstr_t btcstr(tcstr);
-  *timecode = btcstr;
+  *timecode = btcstr.copy();
   return hresult;
 }
 #elif __APPLE__
 HRESULT macadamTimecode::GetString (/* out */ CFStringRef *timecode) {
-  const char* tcstr;
+  char tcstr[MACADAM_TIMECODE_STRING_SIZE];
   HRESULT hresult;
 
-  hresult = formatTimecodeString(&tcstr);
-  CFStringRef cftcstr = CFStringCreateWithCString(nullptr, tcstr, kCFStringEncodingMacRoman);
-  *timecode = cftcstr;
-  return E_NOTIMPL;
+  hresult = formatTimecodeString(tcstr);
+  *timecode = CFStringCreateWithCString(nullptr, tcstr, kCFStringEncodingMacRoman);
+  return hresult;
 }
 #else
 HRESULT macadamTimecode::GetString (/* out */ const char** timecode) {
-  const char* tcstr;
+  char* tcstr = (char*) malloc(MACADAM_TIMECODE_STRING_SIZE);
   HRESULT hresult;
 
-  hresult = formatTimecodeString(&tcstr);
+  hresult = formatTimecodeString(tcstr);
   *timecode = tcstr;
   return hresult;
 }
@@ -278,7 +291,7 @@ napi_value timecodeTest(napi_env env, napi_callback_info info) {
   napi_value result;
   bool pass = true;
   macadamTimecode* tc;
-  const char* tcstr = nullptr;
+  char tcstr[MACADAM_TIMECODE_STRING_SIZE];
   uint8_t hours, minutes, seconds, frames;
   BMDTimecodeBCD bcd;
 
@@ -344,31 +357,31 @@ napi_value timecodeTest(napi_env env, napi_callback_info info) {
 
   tc = new macadamTimecode(60, true, 10, 11, 12, 13);
   pass = pass && (tc != nullptr);
-  tc->formatTimecodeString(&tcstr);
+  tc->formatTimecodeString(tcstr);
   pass = pass && (strcmp(tcstr, "10:11:12;13") == 0); // Zero is no difference
   delete tc;
 
   tc = new macadamTimecode(25, false, 10, 11, 12, 13);
   pass = pass && (tc != nullptr);
-  tc->formatTimecodeString(&tcstr);
+  tc->formatTimecodeString(tcstr);
   pass = pass && (strcmp(tcstr, "10:11:12:13") == 0); // Zero is no difference
   delete tc;
 
   tc = new macadamTimecode(50, false, 10, 11, 12, 13);
   pass = pass && (tc != nullptr);
-  tc->formatTimecodeString(&tcstr);
+  tc->formatTimecodeString(tcstr);
   pass = pass && (strcmp(tcstr, "10:11:12:13") == 0); // Zero is no difference
   delete tc;
 
   tc = new macadamTimecode(50, false, 10, 11, 12, 13);
   pass = pass && (tc != nullptr);
-  tc->formatTimecodeString(&tcstr, true);
+  tc->formatTimecodeString(tcstr, true);
   pass = pass && (strcmp(tcstr, "10:11:12:13.0") == 0); // Zero is no difference
   delete tc;
 
   tc = new macadamTimecode(50, false, 10, 11, 12, 13, 1);
   pass = pass && (tc != nullptr);
-  tc->formatTimecodeString(&tcstr, true);
+  tc->formatTimecodeString(tcstr, true);
   pass = pass && (strcmp(tcstr, "10:11:12:13.1") == 0); // Zero is no difference
   delete tc;
 
@@ -429,7 +442,64 @@ napi_value timecodeTest(napi_env env, napi_callback_info info) {
   pass = pass && ((tc->GetFlags() & bmdTimecodeFieldMark) == 0);
   delete tc;
 
+  formatTimecodeBCD(0x23595924, bmdTimecodeIsDropFrame, false, tcstr);
+  pass = pass && (strcmp(tcstr, "23:59:59;24") == 0);
+  formatTimecodeBCD(0x01020304, bmdTimecodeFieldMark, true, tcstr);
+  pass = pass && (strcmp(tcstr, "01:02:03:04.1") == 0);
+
+  tc = new macadamTimecode(50, false, 10, 11, 12, 13, 1);
+  pass = pass && (tc != nullptr);
+  bcd = tc->GetBCD(); // Sets the field mark
+  formatTimecodeBCD(bcd, tc->GetFlags(), true, tcstr);
+  pass = pass && (strcmp(tcstr, "10:11:12:13.1") == 0);
+  delete tc;
+
   status = napi_get_boolean(env, pass, &result);
   CHECK_STATUS;
   return result;
 };
+
+// formatTimecode(bcd, flags, fieldFlag) formats the timecodeBCD and
+// timecodeFlags values of a captured frame as a string
+napi_value formatTimecode(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  napi_value argv[3];
+  napi_valuetype type;
+  size_t argc = 3;
+  uint32_t bcd;
+  uint32_t flags = 0;
+  bool fieldFlag = false;
+  char tcstr[MACADAM_TIMECODE_STRING_SIZE];
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 1) NAPI_THROW_ERROR("A BCD timecode value must be provided.");
+
+  status = napi_get_value_uint32(env, argv[0], &bcd);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("BCD timecode must be a number.");
+  CHECK_STATUS;
+  if (argc >= 2) {
+    status = napi_typeof(env, argv[1], &type);
+    CHECK_STATUS;
+    if (type != napi_undefined) {
+      status = napi_get_value_uint32(env, argv[1], &flags);
+      if (status == napi_number_expected) NAPI_THROW_ERROR("Timecode flags must be a number.");
+      CHECK_STATUS;
+    }
+  }
+  if (argc >= 3) {
+    status = napi_typeof(env, argv[2], &type);
+    CHECK_STATUS;
+    if (type != napi_undefined) {
+      status = napi_get_value_bool(env, argv[2], &fieldFlag);
+      if (status == napi_boolean_expected) NAPI_THROW_ERROR("Field flag must be a boolean.");
+      CHECK_STATUS;
+    }
+  }
+
+  formatTimecodeBCD((BMDTimecodeBCD) bcd, (BMDTimecodeFlags) flags, fieldFlag, tcstr);
+  status = napi_create_string_utf8(env, tcstr, NAPI_AUTO_LENGTH, &result);
+  CHECK_STATUS;
+  return result;
+}
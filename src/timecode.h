@@ -57,6 +57,10 @@
 #include "DeckLinkAPI.h"
 
 napi_value timecodeTest(napi_env env, napi_callback_info info);
+napi_value formatTimecode(napi_env env, napi_callback_info info);
+
+// Room for HH:MM:SS:FF.f and a terminator
+#define MACADAM_TIMECODE_STRING_SIZE 14
 
 
 struct frameTable {
@@ -112,7 +116,8 @@ struct macadamTimecode : IDeckLinkTimecode {
   #else
   HRESULT GetString (/* out */ const char** timecode);
   #endif
-  HRESULT formatTimecodeString(const char** timecode, bool fieldFlag = false);
+  // Writes to timecode, which must hold MACADAM_TIMECODE_STRING_SIZE characters
+  HRESULT formatTimecodeString(char* timecode, bool fieldFlag = false);
   BMDTimecodeFlags GetFlags (void);
   HRESULT GetTimecodeUserBits (/* out */ BMDTimecodeUserBits *userBits);
   HRESULT SetTimecodeUserBits (BMDTimecodeUserBits userBits);
@@ -126,5 +131,7 @@ struct macadamTimecode : IDeckLinkTimecode {
 };
 
 HRESULT parseTimecode(uint16_t fps, const char* tcstr, macadamTimecode** timecode);
+// Formats a BCD timecode, as delivered by a device, without allocating
+void formatTimecodeBCD(BMDTimecodeBCD bcd, BMDTimecodeFlags flags, bool fieldFlag, char* timecode);
 
 #endif // TIMECODE_H
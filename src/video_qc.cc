@@ -0,0 +1,618 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "video_qc.h"
+#include "pixel_convert.h"
+#include "macadam_util.h"
+#include "simd_util.h"
+
+// Sums over one unpacked line of 10-bit planar YUV
+struct qcLineSums {
+  uint32_t lumaSum;
+  uint32_t lumaMin;
+  uint32_t lumaMax;
+  uint32_t dark;
+  uint32_t illegalLuma;
+  uint32_t illegalChroma;
+};
+
+// Reductions over a line, written branch free so that the compiler can
+// vectorize them, and the sums of each block of the line for the signature.
+// The same loop is built for AVX2 rather than written with intrinsics.
+typedef void (*qcLineKernel)(const uint16_t* y, const uint16_t* cb, const uint16_t* cr,
+  uint32_t width, uint32_t blackLuma, uint32_t blocksWide, uint32_t* blockSums, qcLineSums* sums);
+
+static MACADAM_INLINE void qcLine(const uint16_t* y, const uint16_t* cb, const uint16_t* cr,
+    uint32_t width, uint32_t blackLuma, uint32_t blocksWide, uint32_t* blockSums, qcLineSums* sums) {
+  uint32_t chromaWidth = (width + 1) >> 1;
+  uint32_t lumaSum = 0, lumaMin = 1023, lumaMax = 0, dark = 0, illegalLuma = 0, illegalChroma = 0;
+  for ( uint32_t x = 0 ; x < width ; x++ ) {
+    uint32_t v = y[x];
+    lumaSum += v;
+    lumaMin = (v < lumaMin) ? v : lumaMin;
+    lumaMax = (v > lumaMax) ? v : lumaMax;
+    dark += (v <= blackLuma) ? 1 : 0;
+    illegalLuma += ((v < QC_LUMA_MIN) || (v > QC_LUMA_MAX)) ? 1 : 0;
+  }
+  for ( uint32_t x = 0 ; x < chromaWidth ; x++ ) {
+    uint32_t b = cb[x], r = cr[x];
+    illegalChroma += ((b < QC_CHROMA_MIN) || (b > QC_CHROMA_MAX)) ? 1 : 0;
+    illegalChroma += ((r < QC_CHROMA_MIN) || (r > QC_CHROMA_MAX)) ? 1 : 0;
+  }
+  for ( uint32_t b = 0 ; b < blocksWide ; b++ ) {
+    uint32_t sum = 0;
+    for ( uint32_t k = 0 ; k < QC_BLOCK_SIZE ; k++ ) sum += y[b * QC_BLOCK_SIZE + k];
+    blockSums[b] += sum;
+  }
+  sums->lumaSum = lumaSum;
+  sums->lumaMin = lumaMin;
+  sums->lumaMax = lumaMax;
+  sums->dark = dark;
+  sums->illegalLuma = illegalLuma;
+  sums->illegalChroma = illegalChroma;
+}
+
+static void qcLineDefault(const uint16_t* y, const uint16_t* cb, const uint16_t* cr,
+    uint32_t width, uint32_t blackLuma, uint32_t blocksWide, uint32_t* blockSums, qcLineSums* sums) {
+  qcLine(y, cb, cr, width, blackLuma, blocksWide, blockSums, sums);
+}
+
+#ifdef MACADAM_X86
+
+MACADAM_TARGET("avx2")
+static void qcLineAutoAVX2(const uint16_t* y, const uint16_t* cb, const uint16_t* cr,
+    uint32_t width, uint32_t blackLuma, uint32_t blocksWide, uint32_t* blockSums, qcLineSums* sums) {
+  qcLine(y, cb, cr, width, blackLuma, blocksWide, blockSums, sums);
+}
+
+#endif // MACADAM_X86
+
+static qcLineKernel selectedQCLine = qcLineDefault;
+
+void selectQCKernels() {
+  #ifdef MACADAM_X86
+  if (cpuHasAVX2()) selectedQCLine = qcLineAutoAVX2;
+  #endif
+}
+
+// Four interleaved histograms, so that runs of similar values do not wait
+// on the same counter
+static void histogramLine(const uint16_t* y, uint32_t width, uint32_t (*histograms)[QC_HISTOGRAM_BINS]) {
+  uint32_t x = 0;
+  for ( ; x + 4 <= width ; x += 4 ) {
+    histograms[0][y[x] >> 5]++;
+    histograms[1][y[x + 1] >> 5]++;
+    histograms[2][y[x + 2] >> 5]++;
+    histograms[3][y[x + 3] >> 5]++;
+  }
+  for ( ; x < width ; x++ ) histograms[0][y[x] >> 5]++;
+}
+
+bool analyseVideoFrame(BMDPixelFormat pixelFormat, const uint8_t* src, uint32_t rowBytes,
+    uint32_t width, uint32_t height, const qcOptions& options, qcFrameResult* result,
+    pixelScratch* scratch) {
+  HR_TIME_POINT start = NOW;
+  unpackKernel unpack = getUnpackKernel(pixelFormat);
+  if ((unpack == nullptr) || (width == 0) || (height == 0)) return false;
+
+  qcFrameStats& stats = result->stats;
+  uint32_t chromaWidth = (width + 1) >> 1;
+  uint32_t lineStep = (options.lineStep > 0) ? options.lineStep : 1;
+  uint32_t blocksWide = width / QC_BLOCK_SIZE;
+  uint32_t blocksHigh = height / QC_BLOCK_SIZE;
+  // The line, then the block sums, in one buffer
+  size_t lineBytes = sizeof(uint16_t) * (width + 2 * chromaWidth + 3 * UNPACK_PADDING);
+  lineBytes = (lineBytes + 15) & ~((size_t) 15);
+  pixelScratch callScratch;
+  if (scratch == nullptr) scratch = &callScratch;
+  uint16_t* line = (uint16_t*) scratch->get(lineBytes + sizeof(uint32_t) * blocksWide);
+  if (line == nullptr) return false;
+  uint16_t* y = line;
+  uint16_t* cb = y + width + UNPACK_PADDING;
+  uint16_t* cr = cb + chromaWidth + UNPACK_PADDING;
+  uint32_t* blockSums = (uint32_t*) ((uint8_t*) line + lineBytes);
+  memset(blockSums, 0, sizeof(uint32_t) * blocksWide);
+  uint32_t histograms[4][QC_HISTOGRAM_BINS];
+  memset(histograms, 0, sizeof(histograms));
+  uint32_t blockLines = 0;
+  qcLineSums sums;
+
+  stats.width = width;
+  stats.height = height;
+  result->blocksWide = blocksWide;
+  result->signature.assign(blocksWide * blocksHigh, 0);
+  for ( uint32_t row = 0 ; row < height ; row += lineStep ) {
+    unpack(src + (size_t) row * rowBytes, y, cb, cr, width);
+    bool inBlocks = row < blocksHigh * QC_BLOCK_SIZE;
+    selectedQCLine(y, cb, cr, width, options.blackLuma, inBlocks ? blocksWide : 0,
+      blockSums, &sums);
+    histogramLine(y, width, histograms);
+    stats.lines++;
+    stats.lumaSum += sums.lumaSum;
+    if (sums.lumaMin < stats.lumaMin) stats.lumaMin = sums.lumaMin;
+    if (sums.lumaMax > stats.lumaMax) stats.lumaMax = sums.lumaMax;
+    stats.darkSamples += sums.dark;
+    stats.illegalLuma += sums.illegalLuma;
+    stats.illegalChroma += sums.illegalChroma;
+    if (!inBlocks) continue;
+    blockLines++;
+    // Lines of the next block row start at a multiple of QC_BLOCK_SIZE
+    uint32_t next = row + lineStep;
+    if ((next / QC_BLOCK_SIZE != row / QC_BLOCK_SIZE) || (next >= height)) {
+      uint16_t* means = result->signature.data() + (row / QC_BLOCK_SIZE) * blocksWide;
+      uint32_t count = blockLines * QC_BLOCK_SIZE;
+      for ( uint32_t b = 0 ; b < blocksWide ; b++ ) {
+        means[b] = (uint16_t) ((blockSums[b] + (count >> 1)) / count);
+        blockSums[b] = 0;
+      }
+      blockLines = 0;
+    }
+  }
+
+  for ( uint32_t b = 0 ; b < QC_HISTOGRAM_BINS ; b++ ) {
+    stats.histogram[b] = histograms[0][b] + histograms[1][b] + histograms[2][b] + histograms[3][b];
+  }
+  stats.lumaSamples = (uint64_t) stats.lines * width;
+  stats.chromaSamples = (uint64_t) stats.lines * chromaWidth * 2;
+  stats.black = stats.darkSamples >= options.blackRatio * stats.lumaSamples;
+  stats.outOfGamut = (stats.illegalLuma + stats.illegalChroma) >
+    options.gamutRatio * (stats.lumaSamples + stats.chromaSamples);
+  stats.micros = microTime(start);
+  return true;
+}
+
+double signatureDifference(const std::vector<uint16_t>& a, const std::vector<uint16_t>& b) {
+  if (a.empty() || (a.size() != b.size())) return -1.0;
+  uint64_t total = 0;
+  for ( size_t x = 0 ; x < a.size() ; x++ ) {
+    total += (a[x] > b[x]) ? a[x] - b[x] : b[x] - a[x];
+  }
+  return (double) total / a.size();
+}
+
+// Counts consecutive matching frames, raising a start event once the run
+// reaches threshold frames and an end event on the first frame that does not match
+void macadamVideoQC::track(runState& run, bool matches, uint32_t threshold,
+    qcEventType startType, qcFrameResult* result) {
+  qcEvent event;
+  event.sequence = runStats.frames;
+  event.frames = 0;
+  if (matches) {
+    if (run.length == 0) run.startTime = result->stats.frameTime;
+    run.length++;
+    if (!run.active && (run.length >= threshold)) {
+      run.active = true;
+      event.type = startType;
+      event.frameTime = run.startTime;
+      result->events.push_back(event);
+    }
+    return;
+  }
+  if (run.active) {
+    event.type = (qcEventType) (startType + 1);
+    event.frameTime = result->stats.frameTime;
+    event.frames = run.length;
+    result->events.push_back(event);
+  }
+  run.active = false;
+  run.length = 0;
+}
+
+void macadamVideoQC::compare(qcFrameResult* result) {
+  qcFrameStats& stats = result->stats;
+  if (result->blocksWide == previousBlocksWide) {
+    stats.difference = signatureDifference(result->signature, previous);
+  }
+  stats.frozen = (stats.difference >= 0.0) && (stats.difference <= options.freezeDifference);
+  previous = result->signature;
+  previousBlocksWide = result->blocksWide;
+
+  std::lock_guard<std::mutex> guard(lock);
+  track(black, stats.black, options.blackFrames, qcBlackStart, result);
+  track(frozen, stats.frozen, options.freezeFrames, qcFreezeStart, result);
+  track(gamut, stats.outOfGamut, options.gamutFrames, qcGamutStart, result);
+  for ( auto event : result->events ) {
+    if (pending.size() >= options.eventQueue) {
+      pending.pop_front();
+      runStats.eventsDropped++;
+    }
+    pending.push_back(event);
+  }
+  runStats.frames++;
+  if (stats.black) runStats.blackFrames++;
+  if (stats.frozen) runStats.frozenFrames++;
+  if (stats.outOfGamut) runStats.gamutFrames++;
+  runStats.events += result->events.size();
+  runStats.microsLast = stats.micros;
+  runStats.microsTotal += stats.micros;
+  if (stats.micros > runStats.microsMax) runStats.microsMax = stats.micros;
+}
+
+std::vector<qcEvent> macadamVideoQC::takeEvents() {
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<qcEvent> events(pending.begin(), pending.end());
+  pending.clear();
+  return events;
+}
+
+void macadamVideoQC::getStats(qcRunStats* stats) {
+  std::lock_guard<std::mutex> guard(lock);
+  *stats = runStats;
+}
+
+static napi_status getOptionalUint32(napi_env env, napi_value options, const char* name,
+    uint32_t* value) {
+  napi_status status;
+  napi_value param;
+  napi_valuetype type;
+  status = napi_get_named_property(env, options, name, &param);
+  PASS_STATUS;
+  status = napi_typeof(env, param, &type);
+  PASS_STATUS;
+  if (type == napi_undefined) return napi_ok;
+  return napi_get_value_uint32(env, param, value);
+}
+
+static napi_status getOptionalDouble(napi_env env, napi_value options, const char* name,
+    double* value) {
+  napi_status status;
+  napi_value param;
+  napi_valuetype type;
+  status = napi_get_named_property(env, options, name, &param);
+  PASS_STATUS;
+  status = napi_typeof(env, param, &type);
+  PASS_STATUS;
+  if (type == napi_undefined) return napi_ok;
+  return napi_get_value_double(env, param, value);
+}
+
+// Parses { lineStep, blackLuma, blackRatio, blackFrames, freezeDifference,
+// freezeFrames, gamutRatio, gamutFrames, eventQueue }, returning
+// napi_invalid_arg for values out of range
+napi_status parseQCOptions(napi_env env, napi_value value, qcOptions* options) {
+  napi_status status;
+  napi_valuetype type;
+
+  status = napi_typeof(env, value, &type);
+  PASS_STATUS;
+  if (type == napi_boolean) return napi_ok; // qc: true for the defaults
+  if (type != napi_object) return napi_invalid_arg;
+
+  struct { const char* name; uint32_t* value; uint32_t min; uint32_t max; } counts[] = {
+    { "lineStep", &options->lineStep, 1, 64 },
+    { "blackLuma", &options->blackLuma, 0, 1023 },
+    { "blackFrames", &options->blackFrames, 1, 100000 },
+    { "freezeFrames", &options->freezeFrames, 1, 100000 },
+    { "gamutFrames", &options->gamutFrames, 1, 100000 },
+    { "eventQueue", &options->eventQueue, 1, 4096 } };
+  for ( auto& count : counts ) {
+    status = getOptionalUint32(env, value, count.name, count.value);
+    if (status == napi_number_expected) return napi_invalid_arg;
+    PASS_STATUS;
+    if ((*count.value < count.min) || (*count.value > count.max)) return napi_invalid_arg;
+  }
+  struct { const char* name; double* value; double max; } ratios[] = {
+    { "blackRatio", &options->blackRatio, 1.0 },
+    { "freezeDifference", &options->freezeDifference, 1023.0 },
+    { "gamutRatio", &options->gamutRatio, 1.0 } };
+  for ( auto& ratio : ratios ) {
+    status = getOptionalDouble(env, value, ratio.name, ratio.value);
+    if (status == napi_number_expected) return napi_invalid_arg;
+    PASS_STATUS;
+    if (!(*ratio.value >= 0.0) || (*ratio.value > ratio.max)) return napi_invalid_arg;
+  }
+  return napi_ok;
+}
+
+static const char* qcEventNames[] = {
+  "blackStart", "blackEnd", "freezeStart", "freezeEnd", "gamutStart", "gamutEnd" };
+
+napi_status qcEventsValue(napi_env env, const std::vector<qcEvent>& events, napi_value* value) {
+  napi_status status;
+  napi_value event, param;
+
+  status = napi_create_array(env, value);
+  PASS_STATUS;
+  for ( uint32_t x = 0 ; x < events.size() ; x++ ) {
+    status = napi_create_object(env, &event);
+    PASS_STATUS;
+    status = napi_create_string_utf8(env, qcEventNames[events[x].type], NAPI_AUTO_LENGTH, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, event, "type", param);
+    PASS_STATUS;
+    status = napi_create_int64(env, events[x].sequence, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, event, "sequence", param);
+    PASS_STATUS;
+    status = napi_create_int64(env, events[x].frameTime, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, event, "frameTime", param);
+    PASS_STATUS;
+    if (events[x].frames > 0) {
+      status = napi_create_uint32(env, events[x].frames, &param);
+      PASS_STATUS;
+      status = napi_set_named_property(env, event, "frames", param);
+      PASS_STATUS;
+    }
+    status = napi_set_element(env, *value, x, event);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+// Per-frame stats as { lumaMean, lumaMin, lumaMax, histogram, darkRatio,
+// illegalLuma, illegalChroma, difference, black, frozen, outOfGamut, lines,
+// micros }, with events only when the frame raised any
+napi_status qcFrameValue(napi_env env, qcFrameResult* result, napi_value* value) {
+  napi_status status;
+  napi_value param, arrayBuffer;
+  void* data;
+  const qcFrameStats& stats = result->stats;
+
+  status = napi_create_object(env, value);
+  PASS_STATUS;
+  status = napi_create_double(env, (stats.lumaSamples > 0) ?
+    (double) stats.lumaSum / stats.lumaSamples : 0.0, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "lumaMean", param);
+  PASS_STATUS;
+  status = napi_create_uint32(env, stats.lumaMin, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "lumaMin", param);
+  PASS_STATUS;
+  status = napi_create_uint32(env, stats.lumaMax, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "lumaMax", param);
+  PASS_STATUS;
+  status = napi_create_arraybuffer(env, sizeof(stats.histogram), &data, &arrayBuffer);
+  PASS_STATUS;
+  memcpy(data, stats.histogram, sizeof(stats.histogram));
+  status = napi_create_typedarray(env, napi_uint32_array, QC_HISTOGRAM_BINS, arrayBuffer, 0, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "histogram", param);
+  PASS_STATUS;
+  status = napi_create_double(env, (stats.lumaSamples > 0) ?
+    (double) stats.darkSamples / stats.lumaSamples : 0.0, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "darkRatio", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.illegalLuma, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "illegalLuma", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.illegalChroma, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "illegalChroma", param);
+  PASS_STATUS;
+  status = napi_create_double(env, stats.difference, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "difference", param);
+  PASS_STATUS;
+  status = napi_get_boolean(env, stats.black, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "black", param);
+  PASS_STATUS;
+  status = napi_get_boolean(env, stats.frozen, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "frozen", param);
+  PASS_STATUS;
+  status = napi_get_boolean(env, stats.outOfGamut, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "outOfGamut", param);
+  PASS_STATUS;
+  status = napi_create_uint32(env, stats.lines, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "lines", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.micros, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, *value, "micros", param);
+  PASS_STATUS;
+  if (!result->events.empty()) {
+    status = qcEventsValue(env, result->events, &param);
+    PASS_STATUS;
+    status = napi_set_named_property(env, *value, "events", param);
+    PASS_STATUS;
+  }
+  return napi_ok;
+}
+
+napi_status qcStatsValue(napi_env env, macadamVideoQC* qc, napi_value obj) {
+  napi_status status;
+  napi_value param;
+  qcRunStats stats;
+  qc->getStats(&stats);
+
+  status = napi_create_int64(env, stats.frames, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcFrames", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.blackFrames, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcBlackFrames", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.frozenFrames, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcFrozenFrames", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.gamutFrames, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcGamutFrames", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.events, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcEvents", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.eventsDropped, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcEventsDropped", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.microsLast, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcMicrosLast", param);
+  PASS_STATUS;
+  status = napi_create_int64(env, stats.microsMax, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcMicrosMax", param);
+  PASS_STATUS;
+  status = napi_create_double(env, (stats.frames > 0) ?
+    (double) stats.microsTotal / stats.frames : 0.0, &param);
+  PASS_STATUS;
+  status = napi_set_named_property(env, obj, "qcMicrosMean", param);
+  PASS_STATUS;
+  return napi_ok;
+}
+
+// analyseFrame(buffer, options) - analyses a whole 2vuy or v210 frame with
+// options pixelFormat, width, height, optional rowBytes and the qc capture
+// options. With previous, the signature of an earlier result, the frame is
+// also compared with that frame. The result has the per-frame stats of a
+// captured frame plus its signature, a Uint16Array.
+napi_value analyseFrame(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value argv[2];
+  napi_value result, param, arrayBuffer;
+  napi_valuetype type;
+  napi_typedarray_type arrayType;
+  size_t argc = 2;
+  bool isBuffer;
+  void* data;
+  void* signatureData;
+  size_t dataSize, length;
+  BMDPixelFormat pixelFormat;
+  uint32_t width, height, rowBytes;
+  uint64_t minRowBytes;
+  qcOptions options;
+
+  status = napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+  CHECK_STATUS;
+  if (argc < 2) NAPI_THROW_ERROR("A buffer and analysis options must be provided.");
+
+  status = napi_is_buffer(env, argv[0], &isBuffer);
+  CHECK_STATUS;
+  if (!isBuffer) NAPI_THROW_ERROR("Pixel data must be provided as a node buffer.");
+  status = napi_get_buffer_info(env, argv[0], &data, &dataSize);
+  CHECK_STATUS;
+  status = napi_typeof(env, argv[1], &type);
+  CHECK_STATUS;
+  if (type != napi_object) NAPI_THROW_ERROR("Analysis options must be an object.");
+
+  status = napi_get_named_property(env, argv[1], "pixelFormat", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, (uint32_t*) &pixelFormat);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Pixel format must be an enumeration value.");
+  CHECK_STATUS;
+  if (getUnpackKernel(pixelFormat) == nullptr)
+    NAPI_THROW_ERROR("Only 8-bit and 10-bit YUV pixel formats can be analysed.");
+  status = napi_get_named_property(env, argv[1], "width", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, &width);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Width must be a number.");
+  CHECK_STATUS;
+  status = napi_get_named_property(env, argv[1], "height", &param);
+  CHECK_STATUS;
+  status = napi_get_value_uint32(env, param, &height);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Height must be a number.");
+  CHECK_STATUS;
+  if ((width == 0) || (height == 0)) NAPI_THROW_ERROR("Width and height must be greater than zero.");
+  minRowBytes = pixelFormatMinRowBytes(pixelFormat, width);
+  if (minRowBytes > UINT32_MAX) NAPI_THROW_ERROR("Width is too large.");
+  rowBytes = (uint32_t) minRowBytes;
+  status = getOptionalUint32(env, argv[1], "rowBytes", &rowBytes);
+  if (status == napi_number_expected) NAPI_THROW_ERROR("Row bytes must be a number.");
+  CHECK_STATUS;
+  if (rowBytes < minRowBytes)
+    NAPI_THROW_ERROR("Row bytes is too small for the width and pixel format.");
+  if ((uint64_t) rowBytes * height > dataSize)
+    NAPI_THROW_ERROR("Buffer is too small for the given dimensions and pixel format.");
+  status = parseQCOptions(env, argv[1], &options);
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Invalid analysis options.");
+  CHECK_STATUS;
+
+  qcFrameResult* frameResult = new qcFrameResult;
+  if (!analyseVideoFrame(pixelFormat, (const uint8_t*) data, rowBytes, width, height,
+      options, frameResult)) {
+    frameResult->release();
+    NAPI_THROW_ERROR("Failed to analyse frame.");
+  }
+
+  status = napi_get_named_property(env, argv[1], "previous", &param);
+  if (status == napi_ok) status = napi_typeof(env, param, &type);
+  if ((status == napi_ok) && (type != napi_undefined)) {
+    status = napi_get_typedarray_info(env, param, &arrayType, &length, &signatureData,
+      nullptr, nullptr);
+    if ((status == napi_ok) && (arrayType == napi_uint16_array)) {
+      std::vector<uint16_t> previous((uint16_t*) signatureData, (uint16_t*) signatureData + length);
+      frameResult->stats.difference = signatureDifference(frameResult->signature, previous);
+      frameResult->stats.frozen = (frameResult->stats.difference >= 0.0) &&
+        (frameResult->stats.difference <= options.freezeDifference);
+    } else if (status == napi_ok) {
+      status = napi_invalid_arg;
+    }
+  }
+  if (status == napi_ok) status = qcFrameValue(env, frameResult, &result);
+  if (status == napi_ok) {
+    status = napi_create_arraybuffer(env, frameResult->signature.size() * sizeof(uint16_t),
+      &signatureData, &arrayBuffer);
+  }
+  if (status == napi_ok) {
+    memcpy(signatureData, frameResult->signature.data(),
+      frameResult->signature.size() * sizeof(uint16_t));
+    status = napi_create_typedarray(env, napi_uint16_array, frameResult->signature.size(),
+      arrayBuffer, 0, &param);
+  }
+  if (status == napi_ok) status = napi_set_named_property(env, result, "signature", param);
+  frameResult->release();
+  if (status == napi_invalid_arg) NAPI_THROW_ERROR("Previous must be the Uint16Array signature of an earlier result.");
+  CHECK_STATUS;
+  return result;
+}
+
+// Checks the selected line kernel against the generic build on random lines,
+// with values outside the legal range, for each ragged end
+napi_value qcKernelTest(napi_env env, napi_callback_info info) {
+  napi_status status;
+  napi_value result;
+  bool pass = true;
+  const uint32_t width = 1920 + 6;
+  const uint32_t blocksWide = width / QC_BLOCK_SIZE;
+  std::vector<uint16_t> y(width), cb(width), cr(width);
+  std::vector<uint32_t> refBlocks(blocksWide), testBlocks(blocksWide);
+  qcLineSums ref, test;
+
+  srand(42);
+  for ( uint32_t x = 0 ; x < width ; x++ ) {
+    y[x] = (uint16_t) (rand() & 0x3ff);
+    cb[x] = (uint16_t) (rand() & 0x3ff);
+    cr[x] = (uint16_t) (rand() & 0x3ff);
+  }
+  for ( uint32_t w = width - 11 ; w <= width ; w++ ) {
+    uint32_t blocks = w / QC_BLOCK_SIZE;
+    refBlocks.assign(blocksWide, 7);
+    testBlocks.assign(blocksWide, 7);
+    qcLineDefault(y.data(), cb.data(), cr.data(), w, 80, blocks, refBlocks.data(), &ref);
+    selectedQCLine(y.data(), cb.data(), cr.data(), w, 80, blocks, testBlocks.data(), &test);
+    pass = pass && (ref.lumaSum == test.lumaSum) && (ref.lumaMin == test.lumaMin) &&
+      (ref.lumaMax == test.lumaMax) && (ref.dark == test.dark) &&
+      (ref.illegalLuma == test.illegalLuma) && (ref.illegalChroma == test.illegalChroma);
+    pass = pass && (refBlocks == testBlocks);
+  }
+
+  status = napi_get_boolean(env, pass, &result);
+  CHECK_STATUS;
+  return result;
+}
@@ -0,0 +1,165 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef VIDEO_QC_H
+#define VIDEO_QC_H
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include "node_api.h"
+#include "DeckLinkAPI.h"
+#include "pixel_convert.h"
+
+// Signal QC of 8-bit and 10-bit YUV frames. Each frame is analysed on its
+// own, on any thread, giving luma statistics, counts of samples outside the
+// legal range and a signature of block means. Signatures of consecutive
+// frames are then compared in order, to measure change between frames and
+// to track runs of black, frozen and out of gamut frames.
+
+#define QC_HISTOGRAM_BINS 32 // Of 10-bit luma, 32 code values per bin
+#define QC_BLOCK_SIZE 16 // Width and height of the blocks in a signature, in pixels
+
+// Limits of the legal range, as 10-bit code values
+#define QC_LUMA_MIN 64
+#define QC_LUMA_MAX 940
+#define QC_CHROMA_MIN 64
+#define QC_CHROMA_MAX 960
+
+struct qcOptions {
+  uint32_t lineStep = 1; // Analyse every lineStep-th line
+  uint32_t blackLuma = 80; // 10-bit luma at or below which a sample is dark
+  double blackRatio = 0.98; // Proportion of dark samples for a black frame
+  double freezeDifference = 0.5; // Mean change of block luma at or below which a frame is frozen
+  double gamutRatio = 0.0001; // Proportion of illegal samples for an out of gamut frame
+  uint32_t blackFrames = 1; // Consecutive frames before a run is reported
+  uint32_t freezeFrames = 10;
+  uint32_t gamutFrames = 1;
+  uint32_t eventQueue = 64; // Events held for qcEvents()
+};
+
+enum qcEventType {
+  qcBlackStart = 0,
+  qcBlackEnd,
+  qcFreezeStart,
+  qcFreezeEnd,
+  qcGamutStart,
+  qcGamutEnd
+};
+
+struct qcEvent {
+  qcEventType type;
+  uint64_t sequence; // Frames analysed before this one
+  int64_t frameTime; // Of the first frame of the run for starts, the frame after it for ends
+  uint32_t frames; // Length of a run that has ended
+};
+
+struct qcFrameStats {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t lines = 0; // Lines analysed
+  uint64_t lumaSamples = 0;
+  uint64_t chromaSamples = 0; // Of Cb and Cr together
+  uint64_t lumaSum = 0;
+  uint32_t lumaMin = 1023;
+  uint32_t lumaMax = 0;
+  uint32_t histogram[QC_HISTOGRAM_BINS] = { 0 };
+  uint64_t darkSamples = 0;
+  uint64_t illegalLuma = 0;
+  uint64_t illegalChroma = 0;
+  double difference = -1.0; // Mean absolute change of block luma, -1 for the first frame
+  bool black = false;
+  bool frozen = false;
+  bool outOfGamut = false;
+  int64_t frameTime = 0;
+  long long micros = 0; // Time taken to analyse
+};
+
+// Result of analysing one frame, shared by the copies of a captured frame
+struct qcFrameResult {
+  qcFrameStats stats;
+  uint32_t blocksWide = 0;
+  std::vector<uint16_t> signature; // Mean 10-bit luma of each block, row by row
+  std::vector<qcEvent> events; // Raised by this frame
+  std::atomic<uint32_t> references { 1 };
+
+  void addRef() { references++; }
+  void release() { if (--references == 0) delete this; }
+};
+
+struct qcRunStats {
+  uint64_t frames = 0;
+  uint64_t blackFrames = 0;
+  uint64_t frozenFrames = 0;
+  uint64_t gamutFrames = 0;
+  uint64_t events = 0;
+  uint64_t eventsDropped = 0; // Not taken by qcEvents() before the queue filled
+  long long microsLast = 0;
+  long long microsMax = 0;
+  long long microsTotal = 0;
+};
+
+// Analyses every frame of a capture. analyse may run on several threads at
+// once, while compare must be called once per frame in capture order.
+class macadamVideoQC {
+  struct runState {
+    bool active = false;
+    uint32_t length = 0; // Consecutive matching frames
+    int64_t startTime = 0;
+  };
+
+  qcOptions options;
+  std::vector<uint16_t> previous;
+  uint32_t previousBlocksWide = 0;
+  runState black, frozen, gamut;
+  std::mutex lock; // Of the events and stats
+  std::deque<qcEvent> pending;
+  qcRunStats runStats;
+
+  void track(runState& run, bool matches, uint32_t threshold, qcEventType startType,
+    qcFrameResult* result);
+
+  public:
+    macadamVideoQC(const qcOptions& options) : options(options) { }
+
+    const qcOptions& getOptions() { return options; }
+    // Compares with the previous frame, classifies and raises events
+    void compare(qcFrameResult* result);
+    // Events since the last call, oldest first
+    std::vector<qcEvent> takeEvents();
+    void getStats(qcRunStats* stats);
+};
+
+// Analyses a whole 2vuy or v210 frame, classifying it as black or out of
+// gamut. Returns false for other formats. Without scratch, line buffers are
+// allocated for the call.
+bool analyseVideoFrame(BMDPixelFormat pixelFormat, const uint8_t* src, uint32_t rowBytes,
+  uint32_t width, uint32_t height, const qcOptions& options, qcFrameResult* result,
+  pixelScratch* scratch = nullptr);
+// Select the fastest kernels supported by the CPU. Called once at module load.
+void selectQCKernels();
+// Mean absolute difference of two signatures of the same size, or -1
+double signatureDifference(const std::vector<uint16_t>& a, const std::vector<uint16_t>& b);
+
+napi_status parseQCOptions(napi_env env, napi_value value, qcOptions* options);
+napi_status qcFrameValue(napi_env env, qcFrameResult* result, napi_value* value);
+napi_status qcEventsValue(napi_env env, const std::vector<qcEvent>& events, napi_value* value);
+napi_status qcStatsValue(napi_env env, macadamVideoQC* qc, napi_value obj);
+napi_value analyseFrame(napi_env env, napi_callback_info info);
+napi_value qcKernelTest(napi_env env, napi_callback_info info);
+
+#endif // VIDEO_QC_H
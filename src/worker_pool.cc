@@ -0,0 +1,69 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "worker_pool.h"
+
+macadamWorkerPool::macadamWorkerPool(uint32_t threadCount, uint32_t maxQueued) {
+  this->maxQueued = maxQueued;
+  if (threadCount == 0) threadCount = 1;
+  for ( uint32_t x = 0 ; x < threadCount ; x++ ) {
+    threads.push_back(std::thread(&macadamWorkerPool::run, this, x));
+  }
+}
+
+macadamWorkerPool::~macadamWorkerPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  jobReady.notify_all();
+  for ( auto it = threads.begin() ; it != threads.end() ; ++it ) {
+    it->join();
+  }
+}
+
+bool macadamWorkerPool::submit(macadamJob job) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (stopping) return false;
+    if ((maxQueued > 0) && (jobs.size() >= maxQueued)) return false;
+    jobs.push_back(job);
+  }
+  jobReady.notify_one();
+  return true;
+}
+
+uint32_t macadamWorkerPool::threadCount() {
+  return (uint32_t) threads.size();
+}
+
+uint32_t macadamWorkerPool::queued() {
+  std::lock_guard<std::mutex> guard(lock);
+  return (uint32_t) jobs.size();
+}
+
+void macadamWorkerPool::run(uint32_t workerIndex) {
+  while (true) {
+    macadamJob job;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      jobReady.wait(guard, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) return; // Only when stopping
+      job = jobs.front();
+      jobs.pop_front();
+    }
+    job(workerIndex);
+  }
+}
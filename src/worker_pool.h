@@ -0,0 +1,55 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Job run on a pool thread. The argument is the index of the worker running
+// the job, allowing per-worker resources to be used without locking.
+typedef std::function<void(uint32_t)> macadamJob;
+
+// Fixed-size pool of native threads with a bounded job queue, so that heavy
+// per-frame work never runs on the Node.js main thread or the libuv pool.
+class macadamWorkerPool {
+    std::vector<std::thread> threads;
+    std::deque<macadamJob> jobs;
+    std::mutex lock;
+    std::condition_variable jobReady;
+    uint32_t maxQueued;
+    bool stopping = false;
+
+    void run(uint32_t workerIndex);
+
+    public:
+        // A maxQueued of zero means the job queue is unbounded
+        macadamWorkerPool(uint32_t threadCount, uint32_t maxQueued = 0);
+        // Runs any jobs already submitted, then joins the worker threads
+        ~macadamWorkerPool();
+
+        // Returns false without queueing the job if the queue is full
+        bool submit(macadamJob job);
+        uint32_t threadCount();
+        uint32_t queued();
+};
+
+#endif // WORKER_POOL_H
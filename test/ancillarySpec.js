@@ -0,0 +1,78 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+const test = require('tape');
+const macadam = require('bindings')('macadam');
+const SegfaultHandler = require('segfault-handler');
+SegfaultHandler.registerHandler('crash.log');
+
+// Caption distribution packet at 29.97 with a CEA-608 pair, a padding entry
+// marked invalid and a DTVCC packet start
+const cdp = Buffer.from('9669164f43123472e3fc9420fa0000ff022174123438', 'hex');
+
+test('Decodes CEA-708 caption distribution packets.', t => {
+  let event = macadam.decodeAncillary({ did: 0x61, sdid: 0x01, data: cdp });
+  t.equal(event.type, 'cea708', 'event has the cea708 type.');
+  t.equal(event.frameRateCode, 4, 'frame rate code is 29.97.');
+  t.equal(event.sequence, 0x1234, 'sequence counter is decoded.');
+  t.ok(event.captionServiceActive, 'caption service is active.');
+  t.deepEqual([...event.ccData], [ 0, 0x94, 0x20, 3, 0x02, 0x21 ],
+    'only valid caption entries are kept.');
+  let corrupt = Buffer.from(cdp);
+  corrupt[10] ^= 0x01;
+  t.equal(macadam.decodeAncillary({ did: 0x61, sdid: 0x01, data: corrupt }), undefined,
+    'packet with a bad checksum is not decoded.');
+  t.end();
+});
+
+test('Decodes AFD and bar data.', t => {
+  let event = macadam.decodeAncillary({ did: 0x41, sdid: 0x05,
+    data: Buffer.from('4400000000000000', 'hex') });
+  t.deepEqual(event, { type: 'afd', afd: 8, wide: true, barFlags: 0 },
+    'full frame 16:9 AFD has no bars.');
+  event = macadam.decodeAncillary({ did: 0x41, sdid: 0x05,
+    data: Buffer.from('500000c0008a03b6', 'hex') });
+  t.equal(event.afd, 10, 'AFD code is decoded.');
+  t.notOk(event.wide, '4:3 aspect ratio flag is decoded.');
+  t.equal(event.barFlags, 0xc0, 'top and bottom bar flags are set.');
+  t.equal(event.barValue1, 138, 'top bar ends at line 138.');
+  t.equal(event.barValue2, 950, 'bottom bar starts at line 950.');
+  t.end();
+});
+
+// Multiple operation message holding a splice_start_normal splice request
+const spliceInsert = Buffer.from('08' + 'ffff001e' + '000005' + '0000' + '00' + '00' + '01' +
+  '0101000e' + '01' + '00003039' + '0001' + '1f40' + '012c' + '00' + '00' + '01', 'hex');
+
+test('Decodes SCTE-104 splice requests.', t => {
+  let event = macadam.decodeAncillary({ did: 0x41, sdid: 0x07, data: spliceInsert });
+  t.equal(event.type, 'scte104', 'event has the scte104 type.');
+  t.equal(event.messageNumber, 5, 'message number is decoded.');
+  t.equal(event.timeType, 0, 'message has no timestamp.');
+  t.deepEqual(event.operations, [ { opID: 0x0101, spliceInsertType: 1, spliceEventId: 12345,
+    uniqueProgramId: 1, preRollTime: 8000, breakDuration: 300, availNum: 0,
+    availsExpected: 0, autoReturn: true } ], 'splice request is decoded.');
+  t.equal(macadam.decodeAncillary({ did: 0x41, sdid: 0x07, data: spliceInsert.slice(0, 20) }),
+    undefined, 'truncated message is not decoded.');
+  t.end();
+});
+
+test('Ignores packets without a decoder.', t => {
+  t.equal(macadam.decodeAncillary({ did: 0x60, sdid: 0x60, data: Buffer.alloc(16) }), undefined,
+    'ATC timecode packet is not decoded.');
+  t.throws(() => macadam.decodeAncillary({ did: 0x61, sdid: 0x01, data: 'cdp' }),
+    /must be a node buffer/, 'packet data must be a buffer.');
+  t.end();
+});
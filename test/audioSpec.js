@@ -0,0 +1,71 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+const test = require('tape');
+const macadam = require('bindings')('macadam');
+const SegfaultHandler = require('segfault-handler');
+SegfaultHandler.registerHandler('crash.log');
+
+// Interleaved samples where channel c of frame i has value (c + 1) * 100 + i, negated on odd frames
+function interleaved(sampleType, channels, frames) {
+  let b = Buffer.alloc(channels * frames * sampleType / 8);
+  for ( let i = 0 ; i < frames ; i++ ) {
+    for ( let c = 0 ; c < channels ; c++ ) {
+      let v = ((c + 1) * 100 + i) * ((i & 1) ? -1 : 1);
+      if (sampleType === 16) {
+        b.writeInt16LE(v, (i * channels + c) * 2);
+      } else {
+        b.writeInt32LE(v << 16, (i * channels + c) * 4);
+      }
+    }
+  }
+  return b;
+}
+
+test('Converts interleaved audio to planar float32.', t => {
+  for ( let sampleType of [ 16, 32 ] ) {
+    let planar = macadam.audioToFloat(interleaved(sampleType, 16, 1921),
+      { sampleType: sampleType, channels: 16 });
+    t.equal(planar.length, 16, `${sampleType}-bit audio has a plane per channel.`);
+    t.ok(planar[3] instanceof Float32Array, `${sampleType}-bit planes are Float32Arrays.`);
+    t.equal(planar[3].length, 1921, `${sampleType}-bit planes have a sample per frame.`);
+    t.equal(planar[3][0], 400 / 32768, `${sampleType}-bit samples are scaled to [-1, 1).`);
+    t.equal(planar[15][1919], -(1600 + 1919) / 32768, `${sampleType}-bit negative samples convert.`);
+    t.equal(planar[15][1920], (1600 + 1920) / 32768, `${sampleType}-bit final sample converts.`);
+  }
+  t.end();
+});
+
+test('Selects and reorders channels.', t => {
+  let planar = macadam.audioToFloat(interleaved(16, 8, 100),
+    { sampleType: 16, channels: 8, channelMap: [ 7, 0, 0 ] });
+  t.equal(planar.length, 3, 'has one plane per mapped channel.');
+  t.equal(planar[0][2], 802 / 32768, 'first plane is source channel 7.');
+  t.deepEqual(planar[1], planar[2], 'a source channel can be repeated.');
+  t.throws(() => macadam.audioToFloat(Buffer.alloc(32), { channels: 2, channelMap: [ 2 ] }),
+    /array of source channels/, 'source channel must exist.');
+  t.end();
+});
+
+test('Kernels produce the same results.', t => {
+  for ( let sampleType of [ 16, 32 ] ) {
+    let data = interleaved(sampleType, 6, 333);
+    let reference = macadam.audioToFloat(data,
+      { sampleType: sampleType, channels: 6, kernel: 'scalar' });
+    let selected = macadam.audioToFloat(data, { sampleType: sampleType, channels: 6 });
+    t.deepEqual(selected, reference, `selected ${sampleType}-bit kernel matches scalar.`);
+  }
+  t.end();
+});
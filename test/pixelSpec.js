@@ -0,0 +1,95 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+const test = require('tape');
+const macadam = require('bindings')('macadam');
+const SegfaultHandler = require('segfault-handler');
+SegfaultHandler.registerHandler('crash.log');
+
+test('Passes C++ pixel conversion tests.', t => {
+  t.ok(macadam.pixelConvertTest(), 'Passes all pixel conversion tests.');
+  t.end();
+});
+
+test('Swizzles BGRA to RGBA in place.', t => {
+  let b = Buffer.from([ 1, 2, 3, 4, 5, 6, 7, 8 ]);
+  let kernel = macadam.swizzleBGRA(b);
+  t.equal(typeof kernel, 'string', `reports the kernel used, ${kernel}.`);
+  t.deepEqual(b, Buffer.from([ 3, 2, 1, 255, 7, 6, 5, 255 ]), 'swaps red and blue, sets alpha.');
+  t.equal(macadam.swizzleBGRA(b, 'scalar'), 'scalar', 'scalar kernel can be requested.');
+  t.throws(() => macadam.swizzleBGRA(b, 'mmx'), /not available/, 'unknown kernel throws.');
+  t.end();
+});
+
+const v210 = 0x76323130; // bmdFormat10BitYUV
+const uyvy = 0x32767579; // bmdFormat8BitYUV
+
+function v210Line(y, cb, cr, width) {
+  let b = Buffer.alloc(Math.floor((width + 47) / 48) * 128);
+  for ( let x = 0 ; x < width ; x += 6 ) {
+    let o = (x / 6) * 16;
+    b.writeUInt32LE((cb | (y << 10) | (cr << 20)) >>> 0, o);
+    b.writeUInt32LE((y | (cb << 10) | (y << 20)) >>> 0, o + 4);
+    b.writeUInt32LE((cr | (y << 10) | (cb << 20)) >>> 0, o + 8);
+    b.writeUInt32LE((y | (cr << 10) | (y << 20)) >>> 0, o + 12);
+  }
+  return b;
+}
+
+test('Converts synthetic v210 and 2vuy frames.', t => {
+  let red = Buffer.concat(Array(720).fill(v210Line(250, 409, 960, 12))); // BT.709 red
+  let rgba = macadam.convertPixels(red, { pixelFormat: v210,
+    width: 12, height: 720, convertTo: 'rgba' });
+  t.equal(rgba.length, 12 * 720 * 4, 'RGBA frame is the expected size.');
+  t.deepEqual([...rgba.slice(0, 4)], [ 255, 0, 0, 255 ], 'v210 red converts to RGBA red.');
+  let planar = macadam.convertPixels(red, { pixelFormat: v210,
+    width: 12, height: 720, convertTo: 'yuv422p10' });
+  t.equal(planar.readUInt16LE(0), 250, 'luma plane holds 10-bit Y.');
+  t.equal(planar.readUInt16LE(12 * 720 * 2), 409, 'Cb plane follows the luma plane.');
+  let white = Buffer.alloc(16 * 576 * 2);
+  for ( let x = 0 ; x < white.length ; x += 4 ) white.set([ 128, 235, 128, 235 ], x);
+  let rgb48 = macadam.convertPixels(white, { pixelFormat: uyvy,
+    width: 16, height: 576, convertTo: 'rgb48' });
+  t.ok(rgb48.readUInt16LE(0) > 65000, '2vuy white converts to RGB48 white.');
+  t.throws(() => macadam.convertPixels(red, { pixelFormat: v210,
+    width: 12, height: 720, convertTo: 'cmyk' }), /one of/, 'unknown target throws.');
+  t.throws(() => macadam.convertPixels(red, { pixelFormat: v210, width: 4000000,
+    height: 1, rowBytes: 1, convertTo: 'rgba' }), /too small/, 'short rowBytes throws.');
+  t.end();
+});
+
+test('Downscales synthetic v210 and 2vuy frames.', t => {
+  let red = Buffer.concat(Array(720).fill(v210Line(250, 409, 960, 48)));
+  let quarter = macadam.convertPixels(red, { pixelFormat: v210,
+    width: 48, height: 720, convertTo: 'rgba', outWidth: 12, outHeight: 180 });
+  t.equal(quarter.length, 12 * 180 * 4, 'quarter size RGBA proxy is the expected size.');
+  t.deepEqual([...quarter.slice(-4)], [ 255, 0, 0, 255 ], 'red stays red.');
+  let uyvyProxy = macadam.convertPixels(red, { pixelFormat: v210,
+    width: 48, height: 720, convertTo: 'uyvy', outWidth: 20, outHeight: 100 });
+  t.deepEqual([...uyvyProxy.slice(0, 4)], [ 102, 62, 240, 62 ], 'v210 scales to 2vuy at any size.');
+  let stripes = Buffer.alloc(16 * 4 * 2);
+  for ( let x = 0 ; x < stripes.length ; x += 4 ) {
+    stripes.set((x / 4) % 2 ? [ 128, 200, 128, 200 ] : [ 128, 100, 128, 100 ], x);
+  }
+  let half = macadam.convertPixels(stripes, { pixelFormat: uyvy,
+    width: 16, height: 4, convertTo: 'uyvy', outWidth: 4, outHeight: 2 });
+  t.deepEqual([...half.slice(0, 4)], [ 128, 150, 128, 150 ], 'averages the pixels covered.');
+  t.throws(() => macadam.convertPixels(red, { pixelFormat: v210, width: 48, height: 720,
+    convertTo: 'rgba', outWidth: 13, outHeight: 180 }), /even/, 'odd output width throws.');
+  t.throws(() => macadam.convertPixels(red, { pixelFormat: v210, width: 48, height: 720,
+    rowBytes: 64, convertTo: 'rgba', outWidth: 12, outHeight: 180 }), /too small/,
+    'short rowBytes throws when scaling.');
+  t.end();
+});
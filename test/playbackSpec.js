@@ -0,0 +1,38 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+const test = require('tape');
+const macadam = require('bindings')('macadam');
+const SegfaultHandler = require('segfault-handler');
+SegfaultHandler.registerHandler('crash.log');
+
+test('Pending played promises are found and expired by frame.', t => {
+  for ( let depth of [ 1, 5, 50, 500 ] ) {
+    let result = macadam.pendingPlayTest(depth, 2000);
+    t.ok(result.ok, `ring matches a map of promises at depth ${depth}.`);
+    let last = 2000 - 1 - (Math.floor(depth / 2) + 1); // Last frame to time out
+    t.equal(result.expired, Math.floor((last + 1) / 4), `skipped frames expire at depth ${depth}.`);
+  }
+  t.end();
+});
+
+test('Frames are copied into the output pool at any alignment.', t => {
+  let result = macadam.frameCopyTest(4099, 1);
+  t.ok(result.ok, `selected ${result.kernel} kernel copies exactly.`);
+  t.ok(macadam.frameCopyTest(4099, 1, 'memcpy').ok, 'memcpy kernel copies exactly.');
+  t.throws(() => macadam.frameCopyTest(4099, 1, 'sse9'), /not available/,
+    'unknown kernel throws.');
+  t.end();
+});
@@ -0,0 +1,82 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+const test = require('tape');
+const macadam = require('bindings')('macadam');
+const SegfaultHandler = require('segfault-handler');
+SegfaultHandler.registerHandler('crash.log');
+
+const v210 = 0x76323130; // bmdFormat10BitYUV
+const uyvy = 0x32767579; // bmdFormat8BitYUV
+
+function v210Line(y, cb, cr, width) {
+  let b = Buffer.alloc(Math.floor((width + 47) / 48) * 128);
+  for ( let x = 0 ; x < width ; x += 6 ) {
+    let o = (x / 6) * 16;
+    b.writeUInt32LE((cb | (y << 10) | (cr << 20)) >>> 0, o);
+    b.writeUInt32LE((y | (cb << 10) | (y << 20)) >>> 0, o + 4);
+    b.writeUInt32LE((cr | (y << 10) | (cb << 20)) >>> 0, o + 8);
+    b.writeUInt32LE((y | (cr << 10) | (y << 20)) >>> 0, o + 12);
+  }
+  return b;
+}
+
+test('Selected line kernel matches the generic build.', t => {
+  t.ok(macadam.qcKernelTest(), 'kernels agree on random lines.');
+  t.end();
+});
+
+test('Analyses synthetic v210 and 2vuy frames.', t => {
+  let black = Buffer.concat(Array(64).fill(v210Line(64, 512, 512, 48)));
+  let result = macadam.analyseFrame(black, { pixelFormat: v210, width: 48, height: 64 });
+  t.ok(result.black, 'v210 black frame is black.');
+  t.notOk(result.outOfGamut, 'v210 black frame is legal.');
+  t.equal(result.lumaMean, 64, 'luma mean is black.');
+  t.equal(result.histogram[2], 48 * 64, 'every sample is in the third histogram bin.');
+  t.equal(result.signature.length, 3 * 4, 'signature has one mean per 16x16 block.');
+  t.equal(result.difference, -1, 'no difference without a previous frame.');
+
+  let grey = Buffer.alloc(32 * 32 * 2);
+  for ( let x = 0 ; x < grey.length ; x += 2 ) {
+    grey[x] = 128;
+    grey[x + 1] = 128;
+  }
+  result = macadam.analyseFrame(grey, { pixelFormat: uyvy, width: 32, height: 32 });
+  t.notOk(result.black, 'mid grey 2vuy frame is not black.');
+  t.equal(result.lumaMean, 512, '8-bit luma is scaled to 10 bits.');
+  let again = macadam.analyseFrame(grey, { pixelFormat: uyvy, width: 32, height: 32,
+    previous: result.signature });
+  t.equal(again.difference, 0, 'identical frames do not differ.');
+  t.ok(again.frozen, 'identical frames are frozen.');
+  let changed = macadam.analyseFrame(black.slice(0, 128 * 32), { pixelFormat: v210,
+    width: 48, height: 32, previous: result.signature });
+  t.equal(changed.difference, -1, 'frames of different sizes are not compared.');
+
+  let illegal = Buffer.concat(Array(32).fill(v210Line(1000, 512, 1010, 48)));
+  result = macadam.analyseFrame(illegal, { pixelFormat: v210, width: 48, height: 32,
+    lineStep: 2 });
+  t.ok(result.outOfGamut, 'super-white frame is out of gamut.');
+  t.equal(result.lines, 16, 'every other line is analysed.');
+  t.equal(result.illegalLuma, 48 * 16, 'counts every illegal luma sample.');
+  t.equal(result.illegalChroma, 24 * 16, 'counts illegal Cr samples.');
+
+  t.throws(() => macadam.analyseFrame(black, { pixelFormat: v210, width: 48, height: 65 }),
+    /too small/, 'short buffer throws.');
+  t.throws(() => macadam.analyseFrame(black, { pixelFormat: v210, width: 4000000, height: 1,
+    rowBytes: 1 }), /Row bytes is too small/, 'short rowBytes throws.');
+  t.throws(() => macadam.analyseFrame(black, { pixelFormat: v210, width: 48, height: 64,
+    blackRatio: 2 }), /Invalid/, 'out of range option throws.');
+  t.end();
+});
@@ -0,0 +1,97 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+const test = require('tape');
+const macadam = require('bindings')('macadam');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const SegfaultHandler = require('segfault-handler');
+SegfaultHandler.registerHandler('crash.log');
+
+test('Records synthetic frames to video and broadcast WAV files.', t => {
+  let video = path.join(os.tmpdir(), `macadam_test_${process.pid}.v210`);
+  let audio = path.join(os.tmpdir(), `macadam_test_${process.pid}.wav`);
+  let stats = macadam.recorderTest({ video: video, audio: audio, frames: 12,
+    videoBytes: 3 * 4096 + 100, channels: 4, sampleType: 16, sampleFrames: 1601,
+    writeSize: 8 * 4096 });
+
+  t.equal(stats.recordFrames, 12, 'writes every frame.');
+  t.equal(stats.recordDropped, 0, 'drops no frames.');
+  t.equal(stats.recordErrors, 0, 'has no errors.');
+  t.equal(typeof stats.recordDirectIO, 'boolean', 'reports whether direct I/O is used.');
+
+  let v = fs.readFileSync(video);
+  t.equal(v.length, 12 * (3 * 4096 + 100), 'video file has every frame.');
+  t.ok(v[5 * (3 * 4096 + 100)] === 5 && v[6 * (3 * 4096 + 100) - 1] === 5 &&
+    v[11 * (3 * 4096 + 100)] === 11, 'video frames are in order.');
+
+  let a = fs.readFileSync(audio);
+  let dataBytes = 12 * 1601 * 4 * 2;
+  t.equal(a.toString('ascii', 0, 4), 'RIFF', 'audio file is RIFF.');
+  t.equal(a.readUInt32LE(4), a.length - 8, 'RIFF size is set on close.');
+  t.equal(a.toString('ascii', 8, 12), 'WAVE', 'audio file is WAVE.');
+  t.equal(a.readUInt16LE(22), 4, 'has four channels.');
+  t.equal(a.toString('ascii', 60, 64), 'bext', 'has a broadcast extension chunk.');
+  t.equal(a.readUInt32LE(68 + 338), 1000, 'time reference is the first sample time.');
+  t.equal(a.toString('ascii', 4088, 4092), 'data', 'data chunk header ends on a block.');
+  t.equal(a.readUInt32LE(4092), dataBytes, 'data size is set on close.');
+  t.equal(a.length, 4096 + dataBytes, 'audio file has every sample.');
+  t.equal(a.readInt16LE(4096 + 2 * (1601 * 4 * 7 + 3)), (1601 * 4 * 7 + 3) & 0x7fff,
+    'samples are in order.');
+
+  fs.unlinkSync(video);
+  fs.unlinkSync(audio);
+  t.end();
+});
+
+test('Rotates segments with a per-frame index.', t => {
+  let base = path.join(os.tmpdir(), `macadam_seg_${process.pid}`);
+  let frameBytes = 2 * 4096 + 52;
+  let audioBytes = 1920 * 2 * 4;
+  let stats = macadam.recorderTest({ video: base + '.v210', audio: base + '.wav',
+    index: base + '.idx', frames: 12, videoBytes: frameBytes, channels: 2,
+    sampleType: 32, sampleFrames: 1920, segmentFrames: 5, writeSize: 4 * 4096 });
+
+  t.equal(stats.recordFrames, 12, 'writes every frame.');
+  t.equal(stats.recordSegment, 2, 'ends in the third segment.');
+  t.equal(stats.recordIndexRecords, 12, 'indexes every frame.');
+  t.equal(stats.recordErrors, 0, 'has no errors.');
+
+  [ 5, 5, 2 ].forEach((count, s) => {
+    let name = `${base}_00000${s}`;
+    let v = fs.readFileSync(name + '.v210');
+    let a = fs.readFileSync(name + '.wav');
+    let x = fs.readFileSync(name + '.idx');
+    t.equal(v.length, count * frameBytes, `segment ${s} has ${count} video frames.`);
+    t.equal(a.readUInt32LE(4092), count * audioBytes, `segment ${s} WAV header is complete.`);
+    t.equal(a.readUInt32LE(44 + 338), 1000 + s * 5 * 1920, `segment ${s} has its own time reference.`);
+    t.equal(x.toString('ascii', 0, 8), 'MCDMIDX1', `segment ${s} index has a header.`);
+    t.equal(x.length, 64 + count * 48, `segment ${s} index has a record per frame.`);
+    t.equal(Number(x.readBigUInt64LE(24)), s * 5, `segment ${s} index has its first frame number.`);
+    let last = 64 + (count - 1) * 48;
+    let n = s * 5 + count - 1;
+    t.ok(Number(x.readBigUInt64LE(last)) === n &&
+      Number(x.readBigUInt64LE(last + 8)) === (count - 1) * frameBytes &&
+      Number(x.readBigInt64LE(last + 16)) === n * 1000 &&
+      Number(x.readBigUInt64LE(last + 24)) === 4096 + (count - 1) * audioBytes &&
+      x.readUInt32LE(last + 32) === frameBytes && x.readUInt32LE(last + 36) === audioBytes &&
+      x.readUInt32LE(last + 40) === (0x01000000 | Math.floor(n / 10) << 4 | n % 10) &&
+      x.readUInt16LE(last + 46) === 1, `segment ${s} records locate the last frame.`);
+    t.equal(v[x.readUInt32LE(last + 8)], n, `segment ${s} offsets point at the frame.`);
+    [ '.v210', '.wav', '.idx' ].forEach(e => fs.unlinkSync(name + e));
+  });
+  t.end();
+});
@@ -0,0 +1,72 @@
+/* Copyright 2018 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+const test = require('tape');
+const macadam = require('bindings')('macadam');
+const SegfaultHandler = require('segfault-handler');
+SegfaultHandler.registerHandler('crash.log');
+
+test('Reads frames from a shared memory ring.', async t => {
+  let name = `macadam_test_${process.pid}`;
+  let producer = macadam.sharedRingTest({ name: name, slots: 4 });
+  let reader = macadam.openSharedRing({ name: name });
+  t.ok(reader.slots === 4 && reader.width === 64 && reader.channels === 2,
+    'reader has the ring format.');
+  t.equal(reader.read(), undefined, 'nothing to read before frames are published.');
+
+  producer.publish(2);
+  let frame = reader.read();
+  t.ok(frame.sequence === 0 && frame.video.frameTime === 0 && frame.video.data[0] === 0,
+    'reads the first frame.');
+  frame = reader.read();
+  t.ok(frame.sequence === 1 && frame.video.data.length === 512 && frame.video.data[511] === 1 &&
+    frame.video.timecodeBCD === 0x01000001, 'reads the second frame.');
+  t.ok(frame.audio.sampleFrameCount === 1920 && frame.audio.data.readInt16LE(6) === 4,
+    'frame has audio.');
+  t.equal(reader.read(), undefined, 'has read every frame.');
+
+  producer.publish(6);
+  frame = reader.read();
+  let stats = reader.stats();
+  t.equal(frame.sequence, 5, 'skips to the oldest frame that is safe to read.');
+  t.ok(stats.overruns === 1 && stats.framesLost === 3 && stats.lag === 2,
+    'counts the overrun, frames lost and lag.');
+  t.ok(reader.valid(frame), 'frame is valid until overwritten.');
+  producer.publish(4);
+  t.notOk(reader.valid(frame), 'frame is invalid once overwritten.');
+  t.equal(frame.video.data.length, 512, 'buffers stay mapped.');
+
+  let oldest = macadam.openSharedRing({ name: name, start: 'oldest' });
+  t.equal(oldest.read().sequence, 9, 'another reader can start from the oldest frame.');
+
+  setTimeout(() => producer.publish(1), 20);
+  reader.read(); reader.read(); reader.read(); reader.read();
+  frame = await reader.frame(1000);
+  t.equal(frame.sequence, 12, 'waits for the next frame.');
+  await reader.frame(20).then(() => t.fail('should time out.'),
+    err => t.ok(/Timed out/.test(err.message), 'times out waiting for a frame.'));
+  t.throws(() => macadam.sharedRingTest({ name: name, slots: 4 }), /in use/,
+    'cannot replace a ring that is in use.');
+
+  producer.close();
+  t.ok(reader.stats().producerClosed, 'sees the producer close.');
+  t.equal(await reader.frame(1000), undefined, 'resolves undefined once closed and read.');
+  t.throws(() => macadam.openSharedRing({ name: name }), /Unable to open/,
+    'closed ring can no longer be opened.');
+  reader.close();
+  oldest.close();
+  t.throws(() => reader.read(), /closed/, 'reader cannot be used after closing.');
+  t.end();
+});
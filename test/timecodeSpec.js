@@ -22,3 +22,10 @@ test('Passes C++ timecode value tests.', t => {
   t.ok(macadam.timecodeTest(), 'Passes all timecode tests.');
   t.end();
 });
+
+test('Formats BCD timecode values.', t => {
+  t.equal(macadam.formatTimecode(0x10111213), '10:11:12:13', 'formats non-drop frame timecode.');
+  t.equal(macadam.formatTimecode(0x10111213, 1), '10:11:12;13', 'formats drop frame timecode.');
+  t.equal(macadam.formatTimecode(0x10111213, 2, true), '10:11:12:13.1', 'adds a field flag.');
+  t.end();
+});